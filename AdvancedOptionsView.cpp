@@ -8,12 +8,15 @@
 #include "ControllerObserver.h"
 #include "FrameRateView.h"
 #include "MediaFormatView.h"
+#include "MovieEncoder.h"
+#include "PriorityControl.h"
 #include "Settings.h"
 
 #include <Box.h>
 #include <Catalog.h>
 #include <CheckBox.h>
 #include <LayoutBuilder.h>
+#include <OptionPopUp.h>
 
 
 const static uint32 kLocalUseDirectWindow = 'UsDW';
@@ -22,6 +25,8 @@ const static uint32 kLocalEnableShortcut = 'EnSh';
 const static uint32 kLocalSelectOnStart = 'SeSt';
 const static uint32 kLocalMinimizeOnRecording = 'MiRe';
 const static uint32 kLocalQuitWhenFinished = 'QuFi';
+const static uint32 kLocalEncoderPreset = 'EnPr';
+const static uint32 kLocalScaleWhileCapturing = 'ScCa';
 
 
 #undef B_TRANSLATION_CONTEXT
@@ -43,10 +48,21 @@ AdvancedOptionsView::AdvancedOptionsView()
 	frameBox->SetLabel(B_TRANSLATE("Frame rate"));
 	advancedBox->SetLabel(B_TRANSLATE("Advanced"));
 
-	BView* layoutView = BLayoutBuilder::Group<>()
+	fEncoderPreset = new BOptionPopUp("encoder_preset",
+		B_TRANSLATE("Encoder preset:"), new BMessage(kLocalEncoderPreset));
+	for (int32 i = 0; i < MovieEncoder::CountPresets(); i++)
+		fEncoderPreset->AddOption(MovieEncoder::PresetName((encoder_preset)i), i);
+	fPriorityControl = new PriorityControl("encoding_priority",
+		B_TRANSLATE("Encoding priority:"));
+
+	BView* layoutView = BLayoutBuilder::Group<>(B_VERTICAL)
 		.SetInsets(B_USE_DEFAULT_SPACING, B_USE_DEFAULT_SPACING,
 			B_USE_DEFAULT_SPACING, B_USE_DEFAULT_SPACING)
 		.Add(new MediaFormatView())
+		.AddGroup(B_HORIZONTAL)
+			.Add(fEncoderPreset)
+			.Add(fPriorityControl)
+		.End()
 		.View();
 
 	encodingBox->AddChild(layoutView);
@@ -87,12 +103,18 @@ AdvancedOptionsView::AdvancedOptionsView()
 			.Add(fQuitWhenFinished = new BCheckBox("quit_when_finished",
 					B_TRANSLATE("Quit when finished"),
 					new BMessage(kLocalQuitWhenFinished)))
+			.Add(fScaleWhileCapturing = new BCheckBox("scale_while_capturing",
+					B_TRANSLATE("Scale while capturing"),
+					new BMessage(kLocalScaleWhileCapturing)))
 		.End()
 		.View();
 
 	fHideDeskbarIcon->SetToolTip(B_TRANSLATE(
 		"Stop recording with with CTRL+ALT+SHIFT+R,\n"
 		"or define a key combination with the Shortcuts preferences."));
+	fScaleWhileCapturing->SetToolTip(B_TRANSLATE(
+		"Reduce the frames as they're captured: it takes less memory\n"
+		"and disk space, at the cost of some CPU while recording."));
 
 	advancedBox->AddChild(layoutView);
 
@@ -112,9 +134,12 @@ AdvancedOptionsView::AdvancedOptionsView()
 		fHideDeskbarIcon->SetValue(B_CONTROL_OFF);
 	}
 	fQuitWhenFinished->SetValue(settings.QuitWhenFinished() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fScaleWhileCapturing->SetValue(settings.ScaleWhileCapturing() ? B_CONTROL_ON : B_CONTROL_OFF);
 	fSelectOnStart->SetEnabled(settings.EnableShortcut());
 	fUseShortcut->SetValue(settings.EnableShortcut() ? B_CONTROL_ON : B_CONTROL_OFF);
 	fSelectOnStart->SetValue(settings.SelectOnStart() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fEncoderPreset->SetValue(settings.EncoderPreset());
+	fPriorityControl->SetValue(settings.EncodingThreadPriority());
 }
 
 
@@ -131,6 +156,9 @@ AdvancedOptionsView::AttachedToWindow()
 	fUseShortcut->SetTarget(this);
 	fSelectOnStart->SetTarget(this);
 	fQuitWhenFinished->SetTarget(this);
+	fScaleWhileCapturing->SetTarget(this);
+	fEncoderPreset->SetTarget(this);
+	fPriorityControl->SetTarget(this);
 }
 
 
@@ -175,6 +203,18 @@ AdvancedOptionsView::MessageReceived(BMessage *message)
 			Settings::Current().SetQuitWhenFinished(fQuitWhenFinished->Value() == B_CONTROL_ON);
 			break;
 
+		case kLocalScaleWhileCapturing:
+			Settings::Current().SetScaleWhileCapturing(fScaleWhileCapturing->Value() == B_CONTROL_ON);
+			break;
+
+		case kLocalEncoderPreset:
+			Settings::Current().SetEncoderPreset(fEncoderPreset->Value());
+			break;
+
+		case kPriorityChanged:
+			Settings::Current().SetEncodingThreadPriority(fPriorityControl->Value());
+			break;
+
 		case kLocalEnableShortcut:
 			Settings::Current().SetEnableShortcut(fUseShortcut->Value() == B_CONTROL_ON);
 			fSelectOnStart->SetEnabled(fUseShortcut->Value() == B_CONTROL_ON);
@@ -207,6 +247,10 @@ AdvancedOptionsView::MessageReceived(BMessage *message)
 					fSelectOnStart->SetEnabled(false);
 					fHideDeskbarIcon->SetValue(B_CONTROL_OFF);
 					fQuitWhenFinished->SetValue(B_CONTROL_OFF);
+					fScaleWhileCapturing->SetValue(B_CONTROL_OFF);
+					fEncoderPreset->SetValue(Settings::Current().EncoderPreset());
+					fPriorityControl->SetValue(
+						Settings::Current().EncodingThreadPriority());
 					_EnableDirectWindowIfSupported();
 					break;
 				}
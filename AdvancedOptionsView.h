@@ -8,6 +8,8 @@
 #include <View.h>
 
 class BCheckBox;
+class BOptionPopUp;
+class PriorityControl;
 class SizeControl;
 class AdvancedOptionsView : public BView {
 public:
@@ -23,6 +25,9 @@ private:
 	BCheckBox* fUseShortcut;
 	BCheckBox* fSelectOnStart;
 	BCheckBox* fQuitWhenFinished;
+	BCheckBox* fScaleWhileCapturing;
+	BOptionPopUp* fEncoderPreset;
+	PriorityControl* fPriorityControl;
 	bool fCurrentMinimizeValue;
 
 	void _EnableDirectWindowIfSupported();
@@ -22,6 +22,7 @@
 #include <String.h>
 #include <StringList.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
@@ -30,14 +31,22 @@
 
 #include "Arguments.h"
 #include "BSCWindow.h"
+#include "CapturePipeline.h"
+#include "ColorConversion.h"
 #include "Constants.h"
 #include "ControllerObserver.h"
 #include "DeskbarControlView.h"
+#include "FrameConverter.h"
+#include "FrameCopier.h"
+#include "FramePool.h"
+#include "FrameReducer.h"
+#include "FrameSpool.h"
 #include "FramesList.h"
 #include "MovieEncoder.h"
 #include "PublicMessages.h"
 #include "SelectionWindow.h"
 #include "Settings.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 #undef B_TRANSLATION_CONTEXT
@@ -48,6 +57,19 @@ const char kChangeLog[] = {
 #include "Changelog.h"
 };
 
+// Number of threads writing the captured frames to disk
+const static int32 kCapturePipelineWriters = 2;
+// More threads don't copy the frames any faster: the memory is the limit
+const static int32 kFrameCopyThreads = 4;
+
+// The raw formats the codecs are offered, best first. Most of them work
+// in planar YUV: the encoder converts the frames to it on all the CPUs,
+// instead of the codec on its own thread.
+const static color_space kCodecColorSpaces[] = {
+	B_YUV420,
+	B_YCbCr422
+};
+
 const char* kAuthors[] = {
 	"Stefano Ceccherini (stefano.ceccherini@gmail.com)",
 	NULL
@@ -148,9 +170,11 @@ BSCApp::BSCApp()
 	fRecordWatch(NULL),
 	fKillCaptureThread(true),
 	fPaused(false),
+	fReplaying(false),
 	fDirectWindowAvailable(false),
 	fEncoder(NULL),
 	fEncoderThread(-1),
+	fCapturedFrames(NULL),
 	fStopRunner(NULL),
 	fRequestedRecordTime(0),
 	fSupportsWaitForRetrace(false)
@@ -174,6 +198,7 @@ BSCApp::~BSCApp()
 	StopThreads();
 	delete fRecordWatch;
 	delete fEncoder;
+	delete fCapturedFrames;
 
 	FramesList::DeleteTempPath();
 
@@ -226,6 +251,7 @@ BSCApp::ReadyToRun()
 		}
 	} else {
 		fWindow->Show();
+		_StartReplay();
 	}
 }
 
@@ -283,6 +309,10 @@ BSCApp::MessageReceived(BMessage *message)
 			TogglePause();
 			break;
 
+		case kMsgGUISaveReplay:
+			_SaveReplay();
+			break;
+
 		case kEncodingFinished:
 		{
 			status_t error = static_cast<status_t>(message->GetInt32("status", B_ERROR));
@@ -290,6 +320,19 @@ BSCApp::MessageReceived(BMessage *message)
 			_EncodingFinished(error, fileName);
 			break;
 		}
+		case kReplayFailed:
+		{
+			// Unless the replay was stopped, or restarted, meanwhile
+			if (!fReplaying || fCaptureThread > 0)
+				break;
+			fReplaying = false;
+			status_t error = static_cast<status_t>(message->GetInt32("status", B_ERROR));
+			std::cerr << "BSCApp: instant replay stopped: " << ::strerror(error) << std::endl;
+			BMessage notice(kMsgControllerReplayStopped);
+			notice.AddInt32("status", int32(error));
+			SendNotices(kMsgControllerReplayStopped, &notice);
+			break;
+		}
 		case kEncodingProgress:
 		{
 			BMessage progressMessage(kMsgControllerEncodeProgress);
@@ -305,6 +348,16 @@ BSCApp::MessageReceived(BMessage *message)
 			bool reset = false;
 			if (message->FindBool("reset", &reset) == B_OK)
 				progressMessage.AddBool("reset", reset);
+			// Encoding in parallel segments
+			int32 segments = 0;
+			if (message->FindInt32("segments", &segments) == B_OK)
+				progressMessage.AddInt32("segments", segments);
+			int32 segment = 0;
+			if (message->FindInt32("segment", &segment) == B_OK) {
+				progressMessage.AddInt32("segment", segment);
+				progressMessage.AddInt32("segment_frames_remaining",
+					message->GetInt32("segment_frames_remaining", 0));
+			}
 
 			SendNotices(kMsgControllerEncodeProgress, &progressMessage);
 			break;
@@ -612,6 +665,7 @@ void
 BSCApp::StopThreads()
 {
 	BAutolock _(this);
+	_StopReplay();
 	switch (State()) {
 		case STATE_RECORDING:
 		{
@@ -619,6 +673,7 @@ BSCApp::StopThreads()
 			fKillCaptureThread = true;
 			wait_for_thread(fCaptureThread, &status);
 			fCaptureThread = -1;
+			fEncoder->CancelStreaming();
 			break;
 		}
 		case STATE_ENCODING:
@@ -636,7 +691,7 @@ int
 BSCApp::State() const
 {
 	BAutolock _(const_cast<BSCApp*>(this));
-	if (fCaptureThread > 0)
+	if (fCaptureThread > 0 && !fReplaying)
 		return STATE_RECORDING;
 
 	if (fEncoderThread > 0)
@@ -676,7 +731,7 @@ void
 BSCApp::TogglePause()
 {
 	BAutolock _(this);
-	if (fCaptureThread < 0)
+	if (State() != STATE_RECORDING)
 		return;
 
 	if (fPaused)
@@ -705,7 +760,7 @@ BSCApp::SetRecordingTime(const bigtime_t msecs)
 {
 	BAutolock _(this);
 	// Bail out if recording is already started
-	if (fCaptureThread > 0)
+	if (State() == STATE_RECORDING)
 		return;
 
 	fRequestedRecordTime = msecs;
@@ -728,40 +783,26 @@ BSCApp::EncodeMovie()
 	BAutolock _(this);
 
 	if (RecordedFrames() <= 0) {
+		fEncoder->CancelStreaming();
 		_EncodingFinished(B_ERROR, NULL);
 		return;
 	}
 
-	// Write to a temp file
-	BPath path;
-	status_t status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
-	if (status != B_OK)
-		throw status;
-	char tempFileName[B_PATH_NAME_LENGTH];
-	::snprintf(tempFileName, sizeof(tempFileName), "%s/BSC_clip_XXXXXXX", path.Path());
-	// mkstemp creates a fd with an unique file name.
-	// We then close the fd immediately, because we only need an unique file name.
-	// In theory, it's possible that between this and WriteFrame() someone
-	// creates a file with this exact name, but it's not likely to happen.
-	int tempFile = ::mkstemp(tempFileName);
-	if (tempFile < 0)
-		throw errno;
-
-	BString fileName = tempFileName;
-	::close(tempFile);
-	// Remove the temporary file, will be created
-	// later with the same name by MovieEncoder
-	// TODO: Not nice
-	BEntry(fileName).Remove();
-
-	// Tell the encoder where to write
-	fEncoder->SetOutputFile(fileName);
+	// When encoding while capturing, the movie is already there
+	if (!fEncoder->IsStreaming()) {
+		status_t status = _PrepareOutputFile();
+		if (status != B_OK)
+			throw status;
+		_ApplyEncoderPreset();
+	}
 
 	BMessage message(kMsgControllerEncodeStarted);
 	message.AddInt32("frames_total", RecordedFrames());
 	SendNotices(kMsgControllerEncodeStarted, &message);
 
 	fEncoder->SetMessenger(be_app_messenger);
+	fEncoder->SetSource(fCapturedFrames);
+	fCapturedFrames = NULL;
 
 	fEncoderThread = fEncoder->EncodeThreaded();
 }
@@ -819,6 +860,14 @@ void
 BSCApp::SetPlaybackFrameRate(const int rate)
 {
 	BAutolock _(this);
+	Settings::Current().SetPlaybackFrameRate(std::max(rate, 0));
+
+	// The movie is made at this rate now
+	UpdateMediaFormatAndCodecsForCurrentFamily();
+
+	BMessage message(kMsgControllerPlaybackFrameRateChanged);
+	message.AddInt32("frame_rate", std::max(rate, 0));
+	SendNotices(kMsgControllerPlaybackFrameRateChanged, &message);
 }
 
 
@@ -913,6 +962,7 @@ BSCApp::SetMediaCodec(const char* codecName)
 		media_codec_info& codec = fCodecList.at(i);
 		if (!strcmp(codec.pretty_name, codecName)) {
 			fEncoder->SetMediaCodecInfo(codec);
+			fEncoder->SetCodecColorSpace(fCodecColorSpaces.at(i));
 			Settings::Current().SetOutputCodec(codec.pretty_name);
 			BMessage message(kMsgControllerCodecChanged);
 			message.AddString("codec_name", codec.pretty_name);
@@ -969,6 +1019,33 @@ BSCApp::_ComputeMediaFormat(const int32 &width, const int32 &height,
 }
 
 
+// The first of kCodecColorSpaces the codec takes, or the color space
+// of the format
+color_space
+BSCApp::_CodecColorSpace(const media_file_format& fileFormat,
+	const media_format& format, const media_codec_info& codec) const
+{
+	const int32 count = sizeof(kCodecColorSpaces) / sizeof(kCodecColorSpaces[0]);
+	for (int32 i = 0; i < count; i++) {
+		media_format codecFormat = format;
+		codecFormat.u.raw_video.display.format = kCodecColorSpaces[i];
+		codecFormat.u.raw_video.display.bytes_per_row
+			= FrameConverter::BytesPerRow(kCodecColorSpaces[i],
+				format.u.raw_video.display.line_width);
+
+		int32 cookie = 0;
+		media_codec_info info;
+		media_format encodedFormat;
+		while (get_next_encoder(&cookie, &fileFormat, &codecFormat,
+				&encodedFormat, &info) == B_OK) {
+			if (info.id == codec.id && info.sub_id == codec.sub_id)
+				return kCodecColorSpaces[i];
+		}
+	}
+	return format.u.raw_video.display.format;
+}
+
+
 // Should be called every time the media_format_family is changed
 status_t
 BSCApp::UpdateMediaFormatAndCodecsForCurrentFamily()
@@ -980,7 +1057,9 @@ BSCApp::UpdateMediaFormatAndCodecsForCurrentFamily()
 	targetRect.right++;
 	targetRect.bottom++;
 
-	const float frameRate = float(settings.CaptureFrameRate());
+	float frameRate = float(settings.CaptureFrameRate());
+	if (settings.PlaybackFrameRate() > 0)
+		frameRate = float(settings.PlaybackFrameRate());
 	const media_format mediaFormat = _ComputeMediaFormat(targetRect.IntegerWidth(),
 									targetRect.IntegerHeight(),
 									settings.ClipDepth(), frameRate);
@@ -988,17 +1067,32 @@ BSCApp::UpdateMediaFormatAndCodecsForCurrentFamily()
 	fEncoder->SetMediaFormat(mediaFormat);
 
 	fCodecList.clear();
+	fCodecColorSpaces.clear();
+	fEncoder->SetCodecColorSpace(B_NO_COLOR_SPACE);
 
-	// Handle the NULL/GIF media_file_formats
+	// Handle the NULL/GIF/ffmpeg media_file_formats
 	media_file_format fileFormat = fEncoder->MediaFileFormat();
 	if ((::strcmp(fileFormat.short_name, NULL_FORMAT_SHORT_NAME) != 0) &&
-		(::strcmp(fileFormat.short_name, GIF_FORMAT_SHORT_NAME) != 0)) {
+		(::strcmp(fileFormat.short_name, GIF_FORMAT_SHORT_NAME) != 0) &&
+		FFMPEGMuxerName(fileFormat) == NULL) {
 		int32 cookie = 0;
 		media_codec_info codec;
 		media_format dummyFormat;
 		while (get_next_encoder(&cookie, &fileFormat, &mediaFormat,
 				&dummyFormat, &codec) == B_OK) {
 			fCodecList.push_back(codec);
+			fCodecColorSpaces.push_back(
+				_CodecColorSpace(fileFormat, mediaFormat, codec));
+		}
+	}
+
+	// The codec stays the same, if it's still in the list
+	const media_codec_info codecInfo = fEncoder->MediaCodecInfo();
+	for (size_t i = 0; i < fCodecList.size(); i++) {
+		if (fCodecList[i].id == codecInfo.id
+			&& fCodecList[i].sub_id == codecInfo.sub_id) {
+			fEncoder->SetCodecColorSpace(fCodecColorSpaces[i]);
+			break;
 		}
 	}
 
@@ -1022,13 +1116,34 @@ BSCApp::UpdateDirectInfo(direct_buffer_info* info)
 }
 
 
+// The frame is copied straight from the frame buffer when using
+// BDirectWindow, otherwise app_server reads it into the buffer.
+// With a reducer, the buffer gets the frame at the size and in the
+// color space of the reducer instead, from screenBitmap when
+// app_server reads it.
 status_t
-BSCApp::ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds)
+BSCApp::ReadFrame(FrameBuffer* buffer, BBitmap* screenBitmap,
+	bool includeCursor, BRect bounds, FrameReducer* reducer,
+	FrameCopier* copier)
 {
 	const bool &useDirectWindow = fDirectWindowAvailable && Settings::Current().UseDirectWindow();
 
-	if (!useDirectWindow)
-		return BScreen().ReadBitmap(bitmap, includeCursor, &bounds);
+	if (!useDirectWindow) {
+		BBitmap* bitmap = reducer == NULL ? buffer->Bitmap() : NULL;
+		if (bitmap != NULL)
+			return BScreen().ReadBitmap(bitmap, includeCursor, &bounds);
+
+		status_t status = BScreen().ReadBitmap(screenBitmap, includeCursor, &bounds);
+		if (status == B_OK) {
+			if (reducer != NULL) {
+				status = reducer->Reduce(screenBitmap->Bits(),
+					screenBitmap->BytesPerRow(), buffer->Bits(),
+					buffer->BytesPerRow());
+			} else
+				status = buffer->ImportBits(screenBitmap);
+		}
+		return status;
+	}
 
 	const int32 bytesPerPixel = fDirectInfo.bits_per_pixel >> 3;
 	if (bytesPerPixel <= 0)
@@ -1039,9 +1154,18 @@ BSCApp::ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds)
 
 	const int32 height = bounds.IntegerHeight() + 1;
 	uint8* from = reinterpret_cast<uint8*>(fDirectInfo.bits) + offset;
-	uint8* to = reinterpret_cast<uint8*>(bitmap->Bits());
-	const int32 bytesPerRow = bitmap->BytesPerRow();
+	if (reducer != NULL) {
+		return reducer->Reduce(from, fDirectInfo.bytes_per_row,
+			buffer->Bits(), buffer->BytesPerRow());
+	}
+	uint8* to = reinterpret_cast<uint8*>(buffer->Bits());
+	const int32 bytesPerRow = buffer->BytesPerRow();
 	const int32 areaSize = (bounds.IntegerWidth() + 1) * bytesPerPixel;
+	if (copier != NULL) {
+		copier->Copy(from, fDirectInfo.bytes_per_row, to, bytesPerRow,
+			areaSize, height);
+		return B_OK;
+	}
 	for (int32 y = 0; y < height; y++) {
 		::memcpy(to, from, areaSize);
 		to += bytesPerRow;
@@ -1055,6 +1179,15 @@ BSCApp::ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds)
 void
 BSCApp::StartCapture()
 {
+	// Recording takes over from the instant replay
+	_StopReplay();
+
+	// Frames of a capture which was never encoded
+	delete fCapturedFrames;
+	fCapturedFrames = NULL;
+
+	_StartStreaming();
+
 	fRecordedFrames = 0;
 	fKillCaptureThread = false;
 	fPaused = false;
@@ -1063,6 +1196,7 @@ BSCApp::StartCapture()
 		"Capture thread", B_DISPLAY_PRIORITY, this);
 
 	if (fCaptureThread < 0) {
+		fEncoder->CancelStreaming();
 		BMessage message(kMsgControllerCaptureStopped);
 		message.AddInt32("status", fCaptureThread);
 		SendNotices(kMsgControllerCaptureStopped, &message);
@@ -1072,6 +1206,7 @@ BSCApp::StartCapture()
 	status_t status = resume_thread(fCaptureThread);
 	if (status < B_OK) {
 		kill_thread(fCaptureThread);
+		fEncoder->CancelStreaming();
 		BMessage message(kMsgControllerCaptureStopped);
 		message.AddInt32("status", status);
 		SendNotices(kMsgControllerCaptureStopped, &message);
@@ -1180,6 +1315,141 @@ BSCApp::_ResumeCapture()
 }
 
 
+void
+BSCApp::_StartReplay()
+{
+	const Settings& settings = Settings::Current();
+	if (!settings.InstantReplay() || State() != STATE_IDLE
+		|| fCaptureThread > 0)
+		return;
+
+	delete fCapturedFrames;
+	fCapturedFrames = NULL;
+
+	fRecordedFrames = 0;
+	fKillCaptureThread = false;
+	fPaused = false;
+	fReplaying = true;
+
+	// Runs all the time: don't get in the way of the other apps
+	fCaptureThread = spawn_thread((thread_entry)CaptureStarter,
+		"Replay thread", B_NORMAL_PRIORITY, this);
+	if (fCaptureThread >= 0 && resume_thread(fCaptureThread) != B_OK) {
+		kill_thread(fCaptureThread);
+		fCaptureThread = -1;
+	}
+	if (fCaptureThread < 0) {
+		std::cerr << "BSCApp::_StartReplay(): cannot start the replay thread" << std::endl;
+		fReplaying = false;
+	}
+}
+
+
+// Returns true if the replay was running. The frames
+// of the replay are then in fCapturedFrames.
+bool
+BSCApp::_StopReplay()
+{
+	if (!fReplaying)
+		return false;
+
+	if (fCaptureThread > 0) {
+		fKillCaptureThread = true;
+		status_t unused;
+		wait_for_thread(fCaptureThread, &unused);
+		fCaptureThread = -1;
+	}
+	fReplaying = false;
+	return true;
+}
+
+
+void
+BSCApp::_SaveReplay()
+{
+	BAutolock _(this);
+	if (!_StopReplay())
+		return;
+
+	fRecordedFrames = fCapturedFrames != NULL
+		? fCapturedFrames->CountItems() : 0;
+	EncodeMovie();
+}
+
+
+// Creates an unique temporary file name, and tells the encoder to write there
+status_t
+BSCApp::_PrepareOutputFile()
+{
+	BPath path;
+	status_t status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
+	if (status != B_OK)
+		return status;
+	char tempFileName[B_PATH_NAME_LENGTH];
+	::snprintf(tempFileName, sizeof(tempFileName), "%s/BSC_clip_XXXXXXX", path.Path());
+	// mkstemp creates a fd with an unique file name.
+	// We then close the fd immediately, because we only need an unique file name.
+	// In theory, it's possible that between this and WriteFrame() someone
+	// creates a file with this exact name, but it's not likely to happen.
+	int tempFile = ::mkstemp(tempFileName);
+	if (tempFile < 0)
+		return errno;
+
+	BString fileName = tempFileName;
+	::close(tempFile);
+	// Remove the temporary file, will be created
+	// later with the same name by MovieEncoder
+	// TODO: Not nice
+	BEntry(fileName).Remove();
+
+	// Tell the encoder where to write
+	fEncoder->SetOutputFile(fileName);
+	return B_OK;
+}
+
+
+// Opens the movie before the capture starts, so the frames can be
+// encoded while capturing. Not all the formats can do that: those
+// are encoded after the capture, as usual.
+void
+BSCApp::_StartStreaming()
+{
+	const Settings& settings = Settings::Current();
+	if (!settings.StreamEncoding())
+		return;
+
+	int32 frameRate = settings.CaptureFrameRate();
+	if (frameRate <= 0)
+		frameRate = 10;
+	// The encoder retimes the frames to the playback frame rate
+	if (settings.PlaybackFrameRate() > 0)
+		frameRate = settings.PlaybackFrameRate();
+
+	_ApplyEncoderPreset();
+	status_t status = _PrepareOutputFile();
+	if (status == B_OK) {
+		status = fEncoder->StartStreaming(settings.CaptureArea(),
+			float(frameRate));
+	}
+	if (status != B_OK && status != B_NOT_SUPPORTED) {
+		std::cerr << "BSCApp::_StartStreaming(): ";
+		std::cerr << ::strerror(status) << std::endl;
+	}
+}
+
+
+// The encoder takes the preset and the priority when it starts
+void
+BSCApp::_ApplyEncoderPreset()
+{
+	const Settings& settings = Settings::Current();
+	if (fEncoder->SetPreset((encoder_preset)settings.EncoderPreset()) != B_OK)
+		fEncoder->SetPreset(ENCODER_PRESET_BALANCED);
+	if (fEncoder->SetThreadPriority(settings.EncodingThreadPriority()) != B_OK)
+		fEncoder->SetThreadPriority(B_NORMAL_PRIORITY);
+}
+
+
 void
 BSCApp::_EncodingFinished(const status_t status, const char* fileName)
 {
@@ -1196,6 +1466,8 @@ BSCApp::_EncodingFinished(const status_t status, const char* fileName)
 
 	if (settings.QuitWhenFinished())
 		be_app->PostMessage(B_QUIT_REQUESTED);
+	else
+		_StartReplay();
 }
 
 
@@ -1267,8 +1539,15 @@ BSCApp::CaptureThread()
 	int32 frameRate = settings.CaptureFrameRate();
 	if (frameRate <= 0)
 		frameRate = 10;
+	// Grab at the rate the encoder samples the capture when retiming, so
+	// that no frame is grabbed only to be dropped. That only lowers it
+	// when the movie is made constant: a time-lapse samples at the
+	// capture frame rate, which the user chose for it.
+	const int32 playbackFrameRate = settings.PlaybackFrameRate();
+	if (playbackFrameRate > 0)
+		frameRate = std::min(frameRate, playbackFrameRate);
 
-	bigtime_t captureDelay = 1000 * (1000 / frameRate);
+	bigtime_t captureDelay = 1000000 / frameRate;
 
 #if 0
 	TestSystem();
@@ -1279,21 +1558,105 @@ BSCApp::CaptureThread()
 	// TODO: Check status_t
 	FramesList::CreateTempPath();
 
+	// All the frames go into a single spool, which the encoder will read
+	// back. Frames stay in memory until the budget is used up, and only
+	// then go to disk: short captures never touch it.
+	const uint64 memoryLimit = uint64(std::max(settings.SpoolMemoryLimit(),
+		int32(0))) * 1024 * 1024;
+	FrameSpool* spool = new (std::nothrow) FrameSpool;
+	status_t status = B_NO_MEMORY;
+	if (spool != NULL) {
+		spool->SetCodec((spool_codec)settings.SpoolCodec());
+		spool->SetCompressionLevel(settings.SpoolCompressionLevel());
+		spool->SetMemoryBudget(std::min(memoryLimit, GetFreeMemory() / 2));
+		// The instant replay only keeps the last seconds, and never
+		// goes to disk
+		if (fReplaying)
+			spool->SetRingLength(bigtime_t(settings.ReplayLength()) * 1000000);
+		status = spool->Create(FramesList::Path());
+	}
+
 	const int32 windowEdge = settings.WindowFrameEdgeSize();
 	int32 token = GetWindowTokenForFrame(bounds, windowEdge);
-	status_t status = B_OK;
 	const color_space colorSpace = BScreen().ColorSpace();
-	BBitmap *bitmap = new (std::nothrow) BBitmap(bounds.OffsetToCopy(B_ORIGIN), colorSpace);
-	if (bitmap == NULL)
-		status = B_NO_MEMORY;
+	const int32 poolSize = std::max(settings.FramePoolSize(), int32(2));
 
+	// Reducing the frames before they're queued means less memory and
+	// disk for the spool, and less work for the encoder later.
+	// Enlarged frames are left to the encoder, for the same reason.
+	const int32 width = bounds.IntegerWidth() + 1;
+	const int32 height = bounds.IntegerHeight() + 1;
+	int32 frameWidth = width;
+	int32 frameHeight = height;
+	if (settings.ScaleWhileCapturing()) {
+		const BRect targetRect = settings.TargetRect();
+		const int32 targetWidth = targetRect.IntegerWidth() + 1;
+		const int32 targetHeight = targetRect.IntegerHeight() + 1;
+		if (targetWidth > 0 && targetHeight > 0 && targetWidth <= width
+			&& targetHeight <= height) {
+			frameWidth = targetWidth;
+			frameHeight = targetHeight;
+		}
+	}
+	// A clip of a lower depth than the screen is dithered to it right away
+	color_space frameColorSpace = colorSpace;
+	if (FrameReducer::IsReduction(colorSpace, settings.ClipDepth()))
+		frameColorSpace = settings.ClipDepth();
+
+	FrameReducer* reducer = NULL;
+	if (status == B_OK && (frameWidth != width || frameHeight != height
+			|| frameColorSpace != colorSpace)) {
+		// Half of the CPUs, the others are for the spool writers
+		// and the encoder
+		reducer = new (std::nothrow) FrameReducer(width, height, colorSpace,
+			frameWidth, frameHeight, frameColorSpace,
+			std::max(ThreadPool::DefaultThreadCount() / 2, int32(1)),
+			B_DISPLAY_PRIORITY);
+		status = reducer != NULL ? reducer->InitCheck() : B_NO_MEMORY;
+		if (status == B_OK) {
+			std::cout << "BSCApp::CaptureThread(): reducing frames from ";
+			std::cout << width << "x" << height << " to ";
+			std::cout << frameWidth << "x" << frameHeight;
+			if (frameColorSpace != colorSpace)
+				std::cout << ", " << GetColorSpaceTraits(frameColorSpace)->name;
+			std::cout << std::endl;
+		}
+	}
+	// Otherwise the frame buffer is only copied
+	FrameCopier* copier = NULL;
+	if (status == B_OK && reducer == NULL) {
+		copier = new (std::nothrow) FrameCopier(std::min(std::max(
+			ThreadPool::DefaultThreadCount() / 2, int32(1)), kFrameCopyThreads),
+			B_DISPLAY_PRIORITY);
+		status = copier != NULL ? copier->InitCheck() : B_NO_MEMORY;
+	}
+
+	CapturePipeline* pipeline = NULL;
+	if (status == B_OK) {
+		pipeline = new (std::nothrow) CapturePipeline(spool,
+			BRect(0, 0, frameWidth - 1, frameHeight - 1), frameColorSpace,
+			poolSize, kCapturePipelineWriters);
+		status = pipeline != NULL ? pipeline->InitCheck() : B_NO_MEMORY;
+	}
+	// The encoder takes the frames as long as it keeps up,
+	// the spool gets the others
+	if (status == B_OK && !fReplaying && fEncoder->IsStreaming())
+		pipeline->SetStream(fEncoder);
 	if (status == B_OK)
-		status = bitmap->InitCheck();
+		status = pipeline->Start();
+
+	// Only used when not reading from the frame buffer directly
+	BBitmap* screenBitmap = NULL;
+	if (status == B_OK) {
+		screenBitmap = new (std::nothrow) BBitmap(bounds.OffsetToCopy(B_ORIGIN), colorSpace);
+		if (screenBitmap == NULL)
+			status = B_NO_MEMORY;
+		else
+			status = screenBitmap->InitCheck();
+	}
 
 	if (status != B_OK) {
-		delete bitmap;
-		bitmap = NULL;
-		std::cerr << "BSCApp::CaptureThread(): error initializing bitmap: ";
+		std::cerr << "BSCApp::CaptureThread(): error initializing capture pipeline: ";
 		std::cerr << ::strerror(status) << std::endl;
 		fKillCaptureThread = true;
 	}
@@ -1305,8 +1668,20 @@ BSCApp::CaptureThread()
 					bounds.OffsetTo(windowBounds.LeftTop());
 			}
 
-			status = ReadBitmap(bitmap, true, bounds);
+			// If the writers can't keep up, we don't wait more than
+			// a frame: just skip this frame and keep the cadence
+			FrameBuffer* buffer = pipeline->AcquireBuffer(captureDelay);
+			if (buffer == NULL) {
+				status = pipeline->WriterStatus();
+				if (status != B_OK)
+					break;
+				continue;
+			}
+
+			status = ReadFrame(buffer, screenBitmap, true, bounds, reducer,
+				copier);
 			if (status != B_OK) {
+				pipeline->CancelBuffer(buffer);
 				std::cerr << "BSCApp::CaptureThread(): error reading bitmap: ";
 				std::cerr << ::strerror(status) << std::endl;
 				break;
@@ -1314,11 +1689,9 @@ BSCApp::CaptureThread()
 
 			bigtime_t lastFrameTime = system_time();
 
-			// TODO: set path ?
-			BString fileName;
-			fileName << FramesList::Path() << "/" << lastFrameTime;
+			pipeline->QueueBuffer(buffer, lastFrameTime);
 
-			status = FramesList::WriteFrame(bitmap, lastFrameTime, fileName);
+			status = pipeline->WriterStatus();
 			if (status != B_OK) {
 				std::cerr << "BSCApp::CaptureThread(): WriteFrame failed: ";
 				std::cerr << ::strerror(status) << std::endl;
@@ -1329,8 +1702,23 @@ BSCApp::CaptureThread()
 
 			// Send notices every tenth frame so we don't
 			// overload receivers
-			if (fRecordedFrames % 10 == 0)
-				SendNotices(kMsgControllerCaptureProgress);
+			if (!fReplaying && fRecordedFrames % 10 == 0) {
+				pipeline_stats stats;
+				pipeline->GetStatistics(stats);
+				BMessage message(kMsgControllerCaptureProgress);
+				message.AddInt32("frames_total", fRecordedFrames);
+				message.AddInt32("frames_dropped", stats.frames_dropped);
+				message.AddInt32("frames_duplicated", stats.frames_duplicated);
+				message.AddInt32("queue_depth", stats.queue_depth);
+				message.AddInt64("stall_time", stats.stall_time);
+				if (fEncoder->IsStreaming())
+					message.AddBool("streaming", stats.streaming);
+				if (copier != NULL && copier->CountFrames() > 0) {
+					message.AddInt64("copy_time",
+						copier->CopyTime() / copier->CountFrames());
+				}
+				SendNotices(kMsgControllerCaptureProgress, &message);
+			}
 
 			bigtime_t toWait = (lastFrameTime + captureDelay) - system_time();
 			if (toWait > 0)
@@ -1339,15 +1727,61 @@ BSCApp::CaptureThread()
 			snooze(500000);
 	}
 
+	// Wait for the writers to flush the queued frames,
+	// so the encoder will find all of them on disk
+	if (pipeline != NULL) {
+		status_t writerStatus = pipeline->Stop();
+		if (status == B_OK)
+			status = writerStatus;
+		pipeline->PrintStatistics();
+		delete pipeline;
+	}
+	delete screenBitmap;
+	delete reducer;
+	if (copier != NULL) {
+		copier->PrintStatistics();
+		delete copier;
+	}
+
+	// Hand the spool over to the encoder, since the frames in memory
+	// can't be read back from disk
+	if (spool != NULL) {
+		spool->PrintStatistics();
+		FramesList* frames = NULL;
+		status_t finishStatus = spool->FinishWriting();
+		if (finishStatus == B_OK) {
+			frames = new (std::nothrow) FramesList();
+			if (frames == NULL)
+				finishStatus = B_NO_MEMORY;
+		}
+		if (finishStatus == B_OK) {
+			// From here on, the list owns the spool
+			finishStatus = frames->AddItemsFromSpool(spool);
+			if (finishStatus != B_OK) {
+				delete frames;
+				frames = NULL;
+			}
+		} else
+			delete spool;
+		if (finishStatus != B_OK) {
+			std::cerr << "BSCApp::CaptureThread(): cannot read back the frames: ";
+			std::cerr << ::strerror(finishStatus) << std::endl;
+		}
+		fCapturedFrames = frames;
+	}
+
 	fCaptureThread = -1;
 	fKillCaptureThread = true;
 
-	delete bitmap;
-
-	if (status != B_OK) {
+	if (status != B_OK && !fReplaying) {
 		BMessage message(kMsgControllerCaptureStopped);
 		message.AddInt32("status", int32(status));
 		SendNotices(kMsgControllerCaptureStopped, &message);
+	} else if (status != B_OK) {
+		// Nobody waits for the replay thread: let the app know it's gone
+		BMessage message(kReplayFailed);
+		message.AddInt32("status", int32(status));
+		PostMessage(&message);
 	}
 
 	return B_OK;
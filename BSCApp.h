@@ -23,6 +23,9 @@ class BBitmap;
 class BMessageRunner;
 class BStopWatch;
 class BString;
+class FrameBuffer;
+class FrameCopier;
+class FrameReducer;
 class FramesList;
 class MovieEncoder;
 class Arguments;
@@ -91,7 +94,10 @@ public:
 
 	void		UpdateDirectInfo(direct_buffer_info *info);
 
-	status_t	ReadBitmap(BBitmap *bitmap, bool includeCursor, BRect bounds);
+	status_t	ReadFrame(FrameBuffer* buffer, BBitmap* screenBitmap,
+					bool includeCursor, BRect bounds,
+					FrameReducer* reducer = NULL,
+					FrameCopier* copier = NULL);
 
 	void		ResetSettings();
 
@@ -114,13 +120,19 @@ private:
 	BStopWatch*			fRecordWatch;
 	bool				fKillCaptureThread;
 	bool				fPaused;
+	// The capture thread only fills the instant replay ring
+	bool				fReplaying;
 
 	bool				fDirectWindowAvailable;
 	direct_buffer_info	fDirectInfo;
 	MovieEncoder*		fEncoder;
 	thread_id			fEncoderThread;
+	// Handed over by the capture thread to the encoder
+	FramesList*			fCapturedFrames;
 
 	media_codec_list fCodecList;
+	// The raw format every codec of the list works in
+	std::vector<color_space> fCodecColorSpaces;
 
 	BMessageRunner*		fStopRunner;
 	bigtime_t			fRequestedRecordTime;
@@ -136,12 +148,23 @@ private:
 	void		_PauseCapture();
 	void		_ResumeCapture();
 
+	void		_StartReplay();
+	bool		_StopReplay();
+	void		_SaveReplay();
+
+	status_t	_PrepareOutputFile();
+	void		_StartStreaming();
+	void		_ApplyEncoderPreset();
+
 	void		_EncodingFinished(const status_t status, const char* fileName);
 	void		_HandleTargetFrameChanged(const BRect& targetRect);
 	void		_ForwardGUIMessage(BMessage *message);
 
 	media_format	_ComputeMediaFormat(const int32 &width, const int32 &height,
 							const color_space &colorSpace, const float &fieldRate);
+	color_space		_CodecColorSpace(const media_file_format& fileFormat,
+							const media_format& format,
+							const media_codec_info& codec) const;
 
 	void		_TestWaitForRetrace();
 	void		_WaitForRetrace(bigtime_t time);
@@ -95,6 +95,7 @@ BSCWindow::BSCWindow()
 		be_app->StartWatching(this, kMsgControllerCapturePaused);
 		be_app->StartWatching(this, kMsgControllerCaptureResumed);
 		be_app->StartWatching(this, kMsgControllerSelectionWindowClosed);
+		be_app->StartWatching(this, kMsgControllerReplayStopped);
 		be_app->UnlockLooper();
 	}
 }
@@ -194,6 +195,18 @@ BSCWindow::MessageReceived(BMessage *message)
 					}
 					break;
 				}
+				case kMsgControllerReplayStopped:
+				{
+					status_t status = B_ERROR;
+					message->FindInt32("status", &status);
+
+					BString errorString;
+					errorString.SetToFormat(B_TRANSLATE("Instant replay stopped:\n%s"),
+						strerror(status));
+					(new BAlert(B_TRANSLATE("Instant replay"), errorString,
+						B_TRANSLATE("OK")))->Go();
+					break;
+				}
 				case kMsgControllerCapturePaused:
 				{
 					fPauseButton->SetLabel(LABEL_RESUME);
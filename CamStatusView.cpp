@@ -70,6 +70,7 @@ CamStatusView::CamStatusView()
 	fStatusBar(NULL),
 	fNumFrames(0),
 	fStatusText(""),
+	fSegments(1),
 	fRecording(false),
 	fPaused(false),
 	fRecordingBitmap(NULL),
@@ -196,6 +197,7 @@ CamStatusView::MessageReceived(BMessage *message)
 						int32 totalFrames = 0;
 						message->FindInt32("frames_total", &totalFrames);
 						fStatusText = text;
+						fSegments = message->GetInt32("segments", 1);
 						fEncodingStringView->SetText(fStatusText);
 						fStatusBar->Reset();
 						fStatusBar->SetMaxValue(float(totalFrames));
@@ -208,10 +210,18 @@ CamStatusView::MessageReceived(BMessage *message)
 					if (message->FindInt32("frames_remaining", &remaining) == B_OK) {
 						done = total - remaining;
 						BString string;
-						string.SetToFormat(B_TRANSLATE_COMMENT(
-							"(%" B_PRId32 "/%" B_PRId32 " frames)",
-							"Progress as in '(10/230 frames)"),
-							done, total);
+						if (fSegments > 1) {
+							string.SetToFormat(B_TRANSLATE_COMMENT(
+								"(%" B_PRId32 "/%" B_PRId32 " frames, "
+								"%" B_PRId32 " segments)",
+								"Progress as in '(10/230 frames, 4 segments)"),
+								done, total, fSegments);
+						} else {
+							string.SetToFormat(B_TRANSLATE_COMMENT(
+								"(%" B_PRId32 "/%" B_PRId32 " frames)",
+								"Progress as in '(10/230 frames)"),
+								done, total);
+						}
 						string.Append(" ");
 						string.Append(fStatusText);
 						fEncodingStringView->SetText(string);
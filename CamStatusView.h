@@ -38,6 +38,7 @@ private:
 	BStatusBar* fStatusBar;
 	int32 fNumFrames;
 	BString fStatusText;
+	int32 fSegments;
 	bool fRecording;
 	bool fPaused;
 	BBitmap* fRecordingBitmap;
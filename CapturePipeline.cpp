@@ -0,0 +1,592 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "CapturePipeline.h"
+
+#include "FramePool.h"
+#include "FrameSpool.h"
+
+#include <Autolock.h>
+#include <String.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+// A pool buffer to read a spooled frame back into is only waited for so
+// long: the capture needs them more
+const static bigtime_t kReadBackTimeout = 10000;
+
+
+CapturePipeline::CapturePipeline(FrameSpool* spool, const BRect& frame,
+	color_space colorSpace, int32 numBuffers, int32 numWriters)
+	:
+	fSpool(spool),
+	fPool(NULL),
+	fReadyQueue(numBuffers),
+	fReadySem(-1),
+	fStream(NULL),
+	fStreamQueue(numBuffers),
+	fStreamSem(-1),
+	fStreamThread(-1),
+	fMaxStreamBacklog(std::max(numBuffers / 2, int32(1))),
+	fStreaming(0),
+	fSpoolLock("capture spooled frames"),
+	fReadBack(0),
+	fSpooledLost(false),
+	fWritesInProgress(0),
+	fRowLength(0),
+	fHasLastHash(false),
+	fWriters(NULL),
+	fNumWriters(numWriters > 0 ? numWriters : 1),
+	fStopping(false),
+	fWriterStatus(B_OK),
+	fInitStatus(B_NO_INIT),
+	fFramesQueued(0),
+	fFramesStreamed(0),
+	fFramesReadBack(0),
+	fFramesWritten(0),
+	fFramesDropped(0),
+	fFramesDuplicated(0),
+	fMaxQueueDepth(0),
+	fStallTime(0),
+	fMaxStallTime(0)
+{
+	if (fSpool == NULL) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	fInitStatus = fReadyQueue.InitCheck();
+	if (fInitStatus == B_OK)
+		fInitStatus = fStreamQueue.InitCheck();
+	if (fInitStatus != B_OK)
+		return;
+
+	// Allocate all the frames in advance, so the capture thread never allocates
+	fPool = new (std::nothrow) FramePool(frame, colorSpace, numBuffers);
+	if (fPool == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+	fInitStatus = fPool->InitCheck();
+	if (fInitStatus != B_OK)
+		return;
+
+	// Only the visible part of the rows is hashed: the padding
+	// can contain leftovers from older frames
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	fInitStatus = get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+		&pixelsPerChunk);
+	if (fInitStatus != B_OK)
+		return;
+	fRowLength = (frame.IntegerWidth() + pixelsPerChunk) / pixelsPerChunk
+		* pixelChunk;
+
+	fReadySem = create_sem(0, "capture ready frames");
+	if (fReadySem < 0) {
+		fInitStatus = fReadySem;
+		return;
+	}
+	fStreamSem = create_sem(0, "capture streamed frames");
+	if (fStreamSem < 0) {
+		fInitStatus = fStreamSem;
+		return;
+	}
+
+	fInitStatus = B_OK;
+}
+
+
+CapturePipeline::~CapturePipeline()
+{
+	Stop();
+
+	if (fReadySem >= 0)
+		delete_sem(fReadySem);
+	if (fStreamSem >= 0)
+		delete_sem(fStreamSem);
+
+	delete fPool;
+}
+
+
+status_t
+CapturePipeline::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+void
+CapturePipeline::SetStream(FrameStream* stream)
+{
+	if (fWriters == NULL)
+		fStream = stream;
+}
+
+
+bool
+CapturePipeline::IsStreaming() const
+{
+	return atomic_get(const_cast<int32*>(&fStreaming)) != 0;
+}
+
+
+status_t
+CapturePipeline::Start()
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (fWriters != NULL)
+		return B_OK;
+
+	fWriters = new (std::nothrow) thread_id[fNumWriters];
+	if (fWriters == NULL)
+		return B_NO_MEMORY;
+
+	fStopping = false;
+	for (int32 i = 0; i < fNumWriters; i++) {
+		BString name;
+		name << "Frame writer " << (i + 1);
+		fWriters[i] = spawn_thread((thread_entry)_WriterStarter,
+			name.String(), B_NORMAL_PRIORITY, this);
+		if (fWriters[i] >= 0 && resume_thread(fWriters[i]) != B_OK) {
+			kill_thread(fWriters[i]);
+			fWriters[i] = -1;
+		}
+		if (fWriters[i] < 0) {
+			// Stop the ones we already started
+			fNumWriters = i;
+			Stop();
+			return B_ERROR;
+		}
+	}
+
+	if (fStream != NULL) {
+		fStreamThread = spawn_thread((thread_entry)_StreamStarter,
+			"Frame streamer", B_NORMAL_PRIORITY, this);
+		if (fStreamThread >= 0 && resume_thread(fStreamThread) != B_OK) {
+			kill_thread(fStreamThread);
+			fStreamThread = -1;
+		}
+		if (fStreamThread < 0) {
+			Stop();
+			return B_ERROR;
+		}
+		atomic_set(&fStreaming, 1);
+	}
+
+	return B_OK;
+}
+
+
+status_t
+CapturePipeline::Stop()
+{
+	if (fWriters == NULL)
+		return WriterStatus();
+
+	// Wake up every writer once more. They keep going until
+	// the ready queue is empty, so all the queued frames get written.
+	fStopping = true;
+	release_sem_etc(fReadySem, fNumWriters, 0);
+	for (int32 i = 0; i < fNumWriters; i++) {
+		status_t dummy;
+		wait_for_thread(fWriters[i], &dummy);
+	}
+
+	delete[] fWriters;
+	fWriters = NULL;
+
+	// The stream gets all the frames it was given, too
+	if (fStreamThread >= 0) {
+		release_sem(fStreamSem);
+		status_t dummy;
+		wait_for_thread(fStreamThread, &dummy);
+		fStreamThread = -1;
+	}
+	atomic_set(&fStreaming, 0);
+
+	return WriterStatus();
+}
+
+
+FrameBuffer*
+CapturePipeline::AcquireBuffer(bigtime_t timeout)
+{
+	// Fast path: a buffer is already free, don't account it as a stall
+	FrameBuffer* buffer = fPool->Acquire(0);
+	if (buffer == NULL) {
+		const bigtime_t start = system_time();
+		buffer = fPool->Acquire(timeout);
+
+		const bigtime_t stalled = system_time() - start;
+		atomic_add64(&fStallTime, stalled);
+		if (stalled > atomic_get64(&fMaxStallTime))
+			atomic_set64(&fMaxStallTime, stalled);
+	}
+
+	if (buffer == NULL)
+		atomic_add(&fFramesDropped, 1);
+
+	return buffer;
+}
+
+
+void
+CapturePipeline::QueueBuffer(FrameBuffer* buffer, bigtime_t timeStamp)
+{
+	buffer->SetTimeStamp(timeStamp);
+
+	const frame_hash hash = HashBits(buffer->Bits(), buffer->BytesPerRow(),
+		fRowLength, buffer->Height());
+	bool duplicate = fHasLastHash && hash == fLastHash;
+	fLastHash = hash;
+	fHasLastHash = true;
+
+	atomic_add(&fFramesQueued, 1);
+	if (duplicate)
+		atomic_add(&fFramesDuplicated, 1);
+
+	// Decided under the lock: the stream thread starts streaming again
+	// once it read back all the frames spooled
+	BAutolock _(fSpoolLock);
+	if (IsStreaming()) {
+		if (_StreamBuffer(buffer, duplicate))
+			return;
+		// This is the first frame spooled since the stream fell behind:
+		// the frame it repeats may not be in the spool
+		duplicate = false;
+	}
+	if (fStream != NULL)
+		_AddSpooled(timeStamp, duplicate);
+
+	if (duplicate) {
+		// Nothing changed on screen: don't write the frame again
+		fPool->Release(buffer);
+		status_t status = fSpool->WriteDuplicate(timeStamp);
+		if (status != B_OK)
+			atomic_test_and_set(&fWriterStatus, status, B_OK);
+		return;
+	}
+
+	fReadyQueue.Push(buffer);
+	release_sem(fReadySem);
+
+	const int32 depth = fReadyQueue.CountItems();
+	if (depth > atomic_get(&fMaxQueueDepth))
+		atomic_set(&fMaxQueueDepth, depth);
+}
+
+
+void
+CapturePipeline::CancelBuffer(FrameBuffer* buffer)
+{
+	fPool->Release(buffer);
+}
+
+
+status_t
+CapturePipeline::WriterStatus() const
+{
+	return atomic_get(const_cast<int32*>(&fWriterStatus));
+}
+
+
+void
+CapturePipeline::GetStatistics(pipeline_stats& stats) const
+{
+	CapturePipeline* self = const_cast<CapturePipeline*>(this);
+	stats.frames_queued = atomic_get(&self->fFramesQueued);
+	stats.frames_streamed = atomic_get(&self->fFramesStreamed);
+	stats.frames_read_back = atomic_get(&self->fFramesReadBack);
+	stats.frames_written = atomic_get(&self->fFramesWritten);
+	stats.frames_dropped = atomic_get(&self->fFramesDropped);
+	stats.frames_duplicated = atomic_get(&self->fFramesDuplicated);
+	stats.queue_depth = fReadyQueue.CountItems();
+	stats.max_queue_depth = atomic_get(&self->fMaxQueueDepth);
+	stats.queue_capacity = fPool != NULL ? fPool->CountBuffers() : 0;
+	stats.stall_time = atomic_get64(&self->fStallTime);
+	stats.max_stall_time = atomic_get64(&self->fMaxStallTime);
+	stats.streaming = IsStreaming();
+}
+
+
+void
+CapturePipeline::PrintStatistics() const
+{
+	pipeline_stats stats;
+	GetStatistics(stats);
+	std::cout << "Capture pipeline: " << stats.frames_queued << " frames queued, ";
+	if (fStream != NULL) {
+		std::cout << stats.frames_streamed << " streamed (";
+		std::cout << stats.frames_read_back << " read back), ";
+	}
+	std::cout << stats.frames_written << " written, ";
+	std::cout << stats.frames_duplicated << " unchanged, ";
+	std::cout << stats.frames_dropped << " dropped." << std::endl;
+	std::cout << "Max queue depth: " << stats.max_queue_depth << "/";
+	std::cout << stats.queue_capacity << ", capture stalled for ";
+	std::cout << (stats.stall_time / 1000) << " msec (max ";
+	std::cout << (stats.max_stall_time / 1000) << " msec)." << std::endl;
+}
+
+
+status_t
+CapturePipeline::_WriterThread()
+{
+	for (;;) {
+		status_t status = acquire_sem(fReadySem);
+		if (status == B_INTERRUPTED)
+			continue;
+		if (status != B_OK)
+			break;
+
+		void* item = NULL;
+		if (!fReadyQueue.Pop(&item)) {
+			if (fStopping)
+				break;
+			continue;
+		}
+
+		FrameBuffer* buffer = static_cast<FrameBuffer*>(item);
+		// After an error, keep recycling the buffers without writing them,
+		// so the capture thread doesn't block. It will notice the error
+		// and stop.
+		if (WriterStatus() == B_OK) {
+			status = _WriteBuffer(buffer);
+			if (status == B_OK)
+				atomic_add(&fFramesWritten, 1);
+			else
+				atomic_test_and_set(&fWriterStatus, status, B_OK);
+		}
+		fPool->Release(buffer);
+	}
+
+	return B_OK;
+}
+
+
+/* static */
+int32
+CapturePipeline::_WriterStarter(void* arg)
+{
+	return static_cast<CapturePipeline*>(arg)->_WriterThread();
+}
+
+
+status_t
+CapturePipeline::_WriteBuffer(const FrameBuffer* buffer)
+{
+	// The frame goes to disk as it is: no copy, no translation
+	atomic_add(&fWritesInProgress, 1);
+	off_t offset = -1;
+	status_t status = fSpool->WriteFrame(buffer,
+		fStream != NULL ? &offset : NULL);
+	if (status == B_OK && fStream != NULL)
+		_SetSpooledWritten(buffer->TimeStamp(), offset);
+	atomic_add(&fWritesInProgress, -1);
+	if (status != B_OK) {
+		std::cerr << "CapturePipeline::_WriteBuffer(): WriteFrame failed: ";
+		std::cerr << ::strerror(status) << std::endl;
+	}
+
+	// The stream may be able to read it back now
+	if (fStream != NULL)
+		release_sem(fStreamSem);
+	return status;
+}
+
+
+// Returns false if the stream is falling behind. From then on, the
+// frames go to the spool, until the stream reads them back.
+// Called with fSpoolLock held.
+bool
+CapturePipeline::_StreamBuffer(FrameBuffer* buffer, bool duplicate)
+{
+	if (fStreamQueue.CountItems() >= fMaxStreamBacklog) {
+		atomic_set(&fStreaming, 0);
+		return false;
+	}
+
+	buffer->SetDuplicate(duplicate);
+	fStreamQueue.Push(buffer);
+	release_sem(fStreamSem);
+	return true;
+}
+
+
+// Called with fSpoolLock held, before the frame is handed to the writers
+void
+CapturePipeline::_AddSpooled(bigtime_t timeStamp, bool duplicate)
+{
+	if (fSpooledLost)
+		return;
+
+	spooled_frame frame;
+	frame.time_stamp = timeStamp;
+	frame.offset = -1;
+	frame.duplicate = duplicate;
+	// Unchanged frames are written by the capture thread right away
+	frame.written = duplicate;
+	try {
+		fSpooled.push_back(frame);
+	} catch (...) {
+		// The frames left go to the spool only
+		fSpooledLost = true;
+		fSpooled.clear();
+		fReadBack = 0;
+	}
+}
+
+
+/* static */
+bool
+CapturePipeline::_SpooledBefore(const spooled_frame& a, const spooled_frame& b)
+{
+	return a.time_stamp < b.time_stamp;
+}
+
+
+void
+CapturePipeline::_SetSpooledWritten(bigtime_t timeStamp, off_t offset)
+{
+	BAutolock _(fSpoolLock);
+	spooled_frame key;
+	key.time_stamp = timeStamp;
+	std::vector<spooled_frame>::iterator frame = std::lower_bound(
+		fSpooled.begin() + fReadBack, fSpooled.end(), key, _SpooledBefore);
+	if (frame == fSpooled.end() || frame->time_stamp != timeStamp)
+		return;
+	frame->offset = offset;
+	frame->written = true;
+}
+
+
+// Streams the spooled frames, in order, as far as they can be read back.
+// Once they all are, the stream gets the new frames again.
+void
+CapturePipeline::_ReadBackSpooled()
+{
+	int32 end;
+	{
+		BAutolock _(fSpoolLock);
+		if (IsStreaming() || fSpooledLost)
+			return;
+		if (fReadBack == int32(fSpooled.size())) {
+			fSpooled.clear();
+			fReadBack = 0;
+			atomic_set(&fStreaming, 1);
+			return;
+		}
+		end = fReadBack;
+		while (end < int32(fSpooled.size()) && fSpooled[end].written)
+			end++;
+	}
+	// A frame can be encoded against tiles, or a frame, another writer
+	// is still writing. Once no writer is busy, all the frames written
+	// before are complete.
+	if (end == fReadBack || atomic_get(&fWritesInProgress) != 0)
+		return;
+
+	FrameBuffer* buffer = NULL;
+	const int32 start = fReadBack;
+	while (fReadBack < end && !fStopping && WriterStatus() == B_OK) {
+		spooled_frame frame;
+		{
+			BAutolock _(fSpoolLock);
+			frame = fSpooled[fReadBack];
+		}
+		if (!frame.duplicate && buffer == NULL) {
+			buffer = fPool->Acquire(kReadBackTimeout);
+			if (buffer == NULL)
+				break;
+		}
+
+		status_t status = B_OK;
+		if (!frame.duplicate)
+			status = fSpool->ReadRecord(frame.offset, buffer);
+		if (status == B_OK) {
+			status = _StreamFrame(frame.duplicate ? NULL : buffer,
+				frame.time_stamp);
+		} else {
+			std::cerr << "CapturePipeline::_ReadBackSpooled(): ReadRecord failed: ";
+			std::cerr << ::strerror(status) << std::endl;
+			atomic_test_and_set(&fWriterStatus, status, B_OK);
+		}
+		if (status != B_OK)
+			break;
+		atomic_add(&fFramesReadBack, 1);
+
+		BAutolock _(fSpoolLock);
+		fReadBack++;
+	}
+	if (buffer != NULL)
+		fPool->Release(buffer);
+
+	// Look again: more frames may be written by now, or none be left
+	if (fReadBack > start)
+		release_sem(fStreamSem);
+}
+
+
+status_t
+CapturePipeline::_StreamFrame(const FrameBuffer* buffer, bigtime_t timeStamp)
+{
+	status_t status = fStream->StreamFrame(buffer, timeStamp);
+	if (status == B_OK)
+		atomic_add(&fFramesStreamed, 1);
+	else {
+		std::cerr << "CapturePipeline::_StreamThread(): StreamFrame failed: ";
+		std::cerr << ::strerror(status) << std::endl;
+		atomic_test_and_set(&fWriterStatus, status, B_OK);
+	}
+	return status;
+}
+
+
+status_t
+CapturePipeline::_StreamThread()
+{
+	for (;;) {
+		status_t status = acquire_sem(fStreamSem);
+		if (status == B_INTERRUPTED)
+			continue;
+		if (status != B_OK)
+			break;
+
+		void* item = NULL;
+		if (!fStreamQueue.Pop(&item)) {
+			if (fStopping)
+				break;
+			// The frames queued before the stream fell behind are
+			// done: catch up with the spooled ones
+			if (WriterStatus() == B_OK)
+				_ReadBackSpooled();
+			continue;
+		}
+
+		FrameBuffer* buffer = static_cast<FrameBuffer*>(item);
+		if (WriterStatus() == B_OK) {
+			_StreamFrame(buffer->IsDuplicate() ? NULL : buffer,
+				buffer->TimeStamp());
+		}
+		fPool->Release(buffer);
+	}
+
+	return B_OK;
+}
+
+
+/* static */
+int32
+CapturePipeline::_StreamStarter(void* arg)
+{
+	return static_cast<CapturePipeline*>(arg)->_StreamThread();
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __CAPTUREPIPELINE_H
+#define __CAPTUREPIPELINE_H
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+#include <OS.h>
+#include <Rect.h>
+
+#include <vector>
+
+#include "FrameHash.h"
+#include "FrameQueue.h"
+
+class FrameBuffer;
+class FramePool;
+class FrameSpool;
+
+struct pipeline_stats {
+	int32		frames_queued;
+	int32		frames_streamed;
+	// Streamed after they were spooled, once the stream caught up
+	int32		frames_read_back;
+	int32		frames_written;
+	int32		frames_dropped;
+	int32		frames_duplicated;
+	int32		queue_depth;
+	int32		max_queue_depth;
+	int32		queue_capacity;
+	bigtime_t	stall_time;
+	bigtime_t	max_stall_time;
+	// The new frames go to the stream, which isn't behind
+	bool		streaming;
+};
+
+// Receives the frames while the capture is running, in capture order,
+// on the stream thread of the pipeline.
+class FrameStream {
+public:
+	virtual ~FrameStream() {}
+
+	// "buffer" is NULL when the frame is the same as the previous one
+	virtual status_t StreamFrame(const FrameBuffer* buffer,
+		bigtime_t timeStamp) = 0;
+};
+
+
+// Decouples the capture thread from the disk:
+// the capture thread fills one of the pool buffers and queues it,
+// one or more writer threads pick the queued buffers up, append them
+// to the spool and give them back to the pool.
+// With a stream, the frames go to the stream instead, as long as it keeps
+// up. When it falls behind, the frames go to the spool until the stream
+// catches up: it reads them back from the spool, in order, and then gets
+// the new frames again. The spool keeps the frames read back too: the
+// stream gets a prefix of the capture, and the spool the frames after the
+// last one streamed.
+class CapturePipeline {
+public:
+	CapturePipeline(FrameSpool* spool, const BRect& frame,
+		color_space colorSpace, int32 numBuffers, int32 numWriters);
+	~CapturePipeline();
+
+	status_t InitCheck() const;
+
+	// Must be called before Start()
+	void SetStream(FrameStream* stream);
+	bool IsStreaming() const;
+
+	status_t Start();
+	status_t Stop();
+
+	// Capture side. Returns NULL if no buffer became available
+	// within the given time. In that case the frame is counted as dropped.
+	FrameBuffer* AcquireBuffer(bigtime_t timeout);
+	// A frame identical to the previous one is not queued: the buffer
+	// goes back to the pool, and only its time stamp is recorded.
+	void QueueBuffer(FrameBuffer* buffer, bigtime_t timeStamp);
+	void CancelBuffer(FrameBuffer* buffer);
+
+	status_t WriterStatus() const;
+	void GetStatistics(pipeline_stats& stats) const;
+	void PrintStatistics() const;
+
+private:
+	status_t _WriterThread();
+	static int32 _WriterStarter(void* arg);
+	status_t _WriteBuffer(const FrameBuffer* buffer);
+	bool _StreamBuffer(FrameBuffer* buffer, bool duplicate);
+	void _AddSpooled(bigtime_t timeStamp, bool duplicate);
+	void _SetSpooledWritten(bigtime_t timeStamp, off_t offset);
+	void _ReadBackSpooled();
+	status_t _StreamFrame(const FrameBuffer* buffer, bigtime_t timeStamp);
+	status_t _StreamThread();
+	static int32 _StreamStarter(void* arg);
+
+	// A frame spooled while the stream is behind
+	struct spooled_frame {
+		bigtime_t	time_stamp;
+		off_t		offset;
+		bool		duplicate;
+		bool		written;
+	};
+	static bool _SpooledBefore(const spooled_frame& a,
+		const spooled_frame& b);
+
+	FrameSpool*	fSpool;
+	FramePool*	fPool;
+
+	FrameQueue	fReadyQueue;
+	sem_id		fReadySem;
+
+	FrameStream* fStream;
+	FrameQueue	fStreamQueue;
+	sem_id		fStreamSem;
+	thread_id	fStreamThread;
+	int32		fMaxStreamBacklog;
+	int32		fStreaming;
+
+	// The frames spooled since the stream fell behind, in capture order
+	BLocker		fSpoolLock;
+	std::vector<spooled_frame> fSpooled;
+	// Up to there, they were read back
+	int32		fReadBack;
+	// Once some went untracked, the stream can't catch up anymore
+	bool		fSpooledLost;
+	int32		fWritesInProgress;
+
+	// Only accessed by the capture thread
+	int32		fRowLength;
+	frame_hash	fLastHash;
+	bool		fHasLastHash;
+
+	thread_id*	fWriters;
+	int32		fNumWriters;
+	bool		fStopping;
+	int32		fWriterStatus;
+
+	status_t	fInitStatus;
+
+	// statistics
+	int32		fFramesQueued;
+	int32		fFramesStreamed;
+	int32		fFramesReadBack;
+	int32		fFramesWritten;
+	int32		fFramesDropped;
+	int32		fFramesDuplicated;
+	int32		fMaxQueueDepth;
+	int64		fStallTime;
+	int64		fMaxStallTime;
+
+	CapturePipeline(const CapturePipeline&);
+	CapturePipeline& operator=(const CapturePipeline&);
+};
+
+#endif // __CAPTUREPIPELINE_H
@@ -0,0 +1,1143 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ColorConversion.h"
+
+#include <InterfaceDefs.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Pixels converted at a time by the conversions which go through B_RGBA32.
+// Even, so it never splits a group of pixels.
+const static int32 kChunkPixels = 256;
+
+static constexpr color_space_traits kColorSpaceTraits[] = {
+	{ B_RGB32, "B_RGB32", 4, 1, 1, false, false, false },
+	{ B_RGBA32, "B_RGBA32", 4, 1, 1, true, false, false },
+	{ B_RGB24, "B_RGB24", 3, 1, 1, false, false, false },
+	{ B_RGB16, "B_RGB16", 2, 1, 1, false, false, false },
+	{ B_RGB15, "B_RGB15", 2, 1, 1, false, false, false },
+	{ B_RGBA15, "B_RGBA15", 2, 1, 1, true, false, false },
+	{ B_CMAP8, "B_CMAP8", 1, 1, 1, true, true, false },
+	{ B_YCbCr422, "B_YCbCr422", 4, 2, 1, false, false, true },
+	{ B_YCbCr420, "B_YCbCr420", 3, 2, 2, false, false, true }
+};
+
+
+// The chunks never split a group of pixels, and the rows only come in
+// pairs, which is all ConvertRowPairs() knows about
+static constexpr bool
+CheckColorSpaceTraits(size_t index = 0)
+{
+	return index == sizeof(kColorSpaceTraits) / sizeof(kColorSpaceTraits[0])
+		|| (kChunkPixels % kColorSpaceTraits[index].pixelsPerGroup == 0
+			&& kColorSpaceTraits[index].rowsPerGroup <= 2
+			&& CheckColorSpaceTraits(index + 1));
+}
+
+static_assert(CheckColorSpaceTraits(), "kColorSpaceTraits doesn't fit the "
+	"chunks or the row pairs");
+
+
+typedef void (*row_function)(const uint8* from, uint8* to, int32 width);
+
+
+// How a color space is read and written, as 8 bit BGRA
+template<color_space ColorSpace>
+struct packed_pixel;
+
+
+template<>
+struct packed_pixel<B_RGB32> {
+	static const int32 kSize = 4;
+
+	static inline void Read(const uint8* from, uint8* bgra)
+	{
+		bgra[0] = from[0];
+		bgra[1] = from[1];
+		bgra[2] = from[2];
+		// The fourth byte is undefined
+		bgra[3] = 255;
+	}
+
+	static inline void Write(const uint8* bgra, uint8* to)
+	{
+		::memcpy(to, bgra, 4);
+	}
+};
+
+
+template<>
+struct packed_pixel<B_RGBA32> {
+	static const int32 kSize = 4;
+
+	static inline void Read(const uint8* from, uint8* bgra)
+	{
+		::memcpy(bgra, from, 4);
+	}
+
+	static inline void Write(const uint8* bgra, uint8* to)
+	{
+		::memcpy(to, bgra, 4);
+	}
+};
+
+
+template<>
+struct packed_pixel<B_RGB24> {
+	static const int32 kSize = 3;
+
+	static inline void Read(const uint8* from, uint8* bgra)
+	{
+		bgra[0] = from[0];
+		bgra[1] = from[1];
+		bgra[2] = from[2];
+		bgra[3] = 255;
+	}
+
+	static inline void Write(const uint8* bgra, uint8* to)
+	{
+		to[0] = bgra[0];
+		to[1] = bgra[1];
+		to[2] = bgra[2];
+	}
+};
+
+
+// The high bits are replicated into the low ones, so white stays white
+template<>
+struct packed_pixel<B_RGB16> {
+	static const int32 kSize = 2;
+
+	static inline void Read(const uint8* from, uint8* bgra)
+	{
+		uint16 pixel;
+		::memcpy(&pixel, from, sizeof(pixel));
+		const uint8 blue = pixel & 0x1f;
+		const uint8 green = (pixel >> 5) & 0x3f;
+		const uint8 red = pixel >> 11;
+		bgra[0] = (blue << 3) | (blue >> 2);
+		bgra[1] = (green << 2) | (green >> 4);
+		bgra[2] = (red << 3) | (red >> 2);
+		bgra[3] = 255;
+	}
+
+	static inline void Write(const uint8* bgra, uint8* to)
+	{
+		const uint16 pixel = ((bgra[2] >> 3) << 11) | ((bgra[1] >> 2) << 5)
+			| (bgra[0] >> 3);
+		::memcpy(to, &pixel, sizeof(pixel));
+	}
+};
+
+
+template<color_space ColorSpace>
+struct packed_pixel15 {
+	static const int32 kSize = 2;
+
+	static inline void Read(const uint8* from, uint8* bgra)
+	{
+		uint16 pixel;
+		::memcpy(&pixel, from, sizeof(pixel));
+		const uint8 blue = pixel & 0x1f;
+		const uint8 green = (pixel >> 5) & 0x1f;
+		const uint8 red = (pixel >> 10) & 0x1f;
+		bgra[0] = (blue << 3) | (blue >> 2);
+		bgra[1] = (green << 3) | (green >> 2);
+		bgra[2] = (red << 3) | (red >> 2);
+		bgra[3] = ColorSpace == B_RGBA15 && (pixel & 0x8000) == 0 ? 0 : 255;
+	}
+
+	static inline void Write(const uint8* bgra, uint8* to)
+	{
+		uint16 pixel = ((bgra[2] >> 3) << 10) | ((bgra[1] >> 3) << 5)
+			| (bgra[0] >> 3);
+		if (ColorSpace == B_RGBA15 && bgra[3] >= 128)
+			pixel |= 0x8000;
+		::memcpy(to, &pixel, sizeof(pixel));
+	}
+};
+
+
+template<>
+struct packed_pixel<B_RGB15> : packed_pixel15<B_RGB15> {
+};
+
+
+template<>
+struct packed_pixel<B_RGBA15> : packed_pixel15<B_RGBA15> {
+};
+
+
+// The SIMD part of a conversion: converts as many pixels as it can, and
+// returns how many, the others are left to the loop of row_converter.
+template<color_space From, color_space To>
+struct simd_kernel {
+	static inline int32 Convert(const uint8*, uint8*, int32)
+	{
+		return 0;
+	}
+};
+
+
+template<color_space From, color_space To>
+struct row_converter {
+	static void Convert(const uint8* from, uint8* to, int32 width)
+	{
+		const int32 done = simd_kernel<From, To>::Convert(from, to, width);
+		from += done * packed_pixel<From>::kSize;
+		to += done * packed_pixel<To>::kSize;
+		uint8 bgra[4];
+		for (int32 x = done; x < width; x++) {
+			packed_pixel<From>::Read(from, bgra);
+			packed_pixel<To>::Write(bgra, to);
+			from += packed_pixel<From>::kSize;
+			to += packed_pixel<To>::kSize;
+		}
+	}
+};
+
+
+#if defined(__SSE2__)
+// Four 32 bit pixels to 16 bit ones, in the low half of their lanes
+template<color_space From, color_space To>
+static inline __m128i
+PackPixels(__m128i pixels)
+{
+	__m128i packed;
+	if (To == B_RGB16) {
+		packed = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xf800)),
+			_mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x07e0)));
+	} else {
+		packed = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(pixels, 9), _mm_set1_epi32(0x7c00)),
+			_mm_and_si128(_mm_srli_epi32(pixels, 6), _mm_set1_epi32(0x03e0)));
+		if (To == B_RGBA15) {
+			const __m128i alpha = From == B_RGBA32
+				? _mm_and_si128(_mm_srli_epi32(pixels, 16),
+					_mm_set1_epi32(0x8000))
+				: _mm_set1_epi32(0x8000);
+			packed = _mm_or_si128(packed, alpha);
+		}
+	}
+	packed = _mm_or_si128(packed,
+		_mm_and_si128(_mm_srli_epi32(pixels, 3), _mm_set1_epi32(0x1f)));
+	// _mm_packs_epi32() saturates, the values are sign extended so that
+	// it keeps their bits
+	return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+}
+
+
+template<color_space From, color_space To>
+static int32
+PackRow(const uint8* from, uint8* to, int32 width)
+{
+	int32 x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m128i* pixels = reinterpret_cast<const __m128i*>(from + x * 4);
+		const __m128i first = PackPixels<From, To>(_mm_loadu_si128(pixels));
+		const __m128i second
+			= PackPixels<From, To>(_mm_loadu_si128(pixels + 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + x * 2),
+			_mm_packs_epi32(first, second));
+	}
+	return x;
+}
+
+
+static inline __m128i
+Expand(__m128i value, int32 bits)
+{
+	return _mm_or_si128(_mm_slli_epi32(value, 8 - bits),
+		_mm_srli_epi32(value, 2 * bits - 8));
+}
+
+
+// Four 16 bit pixels, in the low half of their lanes, to 32 bit ones
+template<color_space From>
+static inline __m128i
+UnpackPixels(__m128i pixels)
+{
+	const __m128i fiveBits = _mm_set1_epi32(0x1f);
+	__m128i unpacked = Expand(_mm_and_si128(pixels, fiveBits), 5);
+	__m128i alpha = _mm_set1_epi32(0xff000000);
+	if (From == B_RGB16) {
+		unpacked = _mm_or_si128(unpacked, _mm_slli_epi32(Expand(_mm_and_si128(
+			_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x3f)), 6), 8));
+		unpacked = _mm_or_si128(unpacked, _mm_slli_epi32(Expand(_mm_and_si128(
+			_mm_srli_epi32(pixels, 11), fiveBits), 5), 16));
+	} else {
+		unpacked = _mm_or_si128(unpacked, _mm_slli_epi32(Expand(_mm_and_si128(
+			_mm_srli_epi32(pixels, 5), fiveBits), 5), 8));
+		unpacked = _mm_or_si128(unpacked, _mm_slli_epi32(Expand(_mm_and_si128(
+			_mm_srli_epi32(pixels, 10), fiveBits), 5), 16));
+		if (From == B_RGBA15) {
+			const __m128i bit = _mm_set1_epi32(0x8000);
+			alpha = _mm_and_si128(alpha,
+				_mm_cmpeq_epi32(_mm_and_si128(pixels, bit), bit));
+		}
+	}
+	return _mm_or_si128(unpacked, alpha);
+}
+
+
+template<color_space From>
+static int32
+UnpackRow(const uint8* from, uint8* to, int32 width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int32 x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m128i pixels = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(from + x * 2));
+		__m128i* target = reinterpret_cast<__m128i*>(to + x * 4);
+		_mm_storeu_si128(target,
+			UnpackPixels<From>(_mm_unpacklo_epi16(pixels, zero)));
+		_mm_storeu_si128(target + 1,
+			UnpackPixels<From>(_mm_unpackhi_epi16(pixels, zero)));
+	}
+	return x;
+}
+
+
+template<>
+struct simd_kernel<B_RGB32, B_RGBA32> {
+	static inline int32 Convert(const uint8* from, uint8* to, int32 width)
+	{
+		const __m128i alpha = _mm_set1_epi32(0xff000000);
+		int32 x = 0;
+		for (; x + 4 <= width; x += 4) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to + x * 4),
+				_mm_or_si128(alpha, _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(from + x * 4))));
+		}
+		return x;
+	}
+};
+
+
+template<color_space From, color_space To>
+struct pack_kernel {
+	static inline int32 Convert(const uint8* from, uint8* to, int32 width)
+	{
+		return PackRow<From, To>(from, to, width);
+	}
+};
+
+
+template<color_space From, color_space To>
+struct unpack_kernel {
+	static inline int32 Convert(const uint8* from, uint8* to, int32 width)
+	{
+		return UnpackRow<From>(from, to, width);
+	}
+};
+
+
+template<>
+struct simd_kernel<B_RGB32, B_RGB16> : pack_kernel<B_RGB32, B_RGB16> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB32, B_RGB15> : pack_kernel<B_RGB32, B_RGB15> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB32, B_RGBA15> : pack_kernel<B_RGB32, B_RGBA15> {
+};
+
+
+template<>
+struct simd_kernel<B_RGBA32, B_RGB16> : pack_kernel<B_RGBA32, B_RGB16> {
+};
+
+
+template<>
+struct simd_kernel<B_RGBA32, B_RGB15> : pack_kernel<B_RGBA32, B_RGB15> {
+};
+
+
+template<>
+struct simd_kernel<B_RGBA32, B_RGBA15> : pack_kernel<B_RGBA32, B_RGBA15> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB16, B_RGB32> : unpack_kernel<B_RGB16, B_RGB32> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB16, B_RGBA32> : unpack_kernel<B_RGB16, B_RGBA32> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB15, B_RGB32> : unpack_kernel<B_RGB15, B_RGB32> {
+};
+
+
+template<>
+struct simd_kernel<B_RGB15, B_RGBA32> : unpack_kernel<B_RGB15, B_RGBA32> {
+};
+
+
+template<>
+struct simd_kernel<B_RGBA15, B_RGB32> : unpack_kernel<B_RGBA15, B_RGB32> {
+};
+
+
+template<>
+struct simd_kernel<B_RGBA15, B_RGBA32> : unpack_kernel<B_RGBA15, B_RGBA32> {
+};
+#endif
+
+
+struct direct_conversion {
+	color_space		from;
+	color_space		to;
+	row_function	convert;
+};
+
+
+// Every pair of the packed RGB color spaces
+const static direct_conversion kDirectConversions[] = {
+	{ B_RGB32, B_RGBA32, &row_converter<B_RGB32, B_RGBA32>::Convert },
+	{ B_RGB32, B_RGB24, &row_converter<B_RGB32, B_RGB24>::Convert },
+	{ B_RGB32, B_RGB16, &row_converter<B_RGB32, B_RGB16>::Convert },
+	{ B_RGB32, B_RGB15, &row_converter<B_RGB32, B_RGB15>::Convert },
+	{ B_RGB32, B_RGBA15, &row_converter<B_RGB32, B_RGBA15>::Convert },
+	{ B_RGBA32, B_RGB32, &row_converter<B_RGBA32, B_RGB32>::Convert },
+	{ B_RGBA32, B_RGB24, &row_converter<B_RGBA32, B_RGB24>::Convert },
+	{ B_RGBA32, B_RGB16, &row_converter<B_RGBA32, B_RGB16>::Convert },
+	{ B_RGBA32, B_RGB15, &row_converter<B_RGBA32, B_RGB15>::Convert },
+	{ B_RGBA32, B_RGBA15, &row_converter<B_RGBA32, B_RGBA15>::Convert },
+	{ B_RGB24, B_RGB32, &row_converter<B_RGB24, B_RGB32>::Convert },
+	{ B_RGB24, B_RGBA32, &row_converter<B_RGB24, B_RGBA32>::Convert },
+	{ B_RGB24, B_RGB16, &row_converter<B_RGB24, B_RGB16>::Convert },
+	{ B_RGB24, B_RGB15, &row_converter<B_RGB24, B_RGB15>::Convert },
+	{ B_RGB24, B_RGBA15, &row_converter<B_RGB24, B_RGBA15>::Convert },
+	{ B_RGB16, B_RGB32, &row_converter<B_RGB16, B_RGB32>::Convert },
+	{ B_RGB16, B_RGBA32, &row_converter<B_RGB16, B_RGBA32>::Convert },
+	{ B_RGB16, B_RGB24, &row_converter<B_RGB16, B_RGB24>::Convert },
+	{ B_RGB16, B_RGB15, &row_converter<B_RGB16, B_RGB15>::Convert },
+	{ B_RGB16, B_RGBA15, &row_converter<B_RGB16, B_RGBA15>::Convert },
+	{ B_RGB15, B_RGB32, &row_converter<B_RGB15, B_RGB32>::Convert },
+	{ B_RGB15, B_RGBA32, &row_converter<B_RGB15, B_RGBA32>::Convert },
+	{ B_RGB15, B_RGB24, &row_converter<B_RGB15, B_RGB24>::Convert },
+	{ B_RGB15, B_RGB16, &row_converter<B_RGB15, B_RGB16>::Convert },
+	{ B_RGB15, B_RGBA15, &row_converter<B_RGB15, B_RGBA15>::Convert },
+	{ B_RGBA15, B_RGB32, &row_converter<B_RGBA15, B_RGB32>::Convert },
+	{ B_RGBA15, B_RGBA32, &row_converter<B_RGBA15, B_RGBA32>::Convert },
+	{ B_RGBA15, B_RGB24, &row_converter<B_RGBA15, B_RGB24>::Convert },
+	{ B_RGBA15, B_RGB16, &row_converter<B_RGBA15, B_RGB16>::Convert },
+	{ B_RGBA15, B_RGB15, &row_converter<B_RGBA15, B_RGB15>::Convert }
+};
+
+
+static inline uint8
+Clamp(int32 value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+
+// BT.601, video range
+static inline uint8
+Luma(const uint8* bgra)
+{
+	return ((66 * bgra[2] + 129 * bgra[1] + 25 * bgra[0] + 128) >> 8) + 16;
+}
+
+
+// From the sums of the channels of "1 << shift" pixels
+static inline uint8
+BlueDifference(int32 red, int32 green, int32 blue, int32 shift)
+{
+	return ((-38 * red - 74 * green + 112 * blue + (128 << shift))
+		>> (8 + shift)) + 128;
+}
+
+
+static inline uint8
+RedDifference(int32 red, int32 green, int32 blue, int32 shift)
+{
+	return ((112 * red - 94 * green - 18 * blue + (128 << shift))
+		>> (8 + shift)) + 128;
+}
+
+
+static inline void
+YCbCrToRGBA32(int32 y, int32 cb, int32 cr, uint8* to)
+{
+	const int32 luma = 298 * (y - 16) + 128;
+	cb -= 128;
+	cr -= 128;
+	to[0] = Clamp((luma + 516 * cb) >> 8);
+	to[1] = Clamp((luma - 100 * cb - 208 * cr) >> 8);
+	to[2] = Clamp((luma + 409 * cr) >> 8);
+	to[3] = 255;
+}
+
+
+static void
+CMAP8ToRGBA32(const uint8* from, uint8* to, int32 width)
+{
+	const color_map* colorMap = system_colors();
+	for (int32 x = 0; x < width; x++, to += 4) {
+		const rgb_color& color = colorMap->color_list[from[x]];
+		to[0] = color.blue;
+		to[1] = color.green;
+		to[2] = color.red;
+		to[3] = from[x] == B_TRANSPARENT_MAGIC_CMAP8 ? 0 : 255;
+	}
+}
+
+
+static void
+RGBA32ToCMAP8(const uint8* from, uint8* to, int32 width)
+{
+	const color_map* colorMap = system_colors();
+	for (int32 x = 0; x < width; x++, from += 4) {
+		if (from[3] < 128) {
+			to[x] = B_TRANSPARENT_MAGIC_CMAP8;
+			continue;
+		}
+		to[x] = colorMap->index_map[((from[2] & 0xf8) << 7)
+			| ((from[1] & 0xf8) << 2) | (from[0] >> 3)];
+	}
+}
+
+
+// Ordered dithering, with a 4x4 Bayer matrix of thresholds from 0 to 15.
+// The pattern only depends on the position of the pixel, so that a still
+// part of the screen stays the same from a frame to the next.
+const static uint8 kBayer[4][4] = {
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
+// The system palette is mostly a cube of 6 levels for every channel
+const static int32 kPaletteStep = 51;
+
+
+typedef void (*dither_function)(const uint8* from, uint8* to, int32 width,
+	int32 row);
+
+
+// What is added to the channels of the 4 pixels of a pattern row, as 8 bit
+// BGRA, before they're truncated to "To": up to a step of the channel
+template<color_space To>
+static inline void
+DitherOffsets(int32 row, uint8* offsets)
+{
+	for (int32 x = 0; x < 4; x++) {
+		const int32 threshold = kBayer[row & 3][x];
+		offsets[x * 4] = threshold / 2;
+		offsets[x * 4 + 1] = To == B_RGB16 ? threshold / 4 : threshold / 2;
+		offsets[x * 4 + 2] = threshold / 2;
+		offsets[x * 4 + 3] = 0;
+	}
+}
+
+
+#if defined(__SSE2__)
+// The pattern repeats every 4 pixels, the width of a vector
+template<color_space From, color_space To>
+static int32
+DitherRow(const uint8* from, uint8* to, int32 width, const uint8* offsets)
+{
+	const __m128i dither
+		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(offsets));
+	int32 x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m128i* pixels = reinterpret_cast<const __m128i*>(from + x * 4);
+		const __m128i first = PackPixels<From, To>(
+			_mm_adds_epu8(_mm_loadu_si128(pixels), dither));
+		const __m128i second = PackPixels<From, To>(
+			_mm_adds_epu8(_mm_loadu_si128(pixels + 1), dither));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + x * 2),
+			_mm_packs_epi32(first, second));
+	}
+	return x;
+}
+#endif
+
+
+// 32 bit pixels to 16 or 15 bit ones, dithered
+template<color_space From, color_space To>
+struct dither_converter {
+	static void Convert(const uint8* from, uint8* to, int32 width, int32 row)
+	{
+		uint8 offsets[16];
+		DitherOffsets<To>(row, offsets);
+		int32 x = 0;
+#if defined(__SSE2__)
+		x = DitherRow<From, To>(from, to, width, offsets);
+#endif
+		uint8 bgra[4];
+		for (; x < width; x++) {
+			packed_pixel<From>::Read(from + x * 4, bgra);
+			const uint8* offset = offsets + (x & 3) * 4;
+			for (int32 channel = 0; channel < 3; channel++) {
+				bgra[channel] = std::min(int32(bgra[channel])
+					+ offset[channel], int32(255));
+			}
+			packed_pixel<To>::Write(bgra, to + x * 2);
+		}
+	}
+};
+
+
+// 32 bit pixels to the system palette, dithered by up to half a step
+// of its cube either way
+template<color_space From>
+static void
+DitherToCMAP8(const uint8* from, uint8* to, int32 width, int32 row)
+{
+	const color_map* colorMap = system_colors();
+	int32 offsets[4];
+	for (int32 x = 0; x < 4; x++)
+		offsets[x] = (2 * kBayer[row & 3][x] - 15) * kPaletteStep / 32;
+
+	for (int32 x = 0; x < width; x++, from += 4) {
+		if (From == B_RGBA32 && from[3] < 128) {
+			to[x] = B_TRANSPARENT_MAGIC_CMAP8;
+			continue;
+		}
+		const int32 offset = offsets[x & 3];
+		to[x] = colorMap->index_map[((Clamp(from[2] + offset) & 0xf8) << 7)
+			| ((Clamp(from[1] + offset) & 0xf8) << 2)
+			| (Clamp(from[0] + offset) >> 3)];
+	}
+}
+
+
+struct dither_conversion {
+	color_space		from;
+	color_space		to;
+	dither_function	convert;
+};
+
+
+const static dither_conversion kDitherConversions[] = {
+	{ B_RGB32, B_RGB16, &dither_converter<B_RGB32, B_RGB16>::Convert },
+	{ B_RGB32, B_RGB15, &dither_converter<B_RGB32, B_RGB15>::Convert },
+	{ B_RGB32, B_RGBA15, &dither_converter<B_RGB32, B_RGBA15>::Convert },
+	{ B_RGB32, B_CMAP8, &DitherToCMAP8<B_RGB32> },
+	{ B_RGBA32, B_RGB16, &dither_converter<B_RGBA32, B_RGB16>::Convert },
+	{ B_RGBA32, B_RGB15, &dither_converter<B_RGBA32, B_RGB15>::Convert },
+	{ B_RGBA32, B_RGBA15, &dither_converter<B_RGBA32, B_RGBA15>::Convert },
+	{ B_RGBA32, B_CMAP8, &DitherToCMAP8<B_RGBA32> }
+};
+
+
+// Groups of Y0 Cb Y1 Cr. The last group of an odd row is complete,
+// with the last pixel in it twice.
+static void
+YCbCr422ToRGBA32(const uint8* from, uint8* to, int32 width)
+{
+	for (int32 x = 0; x < width; x += 2, from += 4, to += 8) {
+		YCbCrToRGBA32(from[0], from[1], from[3], to);
+		if (x + 1 < width)
+			YCbCrToRGBA32(from[2], from[1], from[3], to + 4);
+	}
+}
+
+
+static void
+RGBA32ToYCbCr422(const uint8* from, uint8* to, int32 width)
+{
+	for (int32 x = 0; x < width; x += 2, from += 8, to += 4) {
+		const uint8* second = x + 1 < width ? from + 4 : from;
+		const int32 red = from[2] + second[2];
+		const int32 green = from[1] + second[1];
+		const int32 blue = from[0] + second[0];
+		to[0] = Luma(from);
+		to[1] = BlueDifference(red, green, blue, 1);
+		to[2] = Luma(second);
+		to[3] = RedDifference(red, green, blue, 1);
+	}
+}
+
+
+// Groups of C Y0 Y1, where C is Cb on the even row and Cr on the odd one.
+// Without the odd row, at the end of an image of odd height, Cr is 128.
+static void
+YCbCr420ToRGBA32(const uint8* even, const uint8* odd, uint8* toEven,
+	uint8* toOdd, int32 width)
+{
+	for (int32 x = 0; x < width; x += 2, even += 3, toEven += 8) {
+		const int32 cb = even[0];
+		const int32 cr = odd != NULL ? odd[0] : 128;
+		const bool pair = x + 1 < width;
+		YCbCrToRGBA32(even[1], cb, cr, toEven);
+		if (pair)
+			YCbCrToRGBA32(even[2], cb, cr, toEven + 4);
+		if (odd != NULL) {
+			YCbCrToRGBA32(odd[1], cb, cr, toOdd);
+			if (pair)
+				YCbCrToRGBA32(odd[2], cb, cr, toOdd + 4);
+			odd += 3;
+			toOdd += 8;
+		}
+	}
+}
+
+
+static void
+RGBA32ToYCbCr420(const uint8* even, const uint8* odd, uint8* toEven,
+	uint8* toOdd, int32 width)
+{
+	const bool hasOdd = odd != NULL;
+	if (!hasOdd)
+		odd = even;
+	for (int32 x = 0; x < width; x += 2, even += 8, odd += 8, toEven += 3) {
+		const int32 next = x + 1 < width ? 4 : 0;
+		const int32 red = even[2] + even[next + 2] + odd[2] + odd[next + 2];
+		const int32 green = even[1] + even[next + 1] + odd[1]
+			+ odd[next + 1];
+		const int32 blue = even[0] + even[next] + odd[0] + odd[next];
+		toEven[0] = BlueDifference(red, green, blue, 2);
+		toEven[1] = Luma(even);
+		toEven[2] = Luma(even + next);
+		if (hasOdd) {
+			toOdd[0] = RedDifference(red, green, blue, 2);
+			toOdd[1] = Luma(odd);
+			toOdd[2] = Luma(odd + next);
+			toOdd += 3;
+		}
+	}
+}
+
+
+#if defined(__SSE2__)
+// The channels of 8 pixels of 8 bit BGRA, in 16 bit lanes
+static inline void
+SplitChannels(const uint8* pixels, __m128i& blue, __m128i& green,
+	__m128i& red)
+{
+	const __m128i mask = _mm_set1_epi32(0xff);
+	const __m128i first = _mm_loadu_si128(
+		reinterpret_cast<const __m128i*>(pixels));
+	const __m128i second = _mm_loadu_si128(
+		reinterpret_cast<const __m128i*>(pixels + 16));
+	blue = _mm_packs_epi32(_mm_and_si128(first, mask),
+		_mm_and_si128(second, mask));
+	green = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 8), mask),
+		_mm_and_si128(_mm_srli_epi32(second, 8), mask));
+	red = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 16), mask),
+		_mm_and_si128(_mm_srli_epi32(second, 16), mask));
+}
+
+
+// The sum can't go over 16 bits unsigned, the lanes wrap around
+static inline __m128i
+LumaLanes(__m128i blue, __m128i green, __m128i red)
+{
+	const __m128i sum = _mm_add_epi16(
+		_mm_add_epi16(_mm_mullo_epi16(red, _mm_set1_epi16(66)),
+			_mm_mullo_epi16(green, _mm_set1_epi16(129))),
+		_mm_add_epi16(_mm_mullo_epi16(blue, _mm_set1_epi16(25)),
+			_mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+
+// Chroma of 4 pixel pairs, from the sums of the channels of the pairs,
+// in the low 4 lanes, and the weights of "first" and "second"
+static inline __m128i
+ChromaLanes(__m128i first, __m128i second, __m128i third, int16 firstWeight,
+	int16 secondWeight, int16 thirdWeight)
+{
+	const __m128i rounding = _mm_set1_epi16(512);
+	const __m128i sum = _mm_add_epi32(
+		_mm_madd_epi16(_mm_unpacklo_epi16(first, second),
+			_mm_set_epi16(secondWeight, firstWeight, secondWeight, firstWeight,
+				secondWeight, firstWeight, secondWeight, firstWeight)),
+		_mm_madd_epi16(_mm_unpacklo_epi16(third, rounding),
+			_mm_set_epi16(1, thirdWeight, 1, thirdWeight, 1, thirdWeight, 1,
+				thirdWeight)));
+	const __m128i chroma = _mm_add_epi32(_mm_srai_epi32(sum, 10),
+		_mm_set1_epi32(128));
+	const __m128i packed = _mm_packs_epi32(chroma, chroma);
+	return _mm_packus_epi16(packed, packed);
+}
+#endif
+
+
+// Two rows of 8 bit BGRA to planar 4:2:0. Without the odd row, the
+// chroma only comes from the even one.
+static void
+RGBA32ToPlanarYUV420(const uint8* even, const uint8* odd, uint8* yEven,
+	uint8* yOdd, uint8* cb, uint8* cr, int32 width)
+{
+	const bool hasOdd = odd != NULL;
+	if (!hasOdd)
+		odd = even;
+	int32 x = 0;
+#if defined(__SSE2__)
+	const __m128i ones = _mm_set1_epi16(1);
+	for (; x + 8 <= width; x += 8) {
+		__m128i evenBlue, evenGreen, evenRed;
+		__m128i oddBlue, oddGreen, oddRed;
+		SplitChannels(even + x * 4, evenBlue, evenGreen, evenRed);
+		SplitChannels(odd + x * 4, oddBlue, oddGreen, oddRed);
+
+		const __m128i evenLuma = LumaLanes(evenBlue, evenGreen, evenRed);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(yEven + x),
+			_mm_packus_epi16(evenLuma, evenLuma));
+		if (hasOdd) {
+			const __m128i oddLuma = LumaLanes(oddBlue, oddGreen, oddRed);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(yOdd + x),
+				_mm_packus_epi16(oddLuma, oddLuma));
+		}
+
+		// Sums of the 2x2 blocks, in the low 4 lanes
+		__m128i blue = _mm_madd_epi16(_mm_add_epi16(evenBlue, oddBlue), ones);
+		__m128i green = _mm_madd_epi16(_mm_add_epi16(evenGreen, oddGreen),
+			ones);
+		__m128i red = _mm_madd_epi16(_mm_add_epi16(evenRed, oddRed), ones);
+		blue = _mm_packs_epi32(blue, blue);
+		green = _mm_packs_epi32(green, green);
+		red = _mm_packs_epi32(red, red);
+
+		const int32 blueDifference = _mm_cvtsi128_si32(
+			ChromaLanes(blue, green, red, 112, -74, -38));
+		const int32 redDifference = _mm_cvtsi128_si32(
+			ChromaLanes(red, green, blue, 112, -94, -18));
+		::memcpy(cb + x / 2, &blueDifference, 4);
+		::memcpy(cr + x / 2, &redDifference, 4);
+	}
+#endif
+	for (; x < width; x += 2) {
+		const int32 next = x + 1 < width ? 4 : 0;
+		const uint8* evenPixel = even + x * 4;
+		const uint8* oddPixel = odd + x * 4;
+		yEven[x] = Luma(evenPixel);
+		if (next != 0)
+			yEven[x + 1] = Luma(evenPixel + next);
+		if (hasOdd) {
+			yOdd[x] = Luma(oddPixel);
+			if (next != 0)
+				yOdd[x + 1] = Luma(oddPixel + next);
+		}
+		const int32 red = evenPixel[2] + evenPixel[next + 2] + oddPixel[2]
+			+ oddPixel[next + 2];
+		const int32 green = evenPixel[1] + evenPixel[next + 1] + oddPixel[1]
+			+ oddPixel[next + 1];
+		const int32 blue = evenPixel[0] + evenPixel[next] + oddPixel[0]
+			+ oddPixel[next];
+		cb[x / 2] = BlueDifference(red, green, blue, 2);
+		cr[x / 2] = RedDifference(red, green, blue, 2);
+	}
+}
+
+
+struct color_space_functions {
+	color_space		colorSpace;
+	row_function	toRGBA32;
+	row_function	fromRGBA32;
+};
+
+
+// B_YCbCr420 isn't here: its rows go in pairs
+const static color_space_functions kColorSpaceFunctions[] = {
+	{ B_RGB32, &row_converter<B_RGB32, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGB32>::Convert },
+	{ B_RGBA32, &row_converter<B_RGBA32, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGBA32>::Convert },
+	{ B_RGB24, &row_converter<B_RGB24, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGB24>::Convert },
+	{ B_RGB16, &row_converter<B_RGB16, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGB16>::Convert },
+	{ B_RGB15, &row_converter<B_RGB15, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGB15>::Convert },
+	{ B_RGBA15, &row_converter<B_RGBA15, B_RGBA32>::Convert,
+		&row_converter<B_RGBA32, B_RGBA15>::Convert },
+	{ B_CMAP8, &CMAP8ToRGBA32, &RGBA32ToCMAP8 },
+	{ B_YCbCr422, &YCbCr422ToRGBA32, &RGBA32ToYCbCr422 }
+};
+
+
+static row_function
+FindDirectConversion(color_space from, color_space to)
+{
+	const int32 count = sizeof(kDirectConversions) / sizeof(kDirectConversions[0]);
+	for (int32 i = 0; i < count; i++) {
+		if (kDirectConversions[i].from == from && kDirectConversions[i].to == to)
+			return kDirectConversions[i].convert;
+	}
+	return NULL;
+}
+
+
+static dither_function
+FindDitherConversion(color_space from, color_space to)
+{
+	const int32 count = sizeof(kDitherConversions)
+		/ sizeof(kDitherConversions[0]);
+	for (int32 i = 0; i < count; i++) {
+		if (kDitherConversions[i].from == from && kDitherConversions[i].to == to)
+			return kDitherConversions[i].convert;
+	}
+	return NULL;
+}
+
+
+static const color_space_functions*
+FindFunctions(color_space colorSpace)
+{
+	const int32 count = sizeof(kColorSpaceFunctions)
+		/ sizeof(kColorSpaceFunctions[0]);
+	for (int32 i = 0; i < count; i++) {
+		if (kColorSpaceFunctions[i].colorSpace == colorSpace)
+			return &kColorSpaceFunctions[i];
+	}
+	return NULL;
+}
+
+
+// For B_YCbCr420 on either side, two rows at a time
+static void
+ConvertRowPairs(const uint8* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, uint8* to, int32 toBytesPerRow,
+	color_space toColorSpace, int32 width, int32 rows)
+{
+	const color_space_functions* fromFunctions = FindFunctions(fromColorSpace);
+	const color_space_functions* toFunctions = FindFunctions(toColorSpace);
+	uint8 evenBuffer[kChunkPixels * 4];
+	uint8 oddBuffer[kChunkPixels * 4];
+	for (int32 y = 0; y < rows; y += 2) {
+		const uint8* even = from + ssize_t(y) * fromBytesPerRow;
+		const uint8* odd = y + 1 < rows ? even + fromBytesPerRow : NULL;
+		uint8* toEven = to + ssize_t(y) * toBytesPerRow;
+		uint8* toOdd = odd != NULL ? toEven + toBytesPerRow : NULL;
+		for (int32 x = 0; x < width; x += kChunkPixels) {
+			const int32 count = std::min(width - x, kChunkPixels);
+			const size_t fromOffset = RowLength(fromColorSpace, x);
+			const size_t toOffset = RowLength(toColorSpace, x);
+			if (fromFunctions == NULL) {
+				YCbCr420ToRGBA32(even + fromOffset,
+					odd != NULL ? odd + fromOffset : NULL, evenBuffer,
+					oddBuffer, count);
+			} else {
+				fromFunctions->toRGBA32(even + fromOffset, evenBuffer, count);
+				if (odd != NULL)
+					fromFunctions->toRGBA32(odd + fromOffset, oddBuffer, count);
+			}
+			if (toFunctions == NULL) {
+				RGBA32ToYCbCr420(evenBuffer, odd != NULL ? oddBuffer : NULL,
+					toEven + toOffset, odd != NULL ? toOdd + toOffset : NULL,
+					count);
+			} else {
+				toFunctions->fromRGBA32(evenBuffer, toEven + toOffset, count);
+				if (odd != NULL)
+					toFunctions->fromRGBA32(oddBuffer, toOdd + toOffset, count);
+			}
+		}
+	}
+}
+
+
+const color_space_traits*
+GetColorSpaceTraits(color_space colorSpace)
+{
+	const int32 count = sizeof(kColorSpaceTraits) / sizeof(kColorSpaceTraits[0]);
+	for (int32 i = 0; i < count; i++) {
+		if (kColorSpaceTraits[i].colorSpace == colorSpace)
+			return &kColorSpaceTraits[i];
+	}
+	return NULL;
+}
+
+
+size_t
+RowLength(color_space colorSpace, int32 width)
+{
+	const color_space_traits* traits = GetColorSpaceTraits(colorSpace);
+	if (traits == NULL || width <= 0)
+		return 0;
+	return size_t(width + traits->pixelsPerGroup - 1) / traits->pixelsPerGroup
+		* traits->groupSize;
+}
+
+
+bool
+CanConvertColorSpace(color_space from, color_space to)
+{
+	if (GetColorSpaceTraits(from) == NULL || GetColorSpaceTraits(to) == NULL)
+		return false;
+	// The palette comes from the app_server
+	if ((from == B_CMAP8 || to == B_CMAP8) && system_colors() == NULL)
+		return false;
+	return true;
+}
+
+
+status_t
+ConvertBits(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, void* to, int32 toBytesPerRow,
+	color_space toColorSpace, int32 width, int32 rows)
+{
+	if (from == NULL || to == NULL || width < 0 || rows < 0)
+		return B_BAD_VALUE;
+	if (!CanConvertColorSpace(fromColorSpace, toColorSpace))
+		return B_NOT_SUPPORTED;
+
+	const uint8* source = static_cast<const uint8*>(from);
+	uint8* target = static_cast<uint8*>(to);
+	if (fromColorSpace == toColorSpace) {
+		const size_t length = RowLength(fromColorSpace, width);
+		for (int32 y = 0; y < rows; y++) {
+			::memcpy(target + ssize_t(y) * toBytesPerRow,
+				source + ssize_t(y) * fromBytesPerRow, length);
+		}
+		return B_OK;
+	}
+
+	if (fromColorSpace == B_YCbCr420 || toColorSpace == B_YCbCr420) {
+		ConvertRowPairs(source, fromBytesPerRow, fromColorSpace, target,
+			toBytesPerRow, toColorSpace, width, rows);
+		return B_OK;
+	}
+
+	const row_function convert = FindDirectConversion(fromColorSpace,
+		toColorSpace);
+	if (convert != NULL) {
+		for (int32 y = 0; y < rows; y++) {
+			convert(source + ssize_t(y) * fromBytesPerRow,
+				target + ssize_t(y) * toBytesPerRow, width);
+		}
+		return B_OK;
+	}
+
+	// Through B_RGBA32, a chunk of the row at a time
+	const color_space_functions* fromFunctions = FindFunctions(fromColorSpace);
+	const color_space_functions* toFunctions = FindFunctions(toColorSpace);
+	uint8 buffer[kChunkPixels * 4];
+	for (int32 y = 0; y < rows; y++) {
+		const uint8* sourceRow = source + ssize_t(y) * fromBytesPerRow;
+		uint8* targetRow = target + ssize_t(y) * toBytesPerRow;
+		for (int32 x = 0; x < width; x += kChunkPixels) {
+			const int32 count = std::min(width - x, kChunkPixels);
+			fromFunctions->toRGBA32(
+				sourceRow + RowLength(fromColorSpace, x), buffer, count);
+			toFunctions->fromRGBA32(buffer,
+				targetRow + RowLength(toColorSpace, x), count);
+		}
+	}
+	return B_OK;
+}
+
+
+status_t
+DitherBits(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, void* to, int32 toBytesPerRow,
+	color_space toColorSpace, int32 width, int32 rows, int32 firstRow)
+{
+	const dither_function convert = FindDitherConversion(fromColorSpace,
+		toColorSpace);
+	if (convert == NULL || !CanConvertColorSpace(fromColorSpace, toColorSpace)) {
+		return ConvertBits(from, fromBytesPerRow, fromColorSpace, to,
+			toBytesPerRow, toColorSpace, width, rows);
+	}
+	if (from == NULL || to == NULL || width < 0 || rows < 0)
+		return B_BAD_VALUE;
+
+	const uint8* source = static_cast<const uint8*>(from);
+	uint8* target = static_cast<uint8*>(to);
+	for (int32 y = 0; y < rows; y++) {
+		convert(source + ssize_t(y) * fromBytesPerRow,
+			target + ssize_t(y) * toBytesPerRow, width, firstRow + y);
+	}
+	return B_OK;
+}
+
+
+bool
+IsConvertibleColorSpace(color_space colorSpace)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+		case B_RGB24:
+		case B_RGB16:
+		case B_RGB15:
+		case B_RGBA15:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+void
+ConvertRowToRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace)
+{
+	ConvertBits(from, 0, colorSpace, to, 0, B_RGBA32, width, 1);
+}
+
+
+void
+ConvertRowFromRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace)
+{
+	ConvertBits(from, 0, B_RGBA32, to, 0, colorSpace, width, 1);
+}
+
+
+status_t
+ConvertToPlanarYUV420(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, uint8* y, int32 yBytesPerRow, uint8* cb,
+	uint8* cr, int32 chromaBytesPerRow, int32 width, int32 rows)
+{
+	if (from == NULL || y == NULL || cb == NULL || cr == NULL || width < 0
+		|| rows < 0)
+		return B_BAD_VALUE;
+	if (!CanConvertColorSpace(fromColorSpace, B_RGBA32))
+		return B_NOT_SUPPORTED;
+
+	// The 32 bit color spaces are read in place
+	const bool direct = fromColorSpace == B_RGB32
+		|| fromColorSpace == B_RGBA32;
+	const int32 bufferBytesPerRow = kChunkPixels * 4;
+	uint8 buffer[2 * kChunkPixels * 4];
+	const uint8* source = static_cast<const uint8*>(from);
+	for (int32 row = 0; row < rows; row += 2) {
+		const uint8* even = source + ssize_t(row) * fromBytesPerRow;
+		const bool hasOdd = row + 1 < rows;
+		uint8* yEven = y + ssize_t(row) * yBytesPerRow;
+		uint8* yOdd = yEven + yBytesPerRow;
+		uint8* cbRow = cb + ssize_t(row / 2) * chromaBytesPerRow;
+		uint8* crRow = cr + ssize_t(row / 2) * chromaBytesPerRow;
+		if (direct) {
+			RGBA32ToPlanarYUV420(even, hasOdd ? even + fromBytesPerRow : NULL,
+				yEven, yOdd, cbRow, crRow, width);
+			continue;
+		}
+		for (int32 x = 0; x < width; x += kChunkPixels) {
+			const int32 count = std::min(width - x, kChunkPixels);
+			ConvertBits(even + RowLength(fromColorSpace, x), fromBytesPerRow,
+				fromColorSpace, buffer, bufferBytesPerRow, B_RGBA32, count,
+				hasOdd ? 2 : 1);
+			RGBA32ToPlanarYUV420(buffer,
+				hasOdd ? buffer + bufferBytesPerRow : NULL, yEven + x,
+				yOdd + x, cbRow + x / 2, crRow + x / 2, count);
+		}
+	}
+	return B_OK;
+}
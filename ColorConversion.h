@@ -0,0 +1,67 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __COLORCONVERSION_H
+#define __COLORCONVERSION_H
+
+#include "Platform.h"
+
+// Layout of the color spaces the conversions know about
+struct color_space_traits {
+	color_space	colorSpace;
+	const char*	name;
+	// Pixels are stored in groups: a group of B_YCbCr422 is 4 bytes
+	// for 2 pixels, which share their chroma
+	int32		groupSize;
+	int32		pixelsPerGroup;
+	// B_YCbCr420 rows come in pairs: the even row has the Cb samples,
+	// the odd one the Cr samples of both
+	int32		rowsPerGroup;
+	bool		hasAlpha;
+	bool		isIndexed;
+	bool		isYCbCr;
+};
+
+// NULL for the color spaces which can't be converted
+const color_space_traits* GetColorSpaceTraits(color_space colorSpace);
+// Bytes taken by "width" pixels of a row
+size_t RowLength(color_space colorSpace, int32 width);
+
+// B_RGB32, B_RGBA32, B_RGB24, B_RGB16, B_RGB15, B_RGBA15, B_CMAP8
+// (with the system palette), B_YCbCr422 and B_YCbCr420 convert to each
+// other. The RGB pairs have their own kernels, the other ones go through
+// B_RGBA32 a chunk of the row at a time. YCbCr is BT.601, video range.
+bool CanConvertColorSpace(color_space from, color_space to);
+// Converts "rows" rows of "width" pixels. For B_YCbCr420, "from" and "to"
+// must point at an even row, and "rows" only can be odd at the end of
+// the image.
+status_t ConvertBits(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, void* to, int32 toBytesPerRow,
+	color_space toColorSpace, int32 width, int32 rows);
+
+// Like ConvertBits(), but from B_RGB32 and B_RGBA32 to B_RGB16, B_RGB15,
+// B_RGBA15 and B_CMAP8 the pixels are dithered, so that gradients don't
+// turn into bands. "firstRow" is the row of the image "from" points at,
+// for the pattern to line up when an image is converted in parts.
+status_t DitherBits(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, void* to, int32 toBytesPerRow,
+	color_space toColorSpace, int32 width, int32 rows, int32 firstRow = 0);
+
+// Planar 4:2:0 (B_YUV420 for the codecs), what most codecs work with: a
+// plane of Y, and planes of Cb and Cr with a sample for every 2x2 pixels.
+// The same rules as for ConvertBits() apply to "from" and "rows"; the
+// planes start at the matching row, the chroma ones at half of it.
+status_t ConvertToPlanarYUV420(const void* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, uint8* y, int32 yBytesPerRow, uint8* cb,
+	uint8* cr, int32 chromaBytesPerRow, int32 width, int32 rows);
+
+// Row conversions between the RGB color spaces and 8 bit BGRA
+// (B_RGBA32 byte order), for the code working on BGRA pixels.
+bool IsConvertibleColorSpace(color_space colorSpace);
+void ConvertRowToRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace);
+void ConvertRowFromRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace);
+
+#endif // __COLORCONVERSION_H
@@ -28,7 +28,8 @@ enum appMessages {
 							// const char* "file_name",
 							// int32 "frames_processed"
 	kEncodingProgress,
-	kFileNameChanged
+	kFileNameChanged,
+	kReplayFailed			// int32 "status"
 };
 
 
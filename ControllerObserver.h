@@ -12,6 +12,13 @@ enum {
 	kMsgControllerCapturePaused,
 	kMsgControllerCaptureResumed,
 	kMsgControllerCaptureProgress,			// int32 "frames_total"
+											// int32 "frames_dropped"
+											// int32 "frames_duplicated"
+											// int32 "queue_depth"
+											// bigtime_t "stall_time"
+											// bigtime_t "copy_time"
+											// bool "streaming": false while
+											// the encoder is behind
 
 	kMsgControllerEncodeStarted,			// int32 "frames_total"
 
@@ -19,6 +26,9 @@ enum {
 											// const char* "text"
 											// bool "reset"
 											// int32 "frames_total"
+											// int32 "segments"
+											// int32 "segment"
+											// int32 "segment_frames_remaining"
 
 	kMsgControllerEncodeFinished,			// status_t "status"
 											// const char* "file_name"
@@ -33,8 +43,11 @@ enum {
 	kMsgControllerMediaFileFormatChanged,	// const char* "format_name"
 
 	kMsgControllerCaptureFrameRateChanged,	// int32 "frame_rate"
+	kMsgControllerPlaybackFrameRateChanged,	// int32 "frame_rate"
 
-	kMsgControllerResetSettings
+	kMsgControllerResetSettings,
+
+	kMsgControllerReplayStopped			// status_t "status"
 };
 
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "DeltaCodec.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A literal run only ends when at least this many unchanged bytes follow:
+// shorter runs cost more as a token than as literal bytes
+const static int32 kMinZeroRun = 16;
+// Maximum size of a varint for a 32 bit value
+const static size_t kMaxVarIntSize = 5;
+
+
+static inline uint8*
+WriteVarInt(uint8* out, uint32 value)
+{
+	while (value >= 0x80) {
+		*out++ = uint8(value) | 0x80;
+		value >>= 7;
+	}
+	*out++ = uint8(value);
+	return out;
+}
+
+
+static inline const uint8*
+ReadVarInt(const uint8* data, const uint8* end, uint32& value)
+{
+	value = 0;
+	for (int32 shift = 0; data < end && shift < 35; shift += 7) {
+		const uint8 byte = *data++;
+		value |= uint32(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return data;
+	}
+	return NULL;
+}
+
+
+// Returns how many bytes are the same in both rows, starting at "start"
+static inline int32
+CountEqual(const uint8* a, const uint8* b, int32 start, int32 length)
+{
+	int32 i = start;
+#if defined(__SSE2__)
+	for (; i + 16 <= length; i += 16) {
+		const __m128i equal = _mm_cmpeq_epi8(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+		const uint32 mask = ~uint32(_mm_movemask_epi8(equal)) & 0xffff;
+		if (mask != 0)
+			return i + __builtin_ctz(mask) - start;
+	}
+#else
+	for (; i + 8 <= length; i += 8) {
+		uint64 x;
+		uint64 y;
+		::memcpy(&x, a + i, sizeof(x));
+		::memcpy(&y, b + i, sizeof(y));
+		if (x != y)
+			break;
+	}
+#endif
+	while (i < length && a[i] == b[i])
+		i++;
+	return i - start;
+}
+
+
+// Returns true if the kMinZeroRun bytes at "start" are the same in both rows
+static inline bool
+IsEqualRun(const uint8* a, const uint8* b, int32 start)
+{
+#if defined(__SSE2__)
+	const __m128i equal = _mm_cmpeq_epi8(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + start)),
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + start)));
+	return _mm_movemask_epi8(equal) == 0xffff;
+#else
+	return ::memcmp(a + start, b + start, kMinZeroRun) == 0;
+#endif
+}
+
+
+static inline void
+XorBytes(uint8* to, const uint8* a, const uint8* b, int32 length)
+{
+	int32 i = 0;
+#if defined(__SSE2__)
+	for (; i + 16 <= length; i += 16) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), _mm_xor_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+	}
+#endif
+	for (; i < length; i++)
+		to[i] = a[i] ^ b[i];
+}
+
+
+size_t
+DeltaEncodeBound(int32 rowLength, int32 rows)
+{
+	// In the worst case every literal run is interrupted by a short zero run
+	const size_t tokens = rowLength / kMinZeroRun + 1;
+	return (size_t(rowLength) + tokens * 2 * kMaxVarIntSize) * rows;
+}
+
+
+size_t
+DeltaEncode(const uint8* frame, const uint8* reference, int32 bytesPerRow,
+	int32 rowLength, int32 rows, uint8* out)
+{
+	uint8* start = out;
+	for (int32 y = 0; y < rows; y++) {
+		const uint8* current = frame + y * bytesPerRow;
+		const uint8* previous = reference + y * bytesPerRow;
+
+		int32 position = 0;
+		while (position < rowLength) {
+			const int32 zeroes = CountEqual(current, previous, position,
+				rowLength);
+			const int32 literalStart = position + zeroes;
+
+			// The literal run goes on until a long enough unchanged run
+			int32 literalEnd = literalStart;
+			while (literalEnd + kMinZeroRun <= rowLength
+				&& !IsEqualRun(current, previous, literalEnd))
+				literalEnd += kMinZeroRun;
+			if (literalEnd + kMinZeroRun > rowLength)
+				literalEnd = rowLength;
+
+			const int32 literals = literalEnd - literalStart;
+			out = WriteVarInt(out, zeroes);
+			out = WriteVarInt(out, literals);
+			XorBytes(out, current + literalStart, previous + literalStart,
+				literals);
+			out += literals;
+
+			position = literalEnd;
+		}
+	}
+	return out - start;
+}
+
+
+status_t
+DeltaDecode(const uint8* data, size_t size, uint8* frame, int32 bytesPerRow,
+	int32 rowLength, int32 rows)
+{
+	const uint8* end = data + size;
+	for (int32 y = 0; y < rows; y++) {
+		uint8* row = frame + y * bytesPerRow;
+		int32 position = 0;
+		while (position < rowLength) {
+			uint32 zeroes;
+			uint32 literals;
+			data = ReadVarInt(data, end, zeroes);
+			if (data != NULL)
+				data = ReadVarInt(data, end, literals);
+			if (data == NULL || zeroes > uint32(rowLength - position)
+				|| literals > uint32(rowLength - position - zeroes)
+				|| literals > size_t(end - data))
+				return B_BAD_DATA;
+
+			// Unchanged bytes are already there
+			position += zeroes;
+			XorBytes(row + position, row + position, data, literals);
+			position += literals;
+			data += literals;
+		}
+	}
+	return data == end ? B_OK : B_BAD_DATA;
+}
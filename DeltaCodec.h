@@ -0,0 +1,29 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __DELTACODEC_H
+#define __DELTACODEC_H
+
+#include <SupportDefs.h>
+
+// Lossless temporal delta codec.
+// Every row of the frame is XORed with the same row of the reference frame,
+// and the result is stored as a sequence of
+//	varint zeroes, varint literals, literal bytes
+// until the row is complete. Rows are encoded independently.
+// Unchanged bytes XOR to zero, so mostly static frames shrink to a few
+// bytes per row. A key frame is encoded against an all zero reference.
+
+// Worst case size of an encoded frame
+size_t DeltaEncodeBound(int32 rowLength, int32 rows);
+
+// Returns the number of bytes written to "out"
+size_t DeltaEncode(const uint8* frame, const uint8* reference,
+	int32 bytesPerRow, int32 rowLength, int32 rows, uint8* out);
+
+// "frame" must contain the reference frame: it's updated in place
+status_t DeltaDecode(const uint8* data, size_t size, uint8* frame,
+	int32 bytesPerRow, int32 rowLength, int32 rows);
+
+#endif // __DELTACODEC_H
@@ -0,0 +1,688 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FilterChain.h"
+
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// A band of the widest frame of a pass should stay in the L2 cache while
+// all the filters of the pass go over it. Not too small though: filters
+// like the scaler redo some work at the start of every band.
+const static size_t kBandBytes = 256 * 1024;
+
+const static int32 kSourceBuffer = -2;
+const static int32 kDestBuffer = -1;
+
+
+struct FilterChain::chain_job {
+	FilterChain*		chain;
+	image_buffer		source;
+	const chain_pass*	pass;
+	int32				height;
+	int32				bands;
+};
+
+
+static int32
+BytesPerPixel(color_space colorSpace)
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK || pixelsPerChunk == 0)
+		return 0;
+	return pixelChunk / pixelsPerChunk;
+}
+
+
+static inline size_t
+Align(size_t size)
+{
+	return (size + 15) & ~size_t(15);
+}
+
+
+static inline bool
+Is32Bit(color_space colorSpace)
+{
+	return colorSpace == B_RGB32 || colorSpace == B_RGBA32;
+}
+
+
+static inline uint8
+Blend(uint8 over, uint8 under, uint8 alpha)
+{
+	const uint32 value = over * alpha + under * (255 - alpha) + 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+
+// Copies a row, unless the filter works in place
+static inline void
+CopyRow(const image_buffer& input, const image_buffer& output, int32 y,
+	size_t length)
+{
+	if (input.bits != output.bits) {
+		::memcpy(output.bits + size_t(y) * output.bytesPerRow,
+			input.bits + size_t(y) * input.bytesPerRow, length);
+	}
+}
+
+
+// ChainFilter
+ChainFilter::ChainFilter()
+{
+}
+
+
+ChainFilter::~ChainFilter()
+{
+}
+
+
+/* virtual */
+bool
+ChainFilter::IsRowLocal() const
+{
+	return false;
+}
+
+
+/* virtual */
+bool
+ChainFilter::IsInPlace() const
+{
+	return false;
+}
+
+
+/* virtual */
+size_t
+ChainFilter::ScratchSize() const
+{
+	return 0;
+}
+
+
+// CropFilter
+CropFilter::CropFilter(const BRect& rect)
+	:
+	fRect(rect),
+	fLeft(0),
+	fTop(0),
+	fPixelSize(0)
+{
+}
+
+
+/* virtual */
+status_t
+CropFilter::Configure(const image_buffer& input, image_buffer& output)
+{
+	fPixelSize = BytesPerPixel(input.colorSpace);
+	if (fPixelSize == 0)
+		return B_NOT_SUPPORTED;
+
+	const BRect rect = fRect & BRect(0, 0, input.width - 1, input.height - 1);
+	if (!rect.IsValid())
+		return B_BAD_VALUE;
+
+	fLeft = int32(rect.left);
+	fTop = int32(rect.top);
+	output = input;
+	output.width = rect.IntegerWidth() + 1;
+	output.height = rect.IntegerHeight() + 1;
+	return B_OK;
+}
+
+
+/* virtual */
+void
+CropFilter::FilterRows(const image_buffer& input, const image_buffer& output,
+	int32 firstRow, int32 lastRow, uint8* scratch)
+{
+	for (int32 y = firstRow; y < lastRow; y++) {
+		::memcpy(output.bits + size_t(y) * output.bytesPerRow,
+			input.bits + size_t(y + fTop) * input.bytesPerRow
+				+ fLeft * fPixelSize,
+			output.width * fPixelSize);
+	}
+}
+
+
+// ScaleFilter
+ScaleFilter::ScaleFilter(int32 width, int32 height, scale_filter filter)
+	:
+	fWidth(width),
+	fHeight(height),
+	fFilter(filter),
+	fScaler(NULL)
+{
+}
+
+
+ScaleFilter::~ScaleFilter()
+{
+	delete fScaler;
+}
+
+
+/* virtual */
+status_t
+ScaleFilter::Configure(const image_buffer& input, image_buffer& output)
+{
+	delete fScaler;
+	fScaler = NULL;
+	if (!Scaler::IsSupported(input.colorSpace, fFilter))
+		return B_NOT_SUPPORTED;
+
+	fScaler = new (std::nothrow) Scaler(input.width, input.height, fWidth,
+		fHeight, input.colorSpace, fFilter);
+	if (fScaler == NULL)
+		return B_NO_MEMORY;
+	status_t status = fScaler->InitCheck();
+	if (status != B_OK) {
+		delete fScaler;
+		fScaler = NULL;
+		return status;
+	}
+
+	output = input;
+	output.width = fWidth;
+	output.height = fHeight;
+	return B_OK;
+}
+
+
+/* virtual */
+size_t
+ScaleFilter::ScratchSize() const
+{
+	return fScaler != NULL ? fScaler->ScratchSize() : 0;
+}
+
+
+/* virtual */
+void
+ScaleFilter::FilterRows(const image_buffer& input, const image_buffer& output,
+	int32 firstRow, int32 lastRow, uint8* scratch)
+{
+	fScaler->ScaleRows(input.bits, input.bytesPerRow, output.bits,
+		output.bytesPerRow, firstRow, lastRow, scratch);
+}
+
+
+// ColorConvertFilter
+ColorConvertFilter::ColorConvertFilter(color_space colorSpace)
+	:
+	fColorSpace(colorSpace),
+	fInputColorSpace(B_NO_COLOR_SPACE),
+	fWidth(0)
+{
+}
+
+
+/* virtual */
+status_t
+ColorConvertFilter::Configure(const image_buffer& input, image_buffer& output)
+{
+	if (!CanConvertColorSpace(input.colorSpace, fColorSpace))
+		return B_NOT_SUPPORTED;
+	// The bands can start on any row, B_YCbCr420 needs them in pairs
+	if (GetColorSpaceTraits(input.colorSpace)->rowsPerGroup > 1
+		|| GetColorSpaceTraits(fColorSpace)->rowsPerGroup > 1)
+		return B_NOT_SUPPORTED;
+
+	fInputColorSpace = input.colorSpace;
+	fWidth = input.width;
+	output = input;
+	output.colorSpace = fColorSpace;
+	return B_OK;
+}
+
+
+/* virtual */
+bool
+ColorConvertFilter::IsRowLocal() const
+{
+	return true;
+}
+
+
+/* virtual */
+void
+ColorConvertFilter::FilterRows(const image_buffer& input,
+	const image_buffer& output, int32 firstRow, int32 lastRow, uint8* scratch)
+{
+	ConvertBits(input.bits + size_t(firstRow) * input.bytesPerRow,
+		input.bytesPerRow, fInputColorSpace,
+		output.bits + size_t(firstRow) * output.bytesPerRow,
+		output.bytesPerRow, fColorSpace, fWidth, lastRow - firstRow);
+}
+
+
+// OverlayFilter
+OverlayFilter::OverlayFilter(BBitmap* overlay, BPoint where)
+	:
+	fOverlay(overlay),
+	fWhere(where)
+{
+}
+
+
+OverlayFilter::~OverlayFilter()
+{
+	delete fOverlay;
+}
+
+
+/* virtual */
+status_t
+OverlayFilter::Configure(const image_buffer& input, image_buffer& output)
+{
+	if (fOverlay == NULL || fOverlay->InitCheck() != B_OK)
+		return B_BAD_VALUE;
+	if (!Is32Bit(input.colorSpace) || !Is32Bit(fOverlay->ColorSpace()))
+		return B_NOT_SUPPORTED;
+
+	fWhere.x = int32(fWhere.x);
+	fWhere.y = int32(fWhere.y);
+	fArea = fOverlay->Bounds().OffsetToCopy(fWhere)
+		& BRect(0, 0, input.width - 1, input.height - 1);
+	output = input;
+	return B_OK;
+}
+
+
+/* virtual */
+bool
+OverlayFilter::IsRowLocal() const
+{
+	return true;
+}
+
+
+/* virtual */
+bool
+OverlayFilter::IsInPlace() const
+{
+	return true;
+}
+
+
+/* virtual */
+void
+OverlayFilter::FilterRows(const image_buffer& input,
+	const image_buffer& output, int32 firstRow, int32 lastRow, uint8* scratch)
+{
+	const bool opaque = fOverlay->ColorSpace() == B_RGB32;
+	const int32 left = int32(fArea.left);
+	const int32 width = fArea.IntegerWidth() + 1;
+	for (int32 y = firstRow; y < lastRow; y++) {
+		CopyRow(input, output, y, output.width * 4);
+		if (!fArea.IsValid() || y < fArea.top || y > fArea.bottom)
+			continue;
+
+		const uint8* over = static_cast<const uint8*>(fOverlay->Bits())
+			+ size_t(y - int32(fWhere.y)) * fOverlay->BytesPerRow()
+			+ (left - int32(fWhere.x)) * 4;
+		uint8* under = output.bits + size_t(y) * output.bytesPerRow + left * 4;
+		if (opaque) {
+			::memcpy(under, over, width * 4);
+			continue;
+		}
+		for (int32 x = 0; x < width; x++, over += 4, under += 4) {
+			const uint8 alpha = over[3];
+			if (alpha == 0)
+				continue;
+			if (alpha == 255) {
+				::memcpy(under, over, 4);
+				continue;
+			}
+			under[0] = Blend(over[0], under[0], alpha);
+			under[1] = Blend(over[1], under[1], alpha);
+			under[2] = Blend(over[2], under[2], alpha);
+			under[3] = Blend(255, under[3], alpha);
+		}
+	}
+}
+
+
+// PrivacyMaskFilter
+PrivacyMaskFilter::PrivacyMaskFilter(const rgb_color& color)
+	:
+	fColor(color),
+	fPixelSize(0)
+{
+	::memset(fPixel, 0, sizeof(fPixel));
+}
+
+
+void
+PrivacyMaskFilter::AddRect(const BRect& rect)
+{
+	fRects.push_back(rect);
+}
+
+
+/* virtual */
+status_t
+PrivacyMaskFilter::Configure(const image_buffer& input, image_buffer& output)
+{
+	if (!IsConvertibleColorSpace(input.colorSpace))
+		return B_NOT_SUPPORTED;
+
+	const uint8 color[4] = { fColor.blue, fColor.green, fColor.red, 255 };
+	ConvertRowFromRGB32(color, fPixel, 1, input.colorSpace);
+	fPixelSize = BytesPerPixel(input.colorSpace);
+
+	const BRect frame(0, 0, input.width - 1, input.height - 1);
+	fMaskRects.clear();
+	for (size_t i = 0; i < fRects.size(); i++) {
+		const BRect rect = fRects[i] & frame;
+		if (rect.IsValid())
+			fMaskRects.push_back(rect);
+	}
+
+	output = input;
+	return B_OK;
+}
+
+
+/* virtual */
+bool
+PrivacyMaskFilter::IsRowLocal() const
+{
+	return true;
+}
+
+
+/* virtual */
+bool
+PrivacyMaskFilter::IsInPlace() const
+{
+	return true;
+}
+
+
+/* virtual */
+void
+PrivacyMaskFilter::FilterRows(const image_buffer& input,
+	const image_buffer& output, int32 firstRow, int32 lastRow, uint8* scratch)
+{
+	for (int32 y = firstRow; y < lastRow; y++) {
+		CopyRow(input, output, y, output.width * fPixelSize);
+		uint8* row = output.bits + size_t(y) * output.bytesPerRow;
+		for (size_t i = 0; i < fMaskRects.size(); i++) {
+			const BRect& rect = fMaskRects[i];
+			if (y < rect.top || y > rect.bottom)
+				continue;
+			uint8* to = row + int32(rect.left) * fPixelSize;
+			for (int32 x = int32(rect.left); x <= int32(rect.right); x++) {
+				::memcpy(to, fPixel, fPixelSize);
+				to += fPixelSize;
+			}
+		}
+	}
+}
+
+
+// FilterChain
+FilterChain::FilterChain()
+	:
+	fScratchSize(0),
+	fConfigured(false)
+{
+	::memset(&fInput, 0, sizeof(fInput));
+	::memset(&fOutput, 0, sizeof(fOutput));
+}
+
+
+FilterChain::~FilterChain()
+{
+	for (size_t i = 0; i < fFilters.size(); i++)
+		delete fFilters[i];
+}
+
+
+status_t
+FilterChain::AddFilter(ChainFilter* filter)
+{
+	if (filter == NULL)
+		return B_BAD_VALUE;
+	try {
+		fFilters.push_back(filter);
+	} catch (...) {
+		delete filter;
+		return B_NO_MEMORY;
+	}
+	fConfigured = false;
+	return B_OK;
+}
+
+
+int32
+FilterChain::CountFilters() const
+{
+	return fFilters.size();
+}
+
+
+status_t
+FilterChain::Configure(int32 width, int32 height, color_space colorSpace)
+{
+	fConfigured = false;
+	fStages.clear();
+	fPasses.clear();
+	fBuffers.clear();
+	fScratchSize = 0;
+
+	if (width <= 0 || height <= 0 || BytesPerPixel(colorSpace) == 0)
+		return B_BAD_VALUE;
+
+	fInput.bits = NULL;
+	fInput.bytesPerRow = 0;
+	fInput.width = width;
+	fInput.height = height;
+	fInput.colorSpace = colorSpace;
+
+	const int32 count = fFilters.size();
+	try {
+		image_buffer format = fInput;
+		fStages.resize(count);
+		for (int32 i = 0; i < count; i++) {
+			ChainFilter* filter = fFilters[i];
+			image_buffer& output = fStages[i].output;
+			status_t status = filter->Configure(format, output);
+			if (status != B_OK)
+				return status;
+			output.bits = NULL;
+			output.bytesPerRow = 0;
+			if (output.width <= 0 || output.height <= 0
+				|| BytesPerPixel(output.colorSpace) == 0)
+				return B_BAD_VALUE;
+			// Filters in place would see rows changed by other bands
+			if (filter->IsInPlace() && (!filter->IsRowLocal()
+					|| output.width != format.width
+					|| output.colorSpace != format.colorSpace))
+				return B_BAD_VALUE;
+			if (filter->IsRowLocal() && output.height != format.height)
+				return B_BAD_VALUE;
+
+			fStages[i].filter = filter;
+			fScratchSize = std::max(fScratchSize, Align(filter->ScratchSize()));
+			format = output;
+		}
+		fOutput = format;
+
+		// Filters in place at the end of the chain work on the destination.
+		// Other filters in place use the buffer of the previous filter.
+		int32 input = kSourceBuffer;
+		for (int32 i = 0; i < count; i++) {
+			bool inPlaceUntilEnd = true;
+			for (int32 j = i + 1; j < count; j++)
+				inPlaceUntilEnd = inPlaceUntilEnd && fFilters[j]->IsInPlace();
+
+			chain_stage& stage = fStages[i];
+			if (inPlaceUntilEnd)
+				stage.buffer = kDestBuffer;
+			else if (stage.filter->IsInPlace() && input != kSourceBuffer) {
+				stage.buffer = input;
+				stage.output.bytesPerRow = fStages[i - 1].output.bytesPerRow;
+			} else {
+				stage.output.bytesPerRow = Align(size_t(stage.output.width)
+					* BytesPerPixel(stage.output.colorSpace));
+				fBuffers.push_back(std::vector<uint8>(
+					size_t(stage.output.bytesPerRow) * stage.output.height));
+				stage.buffer = fBuffers.size() - 1;
+			}
+			input = stage.buffer;
+
+			if (i == 0 || !stage.filter->IsRowLocal()) {
+				chain_pass pass;
+				pass.firstStage = i;
+				pass.lastStage = i;
+				pass.rowsPerBand = 0;
+				fPasses.push_back(pass);
+			}
+			chain_pass& pass = fPasses.back();
+			pass.lastStage = i;
+			const size_t rowBytes = size_t(stage.output.width)
+				* BytesPerPixel(stage.output.colorSpace);
+			const int32 rows = std::max(kBandBytes / rowBytes, size_t(1));
+			if (pass.rowsPerBand == 0 || rows < pass.rowsPerBand)
+				pass.rowsPerBand = rows;
+		}
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+
+	fConfigured = true;
+	return B_OK;
+}
+
+
+image_buffer
+FilterChain::OutputFormat() const
+{
+	return fOutput;
+}
+
+
+status_t
+FilterChain::Apply(const void* source, int32 sourceBytesPerRow, void* dest,
+	int32 destBytesPerRow, ThreadPool* pool)
+{
+	if (!fConfigured)
+		return B_NO_INIT;
+	if (source == NULL || dest == NULL)
+		return B_BAD_VALUE;
+
+	chain_job job;
+	job.chain = this;
+	job.source = fInput;
+	job.source.bits = const_cast<uint8*>(static_cast<const uint8*>(source));
+	job.source.bytesPerRow = sourceBytesPerRow;
+
+	if (fStages.empty()) {
+		const size_t length = size_t(fInput.width)
+			* BytesPerPixel(fInput.colorSpace);
+		for (int32 y = 0; y < fInput.height; y++) {
+			::memcpy(static_cast<uint8*>(dest) + size_t(y) * destBytesPerRow,
+				job.source.bits + size_t(y) * sourceBytesPerRow, length);
+		}
+		return B_OK;
+	}
+
+	for (size_t i = 0; i < fStages.size(); i++) {
+		chain_stage& stage = fStages[i];
+		if (stage.buffer == kDestBuffer) {
+			stage.output.bits = static_cast<uint8*>(dest);
+			stage.output.bytesPerRow = destBytesPerRow;
+		} else
+			stage.output.bits = &fBuffers[stage.buffer][0];
+	}
+
+	// More bands than threads, if needed to keep them small
+	const int32 threads = pool != NULL ? pool->CountThreads() : 1;
+	for (size_t i = 0; i < fPasses.size(); i++) {
+		const chain_pass& pass = fPasses[i];
+		job.pass = &pass;
+		job.height = fStages[pass.firstStage].output.height;
+		job.bands = (job.height + pass.rowsPerBand - 1) / pass.rowsPerBand;
+		job.bands = std::min(std::max(job.bands, threads), job.height);
+		if (fScratch.size() < fScratchSize * job.bands) {
+			try {
+				fScratch.resize(fScratchSize * job.bands);
+			} catch (...) {
+				return B_NO_MEMORY;
+			}
+		}
+
+		if (pool != NULL && job.bands > 1)
+			pool->Run(job.bands, _PassJob, &job);
+		else {
+			for (int32 band = 0; band < job.bands; band++)
+				_PassJob(&job, band);
+		}
+	}
+
+	return B_OK;
+}
+
+
+BBitmap*
+FilterChain::Apply(const BBitmap* source, ThreadPool* pool)
+{
+	if (source == NULL)
+		return NULL;
+
+	const int32 width = source->Bounds().IntegerWidth() + 1;
+	const int32 height = source->Bounds().IntegerHeight() + 1;
+	if (!fConfigured || width != fInput.width || height != fInput.height
+		|| source->ColorSpace() != fInput.colorSpace) {
+		if (Configure(width, height, source->ColorSpace()) != B_OK)
+			return NULL;
+	}
+
+	BBitmap* bitmap = new (std::nothrow) BBitmap(
+		BRect(0, 0, fOutput.width - 1, fOutput.height - 1), fOutput.colorSpace);
+	if (bitmap == NULL || bitmap->InitCheck() != B_OK
+		|| Apply(source->Bits(), source->BytesPerRow(), bitmap->Bits(),
+			bitmap->BytesPerRow(), pool) != B_OK) {
+		delete bitmap;
+		return NULL;
+	}
+
+	return bitmap;
+}
+
+
+/* static */
+void
+FilterChain::_PassJob(void* cookie, int32 band)
+{
+	const chain_job& job = *static_cast<chain_job*>(cookie);
+	FilterChain* chain = job.chain;
+	const int32 firstRow = job.height * band / job.bands;
+	const int32 lastRow = job.height * (band + 1) / job.bands;
+	uint8* scratch = chain->fScratchSize > 0
+		? &chain->fScratch[0] + chain->fScratchSize * band : NULL;
+
+	for (int32 i = job.pass->firstStage; i <= job.pass->lastStage; i++) {
+		const image_buffer& input = i == 0
+			? job.source : chain->fStages[i - 1].output;
+		chain->fStages[i].filter->FilterRows(input, chain->fStages[i].output,
+			firstRow, lastRow, scratch);
+	}
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FILTERCHAIN_H
+#define __FILTERCHAIN_H
+
+#include <GraphicsDefs.h>
+#include <Point.h>
+#include <Rect.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+#include "Scaler.h"
+
+class BBitmap;
+class ThreadPool;
+
+// An image in memory. Filters only look at the format part:
+// size and color space.
+struct image_buffer {
+	uint8*		bits;
+	int32		bytesPerRow;
+	int32		width;
+	int32		height;
+	color_space	colorSpace;
+};
+
+
+// A step of a FilterChain. Filters write their output one band of
+// rows at a time, and must be able to work on different bands at the
+// same time.
+class ChainFilter {
+public:
+	ChainFilter();
+	virtual ~ChainFilter();
+
+	// Fills in the format of the output for frames like "input"
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output) = 0;
+
+	// Output row y only depends on input row y, so the filter can work
+	// on the band the previous one just wrote, while it's in the cache
+	virtual bool IsRowLocal() const;
+	// Input and output can be the same buffer
+	virtual bool IsInPlace() const;
+	// Working memory for every band
+	virtual size_t ScratchSize() const;
+
+	// Writes the output rows from "firstRow" to "lastRow", excluded
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch) = 0;
+};
+
+
+class CropFilter : public ChainFilter {
+public:
+	CropFilter(const BRect& rect);
+
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output);
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch);
+
+private:
+	BRect		fRect;
+	int32		fLeft;
+	int32		fTop;
+	int32		fPixelSize;
+};
+
+
+class ScaleFilter : public ChainFilter {
+public:
+	ScaleFilter(int32 width, int32 height,
+		scale_filter filter = B_SCALE_BILINEAR);
+	virtual ~ScaleFilter();
+
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output);
+	virtual size_t ScratchSize() const;
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch);
+
+private:
+	int32			fWidth;
+	int32			fHeight;
+	scale_filter	fFilter;
+	Scaler*			fScaler;
+};
+
+
+class ColorConvertFilter : public ChainFilter {
+public:
+	ColorConvertFilter(color_space colorSpace);
+
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output);
+	virtual bool IsRowLocal() const;
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch);
+
+private:
+	color_space		fColorSpace;
+	color_space		fInputColorSpace;
+	int32			fWidth;
+};
+
+
+// Blends a B_RGBA32 image (a logo, a watermark) over 32 bit frames
+class OverlayFilter : public ChainFilter {
+public:
+	// Takes ownership of the overlay
+	OverlayFilter(BBitmap* overlay, BPoint where);
+	virtual ~OverlayFilter();
+
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output);
+	virtual bool IsRowLocal() const;
+	virtual bool IsInPlace() const;
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch);
+
+private:
+	BBitmap*	fOverlay;
+	BPoint		fWhere;
+	// Part of the frame covered by the overlay
+	BRect		fArea;
+};
+
+
+// Paints over parts of the frames, to hide what's there
+class PrivacyMaskFilter : public ChainFilter {
+public:
+	PrivacyMaskFilter(const rgb_color& color);
+
+	void AddRect(const BRect& rect);
+
+	virtual status_t Configure(const image_buffer& input,
+		image_buffer& output);
+	virtual bool IsRowLocal() const;
+	virtual bool IsInPlace() const;
+	virtual void FilterRows(const image_buffer& input,
+		const image_buffer& output, int32 firstRow, int32 lastRow,
+		uint8* scratch);
+
+private:
+	rgb_color			fColor;
+	std::vector<BRect>	fRects;
+	// fRects clipped to the frame
+	std::vector<BRect>	fMaskRects;
+	uint8				fPixel[4];
+	int32				fPixelSize;
+};
+
+
+// Runs frames through an ordered list of filters. Every frame is split in
+// bands of rows, which can go to the threads of a pool. Consecutive row
+// local filters are fused: a band goes through all of them in a row,
+// instead of the whole frame going through one filter at a time.
+class FilterChain {
+public:
+	FilterChain();
+	~FilterChain();
+
+	// The chain takes ownership of the filter
+	status_t AddFilter(ChainFilter* filter);
+	int32 CountFilters() const;
+
+	// Prepares the filters for frames of the given format
+	status_t Configure(int32 width, int32 height, color_space colorSpace);
+	// Format of the frames coming out. "bits" is NULL.
+	image_buffer OutputFormat() const;
+
+	status_t Apply(const void* source, int32 sourceBytesPerRow, void* dest,
+		int32 destBytesPerRow, ThreadPool* pool = NULL);
+	// Returns a new bitmap, configuring the chain for "source" if needed
+	BBitmap* Apply(const BBitmap* source, ThreadPool* pool = NULL);
+
+private:
+	// A filter, and where its output goes
+	struct chain_stage {
+		ChainFilter*	filter;
+		image_buffer	output;
+		int32			buffer;
+	};
+	// Consecutive filters applied band by band
+	struct chain_pass {
+		int32			firstStage;
+		int32			lastStage;
+		int32			rowsPerBand;
+	};
+	struct chain_job;
+
+	static void _PassJob(void* cookie, int32 band);
+
+	std::vector<ChainFilter*>		fFilters;
+	std::vector<chain_stage>		fStages;
+	std::vector<chain_pass>			fPasses;
+	// Frames between the passes
+	std::vector<std::vector<uint8> > fBuffers;
+	std::vector<uint8>				fScratch;
+	size_t							fScratchSize;
+
+	image_buffer					fInput;
+	image_buffer					fOutput;
+	bool							fConfigured;
+
+	FilterChain(const FilterChain&);
+	FilterChain& operator=(const FilterChain&);
+};
+
+#endif // __FILTERCHAIN_H
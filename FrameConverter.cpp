@@ -0,0 +1,188 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameConverter.h"
+
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <new>
+
+// Bands per thread, so that a thread which is late doesn't hold up the
+// others for long
+const static int32 kBandsPerThread = 2;
+
+
+FrameConverter::FrameConverter(color_space colorSpace, int32 threads,
+	int32 priority)
+	:
+	fColorSpace(colorSpace),
+	fPool(NULL),
+	fLastFrame(NULL),
+	fInitStatus(B_OK),
+	fFrame(NULL),
+	fWidth(0),
+	fHeight(0),
+	fBands(1)
+{
+	if (!IsSupported(colorSpace)) {
+		fInitStatus = B_NOT_SUPPORTED;
+		return;
+	}
+	if (threads > 1) {
+		fPool = new (std::nothrow) ThreadPool("frame converter", threads,
+			priority);
+		if (fPool == NULL)
+			fInitStatus = B_NO_MEMORY;
+		else
+			fInitStatus = fPool->InitCheck();
+	}
+}
+
+
+FrameConverter::~FrameConverter()
+{
+	delete fPool;
+}
+
+
+status_t
+FrameConverter::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+color_space
+FrameConverter::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+/* static */
+bool
+FrameConverter::IsSupported(color_space colorSpace)
+{
+	if (colorSpace == B_YUV420)
+		return true;
+	return CanConvertColorSpace(B_RGB32, colorSpace);
+}
+
+
+/* static */
+int32
+FrameConverter::BytesPerRow(color_space colorSpace, int32 width)
+{
+	if (colorSpace == B_YUV420)
+		return width;
+	return RowLength(colorSpace, width);
+}
+
+
+/* static */
+size_t
+FrameConverter::FrameSize(color_space colorSpace, int32 width, int32 height)
+{
+	if (colorSpace == B_YUV420) {
+		return size_t(width) * height
+			+ 2 * size_t((width + 1) / 2) * ((height + 1) / 2);
+	}
+	return size_t(BytesPerRow(colorSpace, width)) * height;
+}
+
+
+const void*
+FrameConverter::Convert(const BBitmap* frame)
+{
+	fLastFrame = NULL;
+	if (frame == NULL || fInitStatus != B_OK)
+		return NULL;
+
+	const color_space colorSpace = frame->ColorSpace();
+	const int32 width = frame->Bounds().IntegerWidth() + 1;
+	const int32 height = frame->Bounds().IntegerHeight() + 1;
+	if (colorSpace == fColorSpace
+		&& frame->BytesPerRow() == BytesPerRow(fColorSpace, width)) {
+		fLastFrame = frame->Bits();
+		return fLastFrame;
+	}
+	if (!CanConvertColorSpace(colorSpace,
+			fColorSpace == B_YUV420 ? B_RGBA32 : fColorSpace))
+		return NULL;
+
+	try {
+		fBuffer.resize(FrameSize(fColorSpace, width, height));
+	} catch (...) {
+		return NULL;
+	}
+
+	// The bands start on even rows, for the 4:2:0 color spaces
+	fFrame = frame;
+	fWidth = width;
+	fHeight = height;
+	const int32 threads = fPool != NULL ? fPool->CountThreads() : 1;
+	fBands = std::min(threads * kBandsPerThread, (height + 1) / 2);
+	if (fPool != NULL && fBands > 1)
+		fPool->Run(fBands, _ConvertJob, this);
+	else {
+		for (int32 band = 0; band < fBands; band++)
+			_ConvertBand(band);
+	}
+	fFrame = NULL;
+
+	fLastFrame = &fBuffer[0];
+	return fLastFrame;
+}
+
+
+const void*
+FrameConverter::LastFrame() const
+{
+	return fLastFrame;
+}
+
+
+/* static */
+void
+FrameConverter::_ConvertJob(void* cookie, int32 band)
+{
+	static_cast<FrameConverter*>(cookie)->_ConvertBand(band);
+}
+
+
+void
+FrameConverter::_ConvertBand(int32 band)
+{
+	const int32 pairs = (fHeight + 1) / 2;
+	const int32 firstRow = 2 * (pairs * band / fBands);
+	const int32 lastRow = std::min(2 * (pairs * (band + 1) / fBands),
+		fHeight);
+	if (firstRow >= lastRow)
+		return;
+
+	const int32 bytesPerRow = fFrame->BytesPerRow();
+	const uint8* bits = static_cast<const uint8*>(fFrame->Bits())
+		+ size_t(firstRow) * bytesPerRow;
+	if (fColorSpace == B_YUV420) {
+		const int32 chromaBytesPerRow = (fWidth + 1) / 2;
+		uint8* y = &fBuffer[0];
+		uint8* cb = y + size_t(fWidth) * fHeight;
+		uint8* cr = cb + size_t(chromaBytesPerRow) * ((fHeight + 1) / 2);
+		const size_t chromaOffset = size_t(firstRow / 2) * chromaBytesPerRow;
+		ConvertToPlanarYUV420(bits, bytesPerRow, fFrame->ColorSpace(),
+			y + size_t(firstRow) * fWidth, fWidth, cb + chromaOffset,
+			cr + chromaOffset, chromaBytesPerRow, fWidth, lastRow - firstRow);
+		return;
+	}
+
+	const int32 toBytesPerRow = BytesPerRow(fColorSpace, fWidth);
+	ConvertBits(bits, bytesPerRow, fFrame->ColorSpace(),
+		&fBuffer[0] + size_t(firstRow) * toBytesPerRow, toBytesPerRow,
+		fColorSpace, fWidth, lastRow - firstRow);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMECONVERTER_H
+#define __FRAMECONVERTER_H
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+
+#include <vector>
+
+class BBitmap;
+class ThreadPool;
+
+// Converts the frames to the color space a codec takes, before they're
+// written, so that the codec doesn't have to do it on its own thread.
+// A frame is split in bands of rows, which are converted at the same time.
+class FrameConverter {
+public:
+	// "threads" counts the calling thread too
+	FrameConverter(color_space colorSpace, int32 threads = 1,
+		int32 priority = B_NORMAL_PRIORITY);
+	~FrameConverter();
+
+	status_t InitCheck() const;
+	color_space ColorSpace() const;
+
+	// Planar B_YUV420 (a plane of Y, then one of Cb and one of Cr at
+	// half the width and height), or a color space of ConvertBits()
+	static bool IsSupported(color_space colorSpace);
+	// Of the first plane
+	static int32 BytesPerRow(color_space colorSpace, int32 width);
+	static size_t FrameSize(color_space colorSpace, int32 width,
+		int32 height);
+
+	// The bits of the frame in the color space: those of the frame
+	// itself if it already is in it, or a buffer which stays valid until
+	// the next call. NULL if the frame can't be converted.
+	const void* Convert(const BBitmap* frame);
+	// What Convert() returned the last time, NULL before the first
+	// frame. If they were the bits of the frame, only while it exists.
+	const void* LastFrame() const;
+
+private:
+	static void _ConvertJob(void* cookie, int32 band);
+	void _ConvertBand(int32 band);
+
+	color_space			fColorSpace;
+	ThreadPool*			fPool;
+	std::vector<uint8>	fBuffer;
+	const void*			fLastFrame;
+	status_t			fInitStatus;
+
+	// The frame being converted
+	const BBitmap*		fFrame;
+	int32				fWidth;
+	int32				fHeight;
+	int32				fBands;
+
+	FrameConverter(const FrameConverter&);
+	FrameConverter& operator=(const FrameConverter&);
+};
+
+#endif // __FRAMECONVERTER_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameCopier.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+// Smaller frames are copied by the calling thread alone: waking up the
+// others would take longer than the copy
+const static size_t kParallelCopySize = 1024 * 1024;
+
+
+FrameCopier::FrameCopier(int32 threads, int32 priority)
+	:
+	fPool(NULL),
+	fInitStatus(B_OK),
+	fFrames(0),
+	fCopyTime(0),
+	fMaxCopyTime(0),
+	fFrom(NULL),
+	fFromBytesPerRow(0),
+	fTo(NULL),
+	fToBytesPerRow(0),
+	fRowLength(0),
+	fRows(0),
+	fBands(1)
+{
+	if (threads > 1) {
+		fPool = new (std::nothrow) ThreadPool("frame copier", threads,
+			priority);
+		if (fPool == NULL)
+			fInitStatus = B_NO_MEMORY;
+		else
+			fInitStatus = fPool->InitCheck();
+	}
+}
+
+
+FrameCopier::~FrameCopier()
+{
+	delete fPool;
+}
+
+
+status_t
+FrameCopier::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+void
+FrameCopier::Copy(const void* source, int32 sourceBytesPerRow, void* dest,
+	int32 destBytesPerRow, int32 rowLength, int32 rows)
+{
+	if (source == NULL || dest == NULL || rowLength <= 0 || rows <= 0)
+		return;
+
+	const bigtime_t start = system_time();
+
+	const size_t size = size_t(rowLength) * rows;
+	fFrom = static_cast<const uint8*>(source);
+	fFromBytesPerRow = sourceBytesPerRow;
+	fTo = static_cast<uint8*>(dest);
+	fToBytesPerRow = destBytesPerRow;
+	fRowLength = rowLength;
+	fRows = rows;
+	if (fPool != NULL && size >= kParallelCopySize) {
+		fBands = std::min(fPool->CountThreads(), rows);
+		fPool->Run(fBands, _CopyJob, this);
+	} else {
+		fBands = 1;
+		_CopyBand(0);
+	}
+	fFrom = NULL;
+	fTo = NULL;
+
+	const bigtime_t elapsed = system_time() - start;
+	fFrames++;
+	fCopyTime += elapsed;
+	fMaxCopyTime = std::max(fMaxCopyTime, elapsed);
+}
+
+
+int32
+FrameCopier::CountFrames() const
+{
+	return fFrames;
+}
+
+
+bigtime_t
+FrameCopier::CopyTime() const
+{
+	return fCopyTime;
+}
+
+
+void
+FrameCopier::PrintStatistics() const
+{
+	if (fFrames <= 0)
+		return;
+	std::cout << "Frame copy: " << fFrames << " frames, ";
+	std::cout << (fCopyTime / fFrames) << " usec on average (max ";
+	std::cout << fMaxCopyTime << " usec)." << std::endl;
+}
+
+
+/* static */
+void
+FrameCopier::_CopyJob(void* cookie, int32 band)
+{
+	static_cast<FrameCopier*>(cookie)->_CopyBand(band);
+}
+
+
+void
+FrameCopier::_CopyBand(int32 band)
+{
+	const int32 firstRow = fRows * band / fBands;
+	const int32 lastRow = fRows * (band + 1) / fBands;
+	const uint8* from = fFrom + size_t(firstRow) * fFromBytesPerRow;
+	uint8* to = fTo + size_t(firstRow) * fToBytesPerRow;
+
+	if (fFromBytesPerRow == fToBytesPerRow && fRowLength == fToBytesPerRow) {
+		::memcpy(to, from, size_t(fRowLength) * (lastRow - firstRow));
+		return;
+	}
+	for (int32 y = firstRow; y < lastRow; y++) {
+		::memcpy(to, from, fRowLength);
+		from += fFromBytesPerRow;
+		to += fToBytesPerRow;
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMECOPIER_H
+#define __FRAMECOPIER_H
+
+#include <OS.h>
+
+class ThreadPool;
+
+// Copies the frames out of the frame buffer. The rows of a big frame are
+// split among a few threads, since one alone can't keep the memory busy.
+class FrameCopier {
+public:
+	// "threads" counts the calling thread too
+	FrameCopier(int32 threads = 1, int32 priority = B_NORMAL_PRIORITY);
+	~FrameCopier();
+
+	status_t InitCheck() const;
+
+	// Copies "rows" rows of "rowLength" bytes
+	void Copy(const void* source, int32 sourceBytesPerRow, void* dest,
+		int32 destBytesPerRow, int32 rowLength, int32 rows);
+
+	// Time taken by the copies so far
+	int32 CountFrames() const;
+	bigtime_t CopyTime() const;
+	void PrintStatistics() const;
+
+private:
+	static void _CopyJob(void* cookie, int32 band);
+	void _CopyBand(int32 band);
+
+	ThreadPool*		fPool;
+	status_t		fInitStatus;
+
+	int32			fFrames;
+	bigtime_t		fCopyTime;
+	bigtime_t		fMaxCopyTime;
+
+	// The frame being copied
+	const uint8*	fFrom;
+	int32			fFromBytesPerRow;
+	uint8*			fTo;
+	int32			fToBytesPerRow;
+	int32			fRowLength;
+	int32			fRows;
+	int32			fBands;
+
+	FrameCopier(const FrameCopier&);
+	FrameCopier& operator=(const FrameCopier&);
+};
+
+#endif // __FRAMECOPIER_H
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameHash.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The data is consumed in 16 byte stripes, each one mixed with its own key
+// into one of four accumulators. Every kBlockSize bytes the accumulators
+// get scrambled, so the position of the data inside the frame matters.
+const static size_t kStripeSize = 16;
+const static size_t kStripesPerBlock = 16;
+const static size_t kBlockSize = kStripeSize * kStripesPerBlock;
+const static int32 kAccumulators = 4;
+
+const static uint32 kPrime32 = 0x9E3779B1UL;
+const static uint64 kPrime64_1 = 0x9E3779B185EBCA87ULL;
+const static uint64 kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const static uint64 kPrime64_3 = 0x165667B19E3779F9ULL;
+
+// Two 64 bit keys per stripe
+const static uint64 kKeys[kStripesPerBlock * 2] = {
+	0xC0E16B163A85A4DCULL, 0x890ACD8DD443C47CULL,
+	0xB3889D8A6DC47761ULL, 0x6A0398E528F0AE6AULL,
+	0x048344ECE48A855EULL, 0xF175CFEA21871330ULL,
+	0x391CEEF02702C2FDULL, 0x4BAF8CAC4784CB12ULL,
+	0x3547744583A3F88EULL, 0xD9CF2B15C6B6C90EULL,
+	0x961FACC76D5FE21CULL, 0x0094AB49D50F11F9ULL,
+	0xE3211E37BDBEB6DCULL, 0x62FE6C274FF3511AULL,
+	0x5AC30B329FDF0574ULL, 0x1450582C6B65B406ULL,
+	0x7A30FCC7888EB791ULL, 0x5540F5BA6A15576EULL,
+	0x16CEF0559096D3E9ULL, 0x2CF8F14B06874899ULL,
+	0xC9C9263B6E2CE103ULL, 0xD6FF920B0A9FAA6DULL,
+	0x53192697DB998DC1ULL, 0x73EA9B9BC7CD18D7ULL,
+	0x102713F872C33FCEULL, 0xF4183A0E5D2A033EULL,
+	0x71B63E307EEBB517ULL, 0xDA61F5713D036000ULL,
+	0x46EB7409AE691B21ULL, 0xB23AD691D6707698ULL,
+	0x67C8FE11D22FC4B9ULL, 0x7EB4661419481338ULL
+};
+
+
+static inline uint64
+Avalanche(uint64 hash)
+{
+	hash ^= hash >> 33;
+	hash *= kPrime64_2;
+	hash ^= hash >> 29;
+	hash *= kPrime64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+
+#if defined(__SSE2__)
+
+struct hash_state {
+	__m128i	acc[kAccumulators];
+};
+
+
+static inline void
+InitState(hash_state& state)
+{
+	for (int32 i = 0; i < kAccumulators; i++) {
+		state.acc[i] = _mm_set_epi64x(kPrime64_2 + i, kPrime64_1 + i);
+	}
+}
+
+
+static inline __m128i
+AccumulateStripe(__m128i acc, __m128i data, const uint64* key)
+{
+	const __m128i dataKey = _mm_xor_si128(data,
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(key)));
+	// low 32 bits times high 32 bits of every 64 bit lane
+	const __m128i dataKeyHigh = _mm_shuffle_epi32(dataKey,
+		_MM_SHUFFLE(0, 3, 0, 1));
+	const __m128i product = _mm_mul_epu32(dataKey, dataKeyHigh);
+	// Add the data itself too, so a zero product doesn't lose it
+	const __m128i dataSwap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+	return _mm_add_epi64(_mm_add_epi64(acc, dataSwap), product);
+}
+
+
+static inline void
+ScrambleState(hash_state& state)
+{
+	const __m128i prime = _mm_set1_epi32(kPrime32);
+	for (int32 i = 0; i < kAccumulators; i++) {
+		__m128i acc = state.acc[i];
+		acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+		acc = _mm_xor_si128(acc,
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&kKeys[i * 2])));
+		// 64 bit multiply by a 32 bit constant
+		const __m128i low = _mm_mul_epu32(acc, prime);
+		const __m128i high = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+		state.acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+	}
+}
+
+
+static inline void
+HashBlock(hash_state& state, const uint8* data, size_t stripes)
+{
+	for (size_t i = 0; i < stripes; i++) {
+		const __m128i stripe = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(data + i * kStripeSize));
+		state.acc[i % kAccumulators] = AccumulateStripe(
+			state.acc[i % kAccumulators], stripe, &kKeys[i * 2]);
+	}
+}
+
+
+static inline void
+StoreState(const hash_state& state, uint64* values)
+{
+	for (int32 i = 0; i < kAccumulators; i++) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 2),
+			state.acc[i]);
+	}
+}
+
+#else // !__SSE2__
+
+// Same algorithm, one 64 bit lane at a time
+struct hash_state {
+	uint64	acc[kAccumulators][2];
+};
+
+
+static inline void
+InitState(hash_state& state)
+{
+	for (int32 i = 0; i < kAccumulators; i++) {
+		state.acc[i][0] = kPrime64_1 + i;
+		state.acc[i][1] = kPrime64_2 + i;
+	}
+}
+
+
+static inline void
+ScrambleState(hash_state& state)
+{
+	for (int32 i = 0; i < kAccumulators; i++) {
+		for (int32 lane = 0; lane < 2; lane++) {
+			uint64 acc = state.acc[i][lane];
+			acc ^= acc >> 47;
+			acc ^= kKeys[i * 2 + lane];
+			state.acc[i][lane] = acc * kPrime32;
+		}
+	}
+}
+
+
+static inline void
+HashBlock(hash_state& state, const uint8* data, size_t stripes)
+{
+	for (size_t i = 0; i < stripes; i++) {
+		uint64 stripe[2];
+		::memcpy(stripe, data + i * kStripeSize, sizeof(stripe));
+		uint64* acc = state.acc[i % kAccumulators];
+		for (int32 lane = 0; lane < 2; lane++) {
+			const uint64 dataKey = stripe[lane] ^ kKeys[i * 2 + lane];
+			acc[lane] += stripe[1 - lane]
+				+ (dataKey & 0xFFFFFFFFULL) * (dataKey >> 32);
+		}
+	}
+}
+
+
+static inline void
+StoreState(const hash_state& state, uint64* values)
+{
+	::memcpy(values, state.acc, sizeof(state.acc));
+}
+
+#endif // !__SSE2__
+
+
+static void
+HashRow(hash_state& state, const uint8* data, size_t length)
+{
+	while (length >= kBlockSize) {
+		HashBlock(state, data, kStripesPerBlock);
+		ScrambleState(state);
+		data += kBlockSize;
+		length -= kBlockSize;
+	}
+
+	const size_t stripes = length / kStripeSize;
+	HashBlock(state, data, stripes);
+	data += stripes * kStripeSize;
+	length -= stripes * kStripeSize;
+	if (length > 0) {
+		// Pad the last partial stripe with zeroes
+		uint8 last[kStripeSize];
+		::memset(last, 0, sizeof(last));
+		::memcpy(last, data, length);
+		HashBlock(state, last, 1);
+	}
+	ScrambleState(state);
+}
+
+
+frame_hash
+HashBits(const void* bits, int32 bytesPerRow, int32 rowLength, int32 rows)
+{
+	hash_state state;
+	InitState(state);
+
+	// Row by row, even when contiguous: the same pixels give the same
+	// hash regardless of the row padding
+	const uint8* data = static_cast<const uint8*>(bits);
+	for (int32 y = 0; y < rows; y++) {
+		HashRow(state, data, rowLength);
+		data += bytesPerRow;
+	}
+
+	uint64 values[kAccumulators * 2];
+	StoreState(state, values);
+
+	const uint64 length = uint64(rowLength) * rows;
+	frame_hash hash;
+	hash.low = length * kPrime64_1;
+	hash.high = ~length * kPrime64_2;
+	for (int32 i = 0; i < kAccumulators * 2; i++) {
+		hash.low = (hash.low ^ Avalanche(values[i] ^ kKeys[i])) * kPrime64_1;
+		hash.high = (hash.high ^ Avalanche(values[i] ^ kKeys[i + 8]))
+			* kPrime64_2;
+	}
+	hash.low = Avalanche(hash.low);
+	hash.high = Avalanche(hash.high);
+	return hash;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEHASH_H
+#define __FRAMEHASH_H
+
+#include <SupportDefs.h>
+
+// 128 bit content hash. Not cryptographic, but wide enough to tell
+// identical frames (or tiles) apart from different ones.
+struct frame_hash {
+	uint64	low;
+	uint64	high;
+
+	bool operator==(const frame_hash& other) const
+		{ return low == other.low && high == other.high; }
+	bool operator!=(const frame_hash& other) const
+		{ return !(*this == other); }
+};
+
+// For hashed containers: the hash is already well mixed
+struct frame_hash_hasher {
+	size_t operator()(const frame_hash& hash) const
+		{ return size_t(hash.low); }
+};
+
+// Hashes "rows" rows of "rowLength" bytes each, starting "bytesPerRow"
+// bytes apart. Uses SSE2 when available: the result is the same
+// with or without it.
+frame_hash HashBits(const void* bits, int32 bytesPerRow, int32 rowLength,
+	int32 rows);
+
+#endif // __FRAMEHASH_H
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameLoader.h"
+
+#include "FramesList.h"
+#include "ImageFilter.h"
+
+#include <Bitmap.h>
+#include <String.h>
+
+#include <new>
+
+
+FrameLoader::FrameLoader(FramesList* list, int32 lookAhead, int32 numWorkers)
+	:
+	fSlots(NULL),
+	fLookAhead(lookAhead > 0 ? lookAhead : 1),
+	fFreeSem(-1),
+	fWorkers(NULL),
+	fNumWorkers(numWorkers > 0 ? numWorkers : 1),
+	fQuitting(false),
+	fNextLoad(0),
+	fNextFrame(0),
+	fScale(false),
+	fScaleColorSpace(B_NO_COLOR_SPACE),
+	fInitStatus(B_NO_INIT)
+{
+	if (list == NULL) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	try {
+		fEntries.reserve(list->CountItems());
+	} catch (...) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+	while (list->CountItems() > 0)
+		fEntries.push_back(list->Pop());
+
+	fInitStatus = _Init();
+}
+
+
+FrameLoader::FrameLoader(const std::vector<BitmapEntry*>& entries,
+	int32 lookAhead, int32 numWorkers)
+	:
+	fSlots(NULL),
+	fLookAhead(lookAhead > 0 ? lookAhead : 1),
+	fFreeSem(-1),
+	fWorkers(NULL),
+	fNumWorkers(numWorkers > 0 ? numWorkers : 1),
+	fQuitting(false),
+	fNextLoad(0),
+	fNextFrame(0),
+	fScale(false),
+	fScaleColorSpace(B_NO_COLOR_SPACE),
+	fInitStatus(B_NO_INIT)
+{
+	try {
+		fEntries = entries;
+	} catch (...) {
+		// The entries must go anyway
+		for (size_t i = 0; i < entries.size(); i++)
+			delete entries[i];
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	fInitStatus = _Init();
+}
+
+
+FrameLoader::~FrameLoader()
+{
+	Stop();
+
+	if (fSlots != NULL) {
+		for (int32 i = 0; i < fLookAhead; i++) {
+			delete fSlots[i].bitmap;
+			if (fSlots[i].ready >= 0)
+				delete_sem(fSlots[i].ready);
+		}
+		delete[] fSlots;
+	}
+	if (fFreeSem >= 0)
+		delete_sem(fFreeSem);
+
+	// Deleting the entries also removes their files, if any
+	for (size_t i = 0; i < fEntries.size(); i++)
+		delete fEntries[i];
+}
+
+
+status_t
+FrameLoader::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+void
+FrameLoader::SetScale(const BRect& frame, color_space colorSpace)
+{
+	if (fWorkers != NULL)
+		return;
+
+	fScale = true;
+	fScaleFrame = frame;
+	fScaleColorSpace = colorSpace;
+}
+
+
+status_t
+FrameLoader::Start()
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (fWorkers != NULL)
+		return B_OK;
+
+	fWorkers = new (std::nothrow) thread_id[fNumWorkers];
+	if (fWorkers == NULL)
+		return B_NO_MEMORY;
+
+	fQuitting = false;
+	for (int32 i = 0; i < fNumWorkers; i++) {
+		BString name;
+		name << "Frame loader " << (i + 1);
+		fWorkers[i] = spawn_thread((thread_entry)_WorkerStarter,
+			name.String(), B_NORMAL_PRIORITY, this);
+		if (fWorkers[i] >= 0 && resume_thread(fWorkers[i]) != B_OK) {
+			kill_thread(fWorkers[i]);
+			fWorkers[i] = -1;
+		}
+		if (fWorkers[i] < 0) {
+			// Work with the ones we have
+			if (i == 0) {
+				delete[] fWorkers;
+				fWorkers = NULL;
+				return B_ERROR;
+			}
+			fNumWorkers = i;
+			break;
+		}
+	}
+
+	return B_OK;
+}
+
+
+void
+FrameLoader::Stop()
+{
+	if (fWorkers == NULL)
+		return;
+
+	fQuitting = true;
+	release_sem_etc(fFreeSem, fNumWorkers, 0);
+	for (int32 i = 0; i < fNumWorkers; i++) {
+		status_t dummy;
+		wait_for_thread(fWorkers[i], &dummy);
+	}
+
+	delete[] fWorkers;
+	fWorkers = NULL;
+}
+
+
+void
+FrameLoader::ReleaseEntries(FramesList* list)
+{
+	Stop();
+	for (size_t i = 0; i < fEntries.size(); i++)
+		list->AddItem(fEntries[i]);
+	fEntries.clear();
+}
+
+
+int32
+FrameLoader::CountFrames() const
+{
+	return fEntries.size();
+}
+
+
+int32
+FrameLoader::CountRemaining() const
+{
+	return CountFrames() - fNextFrame;
+}
+
+
+bigtime_t
+FrameLoader::TimeStamp(int32 index) const
+{
+	return fEntries[index]->TimeStamp();
+}
+
+
+status_t
+FrameLoader::NextFrame(BBitmap*& bitmap, bool& duplicate)
+{
+	if (fWorkers == NULL)
+		return B_NO_INIT;
+	if (fNextFrame >= CountFrames())
+		return B_BAD_INDEX;
+
+	load_slot& slot = fSlots[fNextFrame % fLookAhead];
+	status_t status;
+	do {
+		status = acquire_sem(slot.ready);
+	} while (status == B_INTERRUPTED);
+	if (status != B_OK)
+		return status;
+
+	bitmap = slot.bitmap;
+	duplicate = slot.duplicate;
+	status = slot.status;
+	slot.bitmap = NULL;
+
+	// The slot can take the frame "lookAhead" places after this one
+	fNextFrame++;
+	release_sem(fFreeSem);
+
+	return status;
+}
+
+
+status_t
+FrameLoader::_Init()
+{
+	fSlots = new (std::nothrow) load_slot[fLookAhead];
+	if (fSlots == NULL)
+		return B_NO_MEMORY;
+	for (int32 i = 0; i < fLookAhead; i++) {
+		fSlots[i].bitmap = NULL;
+		fSlots[i].duplicate = false;
+		fSlots[i].status = B_OK;
+		fSlots[i].ready = -1;
+	}
+	for (int32 i = 0; i < fLookAhead; i++) {
+		fSlots[i].ready = create_sem(0, "loaded frame");
+		if (fSlots[i].ready < 0)
+			return fSlots[i].ready;
+	}
+
+	fFreeSem = create_sem(fLookAhead, "frame loader slots");
+	if (fFreeSem < 0)
+		return fFreeSem;
+
+	return B_OK;
+}
+
+
+status_t
+FrameLoader::_WorkerThread()
+{
+	// Every worker draws into its own bitmap
+	ImageFilterScale* filter = NULL;
+	status_t filterStatus = B_OK;
+	if (fScale) {
+		filter = new (std::nothrow) ImageFilterScale(fScaleFrame,
+			fScaleColorSpace);
+		if (filter == NULL)
+			filterStatus = B_NO_MEMORY;
+	}
+
+	for (;;) {
+		status_t status = acquire_sem(fFreeSem);
+		if (status == B_INTERRUPTED)
+			continue;
+		if (status != B_OK || fQuitting)
+			break;
+
+		const int32 index = atomic_add(&fNextLoad, 1);
+		if (index >= CountFrames()) {
+			// Pass the slot on, so the other workers see the end, too
+			release_sem(fFreeSem);
+			break;
+		}
+
+		// Nobody else has this slot: the frame which used it last
+		// has been consumed already
+		load_slot& slot = fSlots[index % fLookAhead];
+		BitmapEntry* entry = fEntries[index];
+		slot.bitmap = NULL;
+		// There's nothing to repeat before the first frame
+		slot.duplicate = index > 0 && entry->IsDuplicate();
+		slot.status = filterStatus;
+		if (!slot.duplicate && slot.status == B_OK) {
+			BBitmap* bitmap = entry->Bitmap();
+			if (bitmap == NULL)
+				slot.status = B_ERROR;
+			else if (filter != NULL)
+				bitmap = filter->ApplyFilter(bitmap);
+			slot.bitmap = bitmap;
+		}
+		release_sem(slot.ready);
+	}
+
+	delete filter;
+	return B_OK;
+}
+
+
+/* static */
+int32
+FrameLoader::_WorkerStarter(void* arg)
+{
+	return static_cast<FrameLoader*>(arg)->_WorkerThread();
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMELOADER_H
+#define __FRAMELOADER_H
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+#include <Rect.h>
+
+#include <vector>
+
+class BBitmap;
+class BitmapEntry;
+class FramesList;
+
+// Reads the frames of a list ahead of the encoder, and scales them,
+// on worker threads. The frames come out in order, and at most
+// "lookAhead" of them are loaded and not consumed yet.
+class FrameLoader {
+public:
+	// Takes all the entries out of the list
+	FrameLoader(FramesList* list, int32 lookAhead, int32 numWorkers);
+	// Takes ownership of the entries
+	FrameLoader(const std::vector<BitmapEntry*>& entries, int32 lookAhead,
+		int32 numWorkers);
+	~FrameLoader();
+
+	status_t InitCheck() const;
+
+	// The frames are scaled to "frame". Must be called before Start().
+	void SetScale(const BRect& frame, color_space colorSpace);
+
+	status_t Start();
+	void Stop();
+	// Stops, and hands all the entries over to the end of the list,
+	// in order, instead of deleting them
+	void ReleaseEntries(FramesList* list);
+
+	int32 CountFrames() const;
+	int32 CountRemaining() const;
+	// Capture time of a frame
+	bigtime_t TimeStamp(int32 index) const;
+
+	// Waits for the next frame, and hands it over to the caller.
+	// A frame the same as the previous one isn't loaded again:
+	// "bitmap" is then NULL, and "duplicate" true. The first frame
+	// is always loaded.
+	status_t NextFrame(BBitmap*& bitmap, bool& duplicate);
+
+private:
+	struct load_slot {
+		BBitmap*	bitmap;
+		bool		duplicate;
+		status_t	status;
+		sem_id		ready;
+	};
+
+	status_t _Init();
+	status_t _WorkerThread();
+	static int32 _WorkerStarter(void* arg);
+
+	std::vector<BitmapEntry*> fEntries;
+
+	load_slot*	fSlots;
+	int32		fLookAhead;
+	sem_id		fFreeSem;
+
+	thread_id*	fWorkers;
+	int32		fNumWorkers;
+	bool		fQuitting;
+
+	int32		fNextLoad;
+	int32		fNextFrame;
+
+	bool		fScale;
+	BRect		fScaleFrame;
+	color_space	fScaleColorSpace;
+
+	status_t	fInitStatus;
+
+	FrameLoader(const FrameLoader&);
+	FrameLoader& operator=(const FrameLoader&);
+};
+
+#endif // __FRAMELOADER_H
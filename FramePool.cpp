@@ -0,0 +1,349 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FramePool.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+
+static inline size_t
+RoundUpToPage(size_t size)
+{
+	return (size + B_PAGE_SIZE - 1) & ~(size_t)(B_PAGE_SIZE - 1);
+}
+
+
+static void
+CopyRows(uint8* to, int32 toBytesPerRow, const uint8* from,
+	int32 fromBytesPerRow, int32 rows)
+{
+	if (toBytesPerRow == fromBytesPerRow) {
+		::memcpy(to, from, size_t(toBytesPerRow) * rows);
+		return;
+	}
+
+	const int32 rowLength = std::min(toBytesPerRow, fromBytesPerRow);
+	for (int32 y = 0; y < rows; y++) {
+		::memcpy(to, from, rowLength);
+		to += toBytesPerRow;
+		from += fromBytesPerRow;
+	}
+}
+
+
+// FrameBuffer
+FrameBuffer::FrameBuffer()
+	:
+	fArea(-1),
+	fAreaOffset(0),
+	fBitmap(NULL),
+	fBitmapStatus(B_NO_INIT),
+	fBits(NULL),
+	fBytesPerRow(0),
+	fWidth(0),
+	fHeight(0),
+	fColorSpace(B_NO_COLOR_SPACE),
+	fTimeStamp(0),
+	fDuplicate(false)
+{
+}
+
+
+FrameBuffer::~FrameBuffer()
+{
+	delete fBitmap;
+}
+
+
+void*
+FrameBuffer::Bits() const
+{
+	return fBits;
+}
+
+
+int32
+FrameBuffer::BitsLength() const
+{
+	return fBytesPerRow * fHeight;
+}
+
+
+int32
+FrameBuffer::BytesPerRow() const
+{
+	return fBytesPerRow;
+}
+
+
+BRect
+FrameBuffer::Bounds() const
+{
+	return BRect(0, 0, fWidth - 1, fHeight - 1);
+}
+
+
+int32
+FrameBuffer::Width() const
+{
+	return fWidth;
+}
+
+
+int32
+FrameBuffer::Height() const
+{
+	return fHeight;
+}
+
+
+color_space
+FrameBuffer::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+bigtime_t
+FrameBuffer::TimeStamp() const
+{
+	return fTimeStamp;
+}
+
+
+void
+FrameBuffer::SetTimeStamp(bigtime_t time)
+{
+	fTimeStamp = time;
+}
+
+
+bool
+FrameBuffer::IsDuplicate() const
+{
+	return fDuplicate;
+}
+
+
+void
+FrameBuffer::SetDuplicate(bool duplicate)
+{
+	fDuplicate = duplicate;
+}
+
+
+status_t
+FrameBuffer::ImportBits(const BBitmap* bitmap)
+{
+	if (bitmap == NULL || bitmap->ColorSpace() != fColorSpace
+		|| bitmap->Bounds().IntegerHeight() + 1 < fHeight)
+		return B_BAD_VALUE;
+
+	CopyRows(fBits, fBytesPerRow, static_cast<const uint8*>(bitmap->Bits()),
+		bitmap->BytesPerRow(), fHeight);
+	return B_OK;
+}
+
+
+status_t
+FrameBuffer::ExportBits(BBitmap* bitmap) const
+{
+	if (bitmap == NULL || bitmap->ColorSpace() != fColorSpace
+		|| bitmap->Bounds().IntegerHeight() + 1 < fHeight)
+		return B_BAD_VALUE;
+
+	CopyRows(static_cast<uint8*>(bitmap->Bits()), bitmap->BytesPerRow(),
+		fBits, fBytesPerRow, fHeight);
+	return B_OK;
+}
+
+
+BBitmap*
+FrameBuffer::Bitmap() const
+{
+	if (fBitmapStatus == B_NO_INIT) {
+		fBitmap = new (std::nothrow) BBitmap(fArea, fAreaOffset,
+			BRect(0, 0, fWidth - 1, fHeight - 1), 0, fColorSpace,
+			fBytesPerRow);
+		fBitmapStatus = fBitmap != NULL ? fBitmap->InitCheck() : B_NO_MEMORY;
+		if (fBitmapStatus != B_OK) {
+			delete fBitmap;
+			fBitmap = NULL;
+		}
+	}
+	return fBitmap;
+}
+
+
+// FramePool
+FramePool::FramePool(const BRect& frame, color_space colorSpace, int32 count)
+	:
+	fArea(-1),
+	fBuffers(NULL),
+	fCount(0),
+	fBufferSize(0),
+	fBounds(frame.OffsetToCopy(B_ORIGIN)),
+	fColorSpace(colorSpace),
+	fFreeQueue(count),
+	fFreeSem(-1),
+	fInitStatus(B_NO_INIT)
+{
+	const int32 width = fBounds.IntegerWidth() + 1;
+	const int32 height = fBounds.IntegerHeight() + 1;
+	const int32 bytesPerRow = BytesPerRowFor(colorSpace, width);
+	if (count <= 0 || bytesPerRow <= 0 || height <= 0) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	fInitStatus = fFreeQueue.InitCheck();
+	if (fInitStatus != B_OK)
+		return;
+
+	fBuffers = new (std::nothrow) FrameBuffer[count];
+	if (fBuffers == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	// Every buffer starts on a page boundary
+	fBufferSize = RoundUpToPage(size_t(bytesPerRow) * height);
+	void* address = NULL;
+	fArea = create_area("frame pool", &address, B_ANY_ADDRESS,
+		fBufferSize * count, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (fArea < 0) {
+		fInitStatus = fArea;
+		return;
+	}
+
+	uint8* bits = static_cast<uint8*>(address);
+	for (int32 i = 0; i < count; i++) {
+		FrameBuffer& buffer = fBuffers[i];
+		buffer.fArea = fArea;
+		buffer.fAreaOffset = fBufferSize * i;
+		buffer.fBits = bits + fBufferSize * i;
+		buffer.fBytesPerRow = bytesPerRow;
+		buffer.fWidth = width;
+		buffer.fHeight = height;
+		buffer.fColorSpace = colorSpace;
+		fFreeQueue.Push(&buffer);
+	}
+	fCount = count;
+
+	fFreeSem = create_sem(fCount, "frame pool free buffers");
+	if (fFreeSem < 0) {
+		fInitStatus = fFreeSem;
+		return;
+	}
+
+	fInitStatus = B_OK;
+}
+
+
+FramePool::~FramePool()
+{
+	if (fFreeSem >= 0)
+		delete_sem(fFreeSem);
+	// The bitmaps of the buffers use the area
+	delete[] fBuffers;
+	if (fArea >= 0)
+		delete_area(fArea);
+}
+
+
+status_t
+FramePool::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+FrameBuffer*
+FramePool::Acquire(bigtime_t timeout)
+{
+	status_t status;
+	do {
+		status = acquire_sem_etc(fFreeSem, 1, B_RELATIVE_TIMEOUT, timeout);
+	} while (status == B_INTERRUPTED);
+
+	if (status != B_OK)
+		return NULL;
+
+	void* item = NULL;
+	if (!fFreeQueue.Pop(&item)) {
+		// Can't happen: the semaphore counts the free buffers
+		release_sem(fFreeSem);
+		return NULL;
+	}
+
+	return static_cast<FrameBuffer*>(item);
+}
+
+
+void
+FramePool::Release(FrameBuffer* buffer)
+{
+	if (buffer == NULL)
+		return;
+
+	fFreeQueue.Push(buffer);
+	release_sem(fFreeSem);
+}
+
+
+int32
+FramePool::CountBuffers() const
+{
+	return fCount;
+}
+
+
+int32
+FramePool::CountFree() const
+{
+	return fFreeQueue.CountItems();
+}
+
+
+size_t
+FramePool::BufferSize() const
+{
+	return fBufferSize;
+}
+
+
+BRect
+FramePool::Bounds() const
+{
+	return fBounds;
+}
+
+
+color_space
+FramePool::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+/* static */
+int32
+FramePool::BytesPerRowFor(color_space colorSpace, int32 width)
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK)
+		return -1;
+
+	const int32 chunks = (width + pixelsPerChunk - 1) / pixelsPerChunk;
+	// Same as BBitmap: rows are int32 aligned
+	return ((chunks * pixelChunk) + 3) & ~3;
+}
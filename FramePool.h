@@ -0,0 +1,100 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEPOOL_H
+#define __FRAMEPOOL_H
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+#include <Rect.h>
+
+#include "FrameQueue.h"
+
+class BBitmap;
+class FramePool;
+class FrameBuffer {
+public:
+	void*		Bits() const;
+	int32		BitsLength() const;
+	int32		BytesPerRow() const;
+	BRect		Bounds() const;
+	int32		Width() const;
+	int32		Height() const;
+	color_space	ColorSpace() const;
+
+	bigtime_t	TimeStamp() const;
+	void		SetTimeStamp(bigtime_t time);
+
+	// Same content as the frame queued before it
+	bool		IsDuplicate() const;
+	void		SetDuplicate(bool duplicate);
+
+	status_t	ImportBits(const BBitmap* bitmap);
+	status_t	ExportBits(BBitmap* bitmap) const;
+
+	// A bitmap sharing the bits of the buffer, so that app_server can
+	// write the frame right into it. Created the first time it's asked
+	// for, and NULL if it can't be.
+	BBitmap*	Bitmap() const;
+
+private:
+	friend class FramePool;
+	FrameBuffer();
+	~FrameBuffer();
+
+	area_id		fArea;
+	size_t		fAreaOffset;
+	mutable BBitmap*	fBitmap;
+	mutable status_t	fBitmapStatus;
+
+	uint8*		fBits;
+	int32		fBytesPerRow;
+	int32		fWidth;
+	int32		fHeight;
+	color_space	fColorSpace;
+	bigtime_t	fTimeStamp;
+	bool		fDuplicate;
+};
+
+
+// A fixed number of page aligned frame buffers, all carved out
+// of a single area. Buffers are recycled: after the pool has been
+// created, acquiring and releasing them never allocates memory.
+class FramePool {
+public:
+	FramePool(const BRect& frame, color_space colorSpace, int32 count);
+	~FramePool();
+
+	status_t		InitCheck() const;
+
+	// Returns NULL if no buffer became free within the given time
+	FrameBuffer*	Acquire(bigtime_t timeout = B_INFINITE_TIMEOUT);
+	void			Release(FrameBuffer* buffer);
+
+	int32			CountBuffers() const;
+	int32			CountFree() const;
+	size_t			BufferSize() const;
+	BRect			Bounds() const;
+	color_space		ColorSpace() const;
+
+	static int32	BytesPerRowFor(color_space colorSpace, int32 width);
+
+private:
+	area_id			fArea;
+	FrameBuffer*	fBuffers;
+	int32			fCount;
+	size_t			fBufferSize;
+	BRect			fBounds;
+	color_space		fColorSpace;
+
+	FrameQueue		fFreeQueue;
+	sem_id			fFreeSem;
+
+	status_t		fInitStatus;
+
+	FramePool(const FramePool&);
+	FramePool& operator=(const FramePool&);
+};
+
+#endif // __FRAMEPOOL_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Based on Dmitry Vyukov's bounded MPMC queue: every cell carries
+// a sequence number which tells producers and consumers whether the
+// cell is free or filled for the current lap.
+
+#include "FrameQueue.h"
+
+#include <OS.h>
+
+#include <new>
+
+
+static inline int32
+SequenceDiff(int32 a, int32 b)
+{
+	// Positions wrap around: do the math unsigned to avoid overflow
+	return int32(uint32(a) - uint32(b));
+}
+
+
+FrameQueue::FrameQueue(int32 capacity)
+	:
+	fCells(NULL),
+	fMask(0),
+	fHead(0),
+	fTail(0)
+{
+	// Capacity must be a power of two
+	int32 size = 2;
+	while (size < capacity)
+		size <<= 1;
+
+	fCells = new (std::nothrow) cell[size];
+	if (fCells == NULL)
+		return;
+
+	fMask = size - 1;
+	for (int32 i = 0; i < size; i++) {
+		fCells[i].sequence = i;
+		fCells[i].item = NULL;
+	}
+}
+
+
+FrameQueue::~FrameQueue()
+{
+	delete[] fCells;
+}
+
+
+status_t
+FrameQueue::InitCheck() const
+{
+	return fCells != NULL ? B_OK : B_NO_MEMORY;
+}
+
+
+bool
+FrameQueue::Push(void* item)
+{
+	cell* target = NULL;
+	int32 position = atomic_get(&fTail);
+	for (;;) {
+		target = &fCells[position & fMask];
+		const int32 sequence = atomic_get(&target->sequence);
+		const int32 diff = SequenceDiff(sequence, position);
+		if (diff == 0) {
+			if (atomic_test_and_set(&fTail, position + 1, position) == position)
+				break;
+			position = atomic_get(&fTail);
+		} else if (diff < 0) {
+			// full
+			return false;
+		} else
+			position = atomic_get(&fTail);
+	}
+
+	target->item = item;
+	atomic_set(&target->sequence, position + 1);
+	return true;
+}
+
+
+bool
+FrameQueue::Pop(void** item)
+{
+	cell* target = NULL;
+	int32 position = atomic_get(&fHead);
+	for (;;) {
+		target = &fCells[position & fMask];
+		const int32 sequence = atomic_get(&target->sequence);
+		const int32 diff = SequenceDiff(sequence, position + 1);
+		if (diff == 0) {
+			if (atomic_test_and_set(&fHead, position + 1, position) == position)
+				break;
+			position = atomic_get(&fHead);
+		} else if (diff < 0) {
+			// empty
+			return false;
+		} else
+			position = atomic_get(&fHead);
+	}
+
+	*item = target->item;
+	atomic_set(&target->sequence, position + fMask + 1);
+	return true;
+}
+
+
+int32
+FrameQueue::CountItems() const
+{
+	// Only a snapshot: other threads could be pushing or popping
+	const int32 tail = atomic_get(const_cast<int32*>(&fTail));
+	const int32 head = atomic_get(const_cast<int32*>(&fHead));
+	const int32 count = SequenceDiff(tail, head);
+	if (count < 0)
+		return 0;
+	return count > Capacity() ? Capacity() : count;
+}
+
+
+int32
+FrameQueue::Capacity() const
+{
+	return fCells != NULL ? fMask + 1 : 0;
+}
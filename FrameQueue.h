@@ -0,0 +1,41 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEQUEUE_H
+#define __FRAMEQUEUE_H
+
+#include <SupportDefs.h>
+
+// Bounded, lock-free, multi producer / multi consumer FIFO of pointers.
+// Push() and Pop() never block: they fail when the queue is full or empty.
+// Callers which need to wait must pair the queue with a semaphore.
+class FrameQueue {
+public:
+	FrameQueue(int32 capacity);
+	~FrameQueue();
+
+	status_t InitCheck() const;
+
+	bool Push(void* item);
+	bool Pop(void** item);
+
+	int32 CountItems() const;
+	int32 Capacity() const;
+
+private:
+	struct cell {
+		int32	sequence;
+		void*	item;
+	};
+
+	cell*	fCells;
+	int32	fMask;
+	int32	fHead;
+	int32	fTail;
+
+	FrameQueue(const FrameQueue&);
+	FrameQueue& operator=(const FrameQueue&);
+};
+
+#endif // __FRAMEQUEUE_H
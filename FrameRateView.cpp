@@ -26,8 +26,10 @@
 #define B_TRANSLATION_CONTEXT "FrameRateView"
 
 const static char* kFrameRateLabel = B_TRANSLATE("Target frame rate");
+const static char* kPlaybackFrameRateLabel = B_TRANSLATE("Playback frame rate");
 
 const static uint32 kLocalFrameRateChanged = 'FrCh';
+const static uint32 kLocalPlaybackFrameRateChanged = 'PfCh';
 
 
 FrameRateView::FrameRateView()
@@ -36,10 +38,17 @@ FrameRateView::FrameRateView()
 {
 	fFrameRateSlider = new SliderTextControl("frame_rate_slider",
 			kFrameRateLabel, new BMessage(kLocalFrameRateChanged), 1, 60, 1, B_TRANSLATE("fps"));
+	// 0 keeps the timing of the capture
+	fPlaybackFrameRateSlider = new SliderTextControl("playback_frame_rate_slider",
+			kPlaybackFrameRateLabel, new BMessage(kLocalPlaybackFrameRateChanged),
+			0, 60, 1, B_TRANSLATE("fps"));
 
 	BLayoutBuilder::Group<>(this, B_VERTICAL, B_USE_DEFAULT_SPACING)
 		.AddGroup(B_HORIZONTAL)
 			.Add(fFrameRateSlider)
+		.End()
+		.AddGroup(B_HORIZONTAL)
+			.Add(fPlaybackFrameRateSlider)
 		.End();
 }
 
@@ -51,10 +60,13 @@ FrameRateView::AttachedToWindow()
 		be_app->StartWatching(this, kMsgControllerCaptureStarted);
 		be_app->StartWatching(this, kMsgControllerCaptureStopped);
 		be_app->StartWatching(this, kMsgControllerResetSettings);
+		be_app->StartWatching(this, kMsgControllerPlaybackFrameRateChanged);
 		be_app->UnlockLooper();
 	}
 	fFrameRateSlider->SetValue(Settings::Current().CaptureFrameRate());
 	fFrameRateSlider->SetTarget(this);
+	fPlaybackFrameRateSlider->SetValue(Settings::Current().PlaybackFrameRate());
+	fPlaybackFrameRateSlider->SetTarget(this);
 }
 
 
@@ -70,6 +82,12 @@ FrameRateView::MessageReceived(BMessage* message)
 			app->SetCaptureFrameRate(rate);
 			break;
 		}
+		case kLocalPlaybackFrameRateChanged:
+		{
+			int32 rate = fPlaybackFrameRateSlider->Value();
+			app->SetPlaybackFrameRate(rate);
+			break;
+		}
 		case B_OBSERVER_NOTICE_CHANGE:
 		{
 			int32 code;
@@ -77,9 +95,11 @@ FrameRateView::MessageReceived(BMessage* message)
 			switch (code) {
 				case kMsgControllerCaptureStarted:
 					fFrameRateSlider->SetEnabled(false);
+					fPlaybackFrameRateSlider->SetEnabled(false);
 					break;
 				case kMsgControllerCaptureStopped:
 					fFrameRateSlider->SetEnabled(true);
+					fPlaybackFrameRateSlider->SetEnabled(true);
 					break;
 				case kMsgControllerCaptureFrameRateChanged:
 				{
@@ -88,10 +108,19 @@ FrameRateView::MessageReceived(BMessage* message)
 						fFrameRateSlider->SetValue(fps);
 					break;
 				}
+				case kMsgControllerPlaybackFrameRateChanged:
+				{
+					int32 fps;
+					if (message->FindInt32("frame_rate", &fps) == B_OK)
+						fPlaybackFrameRateSlider->SetValue(fps);
+					break;
+				}
 				case kMsgControllerResetSettings:
 				{
 					int32 fps = Settings::Current().CaptureFrameRate();
 					fFrameRateSlider->SetValue(fps);
+					fps = Settings::Current().PlaybackFrameRate();
+					fPlaybackFrameRateSlider->SetValue(fps);
 					break;
 				}
 				default:
@@ -16,6 +16,7 @@ public:
 
 private:
 	SliderTextControl* fFrameRateSlider;
+	SliderTextControl* fPlaybackFrameRateSlider;
 };
 
 
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameReducer.h"
+
+#include "ColorConversion.h"
+#include "Scaler.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <new>
+
+// Bands per thread, so that a thread which is late doesn't hold up the
+// others for long
+const static int32 kBandsPerThread = 2;
+
+
+FrameReducer::FrameReducer(int32 sourceWidth, int32 sourceHeight,
+	color_space sourceColorSpace, int32 destWidth, int32 destHeight,
+	color_space destColorSpace, int32 threads, int32 priority)
+	:
+	fSourceColorSpace(sourceColorSpace),
+	fDestColorSpace(destColorSpace),
+	fWidth(destWidth),
+	fHeight(destHeight),
+	fScaler(NULL),
+	fPool(NULL),
+	fScaledBytesPerRow(0),
+	fBands(1),
+	fInitStatus(B_OK),
+	fFrom(NULL),
+	fFromBytesPerRow(0),
+	fTo(NULL),
+	fToBytesPerRow(0)
+{
+	if (sourceWidth <= 0 || sourceHeight <= 0 || destWidth <= 0
+		|| destHeight <= 0) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+	if (sourceColorSpace != destColorSpace
+		&& !IsReduction(sourceColorSpace, destColorSpace)) {
+		fInitStatus = B_NOT_SUPPORTED;
+		return;
+	}
+
+	if (threads > 1) {
+		fPool = new (std::nothrow) ThreadPool("frame reducer", threads,
+			priority);
+		if (fPool == NULL) {
+			fInitStatus = B_NO_MEMORY;
+			return;
+		}
+		fInitStatus = fPool->InitCheck();
+		if (fInitStatus != B_OK)
+			return;
+	}
+
+	if (destWidth != sourceWidth || destHeight != sourceHeight) {
+		// Averaging all the pixels when reducing avoids aliasing
+		scale_filter filter = destWidth <= sourceWidth
+			&& destHeight <= sourceHeight ? B_SCALE_BOX : B_SCALE_BILINEAR;
+		if (!Scaler::IsSupported(sourceColorSpace, filter))
+			filter = B_SCALE_NEAREST;
+		fScaler = new (std::nothrow) Scaler(sourceWidth, sourceHeight,
+			destWidth, destHeight, sourceColorSpace, filter);
+		if (fScaler == NULL) {
+			fInitStatus = B_NO_MEMORY;
+			return;
+		}
+		fInitStatus = fScaler->InitCheck();
+		if (fInitStatus != B_OK)
+			return;
+
+		if (sourceColorSpace != destColorSpace) {
+			fScaledBytesPerRow = (RowLength(sourceColorSpace, destWidth) + 3)
+				& ~3;
+			try {
+				fScaled.resize(size_t(fScaledBytesPerRow) * destHeight);
+			} catch (...) {
+				fInitStatus = B_NO_MEMORY;
+				return;
+			}
+		}
+	}
+
+	// The bands start on even rows, for the 4:2:0 color spaces
+	const int32 poolThreads = fPool != NULL ? fPool->CountThreads() : 1;
+	fBands = std::max(std::min(poolThreads * kBandsPerThread,
+		(destHeight + 1) / 2), int32(1));
+}
+
+
+FrameReducer::~FrameReducer()
+{
+	delete fScaler;
+	delete fPool;
+}
+
+
+status_t
+FrameReducer::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+status_t
+FrameReducer::Reduce(const void* source, int32 sourceBytesPerRow,
+	void* dest, int32 destBytesPerRow)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (source == NULL || dest == NULL)
+		return B_BAD_VALUE;
+
+	const uint8* from = static_cast<const uint8*>(source);
+	int32 fromBytesPerRow = sourceBytesPerRow;
+	if (fScaler != NULL) {
+		if (fSourceColorSpace == fDestColorSpace) {
+			return fScaler->Scale(source, sourceBytesPerRow, dest,
+				destBytesPerRow, fPool);
+		}
+		status_t status = fScaler->Scale(source, sourceBytesPerRow,
+			&fScaled[0], fScaledBytesPerRow, fPool);
+		if (status != B_OK)
+			return status;
+		from = &fScaled[0];
+		fromBytesPerRow = fScaledBytesPerRow;
+	}
+
+	fFrom = from;
+	fFromBytesPerRow = fromBytesPerRow;
+	fTo = static_cast<uint8*>(dest);
+	fToBytesPerRow = destBytesPerRow;
+	if (fPool != NULL && fBands > 1)
+		fPool->Run(fBands, _ConvertJob, this);
+	else {
+		for (int32 band = 0; band < fBands; band++)
+			_ConvertBand(band);
+	}
+	fFrom = NULL;
+	fTo = NULL;
+
+	return B_OK;
+}
+
+
+/* static */
+bool
+FrameReducer::IsReduction(color_space sourceColorSpace,
+	color_space destColorSpace)
+{
+	const color_space_traits* source = GetColorSpaceTraits(sourceColorSpace);
+	const color_space_traits* dest = GetColorSpaceTraits(destColorSpace);
+	if (source == NULL || dest == NULL || dest->rowsPerGroup > 1
+		|| !CanConvertColorSpace(sourceColorSpace, destColorSpace))
+		return false;
+	return dest->groupSize * source->pixelsPerGroup
+		< source->groupSize * dest->pixelsPerGroup;
+}
+
+
+/* static */
+void
+FrameReducer::_ConvertJob(void* cookie, int32 band)
+{
+	static_cast<FrameReducer*>(cookie)->_ConvertBand(band);
+}
+
+
+void
+FrameReducer::_ConvertBand(int32 band)
+{
+	const int32 pairs = (fHeight + 1) / 2;
+	const int32 firstRow = 2 * (pairs * band / fBands);
+	const int32 lastRow = std::min(2 * (pairs * (band + 1) / fBands),
+		fHeight);
+	if (firstRow >= lastRow)
+		return;
+
+	DitherBits(fFrom + size_t(firstRow) * fFromBytesPerRow, fFromBytesPerRow,
+		fSourceColorSpace, fTo + size_t(firstRow) * fToBytesPerRow,
+		fToBytesPerRow, fDestColorSpace, fWidth, lastRow - firstRow, firstRow);
+}
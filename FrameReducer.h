@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEREDUCER_H
+#define __FRAMEREDUCER_H
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+
+#include <vector>
+
+class Scaler;
+class ThreadPool;
+
+// Brings the captured frames down to the size and the depth of the clip,
+// before they're queued, so that the spool and the encoder have less to
+// do. The frame is scaled first, then dithered to the clip color space in
+// bands of rows, which are converted at the same time.
+class FrameReducer {
+public:
+	// "threads" counts the calling thread too
+	FrameReducer(int32 sourceWidth, int32 sourceHeight,
+		color_space sourceColorSpace, int32 destWidth, int32 destHeight,
+		color_space destColorSpace, int32 threads = 1,
+		int32 priority = B_NORMAL_PRIORITY);
+	~FrameReducer();
+
+	status_t InitCheck() const;
+
+	// Source and destination must not overlap
+	status_t Reduce(const void* source, int32 sourceBytesPerRow,
+		void* dest, int32 destBytesPerRow);
+
+	// Color spaces worth converting to while capturing: fewer bytes per
+	// pixel than the source, and no chroma shared among rows
+	static bool IsReduction(color_space sourceColorSpace,
+		color_space destColorSpace);
+
+private:
+	static void _ConvertJob(void* cookie, int32 band);
+	void _ConvertBand(int32 band);
+
+	color_space			fSourceColorSpace;
+	color_space			fDestColorSpace;
+	int32				fWidth;
+	int32				fHeight;
+	Scaler*				fScaler;
+	ThreadPool*			fPool;
+	// The scaled frame, when it's converted too
+	std::vector<uint8>	fScaled;
+	int32				fScaledBytesPerRow;
+	int32				fBands;
+	status_t			fInitStatus;
+
+	// The frame being converted
+	const uint8*		fFrom;
+	int32				fFromBytesPerRow;
+	uint8*				fTo;
+	int32				fToBytesPerRow;
+
+	FrameReducer(const FrameReducer&);
+	FrameReducer& operator=(const FrameReducer&);
+};
+
+#endif // __FRAMEREDUCER_H
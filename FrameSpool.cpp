@@ -0,0 +1,1594 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FrameSpool.h"
+
+#include "DeltaCodec.h"
+#include "FramePool.h"
+#include "LZCodec.h"
+#include "ThreadPool.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const static char* kSpoolFileName = "frames.spool";
+const static char* kIndexFileName = "frames.index";
+
+// Caps the memory used to remember the stored tiles. When full,
+// the map starts over: the tiles seen from then on are stored again.
+const static size_t kMaxKnownTiles = 1 << 20;
+
+
+static inline off_t
+Align(off_t value)
+{
+	return (value + kSpoolAlignment - 1) & ~off_t(kSpoolAlignment - 1);
+}
+
+
+static status_t
+WriteFully(int fd, const void* data, size_t size, off_t offset)
+{
+	const uint8* from = static_cast<const uint8*>(data);
+	while (size > 0) {
+		ssize_t written = ::pwrite(fd, from, size, offset);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (written == 0)
+			return B_IO_ERROR;
+		from += written;
+		offset += written;
+		size -= written;
+	}
+	return B_OK;
+}
+
+
+static status_t
+ReadFully(int fd, void* data, size_t size, off_t offset)
+{
+	uint8* to = static_cast<uint8*>(data);
+	while (size > 0) {
+		ssize_t bytesRead = ::pread(fd, to, size, offset);
+		if (bytesRead < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (bytesRead == 0)
+			return B_BAD_DATA;
+		to += bytesRead;
+		offset += bytesRead;
+		size -= bytesRead;
+	}
+	return B_OK;
+}
+
+
+static void
+MakePath(char* path, const char* directory, const char* name)
+{
+	::snprintf(path, B_PATH_NAME_LENGTH, "%s/%s", directory, name);
+}
+
+
+static void
+InitRecordHeader(spool_record_header& header, uint32 codec, int32 width,
+	int32 height, int32 bytesPerRow, color_space colorSpace,
+	bigtime_t timeStamp, size_t payloadSize)
+{
+	::memset(&header, 0, sizeof(header));
+	header.magic = kSpoolRecordMagic;
+	header.codec = codec;
+	header.width = width;
+	header.height = height;
+	header.bytes_per_row = bytesPerRow;
+	header.color_space = colorSpace;
+	header.time_stamp = timeStamp;
+	header.payload_size = payloadSize;
+}
+
+
+// Returns the length of the visible part of a row, in bytes
+static int32
+RowLengthFor(color_space colorSpace, int32 width)
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK)
+		return -1;
+	return (width + pixelsPerChunk - 1) / pixelsPerChunk * pixelChunk;
+}
+
+
+struct stripe_job {
+	const uint8*	bits;
+	int32			bytesPerRow;
+	int32			height;
+	int32			rowsPerStripe;
+	int32			level;
+	uint8*			stripes;
+	size_t			stripeBound;
+	uint32*			sizes;
+	uint32			storedMask;
+	int64			time;
+	int32			status;
+};
+
+
+static void
+CompressStripe(void* cookie, int32 index)
+{
+	stripe_job* job = static_cast<stripe_job*>(cookie);
+	const bigtime_t start = system_time();
+
+	const int32 firstRow = index * job->rowsPerStripe;
+	const int32 rows = std::min(job->rowsPerStripe, job->height - firstRow);
+	const uint8* from = job->bits + firstRow * job->bytesPerRow;
+	const size_t size = size_t(rows) * job->bytesPerRow;
+	uint8* to = job->stripes + index * job->stripeBound;
+
+	const size_t compressedSize = LZCompress(from, size, to, job->level);
+	if (compressedSize < size)
+		job->sizes[index] = compressedSize;
+	else {
+		::memcpy(to, from, size);
+		job->sizes[index] = size | kSpoolStripeStored;
+	}
+
+	atomic_add64(&job->time, system_time() - start);
+}
+
+
+static void
+DecompressStripe(void* cookie, int32 index)
+{
+	stripe_job* job = static_cast<stripe_job*>(cookie);
+
+	const int32 firstRow = index * job->rowsPerStripe;
+	const int32 rows = std::min(job->rowsPerStripe, job->height - firstRow);
+	uint8* to = const_cast<uint8*>(job->bits) + firstRow * job->bytesPerRow;
+	const size_t size = size_t(rows) * job->bytesPerRow;
+
+	// When decoding, "sizes" holds the offset of every stripe, plus the end
+	const uint8* from = job->stripes + job->sizes[index];
+	const size_t length = job->sizes[index + 1] - job->sizes[index];
+	status_t status = B_OK;
+	if ((job->storedMask & (uint32(1) << index)) != 0) {
+		if (length == size)
+			::memcpy(to, from, size);
+		else
+			status = B_BAD_DATA;
+	} else
+		status = LZDecompress(from, length, to, size);
+
+	if (status != B_OK)
+		atomic_test_and_set(&job->status, status, B_OK);
+}
+
+
+static bool
+TimeStampLess(const spool_index_entry& a, const spool_index_entry& b)
+{
+	return a.time_stamp < b.time_stamp;
+}
+
+
+FrameSpool::FrameSpool()
+	:
+	fSpoolFD(-1),
+	fIndexFD(-1),
+	fWriteOffset(0),
+	fIndexOffset(0),
+	fIndexLock("spool index"),
+	fTileLock("spool tiles"),
+	fTilesStored(0),
+	fTilesReused(0),
+	fCodec(B_SPOOL_CODEC_TILES),
+	fCompressionLevel(kLZFastLevel),
+	fThreadPool(NULL),
+	fThreadPoolLock("spool thread pool"),
+	fRawBytes(0),
+	fCompressedBytes(0),
+	fCompressionTime(0),
+	fMemoryBudget(0),
+	fMemoryArea(-1),
+	fMemoryBase(NULL),
+	fMemorySize(0),
+	fMemoryUsed(0),
+	fIndexInMemory(false),
+	fRingLength(0),
+	fDeltaLock("spool delta"),
+	fReferenceOffset(-1),
+	fFramesSinceKeyFrame(0),
+	fScratchSize(0),
+	fMappedBase(NULL),
+	fMappedSize(0),
+	fDecodeLock("spool decoder"),
+	fDecodedOffset(-1)
+{
+	fDirectory[0] = '\0';
+}
+
+
+FrameSpool::~FrameSpool()
+{
+	Close();
+	delete fThreadPool;
+}
+
+
+/* static */
+bool
+FrameSpool::Exists(const char* directory)
+{
+	if (directory == NULL)
+		return false;
+	char path[B_PATH_NAME_LENGTH];
+	MakePath(path, directory, kIndexFileName);
+	return ::access(path, F_OK) == 0;
+}
+
+
+status_t
+FrameSpool::Create(const char* directory)
+{
+	Close();
+
+	char spoolPath[B_PATH_NAME_LENGTH];
+	char indexPath[B_PATH_NAME_LENGTH];
+	MakePath(spoolPath, directory, kSpoolFileName);
+	MakePath(indexPath, directory, kIndexFileName);
+
+	fSpoolFD = ::open(spoolPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fSpoolFD < 0)
+		return errno;
+	fIndexFD = ::open(indexPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fIndexFD < 0) {
+		status_t status = errno;
+		Close();
+		return status;
+	}
+
+	::strlcpy(fDirectory, directory, sizeof(fDirectory));
+
+	spool_file_header header;
+	::memset(&header, 0, sizeof(header));
+	header.magic = kSpoolFileMagic;
+	header.version = kSpoolVersion;
+	status_t status = WriteFully(fSpoolFD, &header, sizeof(header), 0);
+	if (status == B_OK) {
+		header.magic = kSpoolIndexMagic;
+		status = WriteFully(fIndexFD, &header, sizeof(header), 0);
+	}
+	if (status != B_OK) {
+		Close();
+		return status;
+	}
+
+	fWriteOffset = Align(sizeof(header));
+	fIndexOffset = sizeof(header);
+
+	// Not fatal: without memory, frames just go to disk.
+	// A ring can't do without.
+	if ((fMemoryBudget > 0 || fRingLength > 0)
+		&& (status = _CreateMemory()) != B_OK) {
+		std::cerr << "FrameSpool::Create(): cannot keep frames in memory: ";
+		std::cerr << ::strerror(status) << std::endl;
+		if (fRingLength > 0) {
+			Close();
+			return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::Open(const char* directory)
+{
+	Close();
+
+	char spoolPath[B_PATH_NAME_LENGTH];
+	char indexPath[B_PATH_NAME_LENGTH];
+	MakePath(spoolPath, directory, kSpoolFileName);
+	MakePath(indexPath, directory, kIndexFileName);
+
+	fSpoolFD = ::open(spoolPath, O_RDONLY);
+	if (fSpoolFD < 0)
+		return errno;
+	fIndexFD = ::open(indexPath, O_RDONLY);
+	if (fIndexFD < 0) {
+		status_t status = errno;
+		Close();
+		return status;
+	}
+
+	::strlcpy(fDirectory, directory, sizeof(fDirectory));
+
+	spool_file_header header;
+	status_t status = ReadFully(fSpoolFD, &header, sizeof(header), 0);
+	if (status == B_OK && (header.magic != kSpoolFileMagic
+			|| header.version != kSpoolVersion))
+		status = B_BAD_DATA;
+	if (status == B_OK)
+		status = ReadFully(fIndexFD, &header, sizeof(header), 0);
+	if (status == B_OK && (header.magic != kSpoolIndexMagic
+			|| header.version != kSpoolVersion))
+		status = B_BAD_DATA;
+
+	struct stat indexStat;
+	struct stat spoolStat;
+	if (status == B_OK && (::fstat(fIndexFD, &indexStat) != 0
+			|| ::fstat(fSpoolFD, &spoolStat) != 0))
+		status = errno;
+
+	size_t count = 0;
+	if (status == B_OK) {
+		count = (indexStat.st_size - sizeof(header))
+			/ sizeof(spool_index_entry);
+		try {
+			fIndex.resize(count);
+		} catch (...) {
+			status = B_NO_MEMORY;
+		}
+		if (status == B_OK && count > 0) {
+			status = ReadFully(fIndexFD, &fIndex[0],
+				count * sizeof(spool_index_entry), sizeof(header));
+		}
+	}
+
+	if (status != B_OK) {
+		Close();
+		return status;
+	}
+
+	status = _BuildIndex();
+	if (status != B_OK) {
+		Close();
+		return status;
+	}
+
+	fWriteOffset = Align(spoolStat.st_size);
+	fIndexOffset = sizeof(header) + count * sizeof(spool_index_entry);
+
+	// Not fatal: we can still read the frames without the mapping
+	if (_Map() != B_OK)
+		std::cerr << "FrameSpool::Open(): cannot map spool, using read()" << std::endl;
+
+	return B_OK;
+}
+
+
+void
+FrameSpool::Close()
+{
+	_Unmap();
+	if (fSpoolFD >= 0)
+		::close(fSpoolFD);
+	if (fIndexFD >= 0)
+		::close(fIndexFD);
+	fSpoolFD = -1;
+	fIndexFD = -1;
+	fWriteOffset = 0;
+	fIndexOffset = 0;
+	fIndex.clear();
+	fSources.clear();
+	fTiles.clear();
+	_DeleteMemory();
+	fIndexInMemory = false;
+	fRing.Clear();
+
+	fReference.clear();
+	fReferenceOffset = -1;
+	fFramesSinceKeyFrame = 0;
+	for (size_t i = 0; i < fScratch.size(); i++)
+		delete[] fScratch[i];
+	fScratch.clear();
+	fScratchSize = 0;
+
+	fDecoded.clear();
+	fDecodedOffset = -1;
+	fPayload.clear();
+}
+
+
+void
+FrameSpool::Remove()
+{
+	Close();
+	if (fDirectory[0] == '\0')
+		return;
+
+	char path[B_PATH_NAME_LENGTH];
+	MakePath(path, fDirectory, kSpoolFileName);
+	::unlink(path);
+	MakePath(path, fDirectory, kIndexFileName);
+	::unlink(path);
+	fDirectory[0] = '\0';
+}
+
+
+void
+FrameSpool::SetCodec(spool_codec codec)
+{
+	fCodec = codec;
+}
+
+
+void
+FrameSpool::SetCompressionLevel(int32 level)
+{
+	fCompressionLevel = std::max(kLZFastLevel, std::min(level, kLZBestLevel));
+}
+
+
+void
+FrameSpool::SetMemoryBudget(size_t bytes)
+{
+	fMemoryBudget = bytes;
+}
+
+
+void
+FrameSpool::SetRingLength(bigtime_t length)
+{
+	fRingLength = std::max(length, bigtime_t(0));
+}
+
+
+status_t
+FrameSpool::FinishWriting()
+{
+	if (fSpoolFD < 0)
+		return B_NO_INIT;
+
+	if (!fIndexInMemory) {
+		// Nothing in memory: the index is all on disk
+		char directory[B_PATH_NAME_LENGTH];
+		::strlcpy(directory, fDirectory, sizeof(directory));
+		return Open(directory);
+	}
+
+	if (fRingLength > 0) {
+		// The frames still in the ring, oldest first
+		try {
+			fIndex.resize(fRing.CountRecords());
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		for (int32 i = 0; i < fRing.CountRecords(); i++) {
+			const SpoolRing::record& record = fRing.RecordAt(i);
+			fIndex[i].time_stamp = record.time_stamp;
+			fIndex[i].offset = record.offset < 0 ? kSpoolDuplicateOffset
+				: kSpoolMemoryOffset + record.offset;
+		}
+		fRing.Clear();
+		fRingLength = 0;
+	}
+
+	fIndexInMemory = false;
+	status_t status = _BuildIndex();
+	if (status != B_OK)
+		return status;
+
+	// The records which spilled to disk, if any. Not fatal either.
+	if (fWriteOffset > off_t(Align(sizeof(spool_file_header)))
+		&& _Map() != B_OK)
+		std::cerr << "FrameSpool::FinishWriting(): cannot map spool, using read()" << std::endl;
+
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::WriteFrame(const FrameBuffer* buffer, off_t* recordOffset)
+{
+	if (buffer == NULL)
+		return B_BAD_VALUE;
+
+	// Records in a ring can't reference each other
+	if (fCodec == B_SPOOL_CODEC_LZ
+		|| (fRingLength > 0 && fCodec != B_SPOOL_CODEC_RAW))
+		return _WriteCompressedFrame(buffer, recordOffset);
+
+	if (fCodec == B_SPOOL_CODEC_DELTA) {
+		const int32 rowLength = RowLengthFor(buffer->ColorSpace(),
+			buffer->Width());
+		if (rowLength > 0)
+			return _WriteDeltaFrame(buffer, rowLength, recordOffset);
+	}
+
+	// Tiles are cut at pixel boundaries: only possible
+	// if every pixel takes a whole number of bytes
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (fCodec == B_SPOOL_CODEC_TILES
+		&& get_pixel_size_for(buffer->ColorSpace(), &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) == B_OK && pixelsPerChunk == 1)
+		return _WriteTiledFrame(buffer, pixelChunk, recordOffset);
+
+	spool_record_header header;
+	InitRecordHeader(header, B_SPOOL_CODEC_RAW, buffer->Width(),
+		buffer->Height(), buffer->BytesPerRow(), buffer->ColorSpace(),
+		buffer->TimeStamp(), buffer->BitsLength());
+	return _AppendRecord(header, buffer->Bits(), recordOffset);
+}
+
+
+status_t
+FrameSpool::WriteDuplicate(bigtime_t timeStamp)
+{
+	if (fIndexFD < 0)
+		return B_NO_INIT;
+
+	return _AppendIndexEntry(timeStamp, kSpoolDuplicateOffset);
+}
+
+
+int32
+FrameSpool::CountFrames() const
+{
+	return fIndex.size();
+}
+
+
+bigtime_t
+FrameSpool::TimeStampAt(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return -1;
+	return fIndex[index].time_stamp;
+}
+
+
+bool
+FrameSpool::IsDuplicate(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return false;
+	return fSources[index] != index;
+}
+
+
+status_t
+FrameSpool::GetFrameInfo(int32 index, BRect& bounds,
+	color_space& colorSpace) const
+{
+	if (index < 0 || index >= CountFrames())
+		return B_BAD_INDEX;
+
+	spool_record_header header;
+	status_t status = _ReadHeader(_RecordOffset(index), header);
+	if (status != B_OK)
+		return status;
+
+	bounds.Set(0, 0, header.width - 1, header.height - 1);
+	colorSpace = (color_space)header.color_space;
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::ReadFrame(int32 index, FrameBuffer* buffer) const
+{
+	if (index < 0 || index >= CountFrames())
+		return B_BAD_INDEX;
+
+	// A duplicate has its own time stamp
+	status_t status = _ReadRecord(_RecordOffset(index), buffer);
+	if (status == B_OK)
+		buffer->SetTimeStamp(fIndex[index].time_stamp);
+	return status;
+}
+
+
+status_t
+FrameSpool::ReadRecord(off_t offset, FrameBuffer* buffer) const
+{
+	// The oldest records of a ring are overwritten at any time
+	if (fRingLength > 0)
+		return B_NOT_ALLOWED;
+
+	return _ReadRecord(offset, buffer);
+}
+
+
+BBitmap*
+FrameSpool::ReadBitmap(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return NULL;
+
+	const off_t offset = _RecordOffset(index);
+	spool_record_header header;
+	if (_ReadHeader(offset, header) != B_OK)
+		return NULL;
+
+	BBitmap* bitmap = new (std::nothrow) BBitmap(
+		BRect(0, 0, header.width - 1, header.height - 1),
+		(color_space)header.color_space);
+	if (bitmap == NULL || bitmap->InitCheck() != B_OK
+		|| _DecodeFrame(header, offset, static_cast<uint8*>(bitmap->Bits()),
+			bitmap->BytesPerRow()) != B_OK) {
+		delete bitmap;
+		return NULL;
+	}
+	return bitmap;
+}
+
+
+off_t
+FrameSpool::Size() const
+{
+	return atomic_get64(const_cast<int64*>(&fWriteOffset));
+}
+
+
+size_t
+FrameSpool::MemoryUsed() const
+{
+	// Writers which didn't fit also added their size
+	return std::min(atomic_get64(const_cast<int64*>(&fMemoryUsed)),
+		fMemorySize);
+}
+
+
+void
+FrameSpool::PrintStatistics() const
+{
+	FrameSpool* self = const_cast<FrameSpool*>(this);
+	std::cout << "Frame spool: " << (Size() / (1024 * 1024)) << " MB, ";
+	std::cout << atomic_get64(&self->fTilesStored) << " tiles stored, ";
+	std::cout << atomic_get64(&self->fTilesReused) << " reused." << std::endl;
+	if (fMemoryBase != NULL) {
+		std::cout << "In memory: " << (MemoryUsed() / (1024 * 1024)) << " of ";
+		std::cout << (fMemorySize / (1024 * 1024)) << " MB." << std::endl;
+	}
+
+	const int64 rawBytes = atomic_get64(&self->fRawBytes);
+	const int64 compressedBytes = atomic_get64(&self->fCompressedBytes);
+	const bigtime_t compressionTime = atomic_get64(&self->fCompressionTime);
+	if (rawBytes > 0 && compressedBytes > 0 && compressionTime > 0) {
+		std::cout << "Compression: " << (rawBytes / (1024.0 * 1024)) << " MB -> ";
+		std::cout << (compressedBytes / (1024.0 * 1024)) << " MB, ratio ";
+		std::cout << (float(rawBytes) / compressedBytes) << ", ";
+		std::cout << (rawBytes / compressionTime) << " MB/s per thread.";
+		std::cout << std::endl;
+	}
+}
+
+
+status_t
+FrameSpool::_WriteTiledFrame(const FrameBuffer* buffer, int32 bytesPerPixel,
+	off_t* recordOffset)
+{
+	const int32 width = buffer->Width();
+	const int32 height = buffer->Height();
+	const int32 bytesPerRow = buffer->BytesPerRow();
+	const int32 tilesAcross = (width + kSpoolTileSize - 1) / kSpoolTileSize;
+	const int32 tilesDown = (height + kSpoolTileSize - 1) / kSpoolTileSize;
+
+	// The same size every frame: reused, not allocated again
+	const size_t tableSize = size_t(tilesAcross) * tilesDown * sizeof(int64);
+	uint8* scratch = _AcquireScratch(tableSize);
+	if (scratch == NULL)
+		return B_NO_MEMORY;
+	int64* tileOffsets = reinterpret_cast<int64*>(scratch);
+
+	const uint8* bits = static_cast<const uint8*>(buffer->Bits());
+	size_t i = 0;
+	for (int32 y = 0; y < height; y += kSpoolTileSize) {
+		const int32 rows = std::min(kSpoolTileSize, height - y);
+		for (int32 x = 0; x < width; x += kSpoolTileSize) {
+			const int32 rowLength = std::min(kSpoolTileSize, width - x)
+				* bytesPerPixel;
+			off_t tileOffset;
+			status_t status = _AppendTile(
+				bits + y * bytesPerRow + x * bytesPerPixel, bytesPerRow,
+				rowLength, rows, &tileOffset);
+			if (status != B_OK) {
+				_ReleaseScratch(scratch, tableSize);
+				return status;
+			}
+			tileOffsets[i++] = tileOffset;
+		}
+	}
+
+	spool_record_header header;
+	InitRecordHeader(header, B_SPOOL_CODEC_TILES, width, height,
+		bytesPerRow, buffer->ColorSpace(), buffer->TimeStamp(),
+		tableSize);
+	header.tile_size = kSpoolTileSize;
+	status_t status = _AppendRecord(header, tileOffsets, recordOffset);
+	_ReleaseScratch(scratch, tableSize);
+	return status;
+}
+
+
+status_t
+FrameSpool::_AppendTile(const uint8* bits, int32 bytesPerRow,
+	int32 rowLength, int32 rows, off_t* tileOffset)
+{
+	const frame_hash hash = HashBits(bits, bytesPerRow, rowLength, rows);
+	const size_t tileSize = size_t(rowLength) * rows;
+	{
+		BAutolock _(fTileLock);
+		tile_map::const_iterator known = fTiles.find(hash);
+		if (known != fTiles.end()) {
+			*tileOffset = known->second;
+			atomic_add64(&fTilesReused, 1);
+			return B_OK;
+		}
+
+		// Reserve the space now, so other writers can already
+		// reference the tile while we write it
+		*tileOffset = _Reserve(Align(tileSize));
+		try {
+			if (fTiles.size() >= kMaxKnownTiles)
+				fTiles.clear();
+			fTiles[hash] = *tileOffset;
+		} catch (...) {
+			// Not fatal: the tile just won't be shared
+		}
+	}
+	atomic_add64(&fTilesStored, 1);
+
+	// Tiles are stored contiguously: gather the rows
+	uint8 tile[kSpoolTileSize * kSpoolTileSize * 4];
+	if (tileSize > sizeof(tile)) {
+		for (int32 y = 0; y < rows; y++) {
+			status_t status = _WriteBytes(*tileOffset + off_t(y) * rowLength,
+				bits + y * bytesPerRow, rowLength);
+			if (status != B_OK)
+				return status;
+		}
+		return B_OK;
+	}
+
+	for (int32 y = 0; y < rows; y++)
+		::memcpy(tile + y * rowLength, bits + y * bytesPerRow, rowLength);
+	return _WriteBytes(*tileOffset, tile, tileSize);
+}
+
+
+status_t
+FrameSpool::_WriteDeltaFrame(const FrameBuffer* buffer, int32 rowLength,
+	off_t* recordOffset)
+{
+	const int32 height = buffer->Height();
+	const int32 bytesPerRow = buffer->BytesPerRow();
+	const size_t frameSize = buffer->BitsLength();
+	const size_t scratchSize = DeltaEncodeBound(rowLength, height);
+	uint8* scratch = _AcquireScratch(scratchSize);
+	if (scratch == NULL)
+		return B_NO_MEMORY;
+
+	spool_record_header header;
+	InitRecordHeader(header, B_SPOOL_CODEC_DELTA, buffer->Width(), height,
+		bytesPerRow, buffer->ColorSpace(), buffer->TimeStamp(), 0);
+
+	off_t offset;
+	{
+		// Every frame is encoded against the one encoded before it,
+		// so this part can't run in parallel
+		BAutolock _(fDeltaLock);
+		const bool keyFrame = fReferenceOffset < 0
+			|| fFramesSinceKeyFrame >= kSpoolKeyFrameInterval
+			|| fReference.size() != frameSize;
+		if (keyFrame) {
+			try {
+				fReference.resize(frameSize);
+			} catch (...) {
+				_ReleaseScratch(scratch, scratchSize);
+				return B_NO_MEMORY;
+			}
+			::memset(&fReference[0], 0, frameSize);
+		}
+
+		const uint8* bits = static_cast<const uint8*>(buffer->Bits());
+		header.payload_size = DeltaEncode(bits, &fReference[0], bytesPerRow,
+			rowLength, height, scratch);
+		::memcpy(&fReference[0], bits, frameSize);
+
+		header.flags = keyFrame ? B_SPOOL_KEY_FRAME : 0;
+		header.reference = keyFrame ? -1 : fReferenceOffset;
+		offset = _Reserve(Align(sizeof(header)) + Align(header.payload_size));
+
+		fReferenceOffset = offset;
+		fFramesSinceKeyFrame = keyFrame ? 1 : fFramesSinceKeyFrame + 1;
+	}
+
+	status_t status = _WriteRecord(offset, header, scratch);
+	_ReleaseScratch(scratch, scratchSize);
+	if (status == B_OK && recordOffset != NULL)
+		*recordOffset = offset;
+	return status;
+}
+
+
+status_t
+FrameSpool::_WriteCompressedFrame(const FrameBuffer* buffer,
+	off_t* recordOffset)
+{
+	const int32 height = buffer->Height();
+	const int32 bytesPerRow = buffer->BytesPerRow();
+
+	// A few stripes per thread, so that the threads finish together
+	// even if some stripes compress slower than others.
+	// The decoder keeps the "stored" flags in a 32 bit mask.
+	ThreadPool* pool = _ThreadPool();
+	const int32 threads = pool != NULL ? pool->CountThreads() : 1;
+	int32 stripes = std::min(std::min(threads * 2, height), int32(32));
+	const int32 rowsPerStripe = (height + stripes - 1) / stripes;
+	stripes = (height + rowsPerStripe - 1) / rowsPerStripe;
+
+	const size_t tableSize = (2 + stripes) * sizeof(uint32);
+	const size_t stripeBound = LZCompressBound(
+		size_t(rowsPerStripe) * bytesPerRow);
+	const size_t scratchSize = tableSize + stripes * stripeBound;
+	uint8* scratch = _AcquireScratch(scratchSize);
+	if (scratch == NULL)
+		return B_NO_MEMORY;
+
+	uint32* table = reinterpret_cast<uint32*>(scratch);
+	table[0] = stripes;
+	table[1] = rowsPerStripe;
+
+	stripe_job job;
+	job.bits = static_cast<const uint8*>(buffer->Bits());
+	job.bytesPerRow = bytesPerRow;
+	job.height = height;
+	job.rowsPerStripe = rowsPerStripe;
+	job.level = fCompressionLevel;
+	job.stripes = scratch + tableSize;
+	job.stripeBound = stripeBound;
+	job.sizes = table + 2;
+	job.storedMask = 0;
+	job.time = 0;
+	job.status = B_OK;
+	if (pool != NULL)
+		pool->Run(stripes, CompressStripe, &job);
+	else {
+		for (int32 i = 0; i < stripes; i++)
+			CompressStripe(&job, i);
+	}
+
+	// Close the gaps between the stripes
+	uint8* end = scratch + tableSize;
+	for (int32 i = 0; i < stripes; i++) {
+		const size_t size = job.sizes[i] & ~kSpoolStripeStored;
+		::memmove(end, job.stripes + i * stripeBound, size);
+		end += size;
+	}
+
+	spool_record_header header;
+	InitRecordHeader(header, B_SPOOL_CODEC_LZ, buffer->Width(), height,
+		bytesPerRow, buffer->ColorSpace(), buffer->TimeStamp(), end - scratch);
+	status_t status = _AppendRecord(header, scratch, recordOffset);
+	_ReleaseScratch(scratch, scratchSize);
+
+	atomic_add64(&fRawBytes, buffer->BitsLength());
+	atomic_add64(&fCompressedBytes, header.payload_size);
+	atomic_add64(&fCompressionTime, job.time);
+	return status;
+}
+
+
+ThreadPool*
+FrameSpool::_ThreadPool() const
+{
+	BAutolock _(fThreadPoolLock);
+	if (fThreadPool == NULL) {
+		const int32 threads = ThreadPool::DefaultThreadCount();
+		if (threads <= 1)
+			return NULL;
+		fThreadPool = new (std::nothrow) ThreadPool("spool codec", threads);
+		if (fThreadPool != NULL && fThreadPool->InitCheck() != B_OK) {
+			delete fThreadPool;
+			fThreadPool = NULL;
+		}
+	}
+	return fThreadPool;
+}
+
+
+status_t
+FrameSpool::_CreateMemory()
+{
+	const size_t size = (fMemoryBudget + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+	void* address = NULL;
+	fMemoryArea = create_area("spool memory", &address, B_ANY_ADDRESS, size,
+		B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (fMemoryArea < 0) {
+		status_t status = fMemoryArea;
+		fMemoryArea = -1;
+		return status;
+	}
+
+	if (fRingLength > 0) {
+		// Allocated once: adding frames to the ring never allocates
+		const int32 capacity = std::max(int64(fRingLength / 1000000 + 1)
+			* kSpoolRingFramesPerSecond, int64(kSpoolRingFramesPerSecond));
+		status_t status = fRing.Init(size, fRingLength, capacity);
+		if (status != B_OK) {
+			delete_area(fMemoryArea);
+			fMemoryArea = -1;
+			return status;
+		}
+	}
+
+	fMemoryBase = static_cast<uint8*>(address);
+	fMemorySize = size;
+	fMemoryUsed = 0;
+	fIndexInMemory = true;
+	return B_OK;
+}
+
+
+void
+FrameSpool::_DeleteMemory()
+{
+	if (fMemoryArea >= 0)
+		delete_area(fMemoryArea);
+	fMemoryArea = -1;
+	fMemoryBase = NULL;
+	fMemorySize = 0;
+	fMemoryUsed = 0;
+}
+
+
+// Returns where to write "size" bytes: in memory if they still fit,
+// in the spool file otherwise
+off_t
+FrameSpool::_Reserve(off_t size)
+{
+	if (fMemoryBase != NULL
+		&& atomic_get64(&fMemoryUsed) + size <= fMemorySize) {
+		const int64 offset = atomic_add64(&fMemoryUsed, size);
+		if (offset + size <= fMemorySize)
+			return kSpoolMemoryOffset + offset;
+		// Another writer took the rest
+	}
+	return atomic_add64(&fWriteOffset, size);
+}
+
+
+// Finds where to write a record of "size" bytes in the ring, and adds
+// it to the ring index. The oldest records are dropped to make room.
+status_t
+FrameSpool::_ReserveRing(off_t size, bigtime_t timeStamp, off_t* offset)
+{
+	BAutolock _(fIndexLock);
+	off_t memoryOffset;
+	status_t status = fRing.Reserve(size, timeStamp, &memoryOffset);
+	atomic_set64(&fMemoryUsed, fRing.MemoryUsed());
+	if (status != B_OK)
+		return status;
+
+	*offset = kSpoolMemoryOffset + memoryOffset;
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_WriteBytes(off_t offset, const void* data, size_t size)
+{
+	if (offset >= kSpoolMemoryOffset) {
+		const off_t memoryOffset = offset - kSpoolMemoryOffset;
+		if (memoryOffset + off_t(size) > fMemorySize)
+			return B_BAD_VALUE;
+		::memcpy(fMemoryBase + memoryOffset, data, size);
+		return B_OK;
+	}
+	return WriteFully(fSpoolFD, data, size, offset);
+}
+
+
+// The buffers are all of the last size asked for. The ones of another
+// size, which other threads may still be using, are only freed when
+// they're given back.
+uint8*
+FrameSpool::_AcquireScratch(size_t size)
+{
+	BAutolock _(fDeltaLock);
+	if (size != fScratchSize) {
+		for (size_t i = 0; i < fScratch.size(); i++)
+			delete[] fScratch[i];
+		fScratch.clear();
+		fScratchSize = size;
+	}
+	if (!fScratch.empty()) {
+		uint8* scratch = fScratch.back();
+		fScratch.pop_back();
+		return scratch;
+	}
+	return new (std::nothrow) uint8[size];
+}
+
+
+void
+FrameSpool::_ReleaseScratch(uint8* scratch, size_t size)
+{
+	BAutolock _(fDeltaLock);
+	if (size != fScratchSize) {
+		delete[] scratch;
+		return;
+	}
+	try {
+		fScratch.push_back(scratch);
+	} catch (...) {
+		delete[] scratch;
+	}
+}
+
+
+status_t
+FrameSpool::_AppendRecord(spool_record_header& header, const void* payload,
+	off_t* recordOffset)
+{
+	if (fSpoolFD < 0)
+		return B_NO_INIT;
+
+	const off_t recordSize = Align(sizeof(spool_record_header))
+		+ Align(header.payload_size);
+
+	// Reserve the space, then write without holding any lock.
+	// Ring records are added to the index when they are reserved,
+	// to keep it in the same order as the ring.
+	status_t status;
+	off_t offset;
+	if (fRingLength > 0) {
+		status = _ReserveRing(recordSize, header.time_stamp, &offset);
+		if (status != B_OK)
+			return status;
+		status = _WriteRecordData(offset, header, payload);
+	} else {
+		offset = _Reserve(recordSize);
+		status = _WriteRecord(offset, header, payload);
+	}
+	if (status == B_OK && recordOffset != NULL)
+		*recordOffset = offset;
+	return status;
+}
+
+
+status_t
+FrameSpool::_WriteRecord(off_t offset, const spool_record_header& header,
+	const void* payload)
+{
+	status_t status = _WriteRecordData(offset, header, payload);
+	if (status != B_OK)
+		return status;
+
+	// The record is complete: only now it can be referenced by the index
+	return _AppendIndexEntry(header.time_stamp, offset);
+}
+
+
+status_t
+FrameSpool::_WriteRecordData(off_t offset, const spool_record_header& header,
+	const void* payload)
+{
+	status_t status = _WriteBytes(offset, &header, sizeof(header));
+	if (status == B_OK) {
+		status = _WriteBytes(offset + Align(sizeof(header)), payload,
+			header.payload_size);
+	}
+	return status;
+}
+
+
+status_t
+FrameSpool::_AppendIndexEntry(bigtime_t timeStamp, off_t offset)
+{
+	spool_index_entry entry;
+	entry.time_stamp = timeStamp;
+	entry.offset = offset;
+
+	BAutolock _(fIndexLock);
+	if (fRingLength > 0) {
+		// The ring records were added when they were reserved
+		if (offset != kSpoolDuplicateOffset)
+			return B_NOT_ALLOWED;
+		status_t status = fRing.AddDuplicate(timeStamp);
+		atomic_set64(&fMemoryUsed, fRing.MemoryUsed());
+		return status;
+	}
+	if (fIndexInMemory) {
+		try {
+			fIndex.push_back(entry);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		return B_OK;
+	}
+
+	status_t status = WriteFully(fIndexFD, &entry, sizeof(entry), fIndexOffset);
+	if (status == B_OK)
+		fIndexOffset += sizeof(entry);
+	return status;
+}
+
+
+status_t
+FrameSpool::_BuildIndex()
+{
+	// Writers finish in any order: sort the frames by time
+	std::stable_sort(fIndex.begin(), fIndex.end(), TimeStampLess);
+
+	// Resolve the duplicates to the frame they repeat
+	try {
+		fSources.resize(fIndex.size());
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	size_t first = 0;
+	while (first < fIndex.size()
+			&& fIndex[first].offset == kSpoolDuplicateOffset)
+		first++;
+	if (first > 0) {
+		// Can only happen if the first frames were lost: nothing to repeat
+		fIndex.erase(fIndex.begin(), fIndex.begin() + first);
+		fSources.resize(fIndex.size());
+	}
+	for (size_t i = 0; i < fIndex.size(); i++) {
+		if (fIndex[i].offset == kSpoolDuplicateOffset)
+			fSources[i] = fSources[i - 1];
+		else
+			fSources[i] = i;
+	}
+	return B_OK;
+}
+
+
+off_t
+FrameSpool::_RecordOffset(int32 index) const
+{
+	return fIndex[fSources[index]].offset;
+}
+
+
+// Returns the data at "offset" if it's in memory or mapped,
+// NULL if it must be read from the spool file
+const uint8*
+FrameSpool::_Pointer(off_t offset, size_t size) const
+{
+	if (offset >= kSpoolMemoryOffset) {
+		const off_t memoryOffset = offset - kSpoolMemoryOffset;
+		if (fMemoryBase == NULL || memoryOffset + off_t(size) > fMemorySize)
+			return NULL;
+		return fMemoryBase + memoryOffset;
+	}
+	if (fMappedBase == NULL || offset + off_t(size) > off_t(fMappedSize))
+		return NULL;
+	return fMappedBase + offset;
+}
+
+
+status_t
+FrameSpool::_ReadHeader(off_t offset, spool_record_header& header) const
+{
+	const uint8* data = _Pointer(offset, sizeof(header));
+	if (data != NULL)
+		::memcpy(&header, data, sizeof(header));
+	else if (offset >= kSpoolMemoryOffset)
+		return B_BAD_DATA;
+	else {
+		status_t status = ReadFully(fSpoolFD, &header, sizeof(header), offset);
+		if (status != B_OK)
+			return status;
+	}
+
+	if (header.magic != kSpoolRecordMagic)
+		return B_BAD_DATA;
+	if (header.codec != B_SPOOL_CODEC_RAW
+		&& header.codec != B_SPOOL_CODEC_TILES
+		&& header.codec != B_SPOOL_CODEC_DELTA
+		&& header.codec != B_SPOOL_CODEC_LZ)
+		return B_NOT_SUPPORTED;
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_ReadBytes(off_t offset, void* to, size_t size) const
+{
+	const uint8* data = _Pointer(offset, size);
+	if (data != NULL) {
+		::memcpy(to, data, size);
+		return B_OK;
+	}
+	if (offset >= kSpoolMemoryOffset)
+		return B_BAD_DATA;
+	return ReadFully(fSpoolFD, to, size, offset);
+}
+
+
+status_t
+FrameSpool::_ReadRecord(off_t offset, FrameBuffer* buffer) const
+{
+	spool_record_header header;
+	status_t status = _ReadHeader(offset, header);
+	if (status != B_OK)
+		return status;
+
+	if (header.width != buffer->Width() || header.height != buffer->Height()
+		|| (color_space)header.color_space != buffer->ColorSpace())
+		return B_MISMATCHED_VALUES;
+
+	status = _DecodeFrame(header, offset, static_cast<uint8*>(buffer->Bits()),
+		buffer->BytesPerRow());
+	if (status == B_OK)
+		buffer->SetTimeStamp(header.time_stamp);
+	return status;
+}
+
+
+status_t
+FrameSpool::_DecodeFrame(const spool_record_header& header, off_t offset,
+	uint8* to, int32 toBytesPerRow) const
+{
+	switch (header.codec) {
+		case B_SPOOL_CODEC_RAW:
+			return _CopyPayload(header, offset, to, toBytesPerRow);
+		case B_SPOOL_CODEC_TILES:
+			return _CopyTiles(header, offset, to, toBytesPerRow);
+		case B_SPOOL_CODEC_DELTA:
+			return _CopyDelta(header, offset, to, toBytesPerRow);
+		case B_SPOOL_CODEC_LZ:
+			return _CopyCompressed(header, offset, to, toBytesPerRow);
+		default:
+			return B_NOT_SUPPORTED;
+	}
+}
+
+
+status_t
+FrameSpool::_CopyPayload(const spool_record_header& header, off_t offset,
+	uint8* to, int32 toBytesPerRow) const
+{
+	const off_t payloadOffset = offset + Align(sizeof(header));
+	const int32 rowLength = std::min(toBytesPerRow, header.bytes_per_row);
+
+	const uint8* from = _Pointer(payloadOffset, header.payload_size);
+	if (from != NULL) {
+		if (toBytesPerRow == header.bytes_per_row) {
+			::memcpy(to, from, header.payload_size);
+			return B_OK;
+		}
+		for (int32 y = 0; y < header.height; y++) {
+			::memcpy(to, from, rowLength);
+			to += toBytesPerRow;
+			from += header.bytes_per_row;
+		}
+		return B_OK;
+	}
+
+	// Not mapped, or the record was appended after the mapping was made
+	if (payloadOffset >= kSpoolMemoryOffset)
+		return B_BAD_DATA;
+	if (toBytesPerRow == header.bytes_per_row)
+		return ReadFully(fSpoolFD, to, header.payload_size, payloadOffset);
+
+	for (int32 y = 0; y < header.height; y++) {
+		status_t status = ReadFully(fSpoolFD, to, rowLength,
+			payloadOffset + off_t(y) * header.bytes_per_row);
+		if (status != B_OK)
+			return status;
+		to += toBytesPerRow;
+	}
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_Map()
+{
+	struct stat st;
+	if (::fstat(fSpoolFD, &st) != 0)
+		return errno;
+	if (st.st_size <= 0 || off_t(size_t(st.st_size)) != st.st_size)
+		return B_NO_MEMORY;
+
+	void* address = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+		fSpoolFD, 0);
+	if (address == MAP_FAILED)
+		return errno;
+
+	fMappedBase = static_cast<uint8*>(address);
+	fMappedSize = st.st_size;
+	return B_OK;
+}
+
+
+void
+FrameSpool::_Unmap()
+{
+	if (fMappedBase != NULL)
+		::munmap(fMappedBase, fMappedSize);
+	fMappedBase = NULL;
+	fMappedSize = 0;
+}
+
+
+status_t
+FrameSpool::_CopyTiles(const spool_record_header& header, off_t offset,
+	uint8* to, int32 toBytesPerRow) const
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	status_t status = get_pixel_size_for((color_space)header.color_space,
+		&pixelChunk, &rowAlignment, &pixelsPerChunk);
+	if (status != B_OK)
+		return status;
+
+	const int32 tileSize = header.tile_size;
+	const int32 tilesAcross = (header.width + tileSize - 1) / tileSize;
+	const int32 tilesDown = (header.height + tileSize - 1) / tileSize;
+	if (tileSize <= 0 || pixelsPerChunk != 1
+		|| header.payload_size != tilesAcross * tilesDown * sizeof(int64))
+		return B_BAD_DATA;
+
+	std::vector<int64> tileOffsets;
+	std::vector<uint8> tile;
+	try {
+		tileOffsets.resize(size_t(tilesAcross) * tilesDown);
+		if (fMappedBase == NULL)
+			tile.resize(size_t(tileSize) * tileSize * pixelChunk);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+
+	status = _ReadBytes(offset + Align(sizeof(header)), &tileOffsets[0],
+		header.payload_size);
+	if (status != B_OK)
+		return status;
+
+	size_t i = 0;
+	for (int32 y = 0; y < header.height; y += tileSize) {
+		const int32 rows = std::min(tileSize, header.height - y);
+		for (int32 x = 0; x < header.width; x += tileSize) {
+			const int32 rowLength = std::min(tileSize, header.width - x)
+				* pixelChunk;
+			const off_t tileOffset = tileOffsets[i++];
+			const size_t length = size_t(rowLength) * rows;
+
+			const uint8* from = _Pointer(tileOffset, length);
+			if (from == NULL) {
+				if (tile.size() < length) {
+					try {
+						tile.resize(length);
+					} catch (...) {
+						return B_NO_MEMORY;
+					}
+				}
+				status = ReadFully(fSpoolFD, &tile[0], length, tileOffset);
+				if (status != B_OK)
+					return status;
+				from = &tile[0];
+			}
+
+			uint8* dest = to + y * toBytesPerRow + x * pixelChunk;
+			for (int32 row = 0; row < rows; row++) {
+				::memcpy(dest, from, rowLength);
+				dest += toBytesPerRow;
+				from += rowLength;
+			}
+		}
+	}
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_CopyDelta(const spool_record_header& header, off_t offset,
+	uint8* to, int32 toBytesPerRow) const
+{
+	BAutolock _(fDecodeLock);
+	status_t status = _DecodeDelta(header, offset);
+	if (status != B_OK)
+		return status;
+
+	const int32 rowLength = std::min(toBytesPerRow, header.bytes_per_row);
+	const uint8* from = &fDecoded[0];
+	for (int32 y = 0; y < header.height; y++) {
+		::memcpy(to, from, rowLength);
+		to += toBytesPerRow;
+		from += header.bytes_per_row;
+	}
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_DecodeDelta(const spool_record_header& header, off_t offset) const
+{
+	if (fDecodedOffset == offset)
+		return B_OK;
+
+	// Walk back to the key frame, or to the frame we already have.
+	// Reading in order, that's just the previous one.
+	std::vector<off_t> chain;
+	std::vector<spool_record_header> headers;
+	spool_record_header current = header;
+	try {
+		chain.push_back(offset);
+		headers.push_back(header);
+		while ((current.flags & B_SPOOL_KEY_FRAME) == 0
+			&& current.reference != fDecodedOffset) {
+			const off_t reference = current.reference;
+			status_t status = _ReadHeader(reference, current);
+			if (status != B_OK)
+				return status;
+			if (current.codec != B_SPOOL_CODEC_DELTA
+				|| chain.size() > size_t(kSpoolKeyFrameInterval) * 4)
+				return B_BAD_DATA;
+			chain.push_back(reference);
+			headers.push_back(current);
+		}
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+
+	for (int32 i = chain.size() - 1; i >= 0; i--) {
+		const spool_record_header& record = headers[i];
+		const size_t frameSize = size_t(record.bytes_per_row) * record.height;
+		const int32 rowLength = RowLengthFor((color_space)record.color_space,
+			record.width);
+		if (rowLength <= 0 || rowLength > record.bytes_per_row)
+			return B_BAD_DATA;
+
+		// Until it's done, the decoded frame is not valid
+		fDecodedOffset = -1;
+		try {
+			if ((record.flags & B_SPOOL_KEY_FRAME) != 0) {
+				fDecoded.resize(frameSize);
+				::memset(&fDecoded[0], 0, frameSize);
+			} else if (fDecoded.size() != frameSize)
+				return B_BAD_DATA;
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+
+		const off_t payloadOffset = chain[i] + Align(sizeof(record));
+		const uint8* payload = _Pointer(payloadOffset, record.payload_size);
+		if (payload == NULL) {
+			try {
+				if (fPayload.size() < record.payload_size)
+					fPayload.resize(record.payload_size);
+			} catch (...) {
+				return B_NO_MEMORY;
+			}
+			status_t status = ReadFully(fSpoolFD, &fPayload[0],
+				record.payload_size, payloadOffset);
+			if (status != B_OK)
+				return status;
+			payload = &fPayload[0];
+		}
+
+		status_t status = DeltaDecode(payload, record.payload_size,
+			&fDecoded[0], record.bytes_per_row, rowLength, record.height);
+		if (status != B_OK)
+			return status;
+		fDecodedOffset = chain[i];
+	}
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_CopyCompressed(const spool_record_header& header, off_t offset,
+	uint8* to, int32 toBytesPerRow) const
+{
+	BAutolock _(fDecodeLock);
+
+	const off_t payloadOffset = offset + Align(sizeof(header));
+	const uint8* payload = _Pointer(payloadOffset, header.payload_size);
+	if (payload == NULL) {
+		try {
+			if (fPayload.size() < header.payload_size)
+				fPayload.resize(header.payload_size);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		status_t status = ReadFully(fSpoolFD, &fPayload[0],
+			header.payload_size, payloadOffset);
+		if (status != B_OK)
+			return status;
+		payload = &fPayload[0];
+	}
+
+	if (header.payload_size < 2 * sizeof(uint32))
+		return B_BAD_DATA;
+	uint32 stripes;
+	uint32 rowsPerStripe;
+	::memcpy(&stripes, payload, sizeof(uint32));
+	::memcpy(&rowsPerStripe, payload + sizeof(uint32), sizeof(uint32));
+	const size_t tableSize = (2 + stripes) * sizeof(uint32);
+	if (stripes == 0 || stripes > 32 || rowsPerStripe == 0
+		|| (stripes - 1) * rowsPerStripe >= uint32(header.height)
+		|| stripes * rowsPerStripe < uint32(header.height)
+		|| tableSize > header.payload_size)
+		return B_BAD_DATA;
+
+	// Turn the sizes into offsets, and collect the "stored" flags
+	uint32 offsets[33];
+	uint32 storedMask = 0;
+	offsets[0] = tableSize;
+	for (uint32 i = 0; i < stripes; i++) {
+		uint32 size;
+		::memcpy(&size, payload + (2 + i) * sizeof(uint32), sizeof(uint32));
+		if ((size & kSpoolStripeStored) != 0)
+			storedMask |= uint32(1) << i;
+		offsets[i + 1] = offsets[i] + (size & ~kSpoolStripeStored);
+		if (offsets[i + 1] > header.payload_size)
+			return B_BAD_DATA;
+	}
+
+	// Decompress straight to the destination if the layout is the same
+	uint8* frame = to;
+	if (toBytesPerRow != header.bytes_per_row) {
+		try {
+			fDecoded.resize(size_t(header.bytes_per_row) * header.height);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		frame = &fDecoded[0];
+		// Not a delta frame anymore
+		fDecodedOffset = -1;
+	}
+
+	stripe_job job;
+	job.bits = frame;
+	job.bytesPerRow = header.bytes_per_row;
+	job.height = header.height;
+	job.rowsPerStripe = rowsPerStripe;
+	job.level = 0;
+	job.stripes = const_cast<uint8*>(payload);
+	job.stripeBound = 0;
+	job.sizes = offsets;
+	job.storedMask = storedMask;
+	job.time = 0;
+	job.status = B_OK;
+	ThreadPool* pool = _ThreadPool();
+	if (pool != NULL)
+		pool->Run(stripes, DecompressStripe, &job);
+	else {
+		for (uint32 i = 0; i < stripes; i++)
+			DecompressStripe(&job, i);
+	}
+	if (job.status != B_OK)
+		return job.status;
+
+	if (frame != to) {
+		const int32 rowLength = std::min(toBytesPerRow, header.bytes_per_row);
+		for (int32 y = 0; y < header.height; y++) {
+			::memcpy(to, frame, rowLength);
+			to += toBytesPerRow;
+			frame += header.bytes_per_row;
+		}
+	}
+	return B_OK;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMESPOOL_H
+#define __FRAMESPOOL_H
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+#include <OS.h>
+#include <Rect.h>
+#include <StorageDefs.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "FrameHash.h"
+#include "SpoolRing.h"
+
+// On disk format.
+// The spool file starts with a spool_file_header, followed by frame records:
+// a spool_record_header and its payload, both padded to kSpoolAlignment.
+// Tiled records reference tiles stored elsewhere in the spool file:
+// their payload is an array of int64 tile offsets, row by row. The tiles
+// themselves are raw pixels without header, padded to kSpoolAlignment.
+// Delta records (see DeltaCodec.h) depend on the record they reference,
+// which depends on its own reference, up to a key frame.
+// Compressed records are split in horizontal stripes, compressed
+// independently (see LZCodec.h). Their payload starts with the number of
+// stripes, the rows per stripe and the size of every stripe, followed by
+// the stripes themselves.
+// The index file starts with a spool_file_header, followed by one
+// spool_index_entry per record, in the order the records were written.
+// With a memory budget, records (and the index) are kept in memory
+// until the budget is used up, and only then go to the spool file.
+// Records in memory have offsets starting at kSpoolMemoryOffset,
+// so both kinds can reference each other.
+// In ring mode the memory is reused: the oldest records are dropped
+// to make room for new ones, and nothing goes to disk.
+const uint32 kSpoolFileMagic = 'BSCs';
+const uint32 kSpoolIndexMagic = 'BSCi';
+const uint32 kSpoolRecordMagic = 'BSCf';
+const uint32 kSpoolVersion = 1;
+const size_t kSpoolAlignment = 64;
+const int32 kSpoolTileSize = 64;
+// Bounds the number of records to decode to get a delta frame
+const int32 kSpoolKeyFrameInterval = 30;
+// Index entries with this offset have no record of their own:
+// the frame is the same as the one before it
+const int64 kSpoolDuplicateOffset = -1;
+const int64 kSpoolMemoryOffset = 1LL << 62;
+// Bounds the number of frames a ring can hold, for its length
+const int32 kSpoolRingFramesPerSecond = 120;
+
+enum spool_codec {
+	B_SPOOL_CODEC_RAW = 0,
+	B_SPOOL_CODEC_TILES = 1,
+	B_SPOOL_CODEC_DELTA = 2,
+	B_SPOOL_CODEC_LZ = 3
+};
+
+// Set in the stripe size when the stripe didn't compress, and is stored as is
+const uint32 kSpoolStripeStored = 0x80000000;
+
+enum spool_record_flags {
+	B_SPOOL_KEY_FRAME = 0x1
+};
+
+struct spool_file_header {
+	uint32	magic;
+	uint32	version;
+	uint32	reserved[14];
+};
+
+struct spool_record_header {
+	uint32	magic;
+	uint32	codec;
+	int32	width;
+	int32	height;
+	int32	bytes_per_row;
+	uint32	color_space;
+	int64	time_stamp;
+	uint32	payload_size;
+	uint32	tile_size;		// B_SPOOL_CODEC_TILES
+	uint32	flags;
+	int64	reference;		// B_SPOOL_CODEC_DELTA: offset of the reference
+	uint32	reserved[2];
+};
+
+struct spool_index_entry {
+	int64	time_stamp;
+	int64	offset;
+};
+
+class BBitmap;
+class FrameBuffer;
+class ThreadPool;
+class FrameSpool {
+public:
+	FrameSpool();
+	~FrameSpool();
+
+	static bool Exists(const char* directory);
+
+	// Creates an empty spool for writing
+	status_t Create(const char* directory);
+	// Opens an existing spool for reading. Frames are sorted by time.
+	status_t Open(const char* directory);
+	void Close();
+	// Closes and deletes the spool files
+	void Remove();
+
+	// How new frames are stored. B_SPOOL_CODEC_TILES by default.
+	void SetCodec(spool_codec codec);
+	// For B_SPOOL_CODEC_LZ: kLZFastLevel (default) or kLZBestLevel
+	void SetCompressionLevel(int32 level);
+	// Memory for the records, before they spill to disk. Must be set
+	// before Create(). 0 (the default) writes everything to disk.
+	void SetMemoryBudget(size_t bytes);
+	// Only keeps the frames of the last "length" microseconds, in memory.
+	// Needs a memory budget, and must be set before Create(). Every record
+	// must stand on its own, so frames are always compressed with
+	// B_SPOOL_CODEC_LZ, unless the codec is B_SPOOL_CODEC_RAW.
+	void SetRingLength(bigtime_t length);
+	// Ends writing, and makes the frames readable without reopening
+	// the spool, since the ones in memory can't be reopened.
+	// All the writers must be done.
+	status_t FinishWriting();
+
+	// Thread safe. Can be called by many writers at the same time.
+	// "recordOffset" gets where the frame went, for ReadRecord().
+	status_t WriteFrame(const FrameBuffer* buffer,
+		off_t* recordOffset = NULL);
+	// Records a frame identical to the previous one. Only touches the index.
+	status_t WriteDuplicate(bigtime_t timeStamp);
+
+	int32 CountFrames() const;
+	bigtime_t TimeStampAt(int32 index) const;
+	bool IsDuplicate(int32 index) const;
+	status_t GetFrameInfo(int32 index, BRect& bounds,
+		color_space& colorSpace) const;
+
+	status_t ReadFrame(int32 index, FrameBuffer* buffer) const;
+	// Reads a frame back while the spool is still being written. The
+	// frame, and the tiles or the frames it was encoded against, must
+	// be written completely: no writer may have been busy since it was
+	// written. Not in ring mode.
+	status_t ReadRecord(off_t offset, FrameBuffer* buffer) const;
+	BBitmap* ReadBitmap(int32 index) const;
+
+	// Bytes written to disk, and held in memory
+	off_t Size() const;
+	size_t MemoryUsed() const;
+	void PrintStatistics() const;
+
+private:
+	status_t _WriteTiledFrame(const FrameBuffer* buffer,
+		int32 bytesPerPixel, off_t* recordOffset);
+	status_t _AppendTile(const uint8* bits, int32 bytesPerRow,
+		int32 rowLength, int32 rows, off_t* tileOffset);
+	status_t _WriteDeltaFrame(const FrameBuffer* buffer, int32 rowLength,
+		off_t* recordOffset);
+	status_t _WriteCompressedFrame(const FrameBuffer* buffer,
+		off_t* recordOffset);
+	ThreadPool* _ThreadPool() const;
+	status_t _CreateMemory();
+	void _DeleteMemory();
+	off_t _Reserve(off_t size);
+	status_t _ReserveRing(off_t size, bigtime_t timeStamp,
+		off_t* offset);
+	status_t _WriteBytes(off_t offset, const void* data, size_t size);
+	uint8* _AcquireScratch(size_t size);
+	void _ReleaseScratch(uint8* scratch, size_t size);
+	status_t _AppendRecord(spool_record_header& header,
+		const void* payload, off_t* recordOffset);
+	status_t _WriteRecord(off_t offset, const spool_record_header& header,
+		const void* payload);
+	status_t _WriteRecordData(off_t offset,
+		const spool_record_header& header, const void* payload);
+	status_t _AppendIndexEntry(bigtime_t timeStamp, off_t offset);
+	status_t _BuildIndex();
+	off_t _RecordOffset(int32 index) const;
+	const uint8* _Pointer(off_t offset, size_t size) const;
+	status_t _ReadHeader(off_t offset, spool_record_header& header) const;
+	status_t _ReadBytes(off_t offset, void* to, size_t size) const;
+	status_t _ReadRecord(off_t offset, FrameBuffer* buffer) const;
+	status_t _DecodeFrame(const spool_record_header& header,
+		off_t offset, uint8* to, int32 toBytesPerRow) const;
+	status_t _CopyPayload(const spool_record_header& header,
+		off_t offset, uint8* to, int32 toBytesPerRow) const;
+	status_t _CopyTiles(const spool_record_header& header,
+		off_t offset, uint8* to, int32 toBytesPerRow) const;
+	status_t _CopyDelta(const spool_record_header& header,
+		off_t offset, uint8* to, int32 toBytesPerRow) const;
+	status_t _DecodeDelta(const spool_record_header& header,
+		off_t offset) const;
+	status_t _CopyCompressed(const spool_record_header& header,
+		off_t offset, uint8* to, int32 toBytesPerRow) const;
+	status_t _Map();
+	void _Unmap();
+
+	char		fDirectory[B_PATH_NAME_LENGTH];
+	int			fSpoolFD;
+	int			fIndexFD;
+	int64		fWriteOffset;
+	off_t		fIndexOffset;
+	BLocker		fIndexLock;
+
+	// Tiles already in the spool, by content
+	typedef std::unordered_map<frame_hash, off_t, frame_hash_hasher> tile_map;
+	tile_map	fTiles;
+	BLocker		fTileLock;
+	int64		fTilesStored;
+	int64		fTilesReused;
+
+	spool_codec	fCodec;
+	int32		fCompressionLevel;
+
+	// Compression: shared by writers and readers
+	mutable ThreadPool* fThreadPool;
+	mutable BLocker fThreadPoolLock;
+	int64		fRawBytes;
+	int64		fCompressedBytes;
+	int64		fCompressionTime;
+
+	// Records kept in memory
+	size_t		fMemoryBudget;
+	area_id		fMemoryArea;
+	uint8*		fMemoryBase;
+	int64		fMemorySize;
+	int64		fMemoryUsed;
+	bool		fIndexInMemory;
+
+	// Ring mode: the records in memory, oldest first.
+	// Protected by fIndexLock.
+	bigtime_t	fRingLength;
+	SpoolRing	fRing;
+
+	// Delta encoding: the last frame written, and where
+	BLocker		fDeltaLock;
+	std::vector<uint8> fReference;
+	off_t		fReferenceOffset;
+	int32		fFramesSinceKeyFrame;
+	std::vector<uint8*> fScratch;
+	size_t		fScratchSize;
+
+	// reading
+	std::vector<spool_index_entry> fIndex;
+	// index of the frame which holds the data (differs for duplicates)
+	std::vector<int32> fSources;
+	uint8*		fMappedBase;
+	size_t		fMappedSize;
+
+	// Decoding: the last delta frame decoded, and where
+	mutable BLocker fDecodeLock;
+	mutable std::vector<uint8> fDecoded;
+	mutable off_t fDecodedOffset;
+	mutable std::vector<uint8> fPayload;
+};
+
+#endif // __FRAMESPOOL_H
@@ -5,6 +5,7 @@
 
 #include "FramesList.h"
 
+#include "FrameSpool.h"
 #include "Utils.h"
 
 #include <Bitmap.h>
@@ -28,6 +29,8 @@ char* FramesList::sTemporaryPath = NULL;
 const uint32 kBitmapFormat = 'BMP ';
 
 FramesList::FramesList(bool diskOnly)
+	:
+	fSpool(NULL)
 {
 }
 
@@ -39,6 +42,11 @@ FramesList::~FramesList()
 	// on disk. Must be done before deleting the folder
 	fList.clear();
 
+	if (fSpool != NULL) {
+		fSpool->Remove();
+		delete fSpool;
+	}
+
 	DeleteTempPath();
 }
 
@@ -87,6 +95,64 @@ struct
 
 status_t
 FramesList::AddItemsFromDisk()
+{
+	if (FrameSpool::Exists(Path()))
+		return _OpenSpool();
+
+	// Recordings made by older versions: one file per frame
+	return _AddItemsFromDirectory();
+}
+
+
+status_t
+FramesList::AddItemsFromSpool(FrameSpool* spool)
+{
+	if (spool == NULL)
+		return B_BAD_VALUE;
+	// The entries reference the spool they come from
+	if (fSpool != NULL && fSpool != spool)
+		return B_NOT_ALLOWED;
+
+	fSpool = spool;
+
+	// The spool index is already sorted by time
+	const int32 count = fSpool->CountFrames();
+	for (int32 i = 0; i < count; i++) {
+		BitmapEntry* bitmapEntry = new (std::nothrow) BitmapEntry(fSpool, i,
+			fSpool->TimeStampAt(i));
+		if (bitmapEntry == NULL)
+			return B_NO_MEMORY;
+		fList.push_back(bitmapEntry);
+	}
+	return B_OK;
+}
+
+
+status_t
+FramesList::_OpenSpool()
+{
+	FrameSpool* spool = fSpool;
+	if (spool == NULL) {
+		spool = new (std::nothrow) FrameSpool();
+		if (spool == NULL)
+			return B_NO_MEMORY;
+	}
+
+	status_t status = spool->Open(Path());
+	if (status != B_OK) {
+		std::cerr << "FramesList::AddItemsFromDisk(): cannot open spool: ";
+		std::cerr << ::strerror(status) << std::endl;
+		if (spool != fSpool)
+			delete spool;
+		return status;
+	}
+
+	return AddItemsFromSpool(spool);
+}
+
+
+status_t
+FramesList::_AddItemsFromDirectory()
 {
 	BDirectory dir(Path());
 	BEntry entry;
@@ -115,6 +181,13 @@ FramesList::Pop()
 }
 
 
+void
+FramesList::AddItem(BitmapEntry* entry)
+{
+	fList.push_back(entry);
+}
+
+
 BitmapEntry*
 FramesList::FirstItem() const
 {
@@ -178,13 +251,27 @@ FramesList::WriteFrames(const char* path)
 BitmapEntry::BitmapEntry(const BString& fileName, bigtime_t time)
 	:
 	fFileName(fileName),
-	fFrameTime(time)
+	fSpool(NULL),
+	fIndex(-1),
+	fFrameTime(time),
+	fChanged(false)
+{
+}
+
+
+BitmapEntry::BitmapEntry(FrameSpool* spool, int32 index, bigtime_t time)
+	:
+	fSpool(spool),
+	fIndex(index),
+	fFrameTime(time),
+	fChanged(false)
 {
 }
 
 
 BitmapEntry::~BitmapEntry()
 {
+	// Spooled frames are deleted all together with the spool
 	if (fFileName != "")
 		BEntry(fFileName).Remove();
 }
@@ -193,26 +280,39 @@ BitmapEntry::~BitmapEntry()
 BBitmap*
 BitmapEntry::Bitmap()
 {
+	if (fSpool != NULL)
+		return fSpool->ReadBitmap(fIndex);
 	if (fFileName == "")
 		return NULL;
 	return BTranslationUtils::GetBitmapFile(fFileName);
 }
 
 
+bigtime_t
+BitmapEntry::TimeStamp() const
+{
+	return fFrameTime;
+}
+
+
 void
-BitmapEntry::Replace(BBitmap* bitmap)
+BitmapEntry::SetTimeStamp(bigtime_t time)
 {
-	if (fFileName != "") {
-		FramesList::WriteFrame(bitmap, TimeStamp(), fFileName);
-		delete bitmap;
-	}
+	fFrameTime = time;
 }
 
 
-bigtime_t
-BitmapEntry::TimeStamp() const
+bool
+BitmapEntry::IsDuplicate() const
 {
-	return fFrameTime;
+	return !fChanged && fSpool != NULL && fSpool->IsDuplicate(fIndex);
+}
+
+
+void
+BitmapEntry::MarkChanged()
+{
+	fChanged = true;
 }
 
 
@@ -230,32 +330,31 @@ FramesList::WriteFrame(BBitmap* bitmap, bigtime_t frameTime, const BString& file
 		return B_NO_MEMORY;
 	}
 
-	BBitmap *tempBitmap = new (std::nothrow) BBitmap(*bitmap);
-	if (tempBitmap == NULL) {
-		std::cerr << "BitmapEntry::WriteFrame(): cannot create bitmap" << std::endl;
-		return B_NO_MEMORY;
-	}
-
-	BBitmapStream bitmapStream(tempBitmap);
+	// BBitmapStream takes ownership of the bitmap: we detach it
+	// before the stream goes away, so there's no need to copy it
+	BBitmapStream bitmapStream(bitmap);
 	translator_info translatorInfo;
 	status_t status = sTranslatorRoster->Identify(&bitmapStream, NULL,
 			&translatorInfo, 0, NULL, kBitmapFormat);
-	if (status != B_OK) {
+	if (status != B_OK)
 		std::cerr << "BitmapEntry::WriteFrame(): cannot identify bitmap stream: " << ::strerror(status) << std::endl;
-		return status;
-	}
 
 	BFile outFile;
-	status = outFile.SetTo(fileName.String(), B_WRITE_ONLY|B_CREATE_FILE);
-	if (status != B_OK) {
-		std::cerr << "BitmapEntry::WriteFrame(): cannot create file" << ::strerror(status) << std::endl;
-		return status;
+	if (status == B_OK) {
+		status = outFile.SetTo(fileName.String(), B_WRITE_ONLY|B_CREATE_FILE);
+		if (status != B_OK)
+			std::cerr << "BitmapEntry::WriteFrame(): cannot create file" << ::strerror(status) << std::endl;
 	}
 
-	status = sTranslatorRoster->Translate(&bitmapStream,
-		&translatorInfo, NULL, &outFile, kBitmapFormat);
-	if (status != B_OK)
-		std::cerr << "BitmapEntry::WriteFrame(): cannot translate bitmap: " << ::strerror(status) << std::endl;
+	if (status == B_OK) {
+		status = sTranslatorRoster->Translate(&bitmapStream,
+			&translatorInfo, NULL, &outFile, kBitmapFormat);
+		if (status != B_OK)
+			std::cerr << "BitmapEntry::WriteFrame(): cannot translate bitmap: " << ::strerror(status) << std::endl;
+	}
+
+	BBitmap* detached = NULL;
+	bitmapStream.DetachBitmap(&detached);
 
 	return status;
 }
@@ -12,19 +12,29 @@
 #include <list>
 
 class BBitmap;
+class FrameSpool;
 class BitmapEntry {
 public:
 	BitmapEntry(const BString& fileName, bigtime_t time);
+	BitmapEntry(FrameSpool* spool, int32 index, bigtime_t time);
 	BitmapEntry(BitmapEntry*);
 	BitmapEntry(const BitmapEntry&);
 	~BitmapEntry();
 
 	BBitmap* Bitmap();
-	void Replace(BBitmap* bitmap);
 	bigtime_t TimeStamp() const;
+	void SetTimeStamp(bigtime_t time);
+	// True if the frame is the same as the one before it
+	bool IsDuplicate() const;
+	// The frame before it went away, and it could be different
+	// from the one before that
+	void MarkChanged();
 private:
 	BString fFileName;
+	FrameSpool* fSpool;
+	int32 fIndex;
 	bigtime_t fFrameTime;
+	bool fChanged;
 };
 
 
@@ -41,8 +51,14 @@ public:
 	static status_t DeleteTempPath();
 
 	status_t AddItemsFromDisk();
+	// The spool must be ready for reading. Unless B_BAD_VALUE or
+	// B_NOT_ALLOWED (a list only holds one spool) are returned,
+	// the list takes ownership of it.
+	status_t AddItemsFromSpool(FrameSpool* spool);
 
 	BitmapEntry* Pop();
+	// Entries must be added in time order
+	void AddItem(BitmapEntry* entry);
 	BitmapEntry* LastItem() const;
 	BitmapEntry* FirstItem() const;
 	const bitmap_list* List() const;
@@ -52,9 +68,13 @@ public:
 	status_t WriteFrames(const char* path);
 	static status_t WriteFrame(BBitmap* bitmap, bigtime_t frameTime, const BString& fileName);
 private:
+	status_t _OpenSpool();
+	status_t _AddItemsFromDirectory();
+
 	static char* sTemporaryPath;
 
 	bitmap_list fList;
+	FrameSpool* fSpool;
 };
 
 
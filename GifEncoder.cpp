@@ -0,0 +1,925 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "GifEncoder.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+
+// The colors are counted with 5 bits per channel
+const static int32 kHistogramSize = 1 << 15;
+const static int32 kMaxCodeBits = 12;
+// Prime, and about twice the number of LZW codes
+const static int32 kHashSize = 8191;
+
+// Ordered dithering offsets, a bit less than the histogram step
+const static int8 kBayer[4][4] = {
+	{ -7,  1, -5,  3 },
+	{  5, -3,  7, -1 },
+	{ -4,  4, -6,  2 },
+	{  8,  0,  6, -2 }
+};
+
+
+struct GifEncoder::gif_palette {
+	// Red, green, blue
+	uint8	colors[256 * 3];
+	int32	count;
+	// Every color of the frame got an entry of its own:
+	// there's nothing to dither
+	bool	exact;
+	// For the nearest color search: red and green interleaved,
+	// and blue with zeros, up to a multiple of 4 entries
+	int16	redGreen[2 * 256];
+	int16	blue[2 * 256];
+};
+
+
+struct GifEncoder::gif_image {
+	int32	left;
+	int32	top;
+	int32	width;
+	int32	height;
+	// Nothing changed since the previous frame
+	bool	empty;
+	// -1 when there's none
+	int32	transparentIndex;
+	int32	paletteBits;
+	// Empty with the global palette
+	std::vector<uint8> palette;
+	// LZW minimum code size, then the data sub-blocks.
+	// Allocated for the worst case.
+	std::vector<uint8> data;
+	size_t	dataSize;
+};
+
+
+struct GifEncoder::gif_frame {
+	// B_RGB32, with the alpha channel set
+	std::vector<uint8>	pixels;
+	int32				index;
+	bigtime_t			time;
+	gif_image			image;
+	gif_palette			palette;
+
+	// Count, then the sums of blue, green and red, of every color
+	std::vector<uint32>	histogram;
+	// Palette entry of every histogram color, or -1
+	std::vector<int16>	cache;
+	std::vector<uint8>	indices;
+	std::vector<int32>	lzwKeys;
+	std::vector<int16>	lzwCodes;
+};
+
+
+struct color_bin {
+	uint8	color[3];
+	uint32	count;
+};
+
+
+// Orders the bins by one channel
+struct bin_compare {
+	bin_compare(int32 channel) : fChannel(channel) {}
+	bool operator()(const color_bin& a, const color_bin& b) const
+	{
+		return a.color[fChannel] < b.color[fChannel];
+	}
+	int32 fChannel;
+};
+
+
+struct color_box {
+	int32	begin;
+	int32	end;
+	uint32	count;
+	// Widest channel, and how much the box is worth splitting
+	int32	channel;
+	uint64	score;
+};
+
+
+static inline int32
+HistogramIndex(int32 red, int32 green, int32 blue)
+{
+	return ((red >> 3) << 10) | ((green >> 3) << 5) | (blue >> 3);
+}
+
+
+static inline uint32
+Pixel(const uint8* pixels)
+{
+	uint32 pixel;
+	::memcpy(&pixel, pixels, sizeof(pixel));
+	return pixel;
+}
+
+
+// Worst case: one code for every pixel, and a clear code every
+// time the table is full
+static size_t
+LZWBound(size_t pixels)
+{
+	const size_t codes = pixels + pixels / 1024 + 3;
+	const size_t bytes = (codes * kMaxCodeBits + 7) / 8;
+	return 1 + bytes + bytes / 255 + 2;
+}
+
+
+static void
+AddColors(const uint8* pixels, int32 bytesPerRow, const uint8* previous,
+	int32 left, int32 top, int32 width, int32 height, uint32* histogram)
+{
+	for (int32 y = top; y < top + height; y++) {
+		const uint8* pixel = pixels + y * bytesPerRow + left * 4;
+		const uint8* old = previous != NULL
+			? previous + y * bytesPerRow + left * 4 : NULL;
+		for (int32 x = 0; x < width; x++, pixel += 4) {
+			// Only the pixels which will be drawn count
+			if (old != NULL) {
+				const bool same = Pixel(pixel) == Pixel(old);
+				old += 4;
+				if (same)
+					continue;
+			}
+			uint32* bin = histogram
+				+ 4 * HistogramIndex(pixel[2], pixel[1], pixel[0]);
+			bin[0]++;
+			bin[1] += pixel[0];
+			bin[2] += pixel[1];
+			bin[3] += pixel[2];
+		}
+	}
+}
+
+
+static void
+MeasureBox(color_box& box, const color_bin* bins)
+{
+	uint8 low[3] = { 255, 255, 255 };
+	uint8 high[3] = { 0, 0, 0 };
+	for (int32 i = box.begin; i < box.end; i++) {
+		for (int32 c = 0; c < 3; c++) {
+			low[c] = std::min(low[c], bins[i].color[c]);
+			high[c] = std::max(high[c], bins[i].color[c]);
+		}
+	}
+	box.channel = 0;
+	for (int32 c = 1; c < 3; c++) {
+		if (high[c] - low[c] > high[box.channel] - low[box.channel])
+			box.channel = c;
+	}
+	box.score = uint64(box.count) * (high[box.channel] - low[box.channel]);
+}
+
+
+static void
+SetPaletteColor(uint8* color, const color_bin* bins, int32 begin, int32 end)
+{
+	uint64 sums[3] = { 0, 0, 0 };
+	uint64 count = 0;
+	for (int32 i = begin; i < end; i++) {
+		for (int32 c = 0; c < 3; c++)
+			sums[c] += uint64(bins[i].color[c]) * bins[i].count;
+		count += bins[i].count;
+	}
+	for (int32 c = 0; c < 3; c++)
+		color[c] = count > 0 ? (sums[c] + count / 2) / count : 0;
+}
+
+
+// Median cut: the box with the most pixels times the widest range is
+// split in two, at the median of its widest channel, until there are
+// enough boxes.
+static void
+BuildPalette(const uint32* histogram, int32 maxColors, uint8* colors,
+	int32& count, bool& exact, std::vector<color_bin>& bins)
+{
+	bins.clear();
+	for (int32 i = 0; i < kHistogramSize; i++) {
+		const uint32* bin = histogram + 4 * i;
+		if (bin[0] == 0)
+			continue;
+		color_bin colorBin;
+		// Red, green, blue, like the palette
+		for (int32 c = 0; c < 3; c++)
+			colorBin.color[c] = (bin[3 - c] + bin[0] / 2) / bin[0];
+		colorBin.count = bin[0];
+		bins.push_back(colorBin);
+	}
+
+	exact = (int32)bins.size() <= maxColors;
+	if (exact) {
+		count = bins.size();
+		for (int32 i = 0; i < count; i++)
+			::memcpy(colors + i * 3, bins[i].color, 3);
+		return;
+	}
+
+	std::vector<color_box> boxes;
+	boxes.reserve(maxColors);
+	color_box all = { 0, (int32)bins.size(), 0, 0, 0 };
+	for (size_t i = 0; i < bins.size(); i++)
+		all.count += bins[i].count;
+	MeasureBox(all, &bins[0]);
+	boxes.push_back(all);
+
+	while ((int32)boxes.size() < maxColors) {
+		int32 best = -1;
+		uint64 bestScore = 0;
+		for (size_t b = 0; b < boxes.size(); b++) {
+			if (boxes[b].score > bestScore) {
+				best = b;
+				bestScore = boxes[b].score;
+			}
+		}
+		if (best < 0)
+			break;
+
+		color_box& box = boxes[best];
+		std::sort(bins.begin() + box.begin, bins.begin() + box.end,
+			bin_compare(box.channel));
+		uint32 half = 0;
+		int32 split = box.begin;
+		while (split < box.end - 1 && half + bins[split].count <= box.count / 2)
+			half += bins[split++].count;
+		if (split == box.begin)
+			half += bins[split++].count;
+
+		color_box upper = { split, box.end, box.count - half, 0, 0 };
+		box.end = split;
+		box.count = half;
+		MeasureBox(box, &bins[0]);
+		MeasureBox(upper, &bins[0]);
+		boxes.push_back(upper);
+	}
+
+	count = boxes.size();
+	for (int32 i = 0; i < count; i++)
+		SetPaletteColor(colors + i * 3, &bins[0], boxes[i].begin, boxes[i].end);
+}
+
+
+static void
+PrepareSearch(uint8* colors, int32 count, int16* redGreen, int16* blue)
+{
+	const int32 padded = (count + 3) & ~3;
+	for (int32 i = 0; i < padded; i++) {
+		// Far away from any real color
+		int16 red = 1024, green = 1024, blueValue = 1024;
+		if (i < count) {
+			red = colors[i * 3];
+			green = colors[i * 3 + 1];
+			blueValue = colors[i * 3 + 2];
+		}
+		redGreen[i * 2] = red;
+		redGreen[i * 2 + 1] = green;
+		blue[i * 2] = blueValue;
+		blue[i * 2 + 1] = 0;
+	}
+}
+
+
+static int32
+NearestColor(const int16* redGreen, const int16* blue, int32 count,
+	int32 red, int32 green, int32 blueValue)
+{
+	int32 best = 0;
+#if defined(__SSE2__)
+	// Four palette entries at a time: the squares of the red and green
+	// differences are added by the multiply, then the blue ones
+	const __m128i color = _mm_set_epi16(green, red, green, red,
+		green, red, green, red);
+	const __m128i blueColor = _mm_set_epi16(0, blueValue, 0, blueValue,
+		0, blueValue, 0, blueValue);
+	__m128i bestDistance = _mm_set1_epi32(0x7fffffff);
+	__m128i bestIndex = _mm_setzero_si128();
+	__m128i index = _mm_set_epi32(3, 2, 1, 0);
+	const __m128i four = _mm_set1_epi32(4);
+	for (int32 i = 0; i < count; i += 4) {
+		__m128i rg = _mm_sub_epi16(_mm_loadu_si128(
+			(const __m128i*)(redGreen + i * 2)), color);
+		__m128i b = _mm_sub_epi16(_mm_loadu_si128(
+			(const __m128i*)(blue + i * 2)), blueColor);
+		__m128i distance = _mm_add_epi32(_mm_madd_epi16(rg, rg),
+			_mm_madd_epi16(b, b));
+		__m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+		bestDistance = _mm_or_si128(_mm_and_si128(closer, distance),
+			_mm_andnot_si128(closer, bestDistance));
+		bestIndex = _mm_or_si128(_mm_and_si128(closer, index),
+			_mm_andnot_si128(closer, bestIndex));
+		index = _mm_add_epi32(index, four);
+	}
+	int32 distances[4];
+	int32 indices[4];
+	_mm_storeu_si128((__m128i*)distances, bestDistance);
+	_mm_storeu_si128((__m128i*)indices, bestIndex);
+	int32 bestValue = distances[0];
+	best = indices[0];
+	for (int32 i = 1; i < 4; i++) {
+		if (distances[i] < bestValue
+			|| (distances[i] == bestValue && indices[i] < best)) {
+			bestValue = distances[i];
+			best = indices[i];
+		}
+	}
+#else
+	int32 bestValue = 0x7fffffff;
+	for (int32 i = 0; i < count; i++) {
+		const int32 dr = redGreen[i * 2] - red;
+		const int32 dg = redGreen[i * 2 + 1] - green;
+		const int32 db = blue[i * 2] - blueValue;
+		const int32 distance = dr * dr + dg * dg + db * db;
+		if (distance < bestValue) {
+			bestValue = distance;
+			best = i;
+		}
+	}
+#endif
+	return best;
+}
+
+
+// GIF flavoured LZW. The codes are packed from the least significant bit,
+// in sub-blocks of up to 255 bytes.
+class LZWWriter {
+public:
+	LZWWriter(uint8* output, int32* keys, int16* codes, int32 minCodeSize)
+		:
+		fOutput(output),
+		fSize(0),
+		fBlockStart(0),
+		fBits(0),
+		fBitCount(0),
+		fKeys(keys),
+		fCodes(codes),
+		fMinCodeSize(minCodeSize)
+	{
+		fOutput[fSize++] = minCodeSize;
+		_StartBlock();
+	}
+
+	size_t Compress(const uint8* indices, int32 count)
+	{
+		const int32 clearCode = 1 << fMinCodeSize;
+		_Reset();
+		_Put(clearCode);
+
+		int32 prefix = indices[0];
+		for (int32 i = 1; i < count; i++) {
+			const int32 value = indices[i];
+			const int32 key = (prefix << 8) | value;
+			int32 slot = ((value << 4) ^ prefix) % kHashSize;
+			while (fKeys[slot] >= 0 && fKeys[slot] != key)
+				slot = slot + 1 < kHashSize ? slot + 1 : 0;
+			if (fKeys[slot] == key) {
+				prefix = fCodes[slot];
+				continue;
+			}
+
+			_Put(prefix);
+			if (fNextCode < (1 << kMaxCodeBits)) {
+				fKeys[slot] = key;
+				fCodes[slot] = fNextCode++;
+				// The decoder is one code behind
+				if (fNextCode > (1 << fCodeSize) && fCodeSize < kMaxCodeBits)
+					fCodeSize++;
+			} else {
+				_Put(clearCode);
+				_Reset();
+			}
+			prefix = value;
+		}
+		_Put(prefix);
+		_Put(clearCode + 1);
+
+		if (fBitCount > 0)
+			_PutByte(fBits);
+		_EndBlock();
+		// Terminator
+		if (fSize - fBlockStart > 1)
+			fOutput[fSize++] = 0;
+		else
+			fOutput[fBlockStart] = 0;
+		return fSize;
+	}
+
+private:
+	void _Reset()
+	{
+		for (int32 i = 0; i < kHashSize; i++)
+			fKeys[i] = -1;
+		fCodeSize = fMinCodeSize + 1;
+		fNextCode = (1 << fMinCodeSize) + 2;
+	}
+
+	void _Put(int32 code)
+	{
+		fBits |= uint32(code) << fBitCount;
+		fBitCount += fCodeSize;
+		while (fBitCount >= 8) {
+			_PutByte(fBits & 0xff);
+			fBits >>= 8;
+			fBitCount -= 8;
+		}
+	}
+
+	void _PutByte(uint8 value)
+	{
+		fOutput[fSize++] = value;
+		if (fSize - fBlockStart == 256) {
+			_EndBlock();
+			_StartBlock();
+		}
+	}
+
+	void _StartBlock()
+	{
+		fBlockStart = fSize++;
+	}
+
+	void _EndBlock()
+	{
+		fOutput[fBlockStart] = fSize - fBlockStart - 1;
+	}
+
+	uint8*	fOutput;
+	size_t	fSize;
+	size_t	fBlockStart;
+	uint32	fBits;
+	int32	fBitCount;
+	int32*	fKeys;
+	int16*	fCodes;
+	int32	fMinCodeSize;
+	int32	fCodeSize;
+	int32	fNextCode;
+};
+
+
+GifEncoder::GifEncoder(const char* path, float frameRate, ThreadPool* pool)
+	:
+	fFrameRate(frameRate > 0 ? frameRate : 10),
+	fPool(pool),
+	fPaletteMode(GIF_LOCAL_PALETTES),
+	fDither(true),
+	fWidth(0),
+	fHeight(0),
+	fHeaderWritten(false),
+	fGlobalPalette(NULL),
+	fFrameCount(0),
+	fFramesAdded(0),
+	fPending(NULL),
+	fHasPending(false),
+	fPendingTime(0),
+	fFirstTime(0),
+	fLastTime(0),
+	fInitStatus(B_NO_INIT)
+{
+	fInitStatus = fFile.SetTo(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	if (fInitStatus != B_OK) {
+		std::cerr << "GifEncoder: cannot create " << path << ": ";
+		std::cerr << ::strerror(fInitStatus) << std::endl;
+	}
+}
+
+
+GifEncoder::~GifEncoder()
+{
+	for (size_t i = 0; i < fFrames.size(); i++)
+		delete fFrames[i];
+	delete fPending;
+	delete fGlobalPalette;
+}
+
+
+status_t
+GifEncoder::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+void
+GifEncoder::SetPaletteMode(gif_palette_mode mode)
+{
+	fPaletteMode = mode;
+}
+
+
+void
+GifEncoder::SetDither(bool dither)
+{
+	fDither = dither;
+}
+
+
+status_t
+GifEncoder::AddFrame(const BBitmap* frame, bigtime_t timeStamp)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	const color_space colorSpace = frame->ColorSpace();
+	const int32 width = frame->Bounds().IntegerWidth() + 1;
+	const int32 height = frame->Bounds().IntegerHeight() + 1;
+	if (!IsConvertibleColorSpace(colorSpace))
+		return B_NOT_SUPPORTED;
+
+	if (fFrames.empty()) {
+		if (width > 65535 || height > 65535)
+			return B_BAD_VALUE;
+		fWidth = width;
+		fHeight = height;
+
+		// One frame per thread, after the previous one
+		const int32 count = (fPool != NULL ? fPool->CountThreads() : 1) + 1;
+		const size_t pixels = size_t(width) * height;
+		try {
+			fPending = new gif_image();
+			fPending->data.resize(LZWBound(pixels));
+			fPending->palette.reserve(256 * 3);
+			for (int32 i = 0; i < count; i++) {
+				gif_frame* slot = new gif_frame();
+				fFrames.push_back(slot);
+				slot->pixels.resize(pixels * 4);
+				slot->image.data.resize(LZWBound(pixels));
+				slot->image.palette.reserve(256 * 3);
+				slot->histogram.resize(kHistogramSize * 4);
+				slot->cache.resize(kHistogramSize);
+				slot->indices.resize(pixels);
+				slot->lzwKeys.resize(kHashSize);
+				slot->lzwCodes.resize(kHashSize);
+			}
+		} catch (...) {
+			fInitStatus = B_NO_MEMORY;
+			return fInitStatus;
+		}
+	} else if (width != fWidth || height != fHeight)
+		return B_BAD_VALUE;
+
+	gif_frame* slot = fFrames[fFrameCount + 1];
+	slot->index = fFramesAdded++;
+	slot->time = timeStamp;
+	if (slot->index == 0)
+		fFirstTime = timeStamp;
+	fLastTime = timeStamp;
+	const uint8* bits = (const uint8*)frame->Bits();
+	for (int32 y = 0; y < height; y++) {
+		uint8* row = &slot->pixels[size_t(y) * width * 4];
+		ConvertRowToRGB32(bits + y * frame->BytesPerRow(), row, width,
+			colorSpace);
+		// So pixels can be compared as a whole
+		for (int32 x = 0; x < width; x++)
+			row[x * 4 + 3] = 255;
+	}
+
+	if (++fFrameCount < (int32)fFrames.size() - 1)
+		return B_OK;
+	return _EncodeFrames();
+}
+
+
+status_t
+GifEncoder::Close()
+{
+	status_t status = fInitStatus;
+	if (status == B_OK && fFrameCount > 0)
+		status = _EncodeFrames();
+	if (status == B_OK && !fHeaderWritten)
+		status = _WriteHeader();
+	if (status == B_OK && fHasPending) {
+		// The last frame lasts as long as the average one
+		status = _WriteImage(*fPending, fPendingTime,
+			fLastTime + bigtime_t(1000000 / fFrameRate));
+		fHasPending = false;
+	}
+	if (status == B_OK) {
+		const uint8 trailer = 0x3b;
+		status = _Write(&trailer, 1);
+	}
+	fFile.Unset();
+	if (status != B_OK)
+		fInitStatus = status;
+	return status;
+}
+
+
+status_t
+GifEncoder::_EncodeFrames()
+{
+	if (fPaletteMode == GIF_GLOBAL_PALETTE && fGlobalPalette == NULL) {
+		if (fPool != NULL)
+			fPool->Run(fFrameCount, _HistogramJob, this);
+		else {
+			for (int32 i = 0; i < fFrameCount; i++)
+				_HistogramJob(this, i);
+		}
+
+		fGlobalPalette = new (std::nothrow) gif_palette;
+		if (fGlobalPalette == NULL)
+			return B_NO_MEMORY;
+		std::vector<uint32>& histogram = fFrames[1]->histogram;
+		for (int32 i = 2; i <= fFrameCount; i++) {
+			const std::vector<uint32>& other = fFrames[i]->histogram;
+			for (int32 j = 0; j < kHistogramSize * 4; j++)
+				histogram[j] += other[j];
+		}
+		std::vector<color_bin> bins;
+		try {
+			// One entry is left for the transparent pixels
+			BuildPalette(&histogram[0], 255, fGlobalPalette->colors,
+				fGlobalPalette->count, fGlobalPalette->exact, bins);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		PrepareSearch(fGlobalPalette->colors, fGlobalPalette->count,
+			fGlobalPalette->redGreen, fGlobalPalette->blue);
+	}
+
+	if (!fHeaderWritten) {
+		status_t status = _WriteHeader();
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fPool != NULL)
+		fPool->Run(fFrameCount, _EncodeJob, this);
+	else {
+		for (int32 i = 0; i < fFrameCount; i++)
+			_EncodeJob(this, i);
+	}
+
+	status_t status = B_OK;
+	for (int32 i = 1; i <= fFrameCount && status == B_OK; i++) {
+		gif_frame& frame = *fFrames[i];
+		if (frame.image.empty)
+			continue;
+		if (fHasPending)
+			status = _WriteImage(*fPending, fPendingTime, frame.time);
+		std::swap(*fPending, frame.image);
+		fHasPending = true;
+		fPendingTime = frame.time;
+	}
+
+	// The last frame is the previous one of the next group
+	std::swap(fFrames[0], fFrames[fFrameCount]);
+	fFrameCount = 0;
+	return status;
+}
+
+
+/* static */
+void
+GifEncoder::_HistogramJob(void* cookie, int32 index)
+{
+	GifEncoder* encoder = static_cast<GifEncoder*>(cookie);
+	gif_frame& frame = *encoder->fFrames[index + 1];
+	std::fill(frame.histogram.begin(), frame.histogram.end(), 0);
+	AddColors(&frame.pixels[0], encoder->fWidth * 4, NULL, 0, 0,
+		encoder->fWidth, encoder->fHeight, &frame.histogram[0]);
+}
+
+
+/* static */
+void
+GifEncoder::_EncodeJob(void* cookie, int32 index)
+{
+	GifEncoder* encoder = static_cast<GifEncoder*>(cookie);
+	gif_frame& frame = *encoder->fFrames[index + 1];
+	encoder->_EncodeFrame(frame,
+		frame.index > 0 ? encoder->fFrames[index] : NULL);
+}
+
+
+void
+GifEncoder::_EncodeFrame(gif_frame& frame, const gif_frame* previous)
+{
+	const int32 bytesPerRow = fWidth * 4;
+	const uint8* pixels = &frame.pixels[0];
+	const uint8* old = previous != NULL ? &previous->pixels[0] : NULL;
+	gif_image& image = frame.image;
+
+	// The rectangle which changed
+	int32 top = 0;
+	int32 bottom = fHeight - 1;
+	int32 left = 0;
+	int32 right = fWidth - 1;
+	if (old != NULL) {
+		while (top <= bottom && ::memcmp(pixels + top * bytesPerRow,
+				old + top * bytesPerRow, bytesPerRow) == 0)
+			top++;
+		image.empty = top > bottom;
+		if (image.empty)
+			return;
+		while (::memcmp(pixels + bottom * bytesPerRow,
+				old + bottom * bytesPerRow, bytesPerRow) == 0)
+			bottom--;
+		left = fWidth;
+		right = -1;
+		for (int32 y = top; y <= bottom; y++) {
+			const uint8* row = pixels + y * bytesPerRow;
+			const uint8* oldRow = old + y * bytesPerRow;
+			int32 x = 0;
+			while (x < left && Pixel(row + x * 4) == Pixel(oldRow + x * 4))
+				x++;
+			left = std::min(left, x);
+			x = fWidth - 1;
+			while (x > right && Pixel(row + x * 4) == Pixel(oldRow + x * 4))
+				x--;
+			right = std::max(right, x);
+		}
+	}
+	image.empty = false;
+	image.left = left;
+	image.top = top;
+	image.width = right - left + 1;
+	image.height = bottom - top + 1;
+
+	std::fill(frame.histogram.begin(), frame.histogram.end(), 0);
+	AddColors(pixels, bytesPerRow, old, left, top, image.width, image.height,
+		&frame.histogram[0]);
+
+	const gif_palette* palette = fGlobalPalette;
+	if (palette == NULL) {
+		gif_palette& local = frame.palette;
+		std::vector<color_bin> bins;
+		try {
+			BuildPalette(&frame.histogram[0], old != NULL ? 255 : 256,
+				local.colors, local.count, local.exact, bins);
+		} catch (...) {
+			// Not enough memory for the bins: a gray ramp will do
+			local.count = 256;
+			local.exact = false;
+			for (int32 i = 0; i < 256 * 3; i++)
+				local.colors[i] = i / 3;
+		}
+		PrepareSearch(local.colors, local.count, local.redGreen, local.blue);
+		palette = &local;
+	}
+
+	image.transparentIndex = old != NULL ? palette->count : -1;
+	const int32 entries = palette->count + (old != NULL ? 1 : 0);
+	image.paletteBits = 1;
+	while ((1 << image.paletteBits) < entries)
+		image.paletteBits++;
+	if (palette == fGlobalPalette)
+		image.palette.clear();
+	else {
+		image.palette.assign(palette->colors,
+			palette->colors + palette->count * 3);
+		image.palette.resize(3 << image.paletteBits, 0);
+	}
+
+	// Map the pixels. The nearest palette entry is looked up once for
+	// every histogram color, the one of the pixels in it if there are any.
+	const bool dither = fDither && !palette->exact;
+	std::fill(frame.cache.begin(), frame.cache.end(), -1);
+	uint8* index = &frame.indices[0];
+	for (int32 y = top; y <= bottom; y++) {
+		const uint8* pixel = pixels + y * bytesPerRow + left * 4;
+		const uint8* oldPixel = old != NULL
+			? old + y * bytesPerRow + left * 4 : NULL;
+		for (int32 x = left; x <= right; x++, pixel += 4) {
+			if (oldPixel != NULL) {
+				const bool same = Pixel(pixel) == Pixel(oldPixel);
+				oldPixel += 4;
+				if (same) {
+					*index++ = image.transparentIndex;
+					continue;
+				}
+			}
+			int32 blue = pixel[0];
+			int32 green = pixel[1];
+			int32 red = pixel[2];
+			if (dither) {
+				const int32 offset = kBayer[y & 3][x & 3];
+				blue = std::min(std::max(blue + offset, 0), 255);
+				green = std::min(std::max(green + offset, 0), 255);
+				red = std::min(std::max(red + offset, 0), 255);
+			}
+			const int32 bin = HistogramIndex(red, green, blue);
+			int16& cached = frame.cache[bin];
+			if (cached < 0) {
+				const uint32* counts = &frame.histogram[bin * 4];
+				if (counts[0] > 0) {
+					blue = counts[1] / counts[0];
+					green = counts[2] / counts[0];
+					red = counts[3] / counts[0];
+				} else {
+					blue = (blue & ~7) | 4;
+					green = (green & ~7) | 4;
+					red = (red & ~7) | 4;
+				}
+				cached = NearestColor(palette->redGreen, palette->blue,
+					palette->count, red, green, blue);
+			}
+			*index++ = cached;
+		}
+	}
+
+	LZWWriter writer(&image.data[0], &frame.lzwKeys[0], &frame.lzwCodes[0],
+		std::max(image.paletteBits, int32(2)));
+	image.dataSize = writer.Compress(&frame.indices[0],
+		image.width * image.height);
+}
+
+
+status_t
+GifEncoder::_WriteHeader()
+{
+	uint8 header[13];
+	::memcpy(header, "GIF89a", 6);
+	header[6] = fWidth & 0xff;
+	header[7] = fWidth >> 8;
+	header[8] = fHeight & 0xff;
+	header[9] = fHeight >> 8;
+	header[10] = 0;
+	if (fGlobalPalette != NULL)
+		header[10] = 0x80 | 0x70 | 7;
+	// Background color, aspect ratio
+	header[11] = 0;
+	header[12] = 0;
+	status_t status = _Write(header, sizeof(header));
+
+	if (status == B_OK && fGlobalPalette != NULL) {
+		uint8 colors[256 * 3];
+		::memset(colors, 0, sizeof(colors));
+		::memcpy(colors, fGlobalPalette->colors, fGlobalPalette->count * 3);
+		status = _Write(colors, sizeof(colors));
+	}
+
+	// Loops forever
+	const uint8 loop[19] = { 0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A',
+		'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+	if (status == B_OK)
+		status = _Write(loop, sizeof(loop));
+
+	fHeaderWritten = status == B_OK;
+	return status;
+}
+
+
+// The image shows from "start" to "end"
+status_t
+GifEncoder::_WriteImage(const gif_image& image, bigtime_t start, bigtime_t end)
+{
+	// Hundredths of a second, rounded from the start of the movie
+	// so the rounding errors don't add up
+	const int32 delay = std::min(
+		int32(::llround((end - fFirstTime) / 10000.0))
+			- int32(::llround((start - fFirstTime) / 10000.0)),
+		int32(65535));
+
+	uint8 header[18];
+	// Graphic control: the image stays, and the next one goes over it
+	header[0] = 0x21;
+	header[1] = 0xf9;
+	header[2] = 4;
+	header[3] = (1 << 2) | (image.transparentIndex >= 0 ? 1 : 0);
+	header[4] = delay & 0xff;
+	header[5] = (delay >> 8) & 0xff;
+	header[6] = image.transparentIndex >= 0 ? image.transparentIndex : 0;
+	header[7] = 0;
+	// Image descriptor
+	header[8] = 0x2c;
+	header[9] = image.left & 0xff;
+	header[10] = image.left >> 8;
+	header[11] = image.top & 0xff;
+	header[12] = image.top >> 8;
+	header[13] = image.width & 0xff;
+	header[14] = image.width >> 8;
+	header[15] = image.height & 0xff;
+	header[16] = image.height >> 8;
+	header[17] = image.palette.empty() ? 0 : 0x80 | (image.paletteBits - 1);
+
+	status_t status = _Write(header, sizeof(header));
+	if (status == B_OK && !image.palette.empty())
+		status = _Write(&image.palette[0], image.palette.size());
+	if (status == B_OK)
+		status = _Write(&image.data[0], image.dataSize);
+	return status;
+}
+
+
+status_t
+GifEncoder::_Write(const void* data, size_t size)
+{
+	ssize_t written = fFile.Write(data, size);
+	if (written < 0)
+		return written;
+	return size_t(written) == size ? B_OK : B_IO_ERROR;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __GIFENCODER_H
+#define __GIFENCODER_H
+
+#include <File.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+class BBitmap;
+class ThreadPool;
+
+enum gif_palette_mode {
+	// Every frame gets the colors it needs
+	GIF_LOCAL_PALETTES = 0,
+	// One palette for the whole movie, made from the first frames
+	GIF_GLOBAL_PALETTE
+};
+
+// Writes an animated GIF, without going through the Media Kit.
+// The frames are collected in groups, one frame for every thread of the
+// pool, and the frames of a group are encoded at the same time: palette
+// (median cut), mapping to the palette, optionally with ordered dithering,
+// and LZW compression. Only the rectangle which changed since the previous
+// frame is stored, and the pixels which didn't change in it are left
+// transparent, so the previous frame shows through.
+class GifEncoder {
+public:
+	GifEncoder(const char* path, float frameRate, ThreadPool* pool = NULL);
+	~GifEncoder();
+
+	status_t InitCheck() const;
+
+	// Must be called before the first frame
+	void SetPaletteMode(gif_palette_mode mode);
+	void SetDither(bool dither);
+
+	// The frame is copied, and can be deleted right away.
+	// All the frames must be as big as the first one. The frame
+	// shows until the time stamp of the next one, and the last
+	// one for the time of a frame at "frameRate".
+	status_t AddFrame(const BBitmap* frame, bigtime_t timeStamp);
+	// Encodes the frames left, and ends the file
+	status_t Close();
+
+private:
+	struct gif_palette;
+	struct gif_image;
+	struct gif_frame;
+
+	status_t _EncodeFrames();
+	static void _HistogramJob(void* cookie, int32 index);
+	static void _EncodeJob(void* cookie, int32 index);
+	void _EncodeFrame(gif_frame& frame, const gif_frame* previous);
+	status_t _WriteHeader();
+	status_t _WriteImage(const gif_image& image, bigtime_t start,
+		bigtime_t end);
+	status_t _Write(const void* data, size_t size);
+
+	BFile				fFile;
+	float				fFrameRate;
+	ThreadPool*			fPool;
+	gif_palette_mode	fPaletteMode;
+	bool				fDither;
+
+	int32				fWidth;
+	int32				fHeight;
+	bool				fHeaderWritten;
+	gif_palette*		fGlobalPalette;
+
+	// The first one is the last frame of the previous group
+	std::vector<gif_frame*> fFrames;
+	int32				fFrameCount;
+	int32				fFramesAdded;
+
+	// Written when the next frame with changes comes in, since
+	// the frames without changes only make it last longer
+	gif_image*			fPending;
+	bool				fHasPending;
+	bigtime_t			fPendingTime;
+	bigtime_t			fFirstTime;
+	bigtime_t			fLastTime;
+
+	status_t			fInitStatus;
+
+	GifEncoder(const GifEncoder&);
+	GifEncoder& operator=(const GifEncoder&);
+};
+
+#endif // __GIFENCODER_H
@@ -3,10 +3,13 @@
  * All rights reserved. Distributed under the terms of the MIT license.
  */
 #include "ImageFilter.h"
+#include "FilterChain.h"
 
 #include <Bitmap.h>
 #include <View.h>
 
+#include <new>
+
 ImageFilter::ImageFilter(BRect frame, color_space colorSpace)
 	:
 	fBitmap(NULL),
@@ -44,15 +47,22 @@ ImageFilter::View() const
 
 
 // ImageFilterScale
-ImageFilterScale::ImageFilterScale(BRect frame, color_space colorSpace)
+ImageFilterScale::ImageFilterScale(BRect frame, color_space colorSpace,
+	ThreadPool* pool)
 	:
-	ImageFilter(frame, colorSpace)
+	ImageFilter(frame, colorSpace),
+	fChain(NULL),
+	fPool(pool),
+	fSourceWidth(0),
+	fSourceHeight(0),
+	fSourceColorSpace(B_NO_COLOR_SPACE)
 {
 }
 
 
 ImageFilterScale::~ImageFilterScale()
 {
+	delete fChain;
 }
 
 
@@ -60,6 +70,21 @@ ImageFilterScale::~ImageFilterScale()
 BBitmap*
 ImageFilterScale::ApplyFilter(BBitmap* bitmap)
 {
+	// Already as it should be
+	if (bitmap != NULL
+		&& bitmap->Bounds().IntegerWidth() == Bitmap()->Bounds().IntegerWidth()
+		&& bitmap->Bounds().IntegerHeight() == Bitmap()->Bounds().IntegerHeight()
+		&& bitmap->ColorSpace() == Bitmap()->ColorSpace())
+		return bitmap;
+
+	if (bitmap != NULL) {
+		BBitmap* scaled = _Scale(bitmap);
+		if (scaled != NULL) {
+			delete bitmap;
+			return scaled;
+		}
+	}
+
 	// Draw scaled
 	if (bitmap != NULL) {
 		Bitmap()->Lock();
@@ -72,3 +97,100 @@ ImageFilterScale::ApplyFilter(BBitmap* bitmap)
 
 	return new BBitmap(*Bitmap());
 }
+
+
+status_t
+ImageFilterScale::ApplyFilter(const BBitmap* bitmap, BBitmap* dest)
+{
+	if (bitmap == NULL || dest == NULL)
+		return B_BAD_VALUE;
+	const BRect frame = Bitmap()->Bounds();
+	if (dest->Bounds().IntegerWidth() != frame.IntegerWidth()
+		|| dest->Bounds().IntegerHeight() != frame.IntegerHeight()
+		|| dest->ColorSpace() != Bitmap()->ColorSpace())
+		return B_BAD_VALUE;
+
+	// Already as it should be
+	if (bitmap->Bounds().IntegerWidth() == frame.IntegerWidth()
+		&& bitmap->Bounds().IntegerHeight() == frame.IntegerHeight()
+		&& bitmap->ColorSpace() == dest->ColorSpace())
+		return dest->ImportBits(bitmap);
+
+	FilterChain* chain = _Chain(bitmap);
+	if (chain != NULL) {
+		return chain->Apply(bitmap->Bits(), bitmap->BytesPerRow(),
+			dest->Bits(), dest->BytesPerRow(), fPool);
+	}
+
+	// Draw scaled
+	Bitmap()->Lock();
+	View()->DrawBitmap(bitmap, bitmap->Bounds().OffsetToCopy(B_ORIGIN),
+								View()->Bounds());
+	View()->Sync();
+	Bitmap()->Unlock();
+	return dest->ImportBits(Bitmap());
+}
+
+
+BBitmap*
+ImageFilterScale::_Scale(const BBitmap* bitmap)
+{
+	FilterChain* chain = _Chain(bitmap);
+	if (chain == NULL)
+		return NULL;
+
+	return chain->Apply(bitmap, fPool);
+}
+
+
+// The chain which scales and converts frames like "bitmap", or NULL if
+// it can't
+FilterChain*
+ImageFilterScale::_Chain(const BBitmap* bitmap)
+{
+	const int32 sourceWidth = bitmap->Bounds().IntegerWidth() + 1;
+	const int32 sourceHeight = bitmap->Bounds().IntegerHeight() + 1;
+	const color_space sourceColorSpace = bitmap->ColorSpace();
+	if (sourceWidth != fSourceWidth || sourceHeight != fSourceHeight
+		|| sourceColorSpace != fSourceColorSpace) {
+		// Don't try again for every frame, if the chain can't do it
+		delete fChain;
+		fChain = NULL;
+		fSourceWidth = sourceWidth;
+		fSourceHeight = sourceHeight;
+		fSourceColorSpace = sourceColorSpace;
+
+		const BRect destFrame = Bitmap()->Bounds();
+		const int32 destWidth = destFrame.IntegerWidth() + 1;
+		const int32 destHeight = destFrame.IntegerHeight() + 1;
+		// Averaging all the pixels when reducing avoids aliasing
+		scale_filter filter = destWidth <= sourceWidth
+			&& destHeight <= sourceHeight ? B_SCALE_BOX : B_SCALE_BILINEAR;
+		if (!Scaler::IsSupported(sourceColorSpace, filter))
+			filter = B_SCALE_NEAREST;
+
+		FilterChain* chain = new (std::nothrow) FilterChain;
+		if (chain == NULL)
+			return NULL;
+		// Only converting the color space, at 100%
+		status_t status = B_OK;
+		if (destWidth != sourceWidth || destHeight != sourceHeight) {
+			status = chain->AddFilter(
+				new (std::nothrow) ScaleFilter(destWidth, destHeight, filter));
+		}
+		if (status == B_OK && sourceColorSpace != Bitmap()->ColorSpace()) {
+			status = chain->AddFilter(
+				new (std::nothrow) ColorConvertFilter(Bitmap()->ColorSpace()));
+		}
+		if (status == B_OK)
+			status = chain->Configure(sourceWidth, sourceHeight, sourceColorSpace);
+		if (status != B_OK) {
+			delete chain;
+			return NULL;
+		}
+
+		fChain = chain;
+	}
+
+	return fChain;
+}
@@ -11,6 +11,8 @@
 
 class BBitmap;
 class BView;
+class FilterChain;
+class ThreadPool;
 class ImageFilter {
 public:
 	ImageFilter(BRect frame, color_space colorSpace);
@@ -35,10 +37,27 @@ private:
 
 class ImageFilterScale : public ImageFilter {
 public:
-	ImageFilterScale(BRect frame, color_space colorSpace);
+	// The bands of every frame are split among the threads of "pool",
+	// if given
+	ImageFilterScale(BRect frame, color_space colorSpace,
+		ThreadPool* pool = NULL);
 	virtual ~ImageFilterScale();
 
 	virtual BBitmap* ApplyFilter(BBitmap* bitmap);
+	// Leaves "bitmap" alone, and writes the result into "dest", which
+	// must have the frame and the color space of the filter
+	status_t ApplyFilter(const BBitmap* bitmap, BBitmap* dest);
+
+private:
+	BBitmap* _Scale(const BBitmap* bitmap);
+	FilterChain* _Chain(const BBitmap* bitmap);
+
+	// Used instead of app_server for the color spaces it supports
+	FilterChain* fChain;
+	ThreadPool* fPool;
+	int32 fSourceWidth;
+	int32 fSourceHeight;
+	color_space fSourceColorSpace;
 };
 
 #endif // IMAGEFILTER_H
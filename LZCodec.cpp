@@ -0,0 +1,236 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LZCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+const static size_t kMinMatch = 4;
+// The format requires the last bytes to be literals,
+// and the last match to start a bit earlier
+const static size_t kLastLiterals = 5;
+const static size_t kMatchFindLimit = 12;
+const static size_t kMaxOffset = 65535;
+// At level 1, the search step grows by one every 64 failed attempts
+const static uint32 kSkipTrigger = 6;
+const static int32 kMaxHashLog = 13;
+
+
+static inline uint32
+Read32(const uint8* data)
+{
+	uint32 value;
+	::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+static inline uint32
+Hash(uint32 sequence, int32 hashLog)
+{
+	return (sequence * 2654435761U) >> (32 - hashLog);
+}
+
+
+static inline size_t
+CountMatch(const uint8* a, const uint8* b, const uint8* limit)
+{
+	const uint8* start = a;
+	while (a + sizeof(uint64) <= limit) {
+		uint64 x;
+		uint64 y;
+		::memcpy(&x, a, sizeof(x));
+		::memcpy(&y, b, sizeof(y));
+		if (x != y) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return a - start + __builtin_ctzll(x ^ y) / 8;
+#else
+			break;
+#endif
+		}
+		a += sizeof(uint64);
+		b += sizeof(uint64);
+	}
+	while (a < limit && *a == *b) {
+		a++;
+		b++;
+	}
+	return a - start;
+}
+
+
+static inline uint8*
+WriteLength(uint8* out, size_t length)
+{
+	// The token holds the first 15
+	length -= 15;
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = uint8(length);
+	return out;
+}
+
+
+static inline uint8*
+WriteLiterals(uint8* out, uint8* token, const uint8* literals, size_t length)
+{
+	if (length >= 15) {
+		*token = 15 << 4;
+		out = WriteLength(out, length);
+	} else
+		*token = uint8(length << 4);
+	::memcpy(out, literals, length);
+	return out + length;
+}
+
+
+size_t
+LZCompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+
+size_t
+LZCompress(const uint8* source, size_t size, uint8* dest, int32 level)
+{
+	const int32 hashLog = level >= kLZBestLevel ? kMaxHashLog : kMaxHashLog - 1;
+	// Positions of the last occurrence of every hashed 4 byte sequence
+	uint32 table[1 << kMaxHashLog];
+	::memset(table, 0, sizeof(uint32) << hashLog);
+
+	const uint8* input = source;
+	const uint8* anchor = source;
+	const uint8* end = source + size;
+	uint8* out = dest;
+
+	if (size > kMatchFindLimit) {
+		const uint8* matchFindLimit = end - kMatchFindLimit;
+		const uint8* matchLimit = end - kLastLiterals;
+		input++;
+		bool done = false;
+		while (!done) {
+			// Find a match
+			const uint8* match = NULL;
+			uint32 attempts = 1 << kSkipTrigger;
+			while (input <= matchFindLimit) {
+				const uint32 sequence = Read32(input);
+				const uint32 hash = Hash(sequence, hashLog);
+				match = source + table[hash];
+				table[hash] = input - source;
+				if (match < input && size_t(input - match) <= kMaxOffset
+					&& Read32(match) == sequence)
+					break;
+				if (level >= kLZBestLevel)
+					input++;
+				else
+					input += attempts++ >> kSkipTrigger;
+			}
+			if (input > matchFindLimit)
+				break;
+
+			// The match could start before
+			while (input > anchor && match > source && input[-1] == match[-1]) {
+				input--;
+				match--;
+			}
+
+			const size_t matchLength = kMinMatch
+				+ CountMatch(input + kMinMatch, match + kMinMatch, matchLimit);
+			uint8* token = out++;
+			out = WriteLiterals(out, token, anchor, input - anchor);
+			const size_t offset = input - match;
+			*out++ = uint8(offset);
+			*out++ = uint8(offset >> 8);
+			if (matchLength - kMinMatch >= 15) {
+				*token |= 15;
+				out = WriteLength(out, matchLength - kMinMatch);
+			} else
+				*token |= uint8(matchLength - kMinMatch);
+
+			input += matchLength;
+			anchor = input;
+			if (input > matchFindLimit)
+				done = true;
+			else
+				table[Hash(Read32(input - 2), hashLog)] = input - 2 - source;
+		}
+	}
+
+	// Whatever is left goes as literals
+	uint8* token = out++;
+	out = WriteLiterals(out, token, anchor, end - anchor);
+	return out - dest;
+}
+
+
+status_t
+LZDecompress(const uint8* source, size_t size, uint8* dest, size_t destSize)
+{
+	const uint8* input = source;
+	const uint8* inputEnd = source + size;
+	uint8* out = dest;
+	uint8* outEnd = dest + destSize;
+
+	while (input < inputEnd) {
+		const uint8 token = *input++;
+
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			uint8 byte;
+			do {
+				if (input >= inputEnd)
+					return B_BAD_DATA;
+				byte = *input++;
+				literals += byte;
+			} while (byte == 255);
+		}
+		if (literals > size_t(inputEnd - input)
+			|| literals > size_t(outEnd - out))
+			return B_BAD_DATA;
+		::memcpy(out, input, literals);
+		out += literals;
+		input += literals;
+
+		// The last sequence has no match
+		if (input == inputEnd)
+			break;
+
+		if (inputEnd - input < 2)
+			return B_BAD_DATA;
+		const size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > size_t(out - dest))
+			return B_BAD_DATA;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			uint8 byte;
+			do {
+				if (input >= inputEnd)
+					return B_BAD_DATA;
+				byte = *input++;
+				matchLength += byte;
+			} while (byte == 255);
+		}
+		matchLength += kMinMatch;
+		if (matchLength > size_t(outEnd - out))
+			return B_BAD_DATA;
+
+		// Source and destination overlap when the offset is shorter
+		// than the match: copy one period at a time
+		const uint8* match = out - offset;
+		for (size_t copied = 0; copied < matchLength; copied += offset) {
+			::memcpy(out + copied, match + copied,
+				std::min(offset, matchLength - copied));
+		}
+		out += matchLength;
+	}
+
+	return out == outEnd ? B_OK : B_BAD_DATA;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __LZCODEC_H
+#define __LZCODEC_H
+
+#include <SupportDefs.h>
+
+// Fast lossless LZ77 compressor, using the LZ4 block format:
+// sequences of a token (literal length, match length), the literals,
+// a 16 bit match offset and the match length extension.
+// Level 1 is the fastest, and skips ahead quickly on data which doesn't
+// compress. Level 2 uses a bigger table and looks at every position.
+
+const int32 kLZFastLevel = 1;
+const int32 kLZBestLevel = 2;
+
+size_t LZCompressBound(size_t size);
+
+// Returns the compressed size
+size_t LZCompress(const uint8* source, size_t size, uint8* dest,
+	int32 level);
+
+// The decompressed data must be exactly "destSize" bytes long
+status_t LZDecompress(const uint8* source, size_t size, uint8* dest,
+	size_t destSize);
+
+#endif // __LZCODEC_H
@@ -209,12 +209,17 @@ MediaFormatView::_BuildFileFormatsMenu()
 	MediaFileFormatMenuItem* nullItem = new MediaFileFormatMenuItem(nullFormat);
 	menu->AddItem(nullItem);
 
-	// TODO: Maybe Haiku could support this by enabling this in the ffmpeg addon ?
+	media_file_format gifFormat;
+	MakeGIFMediaFileFormat(gifFormat);
+	MediaFileFormatMenuItem* gifItem = new MediaFileFormatMenuItem(gifFormat);
+	menu->AddItem(gifItem);
+
 	if (IsFFMPEGAvailable()) {
-		media_file_format gifFormat;
-		MakeGIFMediaFileFormat(gifFormat);
-		MediaFileFormatMenuItem* gifItem = new MediaFileFormatMenuItem(gifFormat);
-		menu->AddItem(gifItem);
+		for (int32 i = 0; i < CountFFMPEGMediaFileFormats(); i++) {
+			media_file_format ffmpegFormat;
+			MakeFFMPEGMediaFileFormat(i, ffmpegFormat);
+			menu->AddItem(new MediaFileFormatMenuItem(ffmpegFormat));
+		}
 	}
 }
 
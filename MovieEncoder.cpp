@@ -47,27 +47,170 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <Entry.h>
 #include <FindDirectory.h>
 #include <MediaTrack.h>
+#include <String.h>
 #include <View.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
 #include <iostream>
+#include <vector>
 
 #include "Constants.h"
+#include "FrameConverter.h"
+#include "FrameLoader.h"
+#include "FramePool.h"
 #include "FramesList.h"
+#include "GifEncoder.h"
 #include "ImageFilter.h"
+#include "SceneDetector.h"
 #include "Settings.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
+// Frames loaded ahead of the encoder, per loader thread
+const static int32 kLookAheadPerWorker = 2;
+// Shorter movies aren't worth splitting
+const static int32 kMinSegmentFrames = 100;
+// Never above the capture thread, which runs at display priority
+const static int32 kMaxEncoderPriority = B_DISPLAY_PRIORITY - 1;
+
+
+struct encoder_preset_info {
+	const char*	name;
+	// For BMediaTrack::SetQuality()
+	float		quality;
+	// Applied to the key frame settings. Without scene detection,
+	// the frames aren't read again to compare them.
+	float		sceneChangeFactor;
+	float		keyFrameIntervalFactor;
+	// The encoder takes this share of the CPUs
+	int32		threadDivisor;
+	// Added to the encoding thread priority
+	int32		priorityOffset;
+};
+
+static const encoder_preset_info kEncoderPresets[] = {
+	{ "realtime", 0.4f, 0.0f, 1.0f, 2, 2 },
+	{ "balanced", 0.7f, 1.0f, 1.0f, 1, 0 },
+	{ "archival", 1.0f, 0.5f, 0.5f, 1, -5 }
+};
+
+
+struct MovieEncoder::encode_segment {
+	MovieEncoder*	encoder;
+	int32			index;
+	FrameLoader*	loader;
+	movie_track		track;
+	BString			path;
+	media_format	format;
+	thread_id		thread;
+	status_t		status;
+	// Frames of the movie
+	int32			framesWritten;
+	// Where the segment starts in the movie
+	bigtime_t		startTime;
+	// Only the last one makes its last frame last
+	bool			last;
+};
+
+
+static bool
+IsValidFrameRate(float frameRate)
+{
+	return frameRate > 0 && std::isfinite(frameRate);
+}
+
+
+// Slot of the constant frame rate movie nearest to the time stamp
+static int32
+NearestSlot(bigtime_t timeStamp, bigtime_t timeBase, float frameRate)
+{
+	return int32(::llround((timeStamp - timeBase) * double(frameRate)
+		/ 1000000));
+}
+
+
+static bigtime_t
+SlotTime(int32 slot, float frameRate)
+{
+	return bigtime_t(slot * 1000000.0 / frameRate);
+}
+
+
+// At a constant frame rate, a frame goes to the slot nearest to its time
+// stamp: it's repeated to fill the slots left empty before, or dropped if
+// its slot is taken already. Returns how many times it's written.
+static int32
+CountSlots(bigtime_t timeStamp, bigtime_t timeBase, float frameRate,
+	int32 framesWritten)
+{
+	if (framesWritten == 0 || !IsValidFrameRate(frameRate))
+		return 1;
+	return std::max(NearestSlot(timeStamp, timeBase, frameRate) + 1
+		- framesWritten, int32(0));
+}
+
+
+// A segment doesn't start with a frame that a movie in one piece would
+// leave out: one the same as the frame before it, or, at a constant frame
+// rate, one in the same slot. The segments are then timed just like it.
+static bool
+CanStartSegment(const BitmapEntry* previous, const BitmapEntry* entry,
+	bigtime_t timeBase, float frameRate, bool variableFrameRate)
+{
+	if (entry->IsDuplicate())
+		return false;
+	if (variableFrameRate || !IsValidFrameRate(frameRate))
+		return true;
+	return NearestSlot(entry->TimeStamp(), timeBase, frameRate)
+		> NearestSlot(previous->TimeStamp(), timeBase, frameRate);
+}
+
+
+MovieEncoder::movie_track::movie_track()
+	:
+	file(NULL),
+	track(NULL),
+	headerCommitted(false),
+	colorSpace(B_NO_COLOR_SPACE),
+	converter(NULL),
+	converterThreads(1),
+	timeBase(-1),
+	firstSlot(0),
+	skippedTime(-1),
+	detector(NULL)
+{
+}
+
 
 MovieEncoder::MovieEncoder()
 	:
 	fEncoderThread(-1),
 	fKillThread(false),
+	fPriority(B_NORMAL_PRIORITY),
+	fPreset(ENCODER_PRESET_BALANCED),
+	fQuality(-1),
+	fEncodeStartTime(0),
 	fFileList(NULL),
 	fCursorQueue(NULL),
 	fColorSpace(B_NO_COLOR_SPACE),
-	fMediaFile(NULL),
-	fMediaTrack(NULL),
-	fHeaderCommitted(false)
+	fCodecColorSpace(B_NO_COLOR_SPACE),
+	fStreaming(false),
+	fStreamFrameRate(0),
+	fFramesStreamed(0),
+	fLastStreamedTime(-1),
+	fStreamFrame(NULL),
+	fStreamFilter(NULL),
+	fStreamPool(NULL),
+	fVariableFrameRate(false),
+	fFrameRate(0),
+	fPlaybackFrameRate(0),
+	fRetimeRate(0),
+	fRetimeBase(-1),
+	fSegmentFramesLeft(0)
 {
 }
 
@@ -82,8 +225,9 @@ void
 MovieEncoder::DisposeData()
 {
 	// If the movie is still opened, close it; this also flushes all tracks
-	if (fMediaFile != NULL)
+	if (fTrack.file != NULL)
 		_CloseFile();
+	_DisposeStream();
 
 	// Deleting the filelist deletes the files referenced by it
 	// and also the temporary folder
@@ -103,6 +247,19 @@ MovieEncoder::Cancel()
 }
 
 
+// Takes ownership of the list. Without a source, the encoder
+// picks up the frames from disk.
+status_t
+MovieEncoder::SetSource(FramesList* fileList)
+{
+	if (fileList != fFileList) {
+		delete fFileList;
+		fFileList = fileList;
+	}
+	return B_OK;
+}
+
+
 status_t
 MovieEncoder::SetOutputFile(const char* fileName)
 {
@@ -135,13 +292,66 @@ MovieEncoder::SetColorSpace(const color_space& space)
 }
 
 
+void
+MovieEncoder::SetCodecColorSpace(const color_space& space)
+{
+	fCodecColorSpace = space;
+}
+
+
 status_t
 MovieEncoder::SetQuality(const float& quality)
 {
+	if (quality > 1 || (quality < 0 && quality != -1))
+		return B_BAD_VALUE;
+
+	fQuality = quality;
+	return B_OK;
+}
+
+
+status_t
+MovieEncoder::SetThreadPriority(const int32& value)
+{
+	if (value < B_LOWEST_ACTIVE_PRIORITY || value > kMaxEncoderPriority)
+		return B_BAD_VALUE;
+
+	fPriority = value;
+	if (fEncoderThread >= 0)
+		set_thread_priority(fEncoderThread, _ThreadPriority());
 	return B_OK;
 }
 
 
+status_t
+MovieEncoder::SetPreset(encoder_preset preset)
+{
+	if (preset < 0 || preset >= CountPresets())
+		return B_BAD_VALUE;
+
+	fPreset = preset;
+	return SetQuality(kEncoderPresets[preset].quality);
+}
+
+
+/* static */
+int32
+MovieEncoder::CountPresets()
+{
+	return sizeof(kEncoderPresets) / sizeof(kEncoderPresets[0]);
+}
+
+
+/* static */
+const char*
+MovieEncoder::PresetName(encoder_preset preset)
+{
+	if (preset < 0 || preset >= CountPresets())
+		return NULL;
+	return kEncoderPresets[preset].name;
+}
+
+
 status_t
 MovieEncoder::SetCursorQueue(std::queue<BPoint> *queue)
 {
@@ -161,38 +371,41 @@ MovieEncoder::SetMessenger(const BMessenger& messenger)
 }
 
 
-status_t
-MovieEncoder::_CreateFile(
-	const char* path,
-	const media_file_format& mediaFileFormat,
-	const media_format& mediaFormat,
-	const media_codec_info& mediaCodecInfo,
-	float quality)
+// Without codec, the track takes encoded data
+static status_t
+CreateMediaFile(const char* path, const media_file_format& mediaFileFormat,
+	media_format* mediaFormat, const media_codec_info* mediaCodecInfo,
+	float quality, BMediaFile*& mediaFile, BMediaTrack*& mediaTrack)
 {
+	mediaFile = NULL;
+	mediaTrack = NULL;
+
 	entry_ref ref;
 	status_t status = get_ref_for_path(path, &ref);
 	if (status != B_OK) {
-		std::cerr << "MovieEncoder::_CreateFile(";
+		std::cerr << "CreateMediaFile(";
 		std::cerr << path << "): get_ref_for_path() failed: " << ::strerror(status) << std::endl;
 		return status;
 	}
 
-	fMediaFile = new (std::nothrow) BMediaFile(&ref, &mediaFileFormat);
-	if (fMediaFile == NULL)
+	BMediaFile* file = new (std::nothrow) BMediaFile(&ref, &mediaFileFormat);
+	if (file == NULL)
 		return B_NO_MEMORY;
 
-	status = fMediaFile->InitCheck();
+	status = file->InitCheck();
 	if (status == B_OK) {
-		fHeaderCommitted = false;
-
-		// Fix warning since MediaFile::CreateTrack() argument isn't const
-		fMediaTrack = fMediaFile->CreateTrack(const_cast<media_format*>(&mediaFormat), &mediaCodecInfo);
-		if (fMediaTrack == NULL) {
+		BMediaTrack* track = NULL;
+		if (mediaCodecInfo != NULL)
+			track = file->CreateTrack(mediaFormat, mediaCodecInfo);
+		else
+			track = file->CreateTrack(mediaFormat);
+		if (track == NULL) {
 			status = B_ERROR;
 			std::cerr << "BMediaFile::CreateTrack() failed." << std::endl;
 		} else {
 			if (quality >= 0)
-				fMediaTrack->SetQuality(quality);
+				track->SetQuality(quality);
+			mediaTrack = track;
 		}
 	} else {
 		std::cerr << "BMediaFile::InitCheck() failed: " << ::strerror(status) << std::endl;
@@ -200,82 +413,419 @@ MovieEncoder::_CreateFile(
 
 	// clean up if we incurred an error
 	if (status != B_OK) {
-		fHeaderCommitted = false;
-		delete fMediaFile;
-		fMediaFile = NULL;
+		delete file;
+		return status;
 	}
 
+	mediaFile = file;
+	return B_OK;
+}
+
+
+static status_t
+CloseMediaFile(BMediaFile* mediaFile)
+{
+	if (mediaFile == NULL)
+		return B_OK;
+
+	mediaFile->ReleaseAllTracks();
+	status_t status = mediaFile->CloseFile();
+	delete mediaFile;		// deletes the track, too
 	return status;
 }
 
 
 status_t
-MovieEncoder::_WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame)
+MovieEncoder::_CreateFile(
+	const char* path,
+	const media_file_format& mediaFileFormat,
+	const media_format& mediaFormat,
+	const media_codec_info& mediaCodecInfo,
+	float quality)
+{
+	_CloseTrack(fTrack);
+	fTrack.converterThreads = _CountThreads();
+
+	return _CreateTrack(path, mediaFileFormat, mediaFormat, mediaCodecInfo,
+		quality, fTrack);
+}
+
+
+// The codec gets the frames in the color space it works in, if it takes
+// them that way, so that it doesn't have to convert them on its own
+status_t
+MovieEncoder::_CreateTrack(const char* path,
+	const media_file_format& fileFormat, const media_format& format,
+	const media_codec_info& codecInfo, float quality,
+	movie_track& track) const
+{
+	track.colorSpace = format.u.raw_video.display.format;
+	if (fCodecColorSpace != B_NO_COLOR_SPACE
+		&& fCodecColorSpace != track.colorSpace
+		&& FrameConverter::IsSupported(fCodecColorSpace)) {
+		media_format codecFormat = format;
+		codecFormat.u.raw_video.display.format = fCodecColorSpace;
+		codecFormat.u.raw_video.display.bytes_per_row
+			= FrameConverter::BytesPerRow(fCodecColorSpace,
+				format.u.raw_video.display.line_width);
+		if (CreateMediaFile(path, fileFormat, &codecFormat, &codecInfo,
+				quality, track.file, track.track) == B_OK) {
+			track.colorSpace = fCodecColorSpace;
+			return B_OK;
+		}
+		std::cerr << "MovieEncoder::_CreateTrack(): the codec doesn't take ";
+		std::cerr << "its own color space, giving it the frames as they are.";
+		std::cerr << std::endl;
+	}
+
+	// Fix warning since MediaFile::CreateTrack() argument isn't const
+	return CreateMediaFile(path, fileFormat, const_cast<media_format*>(&format),
+		&codecInfo, quality, track.file, track.track);
+}
+
+
+// "time" is the presentation time of the frame in the movie
+status_t
+MovieEncoder::_WriteFrame(movie_track& track, const BBitmap* bitmap,
+	bigtime_t time, bool isKeyFrame, bool unchanged)
 {
 	// NULL is not a valid bitmap pointer
 	if (!bitmap)
 		return B_BAD_VALUE;
 
-	ASSERT((fMediaTrack != NULL));
+	ASSERT((track.track != NULL));
 
 	// okay, it's the right kind of bitmap -- commit the header if necessary, and
 	// write it as one video frame.  We defer committing the header until the first
 	// frame is written in order to allow the client to adjust the image quality at
 	// any time up to actually writing video data.
 	status_t err = B_OK;
-	if (!fHeaderCommitted) {
+	if (!track.headerCommitted) {
 		isKeyFrame = true;
-		err = fMediaFile->CommitHeader();
+		err = track.file->CommitHeader();
 		if (err == B_OK)
-			fHeaderCommitted = true;
+			track.headerCommitted = true;
+	}
+
+	const void* bits = bitmap->Bits();
+	if (err == B_OK && bitmap->ColorSpace() != track.colorSpace) {
+		if (track.converter == NULL) {
+			track.converter = new (std::nothrow) FrameConverter(
+				track.colorSpace, track.converterThreads, _ThreadPriority());
+			if (track.converter == NULL)
+				err = B_NO_MEMORY;
+			else if ((err = track.converter->InitCheck()) != B_OK) {
+				delete track.converter;
+				track.converter = NULL;
+			}
+		}
+		if (err == B_OK) {
+			// A frame which didn't change is only converted once
+			bits = unchanged ? track.converter->LastFrame() : NULL;
+			if (bits == NULL)
+				bits = track.converter->Convert(bitmap);
+			if (bits == NULL)
+				err = B_NOT_SUPPORTED;
+		}
 	}
 
-	if (err == B_OK)
-		err = fMediaTrack->WriteFrames(bitmap->Bits(), 1, isKeyFrame ? B_MEDIA_KEY_FRAME : 0);
+	if (err == B_OK) {
+		media_encode_info info;
+		info.flags = isKeyFrame ? B_MEDIA_KEY_FRAME : 0;
+		info.start_time = time;
+		err = track.track->WriteFrames(bits, 1, &info);
+	}
 
 	return err;
 }
 
 
+// At a variable frame rate, the frames are written at their time stamp,
+// and an unchanged frame only makes the previous one last longer.
+// At a constant frame rate, they're retimed to the frame rate slots.
+// A track which takes over after another one comes with its time base.
 status_t
-MovieEncoder::_CloseFile()
+MovieEncoder::_WriteTimedFrame(movie_track& track, const BBitmap* bitmap,
+	bigtime_t timeStamp, bool duplicate, int32& framesWritten)
 {
-	status_t err = B_OK;
-	if (fMediaFile != NULL) {
-		fMediaFile->ReleaseAllTracks();
-		err = fMediaFile->CloseFile();
+	if (framesWritten == 0) {
+		if (track.timeBase < 0)
+			track.timeBase = timeStamp;
+		track.skippedTime = -1;
+		if (track.detector == NULL)
+			track.detector = _CreateSceneDetector();
+		if (track.detector == NULL)
+			return B_NO_MEMORY;
+	}
+
+	if (fVariableFrameRate) {
+		if (duplicate && framesWritten > 0) {
+			track.skippedTime = timeStamp;
+			return B_OK;
+		}
+		track.skippedTime = -1;
+		status_t status = _WriteFrame(track, bitmap,
+			timeStamp - track.timeBase,
+			track.detector->IsKeyFrame(bitmap, false));
+		if (status == B_OK)
+			framesWritten++;
+		return status;
+	}
+
+	const int32 slot = track.firstSlot + framesWritten;
+	int32 count = CountSlots(timeStamp, track.timeBase, fFrameRate, slot);
+	// A track starts with a frame
+	if (framesWritten == 0)
+		count = std::max(count, int32(1));
+	for (int32 i = 0; i < count; i++) {
+		const bigtime_t time = IsValidFrameRate(fFrameRate)
+			? SlotTime(slot + i, fFrameRate) : timeStamp - track.timeBase;
+		// The copies of a frame are the same as the frame
+		status_t status = _WriteFrame(track, bitmap, time,
+			track.detector->IsKeyFrame(bitmap, duplicate || i > 0),
+			duplicate || i > 0);
+		if (status != B_OK)
+			return status;
+		framesWritten++;
+	}
+	return B_OK;
+}
+
+
+// Writes the last frame again if it was left out as unchanged,
+// so the movie lasts until then
+status_t
+MovieEncoder::_FinishTimedFrames(movie_track& track,
+	const BBitmap* lastFrame, int32& framesWritten)
+{
+	if (track.skippedTime < 0 || lastFrame == NULL)
+		return B_OK;
+
+	status_t status = _WriteFrame(track, lastFrame,
+		track.skippedTime - track.timeBase,
+		track.detector->IsKeyFrame(lastFrame, true), true);
+	if (status == B_OK)
+		framesWritten++;
+	track.skippedTime = -1;
+	return status;
+}
+
+
+// With a playback frame rate, the movie goes at that rate, whatever the
+// timing of the capture. The capture is sampled at the capture frame rate
+// or at the playback frame rate, whichever is lower, and every sample gets
+// a frame of the movie: the movie is faster than the capture when the
+// capture frame rate is the lower one (a time-lapse), and only made
+// constant otherwise.
+void
+MovieEncoder::_SetUpRetiming()
+{
+	const Settings& settings = Settings::Current();
+	int32 captureFrameRate = settings.CaptureFrameRate();
+	if (captureFrameRate <= 0)
+		captureFrameRate = 10;
+	const int32 playbackFrameRate = std::max(settings.PlaybackFrameRate(),
+		int32(0));
+
+	fPlaybackFrameRate = playbackFrameRate;
+	fRetimeRate = std::min(captureFrameRate, playbackFrameRate);
+	fRetimeBase = -1;
+}
+
+
+bool
+MovieEncoder::_IsRetiming() const
+{
+	return IsValidFrameRate(fPlaybackFrameRate);
+}
+
+
+// Time of the movie slot of a captured frame. The first frame
+// starts the movie.
+bigtime_t
+MovieEncoder::_RetimedTime(bigtime_t timeStamp)
+{
+	if (fRetimeBase < 0)
+		fRetimeBase = timeStamp;
+	return fRetimeBase + SlotTime(NearestSlot(timeStamp, fRetimeBase,
+		fRetimeRate), fPlaybackFrameRate);
+}
+
 
-		delete fMediaFile;		// deletes the track, too
-		fMediaFile = NULL;
-		fMediaTrack = NULL;
+// The capture pipeline spools the frames the stream can't take, and
+// streams them later if it catches up: those are in the list too
+void
+MovieEncoder::_SkipStreamedFrames()
+{
+	while (fFileList->CountItems() > 0
+		&& fFileList->FirstItem()->TimeStamp() <= fLastStreamedTime)
+		delete fFileList->Pop();
+}
+
+
+// Keeps the first frame for every slot of the movie, by its time stamp
+// alone, and retimes it to its slot: the frames left out are never read.
+// Slots without a frame are filled by repeating the previous one.
+void
+MovieEncoder::_RetimeFrames()
+{
+	const int32 count = fFileList->CountItems();
+	int32 dropped = 0;
+	int32 lastSlot = -1;
+	bool changed = false;
+	for (int32 i = 0; i < count; i++) {
+		BitmapEntry* entry = fFileList->Pop();
+		const bigtime_t time = _RetimedTime(entry->TimeStamp());
+		const int32 slot = NearestSlot(time, fRetimeBase, fPlaybackFrameRate);
+		if (slot <= lastSlot) {
+			changed = changed || !entry->IsDuplicate();
+			delete entry;
+			dropped++;
+			continue;
+		}
+		// It's only the same as the frame kept before it if
+		// none of the frames in between changed
+		if (changed)
+			entry->MarkChanged();
+		changed = false;
+		entry->SetTimeStamp(time);
+		fFileList->AddItem(entry);
+		lastSlot = slot;
 	}
+
+	std::cout << "Retiming to " << fPlaybackFrameRate << " frames per second";
+	std::cout << " (" << fPlaybackFrameRate / fRetimeRate << "x): ";
+	std::cout << dropped << " of " << count << " frames left out." << std::endl;
+}
+
+
+// Also forgets how the frames were timed
+status_t
+MovieEncoder::_CloseTrack(movie_track& track)
+{
+	status_t err = CloseMediaFile(track.file);
+	delete track.converter;
+	delete track.detector;
+	track = movie_track();
 	return err;
 }
 
 
+status_t
+MovieEncoder::_CloseFile()
+{
+	return _CloseTrack(fTrack);
+}
+
+
+void
+MovieEncoder::_DisposeStream()
+{
+	delete fStreamFrame;
+	fStreamFrame = NULL;
+	delete fStreamFilter;
+	fStreamFilter = NULL;
+	delete fStreamPool;
+	fStreamPool = NULL;
+	fFramesStreamed = 0;
+	fLastStreamedTime = -1;
+	fStreaming = false;
+}
+
+
+// TODO: Improve this: we are using the name of the media format to see if it's a fake format
+bool
+MovieEncoder::_IsRawFormat() const
+{
+	return ::strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0
+		|| ::strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0
+		|| FFMPEGMuxerName(MediaFileFormat()) != NULL;
+}
+
+
+bool
+MovieEncoder::_IsGIFFormat() const
+{
+	return ::strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0;
+}
+
+
+// Key frames go where the content changes, and no further apart than the
+// maximum interval
+SceneDetector*
+MovieEncoder::_CreateSceneDetector() const
+{
+	const Settings& settings = Settings::Current();
+	const encoder_preset_info& preset = kEncoderPresets[fPreset];
+	const int32 threshold = int32(settings.SceneChangeThreshold()
+		* preset.sceneChangeFactor + 0.5f);
+	const int32 interval = std::max(int32(settings.KeyFrameInterval()
+		* preset.keyFrameIntervalFactor + 0.5f), int32(1));
+	return new (std::nothrow) SceneDetector(threshold, interval);
+}
+
+
+// Threads working for the encoder, the encoding thread included
+int32
+MovieEncoder::_CountThreads() const
+{
+	return std::max(ThreadPool::DefaultThreadCount()
+		/ kEncoderPresets[fPreset].threadDivisor, int32(1));
+}
+
+
+// The preset offset can't take it out of the range SetThreadPriority() takes
+int32
+MovieEncoder::_ThreadPriority() const
+{
+	return std::min(std::max(fPriority + kEncoderPresets[fPreset].priorityOffset,
+		int32(B_LOWEST_ACTIVE_PRIORITY)), kMaxEncoderPriority);
+}
+
+
+bool
+MovieEncoder::_IsVariableFrameRate() const
+{
+	return Settings::Current().VariableFrameRate()
+		&& IsVariableFrameRateFormat(MediaFileFormat());
+}
+
+
 // When this is running, no member variable should be accessed
 // from other threads
 status_t
 MovieEncoder::_EncoderThread()
 {
-	fFileList = new FramesList();
-	fFileList->AddItemsFromDisk();
+	fEncodeStartTime = system_time();
+
+	// Frames kept in memory come with their list already
+	if (fFileList == NULL) {
+		fFileList = new FramesList();
+		fFileList->AddItemsFromDisk();
+	}
 
+	// The streamed frames were retimed already, and the frames
+	// left follow them
+	if (fStreaming)
+		_SkipStreamedFrames();
+	else
+		_SetUpRetiming();
+	if (_IsRetiming())
+		_RetimeFrames();
+
+	// When streaming, the frames left are the ones which
+	// didn't make it while capturing: there can be none
 	int32 framesLeft = fFileList->CountItems();
-	if (framesLeft <= 0) {
+	if (framesLeft <= 0 && fFramesStreamed <= 0) {
 		std::cerr << "MovieEncoder::_EncoderThread(): no frames to encode." << std::endl;
 		_HandleEncodingFinished(B_ERROR);
 		return B_ERROR;
 	}
-	status_t status = _ApplyImageFilters();
-	if (status != B_OK) {
-		_HandleEncodingFinished(status);
-		return status;
-	}
+	status_t status = B_OK;
 
 	// If destination frame is not valid (I.E: something went wrong)
 	// then get source frame and use it as dest frame
-	if (!fDestFrame.IsValid()) {
+	if (!fStreaming && !fDestFrame.IsValid()) {
 		std::cerr << "MovieEncoder::_EncoderThread(): invalid destination frame. Getting it from first frame...";
 		std::flush(std::cerr);
 		BBitmap* bitmap = fFileList->FirstItem()->Bitmap();
@@ -291,36 +841,72 @@ MovieEncoder::_EncoderThread()
 		fDestFrame = sourceFrame.OffsetToCopy(B_ORIGIN);
 	}
 
-	// TODO: Improve this: we are using the name of the media format to see if it's a fake format
-	if ((::strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0) ||
-		(::strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0)) {
+	if (_IsGIFFormat())
+		return _WriteGIF();
+	if (FFMPEGMuxerName(fFileFormat) != NULL)
+		return _WriteFFMPEG(FFMPEGMuxerName(fFileFormat));
+	if (_IsRawFormat())
 		return _WriteRawFrames();
-	}
-
-	media_format mediaFormat = fFormat;
-	const BitmapEntry* firstEntry = fFileList->FirstItem();
-	const BitmapEntry* lastEntry = fFileList->LastItem();
-	ASSERT((firstEntry != NULL));
-	ASSERT((lastEntry != NULL));
-	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
-	const float fps = CalculateFPS(framesLeft, diff);
-	std::cout << "Setting up encoder: " << framesLeft << " frames, ";
-	std::cout << fps << " frames per second." << std::endl;
 
-	// Looks like the decimal part is ignored, so we just round
-	mediaFormat.u.raw_video.field_rate = ::roundf(fps);
+	float fps = 0;
+	if (fStreaming) {
+		// The movie was created when the capture started
+		fps = fStreamFrameRate;
+		std::cout << "Finishing the encoding: " << fFramesStreamed;
+		std::cout << " frames streamed, " << framesLeft << " left." << std::endl;
+	} else {
+		media_format mediaFormat = fFormat;
+		const BitmapEntry* firstEntry = fFileList->FirstItem();
+		const BitmapEntry* lastEntry = fFileList->LastItem();
+		ASSERT((firstEntry != NULL));
+		ASSERT((lastEntry != NULL));
+		const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
+		fps = _IsRetiming() ? fPlaybackFrameRate : CalculateFPS(framesLeft, diff);
+		std::cout << "Setting up encoder: " << framesLeft << " frames, ";
+		std::cout << fps << " frames per second." << std::endl;
+
+		// Looks like the decimal part is ignored, so we just round
+		mediaFormat.u.raw_video.field_rate = ::roundf(fps);
+		// The frames are retimed to the rate of the movie
+		fFrameRate = mediaFormat.u.raw_video.field_rate;
+		fVariableFrameRate = !_IsRetiming() && _IsVariableFrameRate();
+
+		const int32 segments = _CountSegments(framesLeft);
+		if (segments > 1) {
+			int32 framesWritten = 0;
+			status = _EncodeSegments(segments, mediaFormat, framesWritten);
+			if (status != B_OK) {
+				std::cerr << "MovieEncoder::_EncoderThread(): encoding in ";
+				std::cerr << "segments failed: " << ::strerror(status) << std::endl;
+			}
+			// The frames are back in the list if they can still be
+			// encoded in one piece
+			if (status == B_OK || status == B_CANCELED
+				|| fFileList->CountItems() != framesLeft) {
+				_HandleEncodingFinished(status, framesWritten);
+				return status;
+			}
+			std::cerr << "Encoding the movie in one piece." << std::endl;
+		}
 
-	// Create movie
-	status = _CreateFile(fOutputFile.Path(), fFileFormat, mediaFormat, fCodecInfo);
-	fTempPath = FramesList::Path();
+		// Create movie
+		status = _CreateFile(fOutputFile.Path(), fFileFormat, mediaFormat,
+			fCodecInfo, fQuality);
+	}
 	if (status != B_OK) {
 		std::cerr << "MovieEncoder::_EncoderThread(): _CreateFile failed with " << ::strerror(status) << std::endl;
 		_HandleEncodingFinished(status);
 		return status;
 	}
 
-	const uint32 keyFrameFrequency = 10;
-	// TODO: Make this tunable
+	FrameLoader* loader = NULL;
+	if (framesLeft > 0) {
+		loader = _CreateFrameLoader();
+		if (loader == NULL) {
+			_HandleEncodingFinished(B_NO_MEMORY);
+			return B_NO_MEMORY;
+		}
+	}
 
 	BMessage initialMessage(kEncodingProgress);
 	initialMessage.AddBool("reset", true);
@@ -328,33 +914,34 @@ MovieEncoder::_EncoderThread()
 	initialMessage.AddString("text", "Encoding...");
 	fMessenger.SendMessage(&initialMessage);
 
-	int32 framesWritten = 0;
+	int32 framesWritten = fFramesStreamed;
+	int32 framesLoaded = 0;
+	BBitmap* frame = NULL;
 	while (!fKillThread && framesLeft > 0) {
-		BitmapEntry* entry = const_cast<FramesList*>(fFileList)->Pop();
-		if (entry == NULL) {
-			status = B_ERROR;
-			break;
+		// Already read and scaled by the loader threads
+		BBitmap* bitmap = NULL;
+		bool duplicate = false;
+		status = loader->NextFrame(bitmap, duplicate);
+
+		// An unchanged frame comes with the previous bitmap,
+		// without reading anything
+		if (!duplicate) {
+			delete frame;
+			frame = bitmap;
 		}
 
-		// Makes a copy of the bitmap
-		BBitmap* frame = entry->Bitmap();
-		delete entry;
-
-		if (frame == NULL) {
+		if (status == B_OK && frame == NULL)
 			status = B_ERROR;
+		if (status != B_OK) {
 			std::cerr << "Error while loading bitmap entry" << std::endl;
 			break;
 		}
 
-		bool keyFrame = (framesWritten % keyFrameFrequency == 0);
-		if (status == B_OK)
-			status = _WriteFrame(frame, framesWritten + 1, keyFrame);
-		delete frame;
-
+		status = _WriteTimedFrame(fTrack, frame,
+			loader->TimeStamp(framesLoaded++), duplicate, framesWritten);
 		if (status != B_OK)
 			break;
 
-		framesWritten++;
 		framesLeft--;
 
 		if (!fMessenger.IsValid()) {
@@ -363,12 +950,17 @@ MovieEncoder::_EncoderThread()
 			break;
 		}
 		BMessage progressMessage(kEncodingProgress);
-		progressMessage.AddInt32("frames_remaining", fFileList->CountItems());
+		progressMessage.AddInt32("frames_remaining", framesLeft);
 		fMessenger.SendMessage(&progressMessage);
 	}
-
 	if (status == B_OK)
-		status = _PostEncodingAction(fTempPath, framesWritten, int32(fps));
+		status = _FinishTimedFrames(fTrack,
+			frame != NULL ? frame : fStreamFrame, framesWritten);
+	delete frame;
+	delete loader;
+
+	if (fTrack.detector != NULL)
+		fTrack.detector->PrintStatistics("Key frames");
 
 	if (status != B_OK) {
 		// Something went wrong during encoding
@@ -383,42 +975,40 @@ MovieEncoder::_EncoderThread()
 }
 
 
-status_t
-MovieEncoder::_ApplyImageFilters()
+// The frames are read and scaled ahead of the encoder,
+// on all the other CPUs
+FrameLoader*
+MovieEncoder::_CreateFrameLoader()
 {
+	const int32 workers = std::max(_CountThreads() - 1, int32(1));
+	FrameLoader* loader = new (std::nothrow) FrameLoader(fFileList,
+		workers * kLookAheadPerWorker, workers);
+	if (loader == NULL)
+		return NULL;
 
-	if (Settings::Current().Scale() != 100) {
-		const int32 framesTotal = fFileList->CountItems();
-
-		BMessage initialMessage(kEncodingProgress);
-		initialMessage.AddBool("reset", true);
-		initialMessage.AddInt32("frames_total", framesTotal);
-		initialMessage.AddString("text", "Scaling...");
-		fMessenger.SendMessage(&initialMessage);
-
-		// First pass: scale frames if needed
-		// TODO: we could apply different filters
-		ImageFilterScale* filter = new ImageFilterScale(fDestFrame, fColorSpace);
-		bitmap_list::const_iterator i;
-		int c = 0;
-		for (i = fFileList->List()->begin(); i != fFileList->List()->end(); i++) {
-			if (fKillThread) {
-				delete filter;
-				return B_ERROR;
-			}
-			BitmapEntry* entry = *i;
-			BBitmap* filtered = filter->ApplyFilter(entry->Bitmap());
-			entry->Replace(filtered);
+	if (_ConvertsFrames())
+		loader->SetScale(fDestFrame, fColorSpace);
 
-			c++;
-			BMessage progressMessage(kEncodingProgress);
-			progressMessage.AddInt32("frames_remaining", framesTotal - c);
-			fMessenger.SendMessage(&progressMessage);
-		}
-		delete filter;
+	status_t status = loader->InitCheck();
+	if (status == B_OK)
+		status = loader->Start();
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_CreateFrameLoader(): ";
+		std::cerr << ::strerror(status) << std::endl;
+		delete loader;
+		return NULL;
 	}
+	return loader;
+}
 
-	return B_OK;
+
+// The frames are scaled, and converted to the color space of the
+// clip, which needn't be the one of the screen
+bool
+MovieEncoder::_ConvertsFrames() const
+{
+	return Settings::Current().Scale() != 100
+		|| fColorSpace != B_NO_COLOR_SPACE;
 }
 
 
@@ -431,12 +1021,7 @@ MovieEncoder::_WriteRawFrames()
 	if (status != B_OK)
 		return status;
 
-	// TODO: Code duplication between here and _EncoderThread
 	const int32 frames = fFileList->CountItems();
-	const BitmapEntry* firstEntry = fFileList->FirstItem();
-	const BitmapEntry* lastEntry = fFileList->LastItem();
-	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
-	const float fps = CalculateFPS(fFileList->CountItems(), diff);
 
 	BMessage progressMessage(kEncodingProgress);
 	progressMessage.AddBool("reset", true);
@@ -451,32 +1036,312 @@ MovieEncoder::_WriteRawFrames()
 		status = B_ERROR;
 	else if (BEntry(tempDirectoryName).IsDirectory()) {
 		fTempPath = tempDirectoryName;
-		status = fFileList->WriteFrames(tempDirectoryName);
+		status = _WriteBitmapFiles(tempDirectoryName);
 	}
 
-	if (status == B_OK)
-		status = _PostEncodingAction(fTempPath, frames, int32(fps));
-
 	_HandleEncodingFinished(status, status == B_OK ? frames : 0);
 
 	return status;
 }
 
 
-thread_id
-MovieEncoder::EncodeThreaded()
+status_t
+MovieEncoder::_WriteBitmapFiles(const char* path)
 {
-	fKillThread = false;
+	FrameLoader* loader = _CreateFrameLoader();
+	if (loader == NULL)
+		return B_NO_MEMORY;
 
-	fEncoderThread = spawn_thread((thread_entry)EncodeStarter,
-		"Encoder Thread", B_NORMAL_PRIORITY, this);
+	status_t status = B_OK;
+	BBitmap* frame = NULL;
+	const int32 frames = loader->CountFrames();
+	for (int32 i = 0; i < frames && !fKillThread; i++) {
+		BBitmap* bitmap = NULL;
+		bool duplicate = false;
+		status = loader->NextFrame(bitmap, duplicate);
+		// Every frame gets its file, unchanged ones too
+		if (!duplicate) {
+			delete frame;
+			frame = bitmap;
+		}
+		if (status == B_OK && frame == NULL)
+			status = B_ERROR;
+		if (status != B_OK)
+			break;
 
-	if (fEncoderThread < 0)
+		BString fileName;
+		fileName.SetToFormat("%s/frame_%07" B_PRId32 ".bmp", path, i + 1);
+		status = FramesList::WriteFrame(frame, 0, fileName);
+		if (status != B_OK)
+			break;
+
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", loader->CountRemaining());
+		fMessenger.SendMessage(&progressMessage);
+	}
+	delete frame;
+	delete loader;
+
+	return status;
+}
+
+
+// GIFs are written by GifEncoder, a group of frames at a time
+status_t
+MovieEncoder::_WriteGIF()
+{
+	const int32 frames = fFileList->CountItems();
+	const BitmapEntry* firstEntry = fFileList->FirstItem();
+	const BitmapEntry* lastEntry = fFileList->LastItem();
+	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
+	const float fps = _IsRetiming()
+		? fPlaybackFrameRate : CalculateFPS(frames, diff);
+	fFrameRate = fps;
+	std::cout << "Writing GIF: " << frames << " frames, ";
+	std::cout << fps << " frames per second." << std::endl;
+
+	ThreadPool pool("gif encoder", _CountThreads());
+	status_t status = pool.InitCheck();
+	if (status != B_OK) {
+		_HandleEncodingFinished(status);
+		return status;
+	}
+
+	const Settings& settings = Settings::Current();
+	GifEncoder encoder(fOutputFile.Path(), fps, &pool);
+	encoder.SetPaletteMode(settings.GIFGlobalPalette()
+		? GIF_GLOBAL_PALETTE : GIF_LOCAL_PALETTES);
+	encoder.SetDither(settings.GIFDither());
+	status = encoder.InitCheck();
+
+	FrameLoader* loader = NULL;
+	if (status == B_OK) {
+		loader = _CreateFrameLoader();
+		if (loader == NULL)
+			status = B_NO_MEMORY;
+	}
+
+	BMessage initialMessage(kEncodingProgress);
+	initialMessage.AddBool("reset", true);
+	initialMessage.AddInt32("frames_total", frames);
+	initialMessage.AddString("text", "Encoding...");
+	fMessenger.SendMessage(&initialMessage);
+
+	int32 framesWritten = 0;
+	BBitmap* frame = NULL;
+	while (status == B_OK && framesWritten < frames && !fKillThread) {
+		BBitmap* bitmap = NULL;
+		bool duplicate = false;
+		status = loader->NextFrame(bitmap, duplicate);
+		if (!duplicate) {
+			delete frame;
+			frame = bitmap;
+		}
+		if (status == B_OK && frame == NULL)
+			status = B_ERROR;
+		if (status == B_OK)
+			status = encoder.AddFrame(frame, loader->TimeStamp(framesWritten));
+		if (status != B_OK)
+			break;
+
+		framesWritten++;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", frames - framesWritten);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	delete frame;
+	delete loader;
+
+	if (status == B_OK)
+		status = encoder.Close();
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_WriteGIF(): " << ::strerror(status);
+		std::cerr << std::endl;
+		BEntry(fOutputFile.Path()).Remove();
+	}
+	_HandleEncodingFinished(status, status == B_OK ? framesWritten : 0);
+
+	return status;
+}
+
+
+// Input format of ffmpeg for the frames
+static const char*
+FFMPEGPixelFormat(color_space colorSpace)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+			return "bgra";
+		case B_RGB24:
+			return "bgr24";
+		case B_RGB16:
+			return "rgb565le";
+		case B_RGB15:
+		case B_RGBA15:
+			return "rgb555le";
+		default:
+			return NULL;
+	}
+}
+
+
+static status_t
+WriteFrameData(const BBitmap* bitmap, FILE* stream)
+{
+	size_t pixelSize = 0;
+	if (get_pixel_size_for(bitmap->ColorSpace(), &pixelSize, NULL, NULL)
+			!= B_OK)
+		return B_BAD_VALUE;
+
+	// ffmpeg wants the rows without padding
+	const size_t rowSize = (bitmap->Bounds().IntegerWidth() + 1) * pixelSize;
+	const int32 rows = bitmap->Bounds().IntegerHeight() + 1;
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	if (size_t(bitmap->BytesPerRow()) == rowSize) {
+		if (::fwrite(bits, rowSize, rows, stream) != size_t(rows))
+			return errno != 0 ? errno : B_IO_ERROR;
+		return B_OK;
+	}
+	for (int32 y = 0; y < rows; y++) {
+		if (::fwrite(bits + y * bitmap->BytesPerRow(), rowSize, 1, stream) != 1)
+			return errno != 0 ? errno : B_IO_ERROR;
+	}
+	return B_OK;
+}
+
+
+status_t
+MovieEncoder::_StartFFMPEG(const BBitmap* frame, float fps, const char* muxer,
+	FILE*& stream)
+{
+	const char* pixelFormat = FFMPEGPixelFormat(frame->ColorSpace());
+	if (pixelFormat == NULL)
+		return B_NOT_SUPPORTED;
+
+	BString output(fOutputFile.Path());
+	output.ReplaceAll("\"", "\\\"");
+	BString command;
+	command << "ffmpeg -y -loglevel error";
+	command << " -f rawvideo -pix_fmt " << pixelFormat;
+	command << " -s " << (frame->Bounds().IntegerWidth() + 1) << "x";
+	command << (frame->Bounds().IntegerHeight() + 1);
+	command << " -r " << fps << " -i pipe:0";
+	// Most codecs want 4:2:0 chroma, hence even sizes
+	command << " -vf \"pad=ceil(iw/2)*2:ceil(ih/2)*2\" -pix_fmt yuv420p";
+	command << " -f " << muxer << " \"" << output << "\"";
+	std::cout << "Encoding with: " << command.String() << std::endl;
+
+	stream = ::popen(command.String(), "w");
+	if (stream == NULL)
+		return errno != 0 ? errno : B_ERROR;
+	return B_OK;
+}
+
+
+// The frames go straight from the loader to the standard input of ffmpeg.
+// Writing blocks while ffmpeg is busy, so the progress follows the encoding.
+status_t
+MovieEncoder::_WriteFFMPEG(const char* muxer)
+{
+	const int32 frames = fFileList->CountItems();
+	const BitmapEntry* firstEntry = fFileList->FirstItem();
+	const BitmapEntry* lastEntry = fFileList->LastItem();
+	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
+	const float fps = _IsRetiming()
+		? fPlaybackFrameRate : CalculateFPS(frames, diff);
+	fFrameRate = fps;
+
+	FrameLoader* loader = _CreateFrameLoader();
+	if (loader == NULL) {
+		_HandleEncodingFinished(B_NO_MEMORY);
+		return B_NO_MEMORY;
+	}
+
+	BMessage initialMessage(kEncodingProgress);
+	initialMessage.AddBool("reset", true);
+	initialMessage.AddInt32("frames_total", frames);
+	initialMessage.AddString("text", "Encoding...");
+	fMessenger.SendMessage(&initialMessage);
+
+	// If ffmpeg goes away, writing fails instead of killing us
+	struct sigaction ignore;
+	struct sigaction oldAction;
+	::memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	::sigaction(SIGPIPE, &ignore, &oldAction);
+
+	// The frames are retimed to the frame rate given to ffmpeg
+	FILE* stream = NULL;
+	status_t status = B_OK;
+	int32 framesLoaded = 0;
+	int32 framesWritten = 0;
+	bigtime_t timeBase = 0;
+	BBitmap* frame = NULL;
+	while (status == B_OK && framesLoaded < frames && !fKillThread) {
+		BBitmap* bitmap = NULL;
+		bool duplicate = false;
+		status = loader->NextFrame(bitmap, duplicate);
+		// Unchanged frames are written again from the previous bitmap
+		if (!duplicate) {
+			delete frame;
+			frame = bitmap;
+		}
+		if (status == B_OK && frame == NULL)
+			status = B_ERROR;
+		if (status == B_OK && stream == NULL) {
+			status = _StartFFMPEG(frame, fps, muxer, stream);
+			timeBase = loader->TimeStamp(0);
+		}
+		const int32 count = CountSlots(loader->TimeStamp(framesLoaded),
+			timeBase, fps, framesWritten);
+		for (int32 i = 0; status == B_OK && i < count; i++) {
+			status = WriteFrameData(frame, stream);
+			if (status == B_OK)
+				framesWritten++;
+		}
+		if (status != B_OK)
+			break;
+
+		framesLoaded++;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", frames - framesLoaded);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	delete frame;
+	delete loader;
+
+	// ffmpeg finishes the file when its input ends
+	if (stream != NULL && ::pclose(stream) != 0 && status == B_OK)
+		status = B_ERROR;
+	::sigaction(SIGPIPE, &oldAction, NULL);
+
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_WriteFFMPEG(): " << ::strerror(status);
+		std::cerr << std::endl;
+		BEntry(fOutputFile.Path()).Remove();
+	}
+	_HandleEncodingFinished(status, status == B_OK ? framesWritten : 0);
+
+	return status;
+}
+
+
+thread_id
+MovieEncoder::EncodeThreaded()
+{
+	fKillThread = false;
+
+	fEncoderThread = spawn_thread((thread_entry)EncodeStarter,
+		"Encoder Thread", _ThreadPriority(), this);
+
+	if (fEncoderThread < 0)
 		return fEncoderThread;
 
 	status_t status = resume_thread(fEncoderThread);
 	if (status < B_OK) {
 		kill_thread(fEncoderThread);
+		fEncoderThread = -1;
 		return status;
 	}
 
@@ -484,6 +1349,155 @@ MovieEncoder::EncodeThreaded()
 }
 
 
+status_t
+MovieEncoder::StartStreaming(const BRect& sourceFrame, float frameRate)
+{
+	CancelStreaming();
+	_SetUpRetiming();
+
+	// Single frames, GIFs and ffmpeg formats aren't written
+	// through the Media Kit
+	if (_IsRawFormat())
+		return B_NOT_SUPPORTED;
+
+	if (!fDestFrame.IsValid())
+		fDestFrame = sourceFrame.OffsetToCopy(B_ORIGIN);
+	if (_ConvertsFrames()) {
+		// Frames have to be scaled as fast as they come, and the
+		// capture threads need some CPU, too. They're already reduced
+		// when the capture does it.
+		const Settings& settings = Settings::Current();
+		if (settings.Scale() > 100
+			|| (settings.Scale() < 100 && !settings.ScaleWhileCapturing())) {
+			fStreamPool = new (std::nothrow) ThreadPool("stream scaler",
+				std::max(ThreadPool::DefaultThreadCount() / 2, int32(1)));
+			if (fStreamPool == NULL) {
+				_DisposeStream();
+				return B_NO_MEMORY;
+			}
+		}
+		fStreamFilter = new (std::nothrow) ImageFilterScale(fDestFrame,
+			fColorSpace, fStreamPool);
+		if (fStreamFilter == NULL) {
+			_DisposeStream();
+			return B_NO_MEMORY;
+		}
+	}
+
+	media_format mediaFormat = fFormat;
+	mediaFormat.u.raw_video.field_rate = ::roundf(frameRate);
+	status_t status = _CreateFile(fOutputFile.Path(), fFileFormat,
+		mediaFormat, fCodecInfo, fQuality);
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::StartStreaming(): _CreateFile failed with ";
+		std::cerr << ::strerror(status) << std::endl;
+		_DisposeStream();
+		return status;
+	}
+
+	// While capturing, the capture threads need some CPU, too
+	fTrack.converterThreads = std::max(_CountThreads() / 2, int32(1));
+
+	std::cout << "Encoding while capturing, " << frameRate;
+	std::cout << " frames per second." << std::endl;
+	fStreamFrameRate = frameRate;
+	fFrameRate = mediaFormat.u.raw_video.field_rate;
+	fVariableFrameRate = !_IsRetiming() && _IsVariableFrameRate();
+	fFramesStreamed = 0;
+	fLastStreamedTime = -1;
+	fStreaming = true;
+	return B_OK;
+}
+
+
+// Closes and removes the movie, if the capture didn't go anywhere
+void
+MovieEncoder::CancelStreaming()
+{
+	if (!fStreaming)
+		return;
+
+	_CloseFile();
+	BEntry(fOutputFile.Path()).Remove();
+	_DisposeStream();
+}
+
+
+bool
+MovieEncoder::IsStreaming() const
+{
+	return fStreaming;
+}
+
+
+// Called by the capture pipeline while capturing
+/* virtual */
+status_t
+MovieEncoder::StreamFrame(const FrameBuffer* buffer, bigtime_t timeStamp)
+{
+	if (!fStreaming)
+		return B_NOT_ALLOWED;
+
+	// An unchanged frame comes with the previous bitmap. The frames are
+	// all the same size, so the bitmap is only allocated once: the buffer
+	// goes back to the pool, so it's kept for the next unchanged frames.
+	if (buffer != NULL) {
+		const BRect bounds = fStreamFilter != NULL
+			? fDestFrame.OffsetToCopy(B_ORIGIN) : buffer->Bounds();
+		const color_space colorSpace = fStreamFilter != NULL
+			? fColorSpace : buffer->ColorSpace();
+		if (fStreamFrame == NULL || fStreamFrame->Bounds() != bounds
+			|| fStreamFrame->ColorSpace() != colorSpace) {
+			delete fStreamFrame;
+			fStreamFrame = new (std::nothrow) BBitmap(bounds, colorSpace);
+			if (fStreamFrame == NULL)
+				return B_NO_MEMORY;
+			status_t status = fStreamFrame->InitCheck();
+			if (status != B_OK) {
+				delete fStreamFrame;
+				fStreamFrame = NULL;
+				return status;
+			}
+		}
+
+		status_t status = B_OK;
+		if (fStreamFilter == NULL)
+			status = buffer->ExportBits(fStreamFrame);
+		else {
+			// Filtered from the pool buffer itself, when app_server can
+			// share it
+			const BBitmap* source = buffer->Bitmap();
+			BBitmap* copy = NULL;
+			if (source == NULL) {
+				copy = new (std::nothrow) BBitmap(buffer->Bounds(),
+					buffer->ColorSpace());
+				status = copy != NULL ? copy->InitCheck() : B_NO_MEMORY;
+				if (status == B_OK)
+					status = buffer->ExportBits(copy);
+				source = copy;
+			}
+			if (status == B_OK)
+				status = fStreamFilter->ApplyFilter(source, fStreamFrame);
+			delete copy;
+		}
+		if (status != B_OK) {
+			// Don't repeat a half written frame
+			delete fStreamFrame;
+			fStreamFrame = NULL;
+			return status;
+		}
+	}
+	if (fStreamFrame == NULL)
+		return B_BAD_VALUE;
+
+	fLastStreamedTime = timeStamp;
+	if (_IsRetiming())
+		timeStamp = _RetimedTime(timeStamp);
+	return _WriteTimedFrame(fTrack, fStreamFrame, timeStamp, buffer == NULL,
+		fFramesStreamed);
+}
+
+
 void
 MovieEncoder::ResetConfiguration()
 {
@@ -598,7 +1612,12 @@ MovieEncoder::PopCursorPosition(BPoint& point)
 int32
 MovieEncoder::EncodeStarter(void* arg)
 {
-	return reinterpret_cast<MovieEncoder*>(arg)->_EncoderThread();
+	MovieEncoder* encoder = reinterpret_cast<MovieEncoder*>(arg);
+	const int32 status = encoder->_EncoderThread();
+	// Unless another encode was started already, once this one finished
+	if (encoder->fEncoderThread == find_thread(NULL))
+		encoder->fEncoderThread = -1;
+	return status;
 }
 
 
@@ -614,74 +1633,402 @@ ExtractNumFrames(char* string)
 }
 
 
+// One segment per CPU, each starting with a key frame. Every segment
+// becomes a movie of its own, which are then joined without encoding
+// them again.
+int32
+MovieEncoder::_CountSegments(int32 frames) const
+{
+	if (!Settings::Current().ParallelEncoding())
+		return 1;
+	return std::min(_CountThreads(), frames / kMinSegmentFrames);
+}
+
+
+// If the segments can't be encoded or joined, the frames go back to the
+// list, to be encoded in one piece.
 status_t
-MovieEncoder::_PostEncodingAction(const BPath& path, int32 numFrames, int32 fps)
+MovieEncoder::_EncodeSegments(int32 count, const media_format& format,
+	int32& framesWritten)
 {
-	// For now we need PostEncoding only for GIF export
-	if (::strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) != 0)
-		return B_OK;
+	framesWritten = 0;
+	const int32 frames = fFileList->CountItems();
+	const int32 length = (frames + count - 1) / count;
+	count = (frames + length - 1) / length;
 
-	if (!IsFFMPEGAvailable()) {
-		std::cerr << "ffmpeg_tools is not available" << std::endl;
-		return B_ERROR;
+	encode_segment* segments = new (std::nothrow) encode_segment[count];
+	if (segments == NULL)
+		return B_NO_MEMORY;
+
+	const bigtime_t timeBase = fFileList->FirstItem()->TimeStamp();
+	// The segments already keep all the CPUs busy, but the pool threads
+	// of the last ones can take over the CPUs the others leave
+	const int32 converterThreads = _CountThreads();
+	const bool scale = _ConvertsFrames();
+	status_t status = B_OK;
+	for (int32 i = 0; i < count; i++) {
+		encode_segment& segment = segments[i];
+		segment.encoder = this;
+		segment.index = i;
+		segment.loader = NULL;
+		segment.path.SetToFormat("%s.part%" B_PRId32, fOutputFile.Path(), i + 1);
+		segment.format = format;
+		segment.thread = -1;
+		segment.status = B_OK;
+		segment.framesWritten = 0;
+		segment.startTime = 0;
+		segment.last = false;
+		segment.track.converterThreads = converterThreads;
+		segment.track.timeBase = timeBase;
+		if (status != B_OK || fFileList->CountItems() == 0)
+			continue;
+
+		std::vector<BitmapEntry*> entries;
+		try {
+			entries.reserve(length);
+			while (fFileList->CountItems() > 0
+				&& ((int32)entries.size() < length
+					|| !CanStartSegment(entries.back(),
+						fFileList->FirstItem(), timeBase, fFrameRate,
+						fVariableFrameRate))) {
+				entries.push_back(fFileList->Pop());
+			}
+		} catch (...) {
+			for (size_t e = 0; e < entries.size(); e++)
+				delete entries[e];
+			status = B_NO_MEMORY;
+			continue;
+		}
+
+		segment.loader = new (std::nothrow) FrameLoader(entries,
+			kLookAheadPerWorker, 1);
+		if (segment.loader == NULL) {
+			for (size_t e = 0; e < entries.size(); e++)
+				delete entries[e];
+			status = B_NO_MEMORY;
+			continue;
+		}
+		if (scale)
+			segment.loader->SetScale(fDestFrame, fColorSpace);
+		status = segment.loader->InitCheck();
+
+		// Every segment starts with a key frame of its own
+		segment.track.detector = _CreateSceneDetector();
+		if (status == B_OK && segment.track.detector == NULL)
+			status = B_NO_MEMORY;
+	}
+
+	bool stopped = false;
+	// The last segments can go away, when the first ones got longer
+	while (count > 1 && segments[count - 1].loader == NULL && status == B_OK)
+		count--;
+	if (status == B_OK) {
+		std::cout << "Encoding " << frames << " frames in " << count;
+		std::cout << " segments of about " << length << " frames." << std::endl;
+
+		BMessage initialMessage(kEncodingProgress);
+		initialMessage.AddBool("reset", true);
+		initialMessage.AddInt32("frames_total", frames);
+		initialMessage.AddInt32("segments", count);
+		initialMessage.AddString("text", "Encoding...");
+		fMessenger.SendMessage(&initialMessage);
+
+		// Every segment takes over after the last slot of the previous
+		// one, at its first frame
+		for (int32 i = 0; i < count; i++) {
+			encode_segment& segment = segments[i];
+			if (i > 0 && IsValidFrameRate(fFrameRate)) {
+				const FrameLoader* previous = segments[i - 1].loader;
+				segment.track.firstSlot = NearestSlot(
+					previous->TimeStamp(previous->CountFrames() - 1),
+					timeBase, fFrameRate) + 1;
+			}
+			segment.startTime = IsValidFrameRate(fFrameRate)
+				&& !fVariableFrameRate
+				? SlotTime(segment.track.firstSlot, fFrameRate)
+				: segment.loader->TimeStamp(0) - timeBase;
+		}
+		segments[count - 1].last = true;
+
+		fSegmentFramesLeft = frames;
+		for (int32 i = 0; i < count; i++) {
+			BString name;
+			name << "Segment encoder " << (i + 1);
+			thread_id thread = spawn_thread((thread_entry)_SegmentStarter,
+				name.String(), _ThreadPriority(), &segments[i]);
+			if (thread >= 0 && resume_thread(thread) != B_OK) {
+				kill_thread(thread);
+				thread = -1;
+			}
+			if (thread < 0) {
+				// Don't leave the others hanging
+				status = thread;
+				fKillThread = true;
+				stopped = true;
+				break;
+			}
+			segments[i].thread = thread;
+		}
+		for (int32 i = 0; i < count; i++) {
+			if (segments[i].thread < 0)
+				continue;
+			status_t dummy;
+			wait_for_thread(segments[i].thread, &dummy);
+			if (status == B_OK)
+				status = segments[i].status;
+		}
+	}
+
+	for (int32 i = 0; i < count; i++)
+		framesWritten += segments[i].framesWritten;
+
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	if (status == B_OK)
+		status = _JoinSegments(segments, count, framesWritten);
+
+	// A failed segment or join doesn't stop the movie from being saved.
+	// The frames only go back if they all got to a segment.
+	const bool giveBack = status != B_OK && status != B_CANCELED
+		&& (!fKillThread || stopped) && fFileList->CountItems() == 0;
+	if (giveBack)
+		fKillThread = false;
+	for (int32 i = 0; i < count; i++) {
+		if (segments[i].loader != NULL) {
+			if (giveBack)
+				segments[i].loader->ReleaseEntries(fFileList);
+			delete segments[i].loader;
+			segments[i].loader = NULL;
+		}
+		_CloseTrack(segments[i].track);
+		BEntry(segments[i].path.String()).Remove();
+	}
+	delete[] segments;
+
+	return status;
+}
+
+
+/* static */
+int32
+MovieEncoder::_SegmentStarter(void* arg)
+{
+	encode_segment* segment = static_cast<encode_segment*>(arg);
+	return segment->encoder->_EncodeSegment(*segment);
+}
+
+
+// The frames are timed just like those of a movie in one piece
+status_t
+MovieEncoder::_EncodeSegment(encode_segment& segment)
+{
+	movie_track& track = segment.track;
+	status_t status = _CreateTrack(segment.path.String(), fFileFormat,
+		segment.format, fCodecInfo, fQuality, track);
+	if (status == B_OK)
+		status = segment.loader->Start();
+
+	BBitmap* frame = NULL;
+	const int32 frames = segment.loader->CountFrames();
+	for (int32 i = 0; status == B_OK && i < frames && !fKillThread; i++) {
+		BBitmap* bitmap = NULL;
+		bool duplicate = false;
+		status = segment.loader->NextFrame(bitmap, duplicate);
+		if (!duplicate) {
+			delete frame;
+			frame = bitmap;
+		}
+		if (status == B_OK && frame == NULL)
+			status = B_ERROR;
+		if (status == B_OK) {
+			status = _WriteTimedFrame(track, frame,
+				segment.loader->TimeStamp(i), duplicate,
+				segment.framesWritten);
+		}
+		if (status != B_OK)
+			break;
+
+		const int32 framesLeft = atomic_add(&fSegmentFramesLeft, -1) - 1;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", framesLeft);
+		progressMessage.AddInt32("segment", segment.index);
+		progressMessage.AddInt32("segment_frames_remaining", frames - i - 1);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	// Up to the next segment, the last frame lasts until its first one.
+	// At the end of the movie, it has to be written again.
+	if (status == B_OK && segment.last && !fKillThread)
+		status = _FinishTimedFrames(track, frame, segment.framesWritten);
+	delete frame;
+	segment.loader->Stop();
+
+	if (track.detector != NULL) {
+		BString name;
+		name << "Segment " << (segment.index + 1) << " key frames";
+		track.detector->PrintStatistics(name.String());
 	}
 
+	status_t closeStatus = _CloseTrack(track);
+	if (status == B_OK)
+		status = closeStatus;
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder: segment " << (segment.index + 1);
+		std::cerr << " failed: " << ::strerror(status) << std::endl;
+	}
+	segment.status = status;
+	return status;
+}
+
+
+status_t
+MovieEncoder::_JoinSegments(const encode_segment* segments, int32 count,
+	int32 frames)
+{
 	BMessage progressMessage(kEncodingProgress);
 	progressMessage.AddBool("reset", true);
-	progressMessage.AddInt32("frames_total", numFrames);
-	progressMessage.AddString("text", "Processing...");
+	progressMessage.AddInt32("frames_total", frames);
+	progressMessage.AddString("text", "Joining...");
 	fMessenger.SendMessage(&progressMessage);
 
-	if (fps < 0)
-		fps = 0;
+	status_t status = _RemuxSegments(segments, count, frames);
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder: joining the segments failed (";
+		std::cerr << ::strerror(status) << ")";
+		if (IsFFMPEGAvailable()) {
+			std::cerr << ", trying with ffmpeg." << std::endl;
+			status = _ConcatenateSegments(segments, count, frames);
+		} else
+			std::cerr << "." << std::endl;
+	}
+	return status;
+}
 
+
+// Copies the encoded chunks of all the segments into the movie, as they
+// come: with B-frames, they aren't as many as the frames, nor in the order
+// they're shown. The first chunk of a segment is its first key frame,
+// which starts the segment where it belongs in the movie, whatever time
+// the writer of the segment gave it.
+status_t
+MovieEncoder::_RemuxSegments(const encode_segment* segments, int32 count,
+	int32 frames)
+{
+	BMediaFile* output = NULL;
+	BMediaTrack* outputTrack = NULL;
+	int32 chunks = 0;
+	status_t status = B_OK;
+	for (int32 i = 0; i < count && status == B_OK && !fKillThread; i++) {
+		entry_ref ref;
+		status = get_ref_for_path(segments[i].path.String(), &ref);
+		if (status != B_OK)
+			break;
+		BMediaFile input(&ref);
+		status = input.InitCheck();
+		if (status != B_OK)
+			break;
+		BMediaTrack* track = input.CountTracks() > 0 ? input.TrackAt(0) : NULL;
+		if (track == NULL) {
+			status = B_ERROR;
+			break;
+		}
+
+		if (output == NULL) {
+			media_format encodedFormat;
+			status = track->EncodedFormat(&encodedFormat);
+			if (status == B_OK) {
+				status = CreateMediaFile(fOutputFile.Path(), fFileFormat,
+					&encodedFormat, NULL, -1, output, outputTrack);
+			}
+			if (status == B_OK)
+				status = output->CommitHeader();
+		}
+
+		char* buffer = NULL;
+		int32 size = 0;
+		media_header header;
+		bigtime_t offset = 0;
+		int32 segmentChunks = 0;
+		while (status == B_OK && !fKillThread) {
+			status = track->ReadChunk(&buffer, &size, &header);
+			if (status != B_OK)
+				break;
+
+			if (segmentChunks == 0)
+				offset = segments[i].startTime - header.start_time;
+			media_encode_info info;
+			info.flags = header.u.encoded_video.field_flags & B_MEDIA_KEY_FRAME;
+			info.start_time = offset + header.start_time;
+			status = outputTrack->WriteChunk(buffer, size, &info);
+			if (status != B_OK)
+				break;
+
+			segmentChunks++;
+			chunks++;
+			BMessage progressMessage(kEncodingProgress);
+			progressMessage.AddInt32("frames_remaining",
+				std::max(frames - chunks, int32(0)));
+			fMessenger.SendMessage(&progressMessage);
+		}
+		if (status == B_LAST_BUFFER_ERROR)
+			status = B_OK;
+		// Something went missing on the way
+		if (status == B_OK && segmentChunks == 0
+			&& segments[i].framesWritten > 0)
+			status = B_ERROR;
+		input.ReleaseAllTracks();
+	}
+
+	status_t closeStatus = CloseMediaFile(output);
+	if (status == B_OK)
+		status = closeStatus;
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	return status;
+}
+
+
+// The concat demuxer of ffmpeg joins the segments without encoding them
+status_t
+MovieEncoder::_ConcatenateSegments(const encode_segment* segments,
+	int32 count, int32 frames)
+{
+	BString listPath(fOutputFile.Path());
+	listPath << ".parts";
+	FILE* list = ::fopen(listPath.String(), "w");
+	if (list == NULL)
+		return errno;
+	for (int32 i = 0; i < count; i++) {
+		BString path(segments[i].path);
+		path.ReplaceAll("'", "'\\''");
+		::fprintf(list, "file '%s'\n", path.String());
+	}
+	::fclose(list);
+
+	BString output(fOutputFile.Path());
+	output.ReplaceAll("\"", "\\\"");
 	BString command;
-	command.Append("ffmpeg "); // command
-	command.Append("-i ").Append(path.Path()).Append("/frame_%07d.bmp"); // input
-	command.Append(" -f gif "); // output type
-	// filter
-	command.Append("-vf \"");
-	// add FPS
-	command.Append("fps=");
-	command << fps;
-	command.Append(",");
-	// optimize conversion by generating a palette
-	command.Append("split[s0][s1];[s0]palettegen=stats_mode=diff[p];[s1][p]paletteuse=new=1:diff_mode=rectangle ");
-	command.Append("\"");
-	command.Append(" ");
-	command.Append(" -progress pipe:1 "); // to show progress
-	command.Append(fOutputFile.Path()); // output
-	//command.Append (" 2>&1");
-#if 1
-	std::cout << "PostEncodingAction command: " << command.String() << std::endl;
-#endif
+	command << "ffmpeg -y -f concat -safe 0 -i \"" << output << ".parts\"";
+	command << " -c copy -map 0 -progress pipe:1 \"" << output << "\"";
+	std::cout << "Joining segments: " << command.String() << std::endl;
 
 	status_t status = B_ERROR;
 	FILE* commandStream = ::popen(command.String(), "r");
 	if (commandStream != NULL) {
 		char line[256];
 		while (fgets(line, 256, commandStream) != NULL) {
-			uint32 frames = ExtractNumFrames(line);
-			if (frames != 0) {
+			uint32 framesJoined = ExtractNumFrames(line);
+			if (framesJoined != 0) {
 				BMessage progressMessage(kEncodingProgress);
-				progressMessage.AddInt32("frames_remaining", numFrames - frames);
+				progressMessage.AddInt32("frames_remaining",
+					frames - framesJoined);
 				fMessenger.SendMessage(&progressMessage);
 			}
 		}
-		::pclose(commandStream);
-		status = B_OK;
-	}
-
-	// Remove temporary path/files
-	BEntry pathEntry(fTempPath.Path());
-	if (pathEntry.Exists()) {
-		BDirectory dir(fTempPath.Path());
-		BEntry fileEntry;
-		while (dir.GetNextEntry(&fileEntry) == B_OK)
-			fileEntry.Remove();
-		pathEntry.Remove();
+		if (::pclose(commandStream) == 0)
+			status = B_OK;
 	}
 
+	BEntry(listPath.String()).Remove();
 	return status;
 }
 
@@ -691,11 +2038,27 @@ MovieEncoder::_HandleEncodingFinished(const status_t& status, const int32& numFr
 {
 	DisposeData();
 
+	// To compare the presets. When streaming, most of the work was
+	// done while capturing, and isn't counted.
+	const bigtime_t encodingTime = system_time() - fEncodeStartTime;
+	if (status == B_OK && numFrames > 0 && encodingTime > 0) {
+		const float framesPerSecond = numFrames * 1000000.0f / encodingTime;
+		std::cout << "Preset " << kEncoderPresets[fPreset].name << ": ";
+		std::cout << numFrames << " frames in " << (encodingTime / 1000);
+		std::cout << " msec, " << framesPerSecond << " frames per second";
+		if (IsValidFrameRate(fFrameRate))
+			std::cout << " (" << framesPerSecond / fFrameRate << "x real time)";
+		std::cout << ", " << _CountThreads() << " threads at priority ";
+		std::cout << _ThreadPriority() << "." << std::endl;
+	}
+
 	if (!fMessenger.IsValid())
 		return;
 
 	BMessage message(kEncodingFinished);
 	message.AddInt32("status", int32(status));
+	message.AddString("preset", kEncoderPresets[fPreset].name);
+	message.AddInt64("encoding_time", encodingTime);
 	if (numFrames > 0) {
 		message.AddInt32("frames_processed", numFrames);
 		// Unless we exported bitmaps...
@@ -9,11 +9,30 @@
 #include <MediaFile.h>
 #include <Path.h>
 
+#include <cstdio>
 #include <queue>
 
+#include "CapturePipeline.h"
+
 class BBitmap;
+class FrameConverter;
+class FrameLoader;
 class FramesList;
-class MovieEncoder {
+class ImageFilterScale;
+class SceneDetector;
+class ThreadPool;
+
+// Trade-offs between encoding speed and movie quality
+enum encoder_preset {
+	// Keeps up with the capture: lower quality, no scene detection,
+	// and half of the CPUs
+	ENCODER_PRESET_REALTIME = 0,
+	ENCODER_PRESET_BALANCED,
+	// Best quality, more key frames, in the background
+	ENCODER_PRESET_ARCHIVAL
+};
+
+class MovieEncoder : public FrameStream {
 public:
 	MovieEncoder();
 	~MovieEncoder();
@@ -29,8 +48,20 @@ public:
 
 	status_t SetDestFrame(const BRect &rect);
 	void SetColorSpace(const color_space &space);
+	// The raw format the codec works in, if it isn't the one of the
+	// frames: they're converted to it before they're written, and
+	// the frames are written as they are if the codec doesn't take it
+	void SetCodecColorSpace(const color_space &space);
+	// From 0 to 1, or -1 for the default of the codec
 	status_t SetQuality(const float &quality);
+	// Up to B_DISPLAY_PRIORITY - 1. The preset raises or lowers it.
 	status_t SetThreadPriority(const int32 &value);
+	// Sets the quality, and how the key frames, the threads and
+	// the thread priority are chosen
+	status_t SetPreset(encoder_preset preset);
+
+	static int32 CountPresets();
+	static const char* PresetName(encoder_preset preset);
 	status_t SetMessenger(const BMessenger &messenger);
 
 	media_file_format	MediaFileFormat() const;
@@ -45,29 +76,105 @@ public:
 
 	thread_id EncodeThreaded();
 
+	// Encoding while capturing: the output file is created right away,
+	// at the given frame rate, and the frames are written as they come.
+	// EncodeThreaded() then only needs to encode the frames of the source
+	// which didn't make it in time, and close the file.
+	status_t StartStreaming(const BRect& sourceFrame, float frameRate);
+	void CancelStreaming();
+	bool IsStreaming() const;
+
+	virtual status_t StreamFrame(const FrameBuffer* buffer,
+		bigtime_t timeStamp);
+
 private:
 	void ResetConfiguration();
 
 	BBitmap *GetCursorBitmap(const uint8 *data);
 	status_t PopCursorPosition(BPoint &point);
 
+	// A track of the movie, and how the frames are timed in it
+	struct movie_track {
+		BMediaFile*		file;
+		BMediaTrack*	track;
+		bool			headerCommitted;
+		// The color space the track takes, and what converts the frames
+		// to it, with that many threads
+		color_space		colorSpace;
+		FrameConverter*	converter;
+		int32			converterThreads;
+		// Capture time of the start of the movie, -1 until the first
+		// frame, and the frame rate slot of the movie the track starts at
+		bigtime_t		timeBase;
+		int32			firstSlot;
+		// Time of the last unchanged frame left out, or -1
+		bigtime_t		skippedTime;
+		// Tells where the key frames go
+		SceneDetector*	detector;
+
+		movie_track();
+	};
+
 	status_t _CreateFile(const char* path,
 						const media_file_format& mff,
 						const media_format& inputFormat,
 						const media_codec_info& mci,
 						float quality = -1);
-	status_t _WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame);
+	status_t _CreateTrack(const char* path,
+		const media_file_format& fileFormat, const media_format& format,
+		const media_codec_info& codecInfo, float quality,
+		movie_track& track) const;
+	// "unchanged" if it's the same as the frame written before it
+	status_t _WriteFrame(movie_track& track, const BBitmap* bitmap,
+		bigtime_t time, bool isKeyFrame, bool unchanged = false);
+	status_t _WriteTimedFrame(movie_track& track, const BBitmap* bitmap,
+		bigtime_t timeStamp, bool duplicate, int32& framesWritten);
+	status_t _FinishTimedFrames(movie_track& track, const BBitmap* lastFrame,
+		int32& framesWritten);
+	status_t _CloseTrack(movie_track& track);
 	status_t _CloseFile();
+	void _DisposeStream();
+	bool _IsRawFormat() const;
+	bool _IsGIFFormat() const;
+	bool _IsVariableFrameRate() const;
+	SceneDetector* _CreateSceneDetector() const;
+	int32 _CountThreads() const;
+	int32 _ThreadPriority() const;
+
+	void _SetUpRetiming();
+	bool _IsRetiming() const;
+	bigtime_t _RetimedTime(bigtime_t timeStamp);
+	void _RetimeFrames();
+	void _SkipStreamedFrames();
 
 	static int32 EncodeStarter(void *arg);
 	status_t _EncoderThread();
 
-	status_t _ApplyImageFilters();
+	FrameLoader* _CreateFrameLoader();
+	bool _ConvertsFrames() const;
 	status_t _WriteRawFrames();
+	status_t _WriteBitmapFiles(const char* path);
+	status_t _WriteGIF();
+	status_t _StartFFMPEG(const BBitmap* frame, float fps, const char* muxer,
+		FILE*& stream);
+	status_t _WriteFFMPEG(const char* muxer);
+
+	struct encode_segment;
+
+	int32 _CountSegments(int32 frames) const;
+	status_t _EncodeSegments(int32 count, const media_format& format,
+		int32& framesWritten);
+	static int32 _SegmentStarter(void* arg);
+	status_t _EncodeSegment(encode_segment& segment);
+	status_t _JoinSegments(const encode_segment* segments, int32 count,
+		int32 frames);
+	status_t _RemuxSegments(const encode_segment* segments, int32 count,
+		int32 frames);
+	status_t _ConcatenateSegments(const encode_segment* segments,
+		int32 count, int32 frames);
 
 	void _HandleEncodingFinished(const status_t& status,
 								const int32& numFrames = 0);
-	status_t _PostEncodingAction(const BPath& path, int32 numFrames, int32 fps);
 
 	thread_id	fEncoderThread;
 	bool		fKillThread;
@@ -75,6 +182,10 @@ private:
 	int32 fPriority;
 	BMessenger fMessenger;
 
+	encoder_preset		fPreset;
+	float				fQuality;
+	bigtime_t			fEncodeStartTime;
+
 	FramesList* fFileList;
 
 	std::queue<BPoint> *fCursorQueue;
@@ -84,14 +195,35 @@ private:
 
 	BRect fDestFrame;
 	color_space fColorSpace;
-	BMediaFile*			fMediaFile;
-	BMediaTrack*		fMediaTrack;
-	bool				fHeaderCommitted;
+	movie_track			fTrack;
+	color_space			fCodecColorSpace;
 
 	media_file_format	fFileFormat;
 	media_format_family	fFamily;
 	media_format		fFormat;
 	media_codec_info	fCodecInfo;
+
+	bool				fStreaming;
+	float				fStreamFrameRate;
+	int32				fFramesStreamed;
+	// Capture time of the last frame streamed
+	bigtime_t			fLastStreamedTime;
+	BBitmap*			fStreamFrame;
+	ImageFilterScale*	fStreamFilter;
+	ThreadPool*			fStreamPool;
+
+	// How the frames are timed in the movie
+	bool				fVariableFrameRate;
+	float				fFrameRate;
+
+	// The frame rate of the movie, when it doesn't follow the capture
+	float				fPlaybackFrameRate;
+	// Rate at which the capture is sampled, one frame of the movie each
+	float				fRetimeRate;
+	bigtime_t			fRetimeBase;
+
+	// Frames the segment encoders haven't written yet
+	int32				fSegmentFramesLeft;
 };
 
 
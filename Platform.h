@@ -0,0 +1,18 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __PLATFORM_H
+#define __PLATFORM_H
+
+// The only Haiku headers the image code (ColorConversion, Scaler and
+// ThreadPool) includes: the types, the color spaces, and the kernel
+// threads, semaphores and atomics. Nothing from the kits, so that the
+// tests build on other systems too, with the headers in tests/stubs
+// standing in for these.
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+#include <SupportDefs.h>
+
+#endif // __PLATFORM_H
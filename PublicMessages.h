@@ -8,6 +8,7 @@
 enum publicMessages {
 	kMsgGUIToggleCapture = 'StoR',
 	kMsgGUITogglePause = 'PauC',
+	kMsgGUISaveReplay = 'SavR',
 };
 
 #endif // __PUBLIC_MESSAGES_H
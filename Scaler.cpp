@@ -0,0 +1,516 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "Scaler.h"
+
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The coefficients of every pixel add up to 1 << kPrecisionBits.
+// They must fit 16 bits, Lanczos lobes included.
+const static int32 kPrecisionBits = 14;
+const static int32 kRounding = 1 << (kPrecisionBits - 1);
+
+
+struct Scaler::scale_job {
+	Scaler*			scaler;
+	const void*		source;
+	int32			sourceBytesPerRow;
+	void*			dest;
+	int32			destBytesPerRow;
+	int32			bands;
+};
+
+
+static double
+FilterSupport(scale_filter filter)
+{
+	switch (filter) {
+		case B_SCALE_BOX:
+			return 0.5;
+		case B_SCALE_LANCZOS:
+			return 3.0;
+		case B_SCALE_BILINEAR:
+		default:
+			return 1.0;
+	}
+}
+
+
+static double
+FilterWeight(scale_filter filter, double x)
+{
+	switch (filter) {
+		case B_SCALE_BOX:
+			return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+		case B_SCALE_LANCZOS:
+		{
+			if (x == 0.0)
+				return 1.0;
+			if (x <= -3.0 || x >= 3.0)
+				return 0.0;
+			const double px = M_PI * x;
+			return 3.0 * ::sin(px) * ::sin(px / 3.0) / (px * px);
+		}
+		case B_SCALE_BILINEAR:
+		default:
+			x = ::fabs(x);
+			return x < 1.0 ? 1.0 - x : 0.0;
+	}
+}
+
+
+static inline uint8
+Clamp(int32 value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : uint8(value));
+}
+
+
+static inline uint32
+PairOfWeights(int16 first, int16 second)
+{
+	return uint32(uint16(first)) | (uint32(uint16(second)) << 16);
+}
+
+
+static void
+HorizontalRow(const uint8* from, uint8* to, int32 width, const int32* starts,
+	const int32* counts, const int16* coefficients, int32 taps)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+#endif
+	for (int32 x = 0; x < width; x++, to += 4) {
+		const uint8* pixels = from + starts[x] * 4;
+		const int16* weights = coefficients + x * taps;
+		const int32 count = counts[x];
+		int32 i = 0;
+#if defined(__SSE2__)
+		// Two pixels at a time: the channels of both are interleaved,
+		// so a multiply-add does both for all the channels
+		__m128i sum = _mm_set1_epi32(kRounding);
+		for (; i + 2 <= count; i += 2) {
+			__m128i two = _mm_unpacklo_epi8(_mm_loadl_epi64(
+				reinterpret_cast<const __m128i*>(pixels + i * 4)), zero);
+			two = _mm_unpacklo_epi16(two, _mm_srli_si128(two, 8));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(two,
+				_mm_set1_epi32(PairOfWeights(weights[i], weights[i + 1]))));
+		}
+		if (i < count) {
+			int32 value;
+			::memcpy(&value, pixels + i * 4, sizeof(value));
+			__m128i one = _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero);
+			one = _mm_unpacklo_epi16(one, zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(one,
+				_mm_set1_epi32(PairOfWeights(weights[i], 0))));
+		}
+		sum = _mm_srai_epi32(sum, kPrecisionBits);
+		sum = _mm_packs_epi32(sum, sum);
+		sum = _mm_packus_epi16(sum, sum);
+		const int32 pixel = _mm_cvtsi128_si32(sum);
+		::memcpy(to, &pixel, sizeof(pixel));
+#else
+		int32 sum[4] = { kRounding, kRounding, kRounding, kRounding };
+		for (; i < count; i++) {
+			const uint8* pixel = pixels + i * 4;
+			for (int32 c = 0; c < 4; c++)
+				sum[c] += pixel[c] * weights[i];
+		}
+		for (int32 c = 0; c < 4; c++)
+			to[c] = Clamp(sum[c] >> kPrecisionBits);
+#endif
+	}
+}
+
+
+// Sums up "count" rows
+static void
+VerticalRow(const uint8* const* rows, int32 count, const int16* weights,
+	uint8* to, int32 length)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	// 16 bytes of two rows at a time, interleaved like in HorizontalRow()
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= length; x += 16) {
+		__m128i sum0 = _mm_set1_epi32(kRounding);
+		__m128i sum1 = sum0;
+		__m128i sum2 = sum0;
+		__m128i sum3 = sum0;
+		for (int32 i = 0; i < count; i += 2) {
+			const __m128i a = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(rows[i] + x));
+			__m128i b = zero;
+			int16 next = 0;
+			if (i + 1 < count) {
+				b = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(rows[i + 1] + x));
+				next = weights[i + 1];
+			}
+			const __m128i pair = _mm_set1_epi32(PairOfWeights(weights[i], next));
+			const __m128i low = _mm_unpacklo_epi8(a, b);
+			const __m128i high = _mm_unpackhi_epi8(a, b);
+			sum0 = _mm_add_epi32(sum0,
+				_mm_madd_epi16(_mm_unpacklo_epi8(low, zero), pair));
+			sum1 = _mm_add_epi32(sum1,
+				_mm_madd_epi16(_mm_unpackhi_epi8(low, zero), pair));
+			sum2 = _mm_add_epi32(sum2,
+				_mm_madd_epi16(_mm_unpacklo_epi8(high, zero), pair));
+			sum3 = _mm_add_epi32(sum3,
+				_mm_madd_epi16(_mm_unpackhi_epi8(high, zero), pair));
+		}
+		const __m128i low = _mm_packs_epi32(
+			_mm_srai_epi32(sum0, kPrecisionBits),
+			_mm_srai_epi32(sum1, kPrecisionBits));
+		const __m128i high = _mm_packs_epi32(
+			_mm_srai_epi32(sum2, kPrecisionBits),
+			_mm_srai_epi32(sum3, kPrecisionBits));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + x),
+			_mm_packus_epi16(low, high));
+	}
+#endif
+	for (; x < length; x++) {
+		int32 sum = kRounding;
+		for (int32 i = 0; i < count; i++)
+			sum += rows[i][x] * weights[i];
+		to[x] = Clamp(sum >> kPrecisionBits);
+	}
+}
+
+
+static inline size_t
+Align(size_t size)
+{
+	return (size + 15) & ~size_t(15);
+}
+
+
+static void
+RunBands(ThreadPool* pool, int32 bands, parallel_func function, void* cookie)
+{
+	if (pool != NULL && bands > 1) {
+		pool->Run(bands, function, cookie);
+		return;
+	}
+	for (int32 band = 0; band < bands; band++)
+		function(cookie, band);
+}
+
+
+Scaler::Scaler(int32 sourceWidth, int32 sourceHeight, int32 destWidth,
+	int32 destHeight, color_space colorSpace, scale_filter filter)
+	:
+	fSourceWidth(sourceWidth),
+	fSourceHeight(sourceHeight),
+	fDestWidth(destWidth),
+	fDestHeight(destHeight),
+	fColorSpace(colorSpace),
+	fFilter(filter),
+	fPixelSize(0),
+	fScratchSize(0),
+	fSlotsOffset(0),
+	fWindowOffset(0),
+	fRowBufferOffset(0),
+	fInitStatus(B_NO_INIT)
+{
+	if (sourceWidth <= 0 || sourceHeight <= 0 || destWidth <= 0
+		|| destHeight <= 0 || !IsSupported(colorSpace, filter)) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	fInitStatus = get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+		&pixelsPerChunk);
+	if (fInitStatus != B_OK)
+		return;
+	fPixelSize = pixelChunk / pixelsPerChunk;
+
+	try {
+		if (filter == B_SCALE_NEAREST) {
+			fSourceX.resize(destWidth);
+			for (int32 x = 0; x < destWidth; x++) {
+				fSourceX[x] = std::min(int32((x + 0.5) * sourceWidth / destWidth),
+					sourceWidth - 1) * fPixelSize;
+			}
+			fSourceY.resize(destHeight);
+			for (int32 y = 0; y < destHeight; y++) {
+				fSourceY[y] = std::min(int32((y + 0.5) * sourceHeight / destHeight),
+					sourceHeight - 1);
+			}
+		} else {
+			_BuildAxis(sourceWidth, destWidth, fHorizontal);
+			_BuildAxis(sourceHeight, destHeight, fVertical);
+
+			// The scratch holds the vertical taps as row pointers, the source
+			// row in every window slot, the slots, and a row to expand into
+			// or pack from
+			const int32 taps = fVertical.taps;
+			fSlotsOffset = Align(taps * sizeof(const uint8*));
+			fWindowOffset = fSlotsOffset + Align(taps * sizeof(int32));
+			fRowBufferOffset = fWindowOffset
+				+ Align(size_t(destWidth) * 4 * taps);
+			fScratchSize = fRowBufferOffset;
+			if (fPixelSize != 4) {
+				fScratchSize += Align(size_t(std::max(sourceWidth, destWidth))
+					* 4);
+			}
+		}
+	} catch (...) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	fInitStatus = B_OK;
+}
+
+
+Scaler::~Scaler()
+{
+}
+
+
+status_t
+Scaler::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+status_t
+Scaler::Scale(const void* source, int32 sourceBytesPerRow, void* dest,
+	int32 destBytesPerRow, ThreadPool* pool)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (source == NULL || dest == NULL)
+		return B_BAD_VALUE;
+
+	scale_job job;
+	job.scaler = this;
+	job.source = source;
+	job.sourceBytesPerRow = sourceBytesPerRow;
+	job.dest = dest;
+	job.destBytesPerRow = destBytesPerRow;
+	job.bands = std::min(pool != NULL ? pool->CountThreads() : 1, fDestHeight);
+
+	if (fScratch.size() < fScratchSize * job.bands) {
+		try {
+			fScratch.resize(fScratchSize * job.bands);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+	}
+
+	RunBands(pool, job.bands, _ScaleJob, &job);
+	return B_OK;
+}
+
+
+status_t
+Scaler::ScaleRows(const void* source, int32 sourceBytesPerRow, void* dest,
+	int32 destBytesPerRow, int32 firstRow, int32 lastRow,
+	uint8* scratch) const
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (source == NULL || dest == NULL || firstRow < 0
+		|| lastRow > fDestHeight || firstRow > lastRow
+		|| (scratch == NULL && fScratchSize > 0))
+		return B_BAD_VALUE;
+
+	const uint8* sourceBits = static_cast<const uint8*>(source);
+	uint8* destBits = static_cast<uint8*>(dest);
+	if (fFilter == B_SCALE_NEAREST) {
+		_NearestRows(sourceBits, sourceBytesPerRow, destBits, destBytesPerRow,
+			firstRow, lastRow);
+		return B_OK;
+	}
+
+	// The horizontally scaled source rows go into a window of "taps" slots,
+	// row r into slot r % taps. The rows of consecutive destination rows
+	// overlap, so most are still there.
+	const int32 taps = fVertical.taps;
+	const uint8** rows = reinterpret_cast<const uint8**>(scratch);
+	int32* slots = reinterpret_cast<int32*>(scratch + fSlotsOffset);
+	uint8* window = scratch + fWindowOffset;
+	uint8* rowBuffer = fPixelSize != 4 ? scratch + fRowBufferOffset : NULL;
+	const int32 rowLength = fDestWidth * 4;
+	for (int32 i = 0; i < taps; i++)
+		slots[i] = -1;
+
+	for (int32 y = firstRow; y < lastRow; y++) {
+		const int32 start = fVertical.starts[y];
+		const int32 count = fVertical.counts[y];
+		for (int32 i = 0; i < count; i++) {
+			const int32 sourceRow = start + i;
+			const int32 slot = sourceRow % taps;
+			uint8* row = window + size_t(slot) * rowLength;
+			if (slots[slot] != sourceRow) {
+				const uint8* from = sourceBits
+					+ size_t(sourceRow) * sourceBytesPerRow;
+				if (rowBuffer != NULL) {
+					ConvertRowToRGB32(from, rowBuffer, fSourceWidth,
+						fColorSpace);
+					from = rowBuffer;
+				}
+				HorizontalRow(from, row, fDestWidth, &fHorizontal.starts[0],
+					&fHorizontal.counts[0], &fHorizontal.coefficients[0],
+					fHorizontal.taps);
+				slots[slot] = sourceRow;
+			}
+			rows[i] = row;
+		}
+
+		uint8* to = destBits + size_t(y) * destBytesPerRow;
+		VerticalRow(rows, count, &fVertical.coefficients[size_t(y) * taps],
+			rowBuffer != NULL ? rowBuffer : to, rowLength);
+		if (rowBuffer != NULL)
+			ConvertRowFromRGB32(rowBuffer, to, fDestWidth, fColorSpace);
+	}
+
+	return B_OK;
+}
+
+
+size_t
+Scaler::ScratchSize() const
+{
+	return fScratchSize;
+}
+
+
+/* static */
+bool
+Scaler::IsSupported(color_space colorSpace, scale_filter filter)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+		case B_RGB24:
+		case B_RGB16:
+		case B_RGB15:
+		case B_RGBA15:
+			return true;
+		case B_CMAP8:
+			// Averaging palette indices makes no sense
+			return filter == B_SCALE_NEAREST;
+		default:
+			return false;
+	}
+}
+
+
+void
+Scaler::_BuildAxis(int32 sourceSize, int32 destSize, scale_axis& axis)
+{
+	// When reducing, the kernel is stretched over all the source
+	// pixels which fall into a destination pixel
+	const double scale = double(sourceSize) / destSize;
+	const double filterScale = std::max(scale, 1.0);
+	const double support = FilterSupport(fFilter) * filterScale;
+
+	axis.taps = std::min(int32(::ceil(support)) * 2 + 1, sourceSize);
+	axis.starts.resize(destSize);
+	axis.counts.resize(destSize);
+	axis.coefficients.assign(size_t(destSize) * axis.taps, 0);
+
+	std::vector<double> weights(axis.taps);
+	for (int32 i = 0; i < destSize; i++) {
+		const double center = (i + 0.5) * scale;
+		int32 first = std::max(int32(center - support + 0.5), int32(0));
+		const int32 last = std::min(int32(center + support + 0.5), sourceSize);
+		int32 count = std::min(last - first, axis.taps);
+
+		double total = 0;
+		for (int32 j = 0; j < count; j++) {
+			weights[j] = FilterWeight(fFilter,
+				(first + j - center + 0.5) / filterScale);
+			total += weights[j];
+		}
+		// Pixels with no weight only cost time
+		while (count > 1 && weights[count - 1] == 0)
+			count--;
+		while (count > 1 && weights[0] == 0) {
+			std::copy(weights.begin() + 1, weights.begin() + count,
+				weights.begin());
+			first++;
+			count--;
+		}
+		if (count <= 0 || total == 0) {
+			first = std::min(int32(center), sourceSize - 1);
+			count = 1;
+			weights[0] = total = 1;
+		}
+
+		// Rounding errors go to the biggest coefficient,
+		// so the sum is exactly one
+		int16* coefficients = &axis.coefficients[size_t(i) * axis.taps];
+		int32 sum = 0;
+		int32 biggest = 0;
+		for (int32 j = 0; j < count; j++) {
+			coefficients[j] = int16(::lround(weights[j] / total
+				* (1 << kPrecisionBits)));
+			sum += coefficients[j];
+			if (coefficients[j] > coefficients[biggest])
+				biggest = j;
+		}
+		coefficients[biggest] += (1 << kPrecisionBits) - sum;
+
+		axis.starts[i] = first;
+		axis.counts[i] = count;
+	}
+}
+
+
+/* static */
+void
+Scaler::_ScaleJob(void* cookie, int32 band)
+{
+	const scale_job& job = *static_cast<scale_job*>(cookie);
+	const Scaler* scaler = job.scaler;
+	uint8* scratch = scaler->fScratchSize > 0
+		? &job.scaler->fScratch[0] + scaler->fScratchSize * band : NULL;
+	scaler->ScaleRows(job.source, job.sourceBytesPerRow, job.dest,
+		job.destBytesPerRow, scaler->fDestHeight * band / job.bands,
+		scaler->fDestHeight * (band + 1) / job.bands, scratch);
+}
+
+
+void
+Scaler::_NearestRows(const uint8* source, int32 sourceBytesPerRow,
+	uint8* dest, int32 destBytesPerRow, int32 firstRow, int32 lastRow) const
+{
+	const int32* sourceX = &fSourceX[0];
+	for (int32 y = firstRow; y < lastRow; y++) {
+		const uint8* from = source + size_t(fSourceY[y]) * sourceBytesPerRow;
+		uint8* to = dest + size_t(y) * destBytesPerRow;
+		switch (fPixelSize) {
+			case 4:
+				for (int32 x = 0; x < fDestWidth; x++, to += 4)
+					::memcpy(to, from + sourceX[x], 4);
+				break;
+			case 2:
+				for (int32 x = 0; x < fDestWidth; x++, to += 2)
+					::memcpy(to, from + sourceX[x], 2);
+				break;
+			default:
+				for (int32 x = 0; x < fDestWidth; x++, to += fPixelSize)
+					::memcpy(to, from + sourceX[x], fPixelSize);
+				break;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SCALER_H
+#define __SCALER_H
+
+#include "Platform.h"
+
+#include <vector>
+
+class ThreadPool;
+
+enum scale_filter {
+	B_SCALE_NEAREST = 0,
+	B_SCALE_BILINEAR,
+	// Area average when reducing
+	B_SCALE_BOX,
+	B_SCALE_LANCZOS
+};
+
+// Software image scaler, independent from app_server.
+// Apart from B_SCALE_NEAREST, every destination row is the vertical sum of
+// horizontally scaled source rows, kept in a small window while they're
+// needed. The kernel coefficients are computed once, in fixed point.
+// Both directions work on 8 bit BGRA pixels:
+// 32 bit color spaces are read and written as they are, 24, 16 and 15 bit
+// ones are expanded on the way in and packed again on the way out.
+// B_CMAP8 can only be scaled with B_SCALE_NEAREST.
+class Scaler {
+public:
+	Scaler(int32 sourceWidth, int32 sourceHeight, int32 destWidth,
+		int32 destHeight, color_space colorSpace, scale_filter filter);
+	~Scaler();
+
+	status_t InitCheck() const;
+
+	// Source and destination are in the scaler color space, and must not
+	// overlap. With a pool, the passes are split in bands of rows among its
+	// threads. Only one thread at a time can use a scaler.
+	status_t Scale(const void* source, int32 sourceBytesPerRow,
+		void* dest, int32 destBytesPerRow, ThreadPool* pool = NULL);
+
+	// Scales only the destination rows from "firstRow" to "lastRow",
+	// excluded, with "scratch" as working memory of ScratchSize() bytes.
+	// Different bands of rows can be scaled at the same time, each with
+	// its own scratch.
+	status_t ScaleRows(const void* source, int32 sourceBytesPerRow,
+		void* dest, int32 destBytesPerRow, int32 firstRow, int32 lastRow,
+		uint8* scratch) const;
+	size_t ScratchSize() const;
+
+	static bool IsSupported(color_space colorSpace, scale_filter filter);
+
+private:
+	// Kernel of one direction: destination pixel i is the sum of
+	// "counts[i]" source pixels from "starts[i]", weighted with the
+	// coefficients at "i * taps"
+	struct scale_axis {
+		std::vector<int32>	starts;
+		std::vector<int32>	counts;
+		std::vector<int16>	coefficients;
+		int32				taps;
+	};
+
+	struct scale_job;
+
+	void _BuildAxis(int32 sourceSize, int32 destSize, scale_axis& axis);
+	static void _ScaleJob(void* cookie, int32 band);
+	void _NearestRows(const uint8* source, int32 sourceBytesPerRow,
+		uint8* dest, int32 destBytesPerRow, int32 firstRow,
+		int32 lastRow) const;
+
+	int32			fSourceWidth;
+	int32			fSourceHeight;
+	int32			fDestWidth;
+	int32			fDestHeight;
+	color_space		fColorSpace;
+	scale_filter	fFilter;
+	int32			fPixelSize;
+
+	scale_axis		fHorizontal;
+	scale_axis		fVertical;
+	// B_SCALE_NEAREST only
+	std::vector<int32> fSourceX;
+	std::vector<int32> fSourceY;
+
+	// Layout of the scratch memory of ScaleRows()
+	size_t			fScratchSize;
+	size_t			fSlotsOffset;
+	size_t			fWindowOffset;
+	size_t			fRowBufferOffset;
+	// Scratch of every band, for Scale()
+	std::vector<uint8> fScratch;
+
+	status_t		fInitStatus;
+
+	Scaler(const Scaler&);
+	Scaler& operator=(const Scaler&);
+};
+
+#endif // __SCALER_H
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "SceneDetector.h"
+
+#include "ColorConversion.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const static int32 kBlockSize = 8;
+// BT.601 luma, the weights add up to 256
+const static int16 kBlueWeight = 29;
+const static int16 kGreenWeight = 150;
+const static int16 kRedWeight = 77;
+const static int32 kHistogramSize = 8;
+
+
+static inline uint8
+BlockLuma(uint32 sum, int32 pixels)
+{
+	return uint8((sum + pixels * 128) / (pixels * 256));
+}
+
+
+// One sample for every kBlockSize pixels of a B_RGB32 row
+static void
+ReduceRow(const uint8* bits, int32 width, uint8* samples)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	const __m128i weights = _mm_set_epi16(0, kRedWeight, kGreenWeight,
+		kBlueWeight, 0, kRedWeight, kGreenWeight, kBlueWeight);
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + kBlockSize <= width; x += kBlockSize) {
+		const __m128i* pixels = reinterpret_cast<const __m128i*>(bits + x * 4);
+		const __m128i first = _mm_loadu_si128(pixels);
+		const __m128i second = _mm_loadu_si128(pixels + 1);
+		// Blue and green of a pixel in one lane, red in the next one
+		__m128i sum = _mm_add_epi32(
+			_mm_madd_epi16(_mm_unpacklo_epi8(first, zero), weights),
+			_mm_madd_epi16(_mm_unpackhi_epi8(first, zero), weights));
+		sum = _mm_add_epi32(sum,
+			_mm_madd_epi16(_mm_unpacklo_epi8(second, zero), weights));
+		sum = _mm_add_epi32(sum,
+			_mm_madd_epi16(_mm_unpackhi_epi8(second, zero), weights));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		*samples++ = BlockLuma(_mm_cvtsi128_si32(sum), kBlockSize);
+	}
+#endif
+	for (; x < width; x += kBlockSize) {
+		const int32 pixels = std::min(width - x, kBlockSize);
+		const uint8* pixel = bits + x * 4;
+		uint32 sum = 0;
+		for (int32 i = 0; i < pixels; i++, pixel += 4) {
+			sum += pixel[0] * kBlueWeight + pixel[1] * kGreenWeight
+				+ pixel[2] * kRedWeight;
+		}
+		*samples++ = BlockLuma(sum, pixels);
+	}
+}
+
+
+static uint64
+SumOfAbsoluteDifferences(const uint8* first, const uint8* second, size_t size)
+{
+	uint64 sum = 0;
+	size_t i = 0;
+#if defined(__SSE2__)
+	__m128i total = _mm_setzero_si128();
+	for (; i + 16 <= size; i += 16) {
+		total = _mm_add_epi64(total, _mm_sad_epu8(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i))));
+	}
+	total = _mm_add_epi64(total, _mm_unpackhi_epi64(total, total));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(&sum), total);
+#endif
+	for (; i < size; i++)
+		sum += first[i] > second[i] ? first[i] - second[i] : second[i] - first[i];
+	return sum;
+}
+
+
+SceneDetector::SceneDetector(int32 threshold, int32 maxInterval)
+	:
+	fThreshold(std::max(threshold, int32(0))),
+	fMaxInterval(std::max(maxInterval, int32(0))),
+	fPlaneWidth(0),
+	fPlaneHeight(0)
+{
+	Reset();
+}
+
+
+void
+SceneDetector::Reset()
+{
+	fPrevious.clear();
+	fSinceKeyFrame = -1;
+	fLastDifference = 0;
+	fFrames = 0;
+	fSceneKeyFrames = 0;
+	fIntervalKeyFrames = 0;
+	fDifferenceSum = 0;
+	fMaxDifference = 0;
+	for (int32 i = 0; i < kHistogramSize; i++)
+		fHistogram[i] = 0;
+}
+
+
+bool
+SceneDetector::IsKeyFrame(const BBitmap* frame, bool unchanged)
+{
+	// The first frame of the movie always is one
+	bool keyFrame = fSinceKeyFrame < 0;
+	float difference = 0;
+	// Without a threshold, there's nothing to compare the frames for
+	if (fThreshold > 0 && (!unchanged || fSinceKeyFrame < 0)) {
+		if (_ReduceFrame(frame)) {
+			// A frame of another size is a new scene, too
+			if (fPrevious.size() != fPlane.size())
+				keyFrame = true;
+			else
+				difference = _Difference();
+			fPlane.swap(fPrevious);
+		} else {
+			// Nothing to compare the next frame with
+			fPrevious.clear();
+		}
+	}
+	fLastDifference = difference;
+
+	if (!keyFrame && fThreshold > 0 && difference >= fThreshold) {
+		keyFrame = true;
+		fSceneKeyFrames++;
+	}
+	if (!keyFrame && fMaxInterval > 0 && fSinceKeyFrame + 1 >= fMaxInterval) {
+		keyFrame = true;
+		fIntervalKeyFrames++;
+	}
+	fSinceKeyFrame = keyFrame ? 0 : fSinceKeyFrame + 1;
+
+	fFrames++;
+	fDifferenceSum += difference;
+	fMaxDifference = std::max(fMaxDifference, difference);
+	int32 bucket = 0;
+	if (difference >= 1) {
+		bucket = std::min(int32(::log2f(difference)) + 1,
+			int32(kHistogramSize - 1));
+	}
+	fHistogram[bucket]++;
+
+	return keyFrame;
+}
+
+
+float
+SceneDetector::LastDifference() const
+{
+	return fLastDifference;
+}
+
+
+void
+SceneDetector::PrintStatistics(const char* name) const
+{
+	std::cout << name << ": " << fFrames << " frames, ";
+	std::cout << fSceneKeyFrames << " key frames at scene changes, ";
+	std::cout << fIntervalKeyFrames << " at the maximum interval." << std::endl;
+	std::cout << "Frame difference: mean ";
+	std::cout << (fFrames > 0 ? fDifferenceSum / fFrames : 0);
+	std::cout << ", max " << fMaxDifference << ", threshold " << fThreshold;
+	std::cout << "." << std::endl;
+	std::cout << "Frames by difference:";
+	for (int32 i = 0; i < kHistogramSize - 1; i++)
+		std::cout << " <" << (1 << i) << ": " << fHistogram[i] << ",";
+	std::cout << " >=" << (1 << (kHistogramSize - 2)) << ": ";
+	std::cout << fHistogram[kHistogramSize - 1] << std::endl;
+}
+
+
+// Only the middle row of every block is read
+bool
+SceneDetector::_ReduceFrame(const BBitmap* frame)
+{
+	if (frame == NULL)
+		return false;
+	const color_space colorSpace = frame->ColorSpace();
+	if (!IsConvertibleColorSpace(colorSpace))
+		return false;
+
+	const int32 width = frame->Bounds().IntegerWidth() + 1;
+	const int32 height = frame->Bounds().IntegerHeight() + 1;
+	const bool convert = colorSpace != B_RGB32 && colorSpace != B_RGBA32;
+	try {
+		fPlaneWidth = (width + kBlockSize - 1) / kBlockSize;
+		fPlaneHeight = (height + kBlockSize - 1) / kBlockSize;
+		fPlane.resize(fPlaneWidth * fPlaneHeight);
+		if (convert)
+			fRow.resize(width * 4);
+	} catch (...) {
+		return false;
+	}
+
+	const uint8* bits = static_cast<const uint8*>(frame->Bits());
+	const int32 bytesPerRow = frame->BytesPerRow();
+	for (int32 y = 0; y < fPlaneHeight; y++) {
+		const int32 row = std::min(y * kBlockSize + kBlockSize / 2, height - 1);
+		const uint8* source = bits + row * bytesPerRow;
+		if (convert) {
+			ConvertRowToRGB32(source, &fRow[0], width, colorSpace);
+			source = &fRow[0];
+		}
+		ReduceRow(source, width, &fPlane[y * fPlaneWidth]);
+	}
+	return true;
+}
+
+
+float
+SceneDetector::_Difference() const
+{
+	if (fPlane.empty())
+		return 0;
+	return float(SumOfAbsoluteDifferences(&fPlane[0], &fPrevious[0],
+		fPlane.size())) / fPlane.size();
+}
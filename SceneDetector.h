@@ -0,0 +1,65 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SCENEDETECTOR_H
+#define __SCENEDETECTOR_H
+
+#include <SupportDefs.h>
+
+#include <vector>
+
+class BBitmap;
+
+// Places the key frames of a movie where its content changes, instead of
+// at a fixed interval. Every frame is reduced to a small luma plane, one
+// sample for every block of 8x8 pixels, and compared with the plane of
+// the frame before it: the difference is the mean of the absolute
+// differences of the samples, from 0 (same frame) to 255.
+class SceneDetector {
+public:
+	// A frame differing by "threshold" or more starts a new scene.
+	// With a threshold of 0, there's only a key frame every
+	// "maxInterval" frames, and the frames aren't looked at.
+	SceneDetector(int32 threshold, int32 maxInterval);
+
+	// Starts a new movie: the next frame is a key frame
+	void Reset();
+
+	// To be called for every frame of the movie, in order, and
+	// repeated frames too. Returns true if it must be a key frame.
+	// An unchanged frame isn't looked at.
+	bool IsKeyFrame(const BBitmap* frame, bool unchanged);
+	// Difference of the last frame from the one before it
+	float LastDifference() const;
+
+	void PrintStatistics(const char* name) const;
+
+private:
+	bool _ReduceFrame(const BBitmap* frame);
+	float _Difference() const;
+
+	int32				fThreshold;
+	int32				fMaxInterval;
+
+	std::vector<uint8>	fPlane;
+	std::vector<uint8>	fPrevious;
+	// For the color spaces which have to be converted first
+	std::vector<uint8>	fRow;
+	int32				fPlaneWidth;
+	int32				fPlaneHeight;
+
+	// -1 before the first frame
+	int32				fSinceKeyFrame;
+	float				fLastDifference;
+
+	int32				fFrames;
+	int32				fSceneKeyFrames;
+	int32				fIntervalKeyFrames;
+	double				fDifferenceSum;
+	float				fMaxDifference;
+	// Frames by difference: below 1, 2, 4, ... 64, and 64 or more
+	int32				fHistogram[8];
+};
+
+#endif // __SCENEDETECTOR_H
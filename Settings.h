@@ -68,6 +68,11 @@ public:
 	int32 CaptureFrameRate() const;
 	void SetCaptureFrameRate(const int32& value);
 
+	// 0 keeps the timing of the capture. Above the capture frame rate,
+	// the movie is a time-lapse
+	int32 PlaybackFrameRate() const;
+	void SetPlaybackFrameRate(const int32& value);
+
 	void SetWarnOnQuit(const bool& warn);
 	bool WarnOnQuit() const;
 
@@ -83,9 +88,68 @@ public:
 	int32 EncodingThreadPriority() const;
 	void SetEncodingThreadPriority(const int32 &value);
 
+	// One of encoder_preset
+	int32 EncoderPreset() const;
+	void SetEncoderPreset(const int32& preset);
+
 	bool DockingMode() const;
 	void SetDockingMode(const bool& value);
 
+	int32 FramePoolSize() const;
+	void SetFramePoolSize(const int32& size);
+
+	int32 SpoolCodec() const;
+	void SetSpoolCodec(const int32& codec);
+
+	int32 SpoolCompressionLevel() const;
+	void SetSpoolCompressionLevel(const int32& level);
+
+	// In MB. 0 never keeps frames in memory.
+	int32 SpoolMemoryLimit() const;
+	void SetSpoolMemoryLimit(const int32& megabytes);
+
+	// Keeps capturing the last seconds, to be saved with a shortcut.
+	// The replay frames are kept in memory, compressed with the LZ
+	// codec unless SpoolCodec() is raw: the tiles and delta codecs
+	// need the frames before, which the replay throws away.
+	bool InstantReplay() const;
+	void SetInstantReplay(const bool& enable);
+	int32 ReplayLength() const;
+	void SetReplayLength(const int32& seconds);
+
+	// Encodes the frames while recording, instead of after. Off by default.
+	bool StreamEncoding() const;
+	void SetStreamEncoding(const bool& enable);
+
+	// Encodes parts of the movie on all the CPUs, then joins them
+	bool ParallelEncoding() const;
+	void SetParallelEncoding(const bool& enable);
+
+	// Frames are reduced to the target size as they're captured, so that
+	// the spool only gets the smaller ones
+	bool ScaleWhileCapturing() const;
+	void SetScaleWhileCapturing(const bool& enable);
+
+	// Ordered dithering of the GIF frames which have too many colors
+	bool GIFDither() const;
+	void SetGIFDither(const bool& enable);
+	// A single palette for the whole GIF, instead of one per frame
+	bool GIFGlobalPalette() const;
+	void SetGIFGlobalPalette(const bool& enable);
+
+	// Frames are written at their capture time, in the file formats
+	// which allow it
+	bool VariableFrameRate() const;
+	void SetVariableFrameRate(const bool& enable);
+
+	// Frames differing more than this from the one before them
+	// are key frames. 0 leaves only the maximum interval.
+	int32 SceneChangeThreshold() const;
+	void SetSceneChangeThreshold(const int32& threshold);
+	// Maximum number of frames between two key frames
+	int32 KeyFrameInterval() const;
+	void SetKeyFrameInterval(const int32& frames);
+
 	void PrintToStream();
 
 private:
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "SpoolRing.h"
+
+
+SpoolRing::SpoolRing()
+	:
+	fFirst(0),
+	fCount(0),
+	fHead(0),
+	fMemorySize(0),
+	fMemoryUsed(0),
+	fLength(0)
+{
+}
+
+
+status_t
+SpoolRing::Init(off_t memorySize, bigtime_t length, int32 capacity)
+{
+	if (memorySize <= 0 || length <= 0 || capacity <= 0)
+		return B_BAD_VALUE;
+	try {
+		fRecords.resize(capacity);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	fMemorySize = memorySize;
+	fLength = length;
+	fFirst = 0;
+	fCount = 0;
+	fHead = 0;
+	fMemoryUsed = 0;
+	return B_OK;
+}
+
+
+void
+SpoolRing::Clear()
+{
+	fRecords.clear();
+	fFirst = 0;
+	fCount = 0;
+	fHead = 0;
+	fMemorySize = 0;
+	fMemoryUsed = 0;
+	fLength = 0;
+}
+
+
+status_t
+SpoolRing::Reserve(off_t size, bigtime_t timeStamp, off_t* offset)
+{
+	if (fRecords.empty())
+		return B_NO_INIT;
+	// Some records must fit, or the ring would overwrite
+	// records still being written
+	if (size <= 0 || size > fMemorySize / 4)
+		return B_NO_MEMORY;
+
+	// Records are contiguous: start over if it doesn't fit at the end.
+	// What's left from the head on are the oldest records, which would
+	// be out of order with the ones overwritten from now on.
+	off_t leftoversStart = fMemorySize;
+	if (fHead + size > fMemorySize) {
+		leftoversStart = fHead;
+		fHead = 0;
+	}
+	const off_t start = fHead;
+	const off_t end = start + size;
+	_Drop(start, end, leftoversStart);
+
+	status_t status = _Push(timeStamp, start, size);
+	if (status != B_OK)
+		return status;
+
+	fHead = end;
+	*offset = start;
+	return B_OK;
+}
+
+
+status_t
+SpoolRing::AddDuplicate(bigtime_t timeStamp)
+{
+	return _Push(timeStamp, -1, 0);
+}
+
+
+int32
+SpoolRing::CountRecords() const
+{
+	return fCount;
+}
+
+
+const SpoolRing::record&
+SpoolRing::RecordAt(int32 index) const
+{
+	return fRecords[(fFirst + index) % fRecords.size()];
+}
+
+
+off_t
+SpoolRing::MemoryUsed() const
+{
+	return fMemoryUsed;
+}
+
+
+// Drops the records which overlap "start" to "end", and the ones from
+// "leftoversStart" on, wherever they are in the ring, and the duplicates
+// which repeat them. The others keep their order.
+void
+SpoolRing::_Drop(off_t start, off_t end, off_t leftoversStart)
+{
+	const int32 capacity = fRecords.size();
+	int32 kept = 0;
+	// A duplicate at the start has nothing to repeat
+	bool repeatedDropped = true;
+	for (int32 i = 0; i < fCount; i++) {
+		const record current = fRecords[(fFirst + i) % capacity];
+		bool drop = repeatedDropped;
+		if (current.offset >= 0) {
+			drop = current.offset >= leftoversStart
+				|| (current.offset < end && current.offset + current.size > start);
+			repeatedDropped = drop;
+		}
+		if (drop) {
+			fMemoryUsed -= current.size;
+			continue;
+		}
+		if (kept != i)
+			fRecords[(fFirst + kept) % capacity] = current;
+		kept++;
+	}
+	fCount = kept;
+}
+
+
+// Drops the records which are too old, or for which there's no room, and
+// the duplicates left at the start, which have nothing to repeat anymore
+status_t
+SpoolRing::_Push(bigtime_t timeStamp, off_t offset, off_t size)
+{
+	if (fRecords.empty())
+		return B_NO_INIT;
+
+	const int32 capacity = fRecords.size();
+	while (fCount > 0) {
+		const record& oldest = fRecords[fFirst];
+		if (fCount < capacity && oldest.time_stamp >= timeStamp - fLength
+			&& oldest.offset >= 0)
+			break;
+		fMemoryUsed -= oldest.size;
+		fFirst = (fFirst + 1) % capacity;
+		fCount--;
+	}
+
+	record& newest = fRecords[(fFirst + fCount) % capacity];
+	newest.time_stamp = timeStamp;
+	newest.offset = offset;
+	newest.size = size;
+	fCount++;
+	fMemoryUsed += size;
+	return B_OK;
+}
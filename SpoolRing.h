@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SPOOLRING_H
+#define __SPOOLRING_H
+
+#include "Platform.h"
+
+#include <sys/types.h>
+#include <vector>
+
+// Where the records of a spool in ring mode go in its memory, and which
+// ones are still there. The records are written one after the other,
+// and start over from the beginning of the memory when the next one
+// doesn't fit at the end. The ones in the way, and the ones left at the
+// end when it starts over, are dropped, with the duplicates which repeat
+// them. Not thread safe: FrameSpool holds its index lock.
+class SpoolRing {
+public:
+	// A record, or a duplicate of the one before it
+	struct record {
+		bigtime_t	time_stamp;
+		// From the start of the memory, -1 for a duplicate
+		off_t		offset;
+		off_t		size;
+	};
+
+	SpoolRing();
+
+	// Holds up to "capacity" records, none older than "length" than the
+	// newest one, in "memorySize" bytes. Only allocates here.
+	status_t Init(off_t memorySize, bigtime_t length, int32 capacity);
+	void Clear();
+
+	// Finds room for a record of "size" bytes, and adds it as the newest
+	status_t Reserve(off_t size, bigtime_t timeStamp, off_t* offset);
+	status_t AddDuplicate(bigtime_t timeStamp);
+
+	// Oldest first
+	int32 CountRecords() const;
+	const record& RecordAt(int32 index) const;
+	off_t MemoryUsed() const;
+
+private:
+	void _Drop(off_t start, off_t end, off_t leftoversStart);
+	status_t _Push(bigtime_t timeStamp, off_t offset, off_t size);
+
+	std::vector<record>	fRecords;
+	int32				fFirst;
+	int32				fCount;
+	off_t				fHead;
+	off_t				fMemorySize;
+	off_t				fMemoryUsed;
+	bigtime_t			fLength;
+};
+
+#endif // __SPOOLRING_H
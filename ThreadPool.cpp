@@ -0,0 +1,190 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <new>
+
+
+ThreadPool::ThreadPool(const char* name, int32 threads, int32 priority)
+	:
+	fRunSem(-1),
+	fStartSem(-1),
+	fDoneSem(-1),
+	fThreads(NULL),
+	fNumThreads(0),
+	fQuitting(false),
+	fInitStatus(B_NO_INIT),
+	fFunction(NULL),
+	fCookie(NULL),
+	fJobCount(0),
+	fNextJob(0)
+{
+	fRunSem = create_sem(1, "thread pool run");
+	if (fRunSem < 0) {
+		fInitStatus = fRunSem;
+		return;
+	}
+
+	// The calling thread does its share of the work
+	const int32 workers = threads - 1;
+	if (workers <= 0) {
+		fInitStatus = B_OK;
+		return;
+	}
+
+	fStartSem = create_sem(0, "thread pool start");
+	if (fStartSem < 0) {
+		fInitStatus = fStartSem;
+		return;
+	}
+	fDoneSem = create_sem(0, "thread pool done");
+	if (fDoneSem < 0) {
+		fInitStatus = fDoneSem;
+		return;
+	}
+
+	fThreads = new (std::nothrow) thread_id[workers];
+	if (fThreads == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	for (int32 i = 0; i < workers; i++) {
+		char threadName[B_OS_NAME_LENGTH];
+		::snprintf(threadName, sizeof(threadName), "%s %" B_PRId32, name,
+			i + 1);
+		thread_id thread = spawn_thread((thread_entry)_WorkerStarter,
+			threadName, priority, this);
+		if (thread >= 0 && resume_thread(thread) != B_OK) {
+			kill_thread(thread);
+			thread = -1;
+		}
+		if (thread < 0) {
+			// Work with the ones we have
+			break;
+		}
+		fThreads[fNumThreads++] = thread;
+	}
+
+	fInitStatus = B_OK;
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	fQuitting = true;
+	if (fNumThreads > 0)
+		release_sem_etc(fStartSem, fNumThreads, 0);
+	for (int32 i = 0; i < fNumThreads; i++) {
+		status_t dummy;
+		wait_for_thread(fThreads[i], &dummy);
+	}
+	delete[] fThreads;
+
+	if (fStartSem >= 0)
+		delete_sem(fStartSem);
+	if (fDoneSem >= 0)
+		delete_sem(fDoneSem);
+	if (fRunSem >= 0)
+		delete_sem(fRunSem);
+}
+
+
+status_t
+ThreadPool::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+int32
+ThreadPool::CountThreads() const
+{
+	return fNumThreads + 1;
+}
+
+
+void
+ThreadPool::Run(int32 count, parallel_func function, void* cookie)
+{
+	status_t status;
+	do {
+		status = acquire_sem(fRunSem);
+	} while (status == B_INTERRUPTED);
+	if (status != B_OK)
+		return;
+
+	fFunction = function;
+	fCookie = cookie;
+	fJobCount = count;
+	fNextJob = 0;
+
+	// No point in waking up more threads than jobs
+	const int32 helpers = std::min(fNumThreads, count - 1);
+	if (helpers > 0)
+		release_sem_etc(fStartSem, helpers, 0);
+
+	_RunJobs();
+
+	// Wait for the jobs still running on the other threads
+	if (helpers > 0) {
+		do {
+			status = acquire_sem_etc(fDoneSem, helpers, 0, 0);
+		} while (status == B_INTERRUPTED);
+	}
+
+	release_sem(fRunSem);
+}
+
+
+/* static */
+int32
+ThreadPool::DefaultThreadCount()
+{
+	system_info info;
+	if (get_system_info(&info) != B_OK || info.cpu_count < 1)
+		return 1;
+	return info.cpu_count;
+}
+
+
+/* static */
+int32
+ThreadPool::_WorkerStarter(void* arg)
+{
+	return static_cast<ThreadPool*>(arg)->_WorkerThread();
+}
+
+
+int32
+ThreadPool::_WorkerThread()
+{
+	for (;;) {
+		status_t status = acquire_sem(fStartSem);
+		if (status == B_INTERRUPTED)
+			continue;
+		if (status != B_OK || fQuitting)
+			break;
+
+		_RunJobs();
+		release_sem(fDoneSem);
+	}
+	return B_OK;
+}
+
+
+void
+ThreadPool::_RunJobs()
+{
+	for (;;) {
+		const int32 job = atomic_add(&fNextJob, 1);
+		if (job >= fJobCount)
+			break;
+		fFunction(fCookie, job);
+	}
+}
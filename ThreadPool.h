@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include "Platform.h"
+
+typedef void (*parallel_func)(void* cookie, int32 index);
+
+// A fixed set of threads, started once, which split a job in parts.
+class ThreadPool {
+public:
+	// "threads" counts the calling thread too: a pool of one thread
+	// doesn't start any
+	ThreadPool(const char* name, int32 threads,
+		int32 priority = B_NORMAL_PRIORITY);
+	~ThreadPool();
+
+	status_t InitCheck() const;
+	int32 CountThreads() const;
+
+	// Calls function(cookie, i) for every i from 0 to count - 1, on the
+	// pool threads and on the calling thread, and returns when all the
+	// calls are done. Calls from different threads are serialized.
+	void Run(int32 count, parallel_func function, void* cookie);
+
+	static int32 DefaultThreadCount();
+
+private:
+	static int32 _WorkerStarter(void* arg);
+	int32 _WorkerThread();
+	void _RunJobs();
+
+	// Serializes Run()
+	sem_id			fRunSem;
+	sem_id			fStartSem;
+	sem_id			fDoneSem;
+	thread_id*		fThreads;
+	int32			fNumThreads;
+	bool			fQuitting;
+	status_t		fInitStatus;
+
+	// current job
+	parallel_func	fFunction;
+	void*			fCookie;
+	int32			fJobCount;
+	int32			fNextJob;
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif // __THREADPOOL_H
@@ -25,6 +25,20 @@
 
 // TODO: Refactor
 
+struct ffmpeg_file_format {
+	const char* prettyName;
+	const char* shortName;
+	const char* extension;
+	const char* muxer;
+};
+
+// Haiku can't write these yet: see IsFileFormatUsable()
+static const ffmpeg_file_format kFFMPEGFileFormats[] = {
+	{ "AVI (ffmpeg)", "ffmpeg_avi", "avi", "avi" },
+	{ "Matroska (ffmpeg)", "ffmpeg_matroska", "mkv",
+		"matroska" }
+};
+
 void
 PrintMediaFormat(const media_format& format)
 {
@@ -64,6 +78,26 @@ IsFileFormatUsable(const media_file_format& format)
 }
 
 
+// Containers which store a time for every frame
+bool
+IsVariableFrameRateFormat(const media_file_format& format)
+{
+	static const char* variableFrameRateFormats[] = {
+		"matroska",
+		"webm",
+		"mp4",
+		"mov"
+	};
+
+	for (size_t i = 0; i < sizeof(variableFrameRateFormats)
+			/ sizeof(variableFrameRateFormats[0]); i++) {
+		if (::strcmp(format.short_name, variableFrameRateFormats[i]) == 0)
+			return true;
+	}
+	return false;
+}
+
+
 bool
 IsFFMPEGAvailable()
 {
@@ -96,6 +130,13 @@ GetMediaFileFormat(const BString& prettyName, media_file_format* outFormat)
 		MakeGIFMediaFileFormat(*outFormat);
 		return true;
 	}
+	for (int32 i = 0; i < CountFFMPEGMediaFileFormats(); i++) {
+		if (prettyName == kFFMPEGFileFormats[i].prettyName
+			&& IsFFMPEGAvailable()) {
+			MakeFFMPEGMediaFileFormat(i, *outFormat);
+			return true;
+		}
+	}
 	return false;
 }
 
@@ -122,6 +163,36 @@ MakeNULLMediaFileFormat(media_file_format& outFormat)
 }
 
 
+int32
+CountFFMPEGMediaFileFormats()
+{
+	return sizeof(kFFMPEGFileFormats) / sizeof(kFFMPEGFileFormats[0]);
+}
+
+
+void
+MakeFFMPEGMediaFileFormat(int32 index, media_file_format& outFormat)
+{
+	const ffmpeg_file_format& format = kFFMPEGFileFormats[index];
+	::strlcpy(outFormat.pretty_name, format.prettyName, sizeof(outFormat.pretty_name));
+	::strlcpy(outFormat.short_name, format.shortName, sizeof(outFormat.short_name));
+	outFormat.capabilities = media_file_format::B_KNOWS_OTHER;
+	::strlcpy(outFormat.file_extension, format.extension, sizeof(outFormat.file_extension));
+	outFormat.family = B_ANY_FORMAT_FAMILY;
+}
+
+
+const char*
+FFMPEGMuxerName(const media_file_format& format)
+{
+	for (int32 i = 0; i < CountFFMPEGMediaFileFormats(); i++) {
+		if (::strcmp(format.short_name, kFFMPEGFileFormats[i].shortName) == 0)
+			return kFFMPEGFileFormats[i].muxer;
+	}
+	return NULL;
+}
+
+
 BPath
 GetUniqueFileName(const BPath& filePath)
 {
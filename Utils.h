@@ -19,9 +19,15 @@ class BString;
 void PrintMediaFormat(const media_format& format);
 bool IsFileFormatUsable(const media_file_format&);
 bool IsFFMPEGAvailable();
+bool IsVariableFrameRateFormat(const media_file_format&);
 bool GetMediaFileFormat(const BString& prettyName, media_file_format* outFormat);
 void MakeGIFMediaFileFormat(media_file_format& outFormat);
 void MakeNULLMediaFileFormat(media_file_format& outFormat);
+// Formats written by piping the frames to ffmpeg
+int32 CountFFMPEGMediaFileFormats();
+void MakeFFMPEGMediaFileFormat(int32 index, media_file_format& outFormat);
+// NULL if the format isn't written by ffmpeg
+const char* FFMPEGMuxerName(const media_file_format& format);
 
 BPath GetUniqueFileName(const BPath& fileName);
 void FixRect(BRect &rect, const BRect& maxRect, const bool fixWidth = false, const bool fixHeight = false);
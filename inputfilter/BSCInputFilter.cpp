@@ -124,7 +124,7 @@ BSCInputFilter::Filter(BMessage* message, BList* outList)
 			if ((modifiers & B_CONTROL_KEY)
 					&& (modifiers & B_COMMAND_KEY)
 					&& (modifiers & B_SHIFT_KEY)) {
-				if (key == 'r') {
+				if (key == 'r' || key == 's') {
 					int32 repeat;
 					if (message->FindInt32("be:key_repeat", &repeat) == B_OK) {
 						// Ignore repeat keypresses
@@ -132,7 +132,17 @@ BSCInputFilter::Filter(BMessage* message, BList* outList)
 					}
 					if (message->what == B_KEY_UP
 						|| message->what == B_UNMAPPED_KEY_UP) {
-						// Only toggle record on keydown
+						// Only act on keydown
+						return B_SKIP_MESSAGE;
+					}
+
+					if (key == 's') {
+						// Save the instant replay. Nothing to save
+						// if the app isn't running.
+						if (be_roster->IsRunning(kAppSignature)) {
+							BMessenger messenger(kAppSignature);
+							messenger.SendMessage(kMsgGUISaveReplay);
+						}
 						return B_SKIP_MESSAGE;
 					}
 
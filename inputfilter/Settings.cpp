@@ -30,14 +30,30 @@ const static char *kOutputFile = "output file";
 const static char *kOutputFileFormat = "output file format";
 const static char *kOutputCodecName = "output codec";
 const static char *kThreadPriority = "thread priority";
+const static char *kEncoderPreset = "encoder preset";
 const static char *kWindowFrameBorderSize = "window frame border size";
 const static char *kCaptureFrameRate = "capture frame rate";
+const static char *kPlaybackFrameRate = "playback frame rate";
 const static char *kWarnOnQuit = "warn on quit";
 const static char *kQuitWhenFinished = "quit when finished";
 const static char *kEnableShortcut = "enable shortcut";
 const static char *kSelectOnStart = "select on start";
 const static char *kDockingMode = "docking mode";
 const static char *kHideDeskbarIcon = "hide deskbar icon";
+const static char *kFramePoolSize = "frame pool size";
+const static char *kSpoolCodec = "spool codec";
+const static char *kSpoolCompressionLevel = "spool compression level";
+const static char *kSpoolMemoryLimit = "spool memory limit";
+const static char *kInstantReplay = "instant replay";
+const static char *kReplayLength = "replay length";
+const static char *kStreamEncoding = "stream encoding";
+const static char *kParallelEncoding = "parallel encoding";
+const static char *kScaleWhileCapturing = "scale while capturing";
+const static char *kGIFDither = "gif dither";
+const static char *kGIFGlobalPalette = "gif global palette";
+const static char *kVariableFrameRate = "variable frame rate";
+const static char *kSceneChangeThreshold = "scene change threshold";
+const static char *kKeyFrameInterval = "key frame interval";
 
 
 /* static */
@@ -135,6 +151,8 @@ Settings::Load()
 			fSettings->SetString(kOutputCodecName, string);
 		if (tempMessage.FindInt32(kThreadPriority, &integer) == B_OK)
 			fSettings->SetInt32(kThreadPriority, integer);
+		if (tempMessage.FindInt32(kEncoderPreset, &integer) == B_OK)
+			fSettings->SetInt32(kEncoderPreset, integer);
 		if (tempMessage.FindInt32(kWindowFrameBorderSize, &integer) == B_OK)
 			fSettings->SetInt32(kWindowFrameBorderSize, integer);
 		if (tempMessage.FindBool(kWarnOnQuit, &boolean) == B_OK)
@@ -143,12 +161,42 @@ Settings::Load()
 			fSettings->SetBool(kQuitWhenFinished, boolean);
 		if (tempMessage.FindInt32(kCaptureFrameRate, &integer) == B_OK)
 			fSettings->SetInt32(kCaptureFrameRate, integer);
+		if (tempMessage.FindInt32(kPlaybackFrameRate, &integer) == B_OK)
+			fSettings->SetInt32(kPlaybackFrameRate, integer);
 		if (tempMessage.FindBool(kDockingMode, &boolean) == B_OK)
 			fSettings->SetBool(kDockingMode, boolean);
 		if (tempMessage.FindBool(kEnableShortcut, &boolean) == B_OK)
 			fSettings->SetBool(kEnableShortcut, boolean);
 		if (tempMessage.FindBool(kSelectOnStart, &boolean) == B_OK)
 			fSettings->SetBool(kSelectOnStart, boolean);
+		if (tempMessage.FindInt32(kFramePoolSize, &integer) == B_OK)
+			fSettings->SetInt32(kFramePoolSize, integer);
+		if (tempMessage.FindInt32(kSpoolCodec, &integer) == B_OK)
+			fSettings->SetInt32(kSpoolCodec, integer);
+		if (tempMessage.FindInt32(kSpoolCompressionLevel, &integer) == B_OK)
+			fSettings->SetInt32(kSpoolCompressionLevel, integer);
+		if (tempMessage.FindInt32(kSpoolMemoryLimit, &integer) == B_OK)
+			fSettings->SetInt32(kSpoolMemoryLimit, integer);
+		if (tempMessage.FindBool(kInstantReplay, &boolean) == B_OK)
+			fSettings->SetBool(kInstantReplay, boolean);
+		if (tempMessage.FindInt32(kReplayLength, &integer) == B_OK)
+			fSettings->SetInt32(kReplayLength, integer);
+		if (tempMessage.FindBool(kStreamEncoding, &boolean) == B_OK)
+			fSettings->SetBool(kStreamEncoding, boolean);
+		if (tempMessage.FindBool(kParallelEncoding, &boolean) == B_OK)
+			fSettings->SetBool(kParallelEncoding, boolean);
+		if (tempMessage.FindBool(kScaleWhileCapturing, &boolean) == B_OK)
+			fSettings->SetBool(kScaleWhileCapturing, boolean);
+		if (tempMessage.FindBool(kGIFDither, &boolean) == B_OK)
+			fSettings->SetBool(kGIFDither, boolean);
+		if (tempMessage.FindBool(kGIFGlobalPalette, &boolean) == B_OK)
+			fSettings->SetBool(kGIFGlobalPalette, boolean);
+		if (tempMessage.FindBool(kVariableFrameRate, &boolean) == B_OK)
+			fSettings->SetBool(kVariableFrameRate, boolean);
+		if (tempMessage.FindInt32(kSceneChangeThreshold, &integer) == B_OK)
+			fSettings->SetInt32(kSceneChangeThreshold, integer);
+		if (tempMessage.FindInt32(kKeyFrameInterval, &integer) == B_OK)
+			fSettings->SetInt32(kKeyFrameInterval, integer);
 	}
 
 	return status;
@@ -411,6 +459,24 @@ Settings::SetCaptureFrameRate(const int32& value)
 }
 
 
+int32
+Settings::PlaybackFrameRate() const
+{
+	BAutolock _(fLocker);
+	int32 value = 0;
+	fSettings->FindInt32(kPlaybackFrameRate, &value);
+	return value;
+}
+
+
+void
+Settings::SetPlaybackFrameRate(const int32& value)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kPlaybackFrameRate, value);
+}
+
+
 void
 Settings::SetWarnOnQuit(const bool& warn)
 {
@@ -501,6 +567,24 @@ Settings::EncodingThreadPriority() const
 }
 
 
+int32
+Settings::EncoderPreset() const
+{
+	BAutolock _(fLocker);
+	int32 preset = 1;
+	fSettings->FindInt32(kEncoderPreset, &preset);
+	return preset;
+}
+
+
+void
+Settings::SetEncoderPreset(const int32& preset)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kEncoderPreset, preset);
+}
+
+
 bool
 Settings::DockingMode() const
 {
@@ -519,6 +603,258 @@ Settings::SetDockingMode(const bool& value)
 }
 
 
+int32
+Settings::FramePoolSize() const
+{
+	BAutolock _(fLocker);
+	int32 size = 8;
+	fSettings->FindInt32(kFramePoolSize, &size);
+	return size;
+}
+
+
+void
+Settings::SetFramePoolSize(const int32& size)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kFramePoolSize, size);
+}
+
+
+int32
+Settings::SpoolCodec() const
+{
+	BAutolock _(fLocker);
+	int32 codec = 1;
+	fSettings->FindInt32(kSpoolCodec, &codec);
+	return codec;
+}
+
+
+void
+Settings::SetSpoolCodec(const int32& codec)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kSpoolCodec, codec);
+}
+
+
+int32
+Settings::SpoolCompressionLevel() const
+{
+	BAutolock _(fLocker);
+	int32 level = 1;
+	fSettings->FindInt32(kSpoolCompressionLevel, &level);
+	return level;
+}
+
+
+void
+Settings::SetSpoolCompressionLevel(const int32& level)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kSpoolCompressionLevel, level);
+}
+
+
+int32
+Settings::SpoolMemoryLimit() const
+{
+	BAutolock _(fLocker);
+	int32 megabytes = 512;
+	fSettings->FindInt32(kSpoolMemoryLimit, &megabytes);
+	return megabytes;
+}
+
+
+void
+Settings::SetSpoolMemoryLimit(const int32& megabytes)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kSpoolMemoryLimit, megabytes);
+}
+
+
+bool
+Settings::InstantReplay() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kInstantReplay, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetInstantReplay(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kInstantReplay, enable);
+}
+
+
+int32
+Settings::ReplayLength() const
+{
+	BAutolock _(fLocker);
+	int32 seconds = 30;
+	fSettings->FindInt32(kReplayLength, &seconds);
+	return seconds;
+}
+
+
+void
+Settings::SetReplayLength(const int32& seconds)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kReplayLength, seconds);
+}
+
+
+bool
+Settings::StreamEncoding() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kStreamEncoding, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetStreamEncoding(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kStreamEncoding, enable);
+}
+
+
+bool
+Settings::ParallelEncoding() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kParallelEncoding, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetParallelEncoding(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kParallelEncoding, enable);
+}
+
+
+bool
+Settings::ScaleWhileCapturing() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kScaleWhileCapturing, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetScaleWhileCapturing(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kScaleWhileCapturing, enable);
+}
+
+
+bool
+Settings::GIFDither() const
+{
+	BAutolock _(fLocker);
+	bool enable = true;
+	fSettings->FindBool(kGIFDither, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetGIFDither(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kGIFDither, enable);
+}
+
+
+bool
+Settings::GIFGlobalPalette() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kGIFGlobalPalette, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetGIFGlobalPalette(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kGIFGlobalPalette, enable);
+}
+
+
+bool
+Settings::VariableFrameRate() const
+{
+	BAutolock _(fLocker);
+	bool enable = true;
+	fSettings->FindBool(kVariableFrameRate, &enable);
+	return enable;
+}
+
+
+void
+Settings::SetVariableFrameRate(const bool& enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kVariableFrameRate, enable);
+}
+
+
+int32
+Settings::SceneChangeThreshold() const
+{
+	BAutolock _(fLocker);
+	int32 threshold = 16;
+	fSettings->FindInt32(kSceneChangeThreshold, &threshold);
+	return threshold;
+}
+
+
+void
+Settings::SetSceneChangeThreshold(const int32& threshold)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kSceneChangeThreshold, threshold);
+}
+
+
+int32
+Settings::KeyFrameInterval() const
+{
+	BAutolock _(fLocker);
+	int32 frames = 250;
+	fSettings->FindInt32(kKeyFrameInterval, &frames);
+	return frames;
+}
+
+
+void
+Settings::SetKeyFrameInterval(const int32& frames)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kKeyFrameInterval, frames);
+}
+
+
 void
 Settings::PrintToStream()
 {
@@ -565,17 +901,33 @@ Settings::_SetDefaults()
 	fSettings->SetInt32(kClipDepth, B_RGB32);
 	fSettings->SetBool(kIncludeCursor, true);
 	fSettings->SetInt32(kThreadPriority, B_NORMAL_PRIORITY);
+	fSettings->SetInt32(kEncoderPreset, 1);
 	fSettings->SetBool(kMinimize, false);
 	fSettings->SetString(kOutputFileFormat, "");
 	fSettings->SetString(kOutputCodecName, "");
 	fSettings->SetInt32(kWindowFrameBorderSize, 0);
 	fSettings->SetInt32(kCaptureFrameRate, 20);
+	fSettings->SetInt32(kPlaybackFrameRate, 0);
 	fSettings->SetBool(kWarnOnQuit, true);
 	fSettings->SetBool(kQuitWhenFinished, false);
 	fSettings->SetBool(kDockingMode, false);
 	fSettings->SetBool(kEnableShortcut, false);
 	fSettings->SetBool(kSelectOnStart, false);
 	fSettings->SetBool(kHideDeskbarIcon, false);
+	fSettings->SetInt32(kFramePoolSize, 8);
+	fSettings->SetInt32(kSpoolCodec, 1);
+	fSettings->SetInt32(kSpoolCompressionLevel, 1);
+	fSettings->SetInt32(kSpoolMemoryLimit, 512);
+	fSettings->SetBool(kInstantReplay, false);
+	fSettings->SetInt32(kReplayLength, 30);
+	fSettings->SetBool(kStreamEncoding, false);
+	fSettings->SetBool(kParallelEncoding, false);
+	fSettings->SetBool(kScaleWhileCapturing, false);
+	fSettings->SetBool(kGIFDither, true);
+	fSettings->SetBool(kGIFGlobalPalette, false);
+	fSettings->SetBool(kVariableFrameRate, true);
+	fSettings->SetInt32(kSceneChangeThreshold, 16);
+	fSettings->SetInt32(kKeyFrameInterval, 250);
 	return B_OK;
 }
 
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// ConvertBits() against what the conversions went through before it: a row
+// at a time through a B_RGBA32 row, like the old ColorConvertFilter did,
+// and, on Haiku, drawing the frame into a bitmap of the other color space,
+// like ImageFilterScale did.
+
+#include "ColorConversion.h"
+
+#ifdef __HAIKU__
+#include <Application.h>
+#include <Bitmap.h>
+#include <View.h>
+#endif
+
+#include <OS.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const static int32 kWidth = 1920;
+const static int32 kHeight = 1080;
+const static int32 kRuns = 20;
+
+struct conversion_pair {
+	color_space	from;
+	color_space	to;
+};
+
+const static conversion_pair kPairs[] = {
+	{ B_RGB32, B_RGB16 },
+	{ B_RGB32, B_RGB15 },
+	{ B_RGB32, B_RGB24 },
+	{ B_RGB32, B_RGBA32 },
+	{ B_RGB32, B_CMAP8 },
+	{ B_RGB32, B_YCbCr422 },
+	{ B_RGB16, B_RGB32 },
+	{ B_RGB24, B_RGB32 },
+	{ B_RGB32, B_YUV420 }
+};
+
+
+// The row conversions as they were before ConvertBits()
+static void
+PreviousRowToRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace)
+{
+	if (colorSpace == B_RGB32 || colorSpace == B_RGBA32) {
+		::memcpy(to, from, width * 4);
+		return;
+	}
+
+	for (int32 x = 0; x < width; x++, to += 4) {
+		if (colorSpace == B_RGB24) {
+			to[0] = from[0];
+			to[1] = from[1];
+			to[2] = from[2];
+			to[3] = 255;
+			from += 3;
+			continue;
+		}
+
+		uint16 pixel;
+		::memcpy(&pixel, from, sizeof(pixel));
+		from += sizeof(pixel);
+		const uint8 blue = pixel & 0x1f;
+		to[0] = (blue << 3) | (blue >> 2);
+		if (colorSpace == B_RGB16) {
+			const uint8 green = (pixel >> 5) & 0x3f;
+			const uint8 red = pixel >> 11;
+			to[1] = (green << 2) | (green >> 4);
+			to[2] = (red << 3) | (red >> 2);
+			to[3] = 255;
+		} else {
+			const uint8 green = (pixel >> 5) & 0x1f;
+			const uint8 red = (pixel >> 10) & 0x1f;
+			to[1] = (green << 3) | (green >> 2);
+			to[2] = (red << 3) | (red >> 2);
+			to[3] = colorSpace == B_RGBA15 && (pixel & 0x8000) == 0 ? 0 : 255;
+		}
+	}
+}
+
+
+static void
+PreviousRowFromRGB32(const uint8* from, uint8* to, int32 width,
+	color_space colorSpace)
+{
+	if (colorSpace == B_RGB32 || colorSpace == B_RGBA32) {
+		::memcpy(to, from, width * 4);
+		return;
+	}
+
+	for (int32 x = 0; x < width; x++, from += 4) {
+		if (colorSpace == B_RGB24) {
+			to[0] = from[0];
+			to[1] = from[1];
+			to[2] = from[2];
+			to += 3;
+			continue;
+		}
+
+		uint16 pixel;
+		if (colorSpace == B_RGB16) {
+			pixel = ((from[2] >> 3) << 11) | ((from[1] >> 2) << 5)
+				| (from[0] >> 3);
+		} else {
+			pixel = ((from[2] >> 3) << 10) | ((from[1] >> 3) << 5)
+				| (from[0] >> 3);
+			if (colorSpace == B_RGBA15 && from[3] >= 128)
+				pixel |= 0x8000;
+		}
+		::memcpy(to, &pixel, sizeof(pixel));
+		to += sizeof(pixel);
+	}
+}
+
+
+static bool
+PreviousCanConvert(color_space colorSpace)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+		case B_RGB24:
+		case B_RGB16:
+		case B_RGB15:
+		case B_RGBA15:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+// The band loop of the old ColorConvertFilter
+static void
+PreviousConvert(const uint8* from, int32 fromBytesPerRow,
+	color_space fromColorSpace, uint8* to, int32 toBytesPerRow,
+	color_space toColorSpace, uint8* scratch)
+{
+	const bool fromRGB32 = fromColorSpace == B_RGB32
+		|| fromColorSpace == B_RGBA32;
+	for (int32 y = 0; y < kHeight; y++) {
+		const uint8* row = from;
+		if (!fromRGB32) {
+			PreviousRowToRGB32(from, scratch, kWidth, fromColorSpace);
+			row = scratch;
+		}
+		PreviousRowFromRGB32(row, to, kWidth, toColorSpace);
+		if (fromColorSpace == B_RGB32 && toColorSpace == B_RGBA32) {
+			for (int32 x = 0; x < kWidth; x++)
+				to[x * 4 + 3] = 255;
+		}
+		from += fromBytesPerRow;
+		to += toBytesPerRow;
+	}
+}
+
+
+static const char*
+Name(color_space colorSpace)
+{
+	if (colorSpace == B_YUV420)
+		return "B_YUV420 (planar)";
+	const color_space_traits* traits = GetColorSpaceTraits(colorSpace);
+	return traits != NULL ? traits->name : "?";
+}
+
+
+static void
+PrintTime(const char* what, bigtime_t time)
+{
+	printf("  %-24s %8.2f ms\n", what, time / 1000.0 / kRuns);
+}
+
+
+static void
+Benchmark(const conversion_pair& pair, const std::vector<uint8>& source)
+{
+	const int32 fromBytesPerRow = int32(RowLength(pair.from, kWidth));
+	const bool planar = pair.to == B_YUV420;
+	const int32 toBytesPerRow = planar ? kWidth
+		: int32(RowLength(pair.to, kWidth));
+	const int32 chromaWidth = (kWidth + 1) / 2;
+	const size_t toSize = size_t(toBytesPerRow) * kHeight
+		+ (planar ? 2 * size_t(chromaWidth) * ((kHeight + 1) / 2) : 0);
+	std::vector<uint8> dest(toSize);
+
+	printf("%s to %s:\n", Name(pair.from), Name(pair.to));
+
+	bigtime_t start = system_time();
+	for (int32 run = 0; run < kRuns; run++) {
+		if (planar) {
+			uint8* cb = &dest[0] + size_t(kWidth) * kHeight;
+			uint8* cr = cb + size_t(chromaWidth) * ((kHeight + 1) / 2);
+			ConvertToPlanarYUV420(&source[0], fromBytesPerRow, pair.from,
+				&dest[0], kWidth, cb, cr, chromaWidth, kWidth, kHeight);
+		} else {
+			ConvertBits(&source[0], fromBytesPerRow, pair.from, &dest[0],
+				toBytesPerRow, pair.to, kWidth, kHeight);
+		}
+	}
+	PrintTime("ConvertBits()", system_time() - start);
+
+	if (PreviousCanConvert(pair.from) && PreviousCanConvert(pair.to)) {
+		std::vector<uint8> scratch(size_t(kWidth) * 4);
+		start = system_time();
+		for (int32 run = 0; run < kRuns; run++) {
+			PreviousConvert(&source[0], fromBytesPerRow, pair.from, &dest[0],
+				toBytesPerRow, pair.to, &scratch[0]);
+		}
+		PrintTime("previous row by row", system_time() - start);
+	}
+
+#ifdef __HAIKU__
+	if (planar)
+		return;
+	const BRect bounds(0, 0, kWidth - 1, kHeight - 1);
+	BBitmap sourceBitmap(bounds, 0, pair.from, fromBytesPerRow);
+	BBitmap destBitmap(bounds, B_BITMAP_ACCEPTS_VIEWS, pair.to);
+	if (sourceBitmap.InitCheck() != B_OK || destBitmap.InitCheck() != B_OK) {
+		printf("  %-24s not supported\n", "DrawBitmap()");
+		return;
+	}
+	::memcpy(sourceBitmap.Bits(), &source[0], sourceBitmap.BitsLength());
+	BView* view = new BView(bounds, "benchmark", B_FOLLOW_NONE, 0);
+	destBitmap.AddChild(view);
+	destBitmap.Lock();
+	start = system_time();
+	for (int32 run = 0; run < kRuns; run++) {
+		view->DrawBitmap(&sourceBitmap, sourceBitmap.Bounds(), view->Bounds());
+		view->Sync();
+	}
+	PrintTime("DrawBitmap()", system_time() - start);
+	destBitmap.Unlock();
+#endif
+}
+
+
+int
+main()
+{
+#ifdef __HAIKU__
+	BApplication application("application/x-vnd.BeScreenCapture-benchmark");
+#endif
+
+	uint32 seed = 1;
+	std::vector<uint8> source(size_t(kWidth) * kHeight * 4);
+	for (size_t i = 0; i < source.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		source[i] = seed >> 16;
+	}
+
+	printf("%" B_PRId32 "x%" B_PRId32 ", %" B_PRId32 " runs, time per "
+		"frame\n", kWidth, kHeight, kRuns);
+	for (size_t i = 0; i < sizeof(kPairs) / sizeof(kPairs[0]); i++)
+		Benchmark(kPairs[i], source);
+	return 0;
+}
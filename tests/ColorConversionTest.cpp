@@ -0,0 +1,363 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Every pair of color spaces ColorConversion knows about: the round trips
+// give the pixels back, exactly when the color space in the middle keeps
+// all of their bits, and the SSE2 code gives the same bytes as the scalar
+// one. Nothing is written past the end of a row.
+
+#include "ScalarColorConversion.h"
+
+#ifdef __HAIKU__
+#include <Application.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+const static color_space kColorSpaces[] = {
+	B_RGB32, B_RGBA32, B_RGB24, B_RGB16, B_RGB15, B_RGBA15, B_CMAP8,
+	B_YCbCr422, B_YCbCr420
+};
+const static int32 kColorSpaceCount = sizeof(kColorSpaces)
+	/ sizeof(kColorSpaces[0]);
+
+// Odd ones, and ones around the vector sizes and the chunks
+const static int32 kWidths[] = {
+	1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 63, 255, 256, 257, 300, 513
+};
+
+// Written past the end of the rows, and checked after the conversion
+const static int32 kPadding = 16;
+const static uint8 kPaddingByte = 0xab;
+
+static int32 sChecks = 0;
+static int32 sFailures = 0;
+
+
+static void
+Check(bool condition, const char* what, color_space from, color_space to,
+	int32 width)
+{
+	sChecks++;
+	if (condition)
+		return;
+	sFailures++;
+	const color_space_traits* fromTraits = GetColorSpaceTraits(from);
+	const color_space_traits* toTraits = GetColorSpaceTraits(to);
+	printf("FAILED: %s, %s to %s, %" B_PRId32 " pixels wide\n", what,
+		fromTraits != NULL ? fromTraits->name : "?",
+		toTraits != NULL ? toTraits->name : "?", width);
+}
+
+
+static uint32
+Random(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+
+// An image in a color space, with some padding after every row
+struct test_image {
+	color_space			colorSpace;
+	int32				width;
+	int32				height;
+	int32				bytesPerRow;
+	std::vector<uint8>	bits;
+
+	test_image(color_space space, int32 imageWidth, int32 imageHeight)
+		:
+		colorSpace(space),
+		width(imageWidth),
+		height(imageHeight),
+		bytesPerRow(int32(RowLength(space, imageWidth)) + kPadding),
+		bits(size_t(bytesPerRow) * imageHeight, kPaddingByte)
+	{
+	}
+
+	uint8* Row(int32 y)
+	{
+		return &bits[size_t(y) * bytesPerRow];
+	}
+
+	bool PaddingIntact() const
+	{
+		const size_t length = RowLength(colorSpace, width);
+		for (int32 y = 0; y < height; y++) {
+			const uint8* row = &bits[size_t(y) * bytesPerRow];
+			for (size_t x = length; x < size_t(bytesPerRow); x++) {
+				if (row[x] != kPaddingByte)
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+
+static status_t
+Convert(test_image& from, test_image& to)
+{
+	return ConvertBits(from.Row(0), from.bytesPerRow, from.colorSpace,
+		to.Row(0), to.bytesPerRow, to.colorSpace, from.width, from.height);
+}
+
+
+// Bits every channel keeps, as B, G, R, A
+static void
+ChannelBits(color_space colorSpace, int32* bits)
+{
+	const int32 alpha = colorSpace == B_RGBA32 ? 8
+		: (colorSpace == B_RGBA15 || colorSpace == B_CMAP8 ? 1 : 0);
+	for (int32 channel = 0; channel < 3; channel++)
+		bits[channel] = 8;
+	bits[3] = alpha;
+	if (colorSpace == B_RGB16) {
+		bits[0] = 5;
+		bits[1] = 6;
+		bits[2] = 5;
+	} else if (colorSpace == B_RGB15 || colorSpace == B_RGBA15) {
+		for (int32 channel = 0; channel < 3; channel++)
+			bits[channel] = 5;
+	}
+}
+
+
+// How far a channel can be off after going from "from" through "through"
+// and back. The palette and YCbCr are the only lossy ones in both
+// directions; the others lose the low bits they don't keep.
+static int32
+Tolerance(color_space from, color_space through)
+{
+	int32 fromBits[4];
+	int32 throughBits[4];
+	ChannelBits(from, fromBits);
+	ChannelBits(through, throughBits);
+	int32 tolerance = 0;
+	for (int32 channel = 0; channel < 3; channel++) {
+		if (throughBits[channel] < fromBits[channel]) {
+			tolerance = std::max(tolerance,
+				(1 << (8 - throughBits[channel])) - 1);
+		}
+	}
+	// Up to a step of the cube of the palette. Its colors are looked up
+	// with 5 bits per channel, and can come back as a close one.
+	if (through == B_CMAP8)
+		tolerance = std::max(tolerance, int32(51));
+	if (from == B_CMAP8)
+		tolerance = std::max(tolerance, int32(15));
+	// Rounding, in both directions, which can take a channel to the next
+	// step of the source when it keeps fewer bits
+	if (GetColorSpaceTraits(from)->isYCbCr
+		|| GetColorSpaceTraits(through)->isYCbCr) {
+		int32 rounding = 4;
+		for (int32 channel = 0; channel < 3; channel++)
+			rounding = std::max(rounding, int32(1 << (8 - fromBits[channel])));
+		tolerance += rounding;
+	}
+	return tolerance;
+}
+
+
+static bool
+HasAlpha(color_space colorSpace)
+{
+	return GetColorSpaceTraits(colorSpace)->hasAlpha;
+}
+
+
+// "from" to "through" and back, compared as B_RGBA32. The source pixels
+// are fully opaque or fully transparent, if both keep the alpha channel,
+// and the same in every 2x2 block with YCbCr, which shares the chroma.
+static void
+TestRoundTrip(color_space from, color_space through, uint32& seed)
+{
+	const bool ycbcr = GetColorSpaceTraits(from)->isYCbCr
+		|| GetColorSpaceTraits(through)->isYCbCr;
+	const bool alpha = HasAlpha(from) && HasAlpha(through);
+	const int32 width = 37;
+	// The last row of an odd B_YCbCr420 image has no Cr of its own
+	const int32 height = from == B_YCbCr420 || through == B_YCbCr420 ? 10 : 9;
+
+	test_image pixels(B_RGBA32, width, height);
+	for (int32 y = 0; y < height; y++) {
+		uint8* row = pixels.Row(y);
+		for (int32 x = 0; x < width; x++) {
+			uint8* pixel = row + x * 4;
+			if (ycbcr && (y & 1) != 0) {
+				::memcpy(pixel, pixels.Row(y - 1) + x * 4, 4);
+				continue;
+			}
+			if (ycbcr && (x & 1) != 0) {
+				::memcpy(pixel, pixel - 4, 4);
+				continue;
+			}
+			const uint32 value = Random(seed);
+			pixel[0] = value;
+			pixel[1] = value >> 8;
+			pixel[2] = value >> 16;
+			pixel[3] = alpha && (value & 0x1000000) != 0 ? 0 : 255;
+		}
+	}
+
+	test_image source(from, width, height);
+	test_image middle(through, width, height);
+	test_image back(from, width, height);
+	test_image expected(B_RGBA32, width, height);
+	test_image result(B_RGBA32, width, height);
+	status_t status = Convert(pixels, source);
+	if (status == B_OK)
+		status = Convert(source, middle);
+	if (status == B_OK)
+		status = Convert(middle, back);
+	if (status == B_OK)
+		status = Convert(source, expected);
+	if (status == B_OK)
+		status = Convert(back, result);
+	Check(status == B_OK, "round trip status", from, through, width);
+	if (status != B_OK)
+		return;
+	Check(middle.PaddingIntact() && back.PaddingIntact(),
+		"round trip padding", from, through, width);
+
+	const int32 tolerance = Tolerance(from, through);
+	const int32 channels = alpha ? 4 : 3;
+	int32 error = 0;
+	for (int32 y = 0; y < height; y++) {
+		const uint8* expectedRow = expected.Row(y);
+		const uint8* resultRow = result.Row(y);
+		for (int32 x = 0; x < width; x++) {
+			for (int32 channel = 0; channel < channels; channel++) {
+				error = std::max(error, std::abs(
+					int32(expectedRow[x * 4 + channel])
+					- int32(resultRow[x * 4 + channel])));
+			}
+		}
+	}
+	if (error > tolerance) {
+		printf("Round trip off by %" B_PRId32 ", up to %" B_PRId32
+			" expected\n", error, tolerance);
+	}
+	Check(error <= tolerance, tolerance == 0
+		? "round trip isn't exact" : "round trip is too far off",
+		from, through, width);
+}
+
+
+static void
+FillRandom(test_image& image, uint32& seed)
+{
+	const size_t length = RowLength(image.colorSpace, image.width);
+	for (int32 y = 0; y < image.height; y++) {
+		uint8* row = image.Row(y);
+		for (size_t x = 0; x < length; x++)
+			row[x] = Random(seed);
+	}
+}
+
+
+// Any bytes, as long as the color space is one of the pair
+static void
+TestScalar(color_space from, color_space to, int32 width, uint32& seed)
+{
+	const int32 height = 5;
+	test_image source(from, width, height);
+	FillRandom(source, seed);
+
+	test_image vector(to, width, height);
+	test_image scalar(to, width, height);
+	status_t vectorStatus = Convert(source, vector);
+	status_t scalarStatus = ScalarConvertBits(source.Row(0),
+		source.bytesPerRow, from, scalar.Row(0), scalar.bytesPerRow, to,
+		width, height);
+	Check(vectorStatus == B_OK && scalarStatus == B_OK, "convert status",
+		from, to, width);
+	Check(vector.bits == scalar.bits, "SSE2 and scalar conversions differ",
+		from, to, width);
+	Check(vector.PaddingIntact(), "convert padding", from, to, width);
+
+	// The dithering pattern lines up with the row of the image
+	test_image vectorDither(to, width, height);
+	test_image scalarDither(to, width, height);
+	vectorStatus = DitherBits(source.Row(0), source.bytesPerRow, from,
+		vectorDither.Row(0), vectorDither.bytesPerRow, to, width, height, 3);
+	scalarStatus = ScalarDitherBits(source.Row(0), source.bytesPerRow, from,
+		scalarDither.Row(0), scalarDither.bytesPerRow, to, width, height, 3);
+	Check(vectorStatus == B_OK && scalarStatus == B_OK, "dither status",
+		from, to, width);
+	Check(vectorDither.bits == scalarDither.bits,
+		"SSE2 and scalar dithering differ", from, to, width);
+	Check(vectorDither.PaddingIntact(), "dither padding", from, to, width);
+}
+
+
+static void
+TestPlanarScalar(color_space from, int32 width, uint32& seed)
+{
+	const int32 height = 5;
+	test_image source(from, width, height);
+	FillRandom(source, seed);
+
+	const int32 chromaWidth = (width + 1) / 2;
+	const int32 chromaHeight = (height + 1) / 2;
+	std::vector<uint8> planes[2];
+	for (int32 i = 0; i < 2; i++) {
+		planes[i].assign(size_t(width) * height
+			+ 2 * size_t(chromaWidth) * chromaHeight, kPaddingByte);
+	}
+	uint8* y[2];
+	uint8* cb[2];
+	uint8* cr[2];
+	for (int32 i = 0; i < 2; i++) {
+		y[i] = &planes[i][0];
+		cb[i] = y[i] + size_t(width) * height;
+		cr[i] = cb[i] + size_t(chromaWidth) * chromaHeight;
+	}
+	status_t vectorStatus = ConvertToPlanarYUV420(source.Row(0),
+		source.bytesPerRow, from, y[0], width, cb[0], cr[0], chromaWidth,
+		width, height);
+	status_t scalarStatus = ScalarConvertToPlanarYUV420(source.Row(0),
+		source.bytesPerRow, from, y[1], width, cb[1], cr[1], chromaWidth,
+		width, height);
+	Check(vectorStatus == B_OK && scalarStatus == B_OK, "planar status",
+		from, B_YUV420, width);
+	Check(planes[0] == planes[1], "SSE2 and scalar planar 4:2:0 differ",
+		from, B_YUV420, width);
+}
+
+
+int
+main()
+{
+#ifdef __HAIKU__
+	// For the system palette
+	BApplication application("application/x-vnd.BeScreenCapture-tests");
+#endif
+
+	uint32 seed = 1;
+	for (int32 i = 0; i < kColorSpaceCount; i++) {
+		for (int32 j = 0; j < kColorSpaceCount; j++) {
+			const color_space from = kColorSpaces[i];
+			const color_space to = kColorSpaces[j];
+			Check(CanConvertColorSpace(from, to), "can't convert", from, to,
+				0);
+			if (from != to)
+				TestRoundTrip(from, to, seed);
+			for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); w++)
+				TestScalar(from, to, kWidths[w], seed);
+		}
+		for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); w++)
+			TestPlanarScalar(kColorSpaces[i], kWidths[w], seed);
+	}
+
+	printf("ColorConversion: %" B_PRId32 " checks, %" B_PRId32 " failed\n",
+		sChecks, sFailures);
+	return sFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SCALARCOLORCONVERSION_H
+#define __SCALARCOLORCONVERSION_H
+
+// ColorConversion.cpp is built a second time without its SSE2 parts, with
+// this header forced in first and SCALAR_BUILD defined: what it declares
+// gets other names, so that the tests can tell the two builds apart.
+
+#ifndef SCALAR_BUILD
+#include "ColorConversion.h"
+#undef __COLORCONVERSION_H
+#endif
+
+#define color_space_traits scalar_color_space_traits
+#define GetColorSpaceTraits ScalarGetColorSpaceTraits
+#define RowLength ScalarRowLength
+#define CanConvertColorSpace ScalarCanConvertColorSpace
+#define ConvertBits ScalarConvertBits
+#define DitherBits ScalarDitherBits
+#define ConvertToPlanarYUV420 ScalarConvertToPlanarYUV420
+#define IsConvertibleColorSpace ScalarIsConvertibleColorSpace
+#define ConvertRowToRGB32 ScalarConvertRowToRGB32
+#define ConvertRowFromRGB32 ScalarConvertRowFromRGB32
+
+#include "ColorConversion.h"
+
+#ifndef SCALAR_BUILD
+#undef color_space_traits
+#undef GetColorSpaceTraits
+#undef RowLength
+#undef CanConvertColorSpace
+#undef ConvertBits
+#undef DitherBits
+#undef ConvertToPlanarYUV420
+#undef IsConvertibleColorSpace
+#undef ConvertRowToRGB32
+#undef ConvertRowFromRGB32
+#endif
+
+#endif // __SCALARCOLORCONVERSION_H
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// The Scaler filters, alone and with a thread pool, against what
+// ImageFilterScale did before it: drawing the frame into a smaller bitmap
+// with DrawBitmap(), on Haiku only, since it goes through app_server.
+
+#include "Scaler.h"
+#include "ThreadPool.h"
+
+#ifdef __HAIKU__
+#include <Application.h>
+#include <Bitmap.h>
+#include <View.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const static int32 kWidth = 1920;
+const static int32 kHeight = 1080;
+const static int32 kRuns = 10;
+
+const static int32 kDestSizes[][2] = {
+	{ 960, 540 },
+	{ 1280, 720 }
+};
+
+const static scale_filter kFilters[] = {
+	B_SCALE_NEAREST, B_SCALE_BILINEAR, B_SCALE_BOX, B_SCALE_LANCZOS
+};
+const static char* kFilterNames[] = {
+	"B_SCALE_NEAREST", "B_SCALE_BILINEAR", "B_SCALE_BOX", "B_SCALE_LANCZOS"
+};
+
+
+static void
+PrintTime(const char* what, const char* how, bigtime_t time)
+{
+	printf("  %-18s %-12s %8.2f ms\n", what, how, time / 1000.0 / kRuns);
+}
+
+
+#ifdef __HAIKU__
+// As ImageFilterScale::ApplyFilter() did it, with the default filtering
+// and with the bilinear one
+static void
+BenchmarkDrawBitmap(const std::vector<uint8>& source, int32 width,
+	int32 height)
+{
+	BBitmap sourceBitmap(BRect(0, 0, kWidth - 1, kHeight - 1), 0, B_RGB32,
+		kWidth * 4);
+	BBitmap destBitmap(BRect(0, 0, width - 1, height - 1),
+		B_BITMAP_ACCEPTS_VIEWS, B_RGB32);
+	if (sourceBitmap.InitCheck() != B_OK || destBitmap.InitCheck() != B_OK) {
+		printf("  DrawBitmap() can't be timed\n");
+		return;
+	}
+	::memcpy(sourceBitmap.Bits(), &source[0], sourceBitmap.BitsLength());
+	BView* view = new BView(destBitmap.Bounds(), "benchmark", B_FOLLOW_NONE,
+		0);
+	destBitmap.AddChild(view);
+
+	const uint32 options[] = { 0, B_FILTER_BITMAP_BILINEAR };
+	const char* optionNames[] = { "default", "bilinear" };
+	for (int32 i = 0; i < 2; i++) {
+		destBitmap.Lock();
+		const bigtime_t start = system_time();
+		for (int32 run = 0; run < kRuns; run++) {
+			view->DrawBitmap(&sourceBitmap, sourceBitmap.Bounds(),
+				view->Bounds(), options[i]);
+			view->Sync();
+		}
+		PrintTime("DrawBitmap()", optionNames[i], system_time() - start);
+		destBitmap.Unlock();
+	}
+}
+#endif
+
+
+int
+main()
+{
+#ifdef __HAIKU__
+	BApplication application("application/x-vnd.BeScreenCapture-benchmark");
+#endif
+
+	ThreadPool pool("scaler benchmark", ThreadPool::DefaultThreadCount());
+	if (pool.InitCheck() != B_OK) {
+		printf("Can't start the thread pool\n");
+		return 1;
+	}
+
+	uint32 seed = 1;
+	std::vector<uint8> source(size_t(kWidth) * kHeight * 4);
+	for (size_t i = 0; i < source.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		source[i] = seed >> 16;
+	}
+
+	printf("B_RGB32, %" B_PRId32 " runs, %" B_PRId32 " threads, time per "
+		"frame\n", kRuns, pool.CountThreads());
+	for (size_t d = 0; d < sizeof(kDestSizes) / sizeof(kDestSizes[0]); d++) {
+		const int32 width = kDestSizes[d][0];
+		const int32 height = kDestSizes[d][1];
+		std::vector<uint8> dest(size_t(width) * height * 4);
+		printf("%" B_PRId32 "x%" B_PRId32 " to %" B_PRId32 "x%" B_PRId32
+			":\n", kWidth, kHeight, width, height);
+#ifdef __HAIKU__
+		BenchmarkDrawBitmap(source, width, height);
+#endif
+		for (size_t f = 0; f < sizeof(kFilters) / sizeof(kFilters[0]); f++) {
+			Scaler scaler(kWidth, kHeight, width, height, B_RGB32,
+				kFilters[f]);
+			if (scaler.InitCheck() != B_OK)
+				continue;
+			for (int32 usePool = 0; usePool < 2; usePool++) {
+				ThreadPool* threads = usePool != 0 ? &pool : NULL;
+				// The first one warms up the caches and the threads
+				scaler.Scale(&source[0], kWidth * 4, &dest[0], width * 4,
+					threads);
+				const bigtime_t start = system_time();
+				for (int32 run = 0; run < kRuns; run++) {
+					scaler.Scale(&source[0], kWidth * 4, &dest[0], width * 4,
+						threads);
+				}
+				PrintTime(kFilterNames[f], usePool != 0 ? "thread pool"
+					: "alone", system_time() - start);
+			}
+		}
+	}
+	return 0;
+}
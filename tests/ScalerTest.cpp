@@ -0,0 +1,441 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Every filter, in every color space it supports, keeps an image of one
+// color as it is, at any size, and doesn't write past the end of the rows.
+// With a thread pool, or one band at a time, the result is the same.
+// Known answers, in a 32 bit and in packed color spaces: B_SCALE_NEAREST
+// picks the source pixel under the center of the destination one,
+// B_SCALE_BOX halves an image to the means of its 2x2 blocks, and
+// B_SCALE_BILINEAR and B_SCALE_LANCZOS follow a ramp.
+
+#include "ColorConversion.h"
+#include "Scaler.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const static color_space kColorSpaces[] = {
+	B_RGB32, B_RGBA32, B_RGB24, B_RGB16, B_RGB15, B_RGBA15, B_CMAP8
+};
+
+const static scale_filter kFilters[] = {
+	B_SCALE_NEAREST, B_SCALE_BILINEAR, B_SCALE_BOX, B_SCALE_LANCZOS
+};
+
+// Source and destination width and height: reductions, enlargements,
+// both at once, and rows or columns of one pixel
+const static int32 kSizes[][4] = {
+	{ 64, 48, 32, 24 },
+	{ 100, 80, 37, 91 },
+	{ 17, 9, 200, 150 },
+	{ 1, 1, 5, 3 },
+	{ 640, 480, 640, 480 },
+	{ 33, 1, 7, 1 },
+	{ 5, 300, 300, 5 }
+};
+
+// The known answers are checked in these
+const static color_space kKnownAnswerColorSpaces[] = {
+	B_RGB32, B_RGB24, B_RGB16
+};
+
+// Written past the end of the rows, and checked after scaling
+const static int32 kPadding = 7;
+const static uint8 kPaddingByte = 0xcd;
+
+static int32 sChecks = 0;
+static int32 sFailures = 0;
+
+
+static void
+Check(bool condition, const char* what, color_space colorSpace,
+	scale_filter filter, const int32* size)
+{
+	sChecks++;
+	if (condition)
+		return;
+	sFailures++;
+	printf("FAILED: %s, color space 0x%x, filter %d, %" B_PRId32 "x%"
+		B_PRId32 " to %" B_PRId32 "x%" B_PRId32 "\n", what,
+		unsigned(colorSpace), int(filter), size[0], size[1], size[2],
+		size[3]);
+}
+
+
+static int32
+PixelSize(color_space colorSpace)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+			return 4;
+		case B_RGB24:
+			return 3;
+		case B_CMAP8:
+			return 1;
+		default:
+			return 2;
+	}
+}
+
+
+static void
+FillPixel(uint8* pixel, color_space colorSpace)
+{
+	const uint8 bgra[] = { 10, 200, 77, 255 };
+	uint16 value = colorSpace == B_RGBA15 ? 0x9234 : 0x1234;
+	switch (PixelSize(colorSpace)) {
+		case 4:
+		case 3:
+			::memcpy(pixel, bgra, PixelSize(colorSpace));
+			break;
+		case 2:
+			::memcpy(pixel, &value, sizeof(value));
+			break;
+		default:
+			pixel[0] = 42;
+			break;
+	}
+}
+
+
+static void
+TestConstant(ThreadPool& pool, color_space colorSpace, scale_filter filter,
+	const int32* size, bool usePool)
+{
+	const int32 pixelSize = PixelSize(colorSpace);
+	const int32 sourceBytesPerRow = size[0] * pixelSize + kPadding;
+	const int32 destBytesPerRow = size[2] * pixelSize + kPadding;
+	std::vector<uint8> source(size_t(sourceBytesPerRow) * size[1]);
+	std::vector<uint8> dest(size_t(destBytesPerRow) * size[3], kPaddingByte);
+	for (int32 y = 0; y < size[1]; y++) {
+		for (int32 x = 0; x < size[0]; x++)
+			FillPixel(&source[y * sourceBytesPerRow + x * pixelSize], colorSpace);
+	}
+
+	Scaler scaler(size[0], size[1], size[2], size[3], colorSpace, filter);
+	status_t status = scaler.InitCheck();
+	if (status == B_OK) {
+		status = scaler.Scale(&source[0], sourceBytesPerRow, &dest[0],
+			destBytesPerRow, usePool ? &pool : NULL);
+	}
+	Check(status == B_OK, "scale status", colorSpace, filter, size);
+	if (status != B_OK)
+		return;
+
+	bool constant = true;
+	bool padding = true;
+	for (int32 y = 0; y < size[3]; y++) {
+		const uint8* row = &dest[y * destBytesPerRow];
+		for (int32 x = 0; x < size[2]; x++) {
+			if (::memcmp(row + x * pixelSize, &source[0], pixelSize) != 0)
+				constant = false;
+		}
+		for (int32 x = size[2] * pixelSize; x < destBytesPerRow; x++) {
+			if (row[x] != kPaddingByte)
+				padding = false;
+		}
+	}
+	Check(constant, "the color changed", colorSpace, filter, size);
+	Check(padding, "written past the end of a row", colorSpace, filter, size);
+}
+
+
+// From B_RGBA32 pixels to "colorSpace", without padding
+static std::vector<uint8>
+Pack(const std::vector<uint8>& pixels, int32 width, int32 height,
+	color_space colorSpace)
+{
+	const int32 pixelSize = PixelSize(colorSpace);
+	std::vector<uint8> packed(size_t(width) * height * pixelSize);
+	for (int32 y = 0; y < height; y++) {
+		ConvertRowFromRGB32(&pixels[size_t(y) * width * 4],
+			&packed[size_t(y) * width * pixelSize], width, colorSpace);
+	}
+	return packed;
+}
+
+
+static std::vector<uint8>
+Unpack(const std::vector<uint8>& packed, int32 width, int32 height,
+	color_space colorSpace)
+{
+	const int32 pixelSize = PixelSize(colorSpace);
+	std::vector<uint8> pixels(size_t(width) * height * 4);
+	for (int32 y = 0; y < height; y++) {
+		ConvertRowToRGB32(&packed[size_t(y) * width * pixelSize],
+			&pixels[size_t(y) * width * 4], width, colorSpace);
+	}
+	return pixels;
+}
+
+
+// What "value" becomes in every channel of "colorSpace"
+static void
+Quantize(double value, color_space colorSpace, uint8* pixel)
+{
+	const uint8 channel = uint8(std::min(std::max(value, 0.0), 255.0));
+	const uint8 gray[4] = { channel, channel, channel, 255 };
+	uint8 packed[4];
+	ConvertRowFromRGB32(gray, packed, 1, colorSpace);
+	ConvertRowToRGB32(packed, pixel, 1, colorSpace);
+}
+
+
+static status_t
+ScaleImage(const std::vector<uint8>& source, int32 sourceWidth,
+	int32 sourceHeight, std::vector<uint8>& dest, int32 destWidth,
+	int32 destHeight, color_space colorSpace, scale_filter filter)
+{
+	const int32 pixelSize = PixelSize(colorSpace);
+	dest.assign(size_t(destWidth) * destHeight * pixelSize, 0);
+	Scaler scaler(sourceWidth, sourceHeight, destWidth, destHeight,
+		colorSpace, filter);
+	status_t status = scaler.InitCheck();
+	if (status != B_OK)
+		return status;
+	return scaler.Scale(&source[0], sourceWidth * pixelSize, &dest[0],
+		destWidth * pixelSize);
+}
+
+
+// Every source pixel is different: the destination ones tell where
+// they come from
+static void
+TestNearest(color_space colorSpace)
+{
+	const int32 size[] = { 23, 19, 37, 11 };
+	std::vector<uint8> pixels(size_t(size[0]) * size[1] * 4);
+	for (int32 y = 0; y < size[1]; y++) {
+		for (int32 x = 0; x < size[0]; x++) {
+			uint8* pixel = &pixels[(size_t(y) * size[0] + x) * 4];
+			pixel[0] = x * 8;
+			pixel[1] = y * 8;
+			pixel[2] = (x + y) * 4;
+			pixel[3] = 255;
+		}
+	}
+	const std::vector<uint8> source = Pack(pixels, size[0], size[1],
+		colorSpace);
+
+	std::vector<uint8> dest;
+	status_t status = ScaleImage(source, size[0], size[1], dest, size[2],
+		size[3], colorSpace, B_SCALE_NEAREST);
+	Check(status == B_OK, "scale status", colorSpace, B_SCALE_NEAREST, size);
+	if (status != B_OK)
+		return;
+
+	const int32 pixelSize = PixelSize(colorSpace);
+	bool expected = true;
+	for (int32 y = 0; y < size[3]; y++) {
+		const int32 sourceY = (2 * y + 1) * size[1] / (2 * size[3]);
+		for (int32 x = 0; x < size[2]; x++) {
+			const int32 sourceX = (2 * x + 1) * size[0] / (2 * size[2]);
+			if (::memcmp(&dest[(size_t(y) * size[2] + x) * pixelSize],
+					&source[(size_t(sourceY) * size[0] + sourceX) * pixelSize],
+					pixelSize) != 0)
+				expected = false;
+		}
+	}
+	Check(expected, "not the pixel under the center", colorSpace,
+		B_SCALE_NEAREST, size);
+}
+
+
+// Halved, every pixel is the mean of a 2x2 block, rounded after the
+// horizontal pass and after the vertical one
+static void
+TestBox(color_space colorSpace)
+{
+	const int32 size[] = { 32, 24, 16, 12 };
+	uint32 seed = 1;
+	std::vector<uint8> pixels(size_t(size[0]) * size[1] * 4);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		// The color spaces don't keep the alpha channel
+		pixels[i] = i % 4 == 3 ? 255 : seed >> 16;
+	}
+	const std::vector<uint8> source = Pack(pixels, size[0], size[1],
+		colorSpace);
+	// What the scaler sees
+	pixels = Unpack(source, size[0], size[1], colorSpace);
+
+	std::vector<uint8> means(size_t(size[2]) * size[3] * 4);
+	for (int32 y = 0; y < size[3]; y++) {
+		const uint8* top = &pixels[size_t(2 * y) * size[0] * 4];
+		const uint8* bottom = top + size[0] * 4;
+		for (int32 x = 0; x < size[2]; x++) {
+			for (int32 c = 0; c < 4; c++) {
+				const int32 first = (top[x * 8 + c] + top[x * 8 + 4 + c] + 1)
+					/ 2;
+				const int32 second = (bottom[x * 8 + c]
+					+ bottom[x * 8 + 4 + c] + 1) / 2;
+				means[(size_t(y) * size[2] + x) * 4 + c]
+					= (first + second + 1) / 2;
+			}
+		}
+	}
+
+	std::vector<uint8> dest;
+	status_t status = ScaleImage(source, size[0], size[1], dest, size[2],
+		size[3], colorSpace, B_SCALE_BOX);
+	Check(status == B_OK, "scale status", colorSpace, B_SCALE_BOX, size);
+	Check(status == B_OK && dest == Pack(means, size[2], size[3], colorSpace),
+		"not the means of the blocks", colorSpace, B_SCALE_BOX, size);
+}
+
+
+// Enlarged, a ramp is sampled at the centers of the destination pixels,
+// up to the edges for B_SCALE_BILINEAR, and away from them for
+// B_SCALE_LANCZOS, whose lobes would reach past them
+static void
+TestRamp(color_space colorSpace, scale_filter filter, bool vertical)
+{
+	const int32 length = 16;
+	const int32 scaledLength = 61;
+	const int32 across = 3;
+	const double step = 16;
+	const int32 size[] = { vertical ? across : length,
+		vertical ? length : across, vertical ? across : scaledLength,
+		vertical ? scaledLength : across };
+
+	std::vector<uint8> pixels(size_t(size[0]) * size[1] * 4);
+	for (int32 y = 0; y < size[1]; y++) {
+		for (int32 x = 0; x < size[0]; x++) {
+			uint8* pixel = &pixels[(size_t(y) * size[0] + x) * 4];
+			const uint8 value = uint8((vertical ? y : x) * step);
+			pixel[0] = pixel[1] = pixel[2] = value;
+			pixel[3] = 255;
+		}
+	}
+	const std::vector<uint8> source = Pack(pixels, size[0], size[1],
+		colorSpace);
+
+	std::vector<uint8> dest;
+	status_t status = ScaleImage(source, size[0], size[1], dest, size[2],
+		size[3], colorSpace, filter);
+	Check(status == B_OK, "scale status", colorSpace, filter, size);
+	if (status != B_OK)
+		return;
+	const std::vector<uint8> result = Unpack(dest, size[2], size[3],
+		colorSpace);
+	// The ramp the scaler sees: the packed color spaces replicate the
+	// high bits into the low ones
+	const std::vector<uint8> ramp = Unpack(source, size[0], size[1],
+		colorSpace);
+	const int32 rampStep = vertical ? across * 4 : 4;
+
+	const double tolerance = 1;
+	bool expected = true;
+	for (int32 i = 0; i < scaledLength; i++) {
+		double position = (i + 0.5) * length / scaledLength - 0.5;
+		if (filter == B_SCALE_LANCZOS
+			&& (position < 3 || position > length - 4))
+			continue;
+		position = std::min(std::max(position, 0.0), double(length - 1));
+		const int32 before = std::min(int32(position), length - 2);
+		const double fraction = position - before;
+		// The quantized values around the right ones
+		uint8 low[4];
+		uint8 high[4];
+		for (int32 c = 0; c < 3; c++) {
+			const double value = ramp[before * rampStep + c] * (1 - fraction)
+				+ ramp[(before + 1) * rampStep + c] * fraction;
+			uint8 quantized[4];
+			Quantize(::floor(value - tolerance), colorSpace, quantized);
+			low[c] = quantized[c];
+			Quantize(::ceil(value + tolerance), colorSpace, quantized);
+			high[c] = quantized[c];
+		}
+		for (int32 j = 0; j < across; j++) {
+			const uint8* pixel = &result[(vertical
+				? size_t(i) * across + j : size_t(j) * scaledLength + i) * 4];
+			for (int32 c = 0; c < 3; c++) {
+				if (pixel[c] < low[c] || pixel[c] > high[c])
+					expected = false;
+			}
+		}
+	}
+	Check(expected, vertical ? "off the vertical ramp"
+		: "off the horizontal ramp", colorSpace, filter, size);
+}
+
+
+// A gradient, scaled with and without the pool
+static void
+TestPool(ThreadPool& pool, color_space colorSpace, scale_filter filter)
+{
+	const int32 size[] = { 301, 173, 97, 211 };
+	const int32 pixelSize = PixelSize(colorSpace);
+	const int32 sourceBytesPerRow = size[0] * pixelSize;
+	const int32 destBytesPerRow = size[2] * pixelSize;
+	std::vector<uint8> source(size_t(sourceBytesPerRow) * size[1]);
+	for (int32 y = 0; y < size[1]; y++) {
+		for (int32 x = 0; x < sourceBytesPerRow; x++)
+			source[y * sourceBytesPerRow + x] = x * 255 / sourceBytesPerRow + y;
+	}
+
+	std::vector<uint8> pooled(size_t(destBytesPerRow) * size[3]);
+	std::vector<uint8> alone(pooled.size());
+	Scaler scaler(size[0], size[1], size[2], size[3], colorSpace, filter);
+	status_t status = scaler.InitCheck();
+	if (status == B_OK) {
+		status = scaler.Scale(&source[0], sourceBytesPerRow, &pooled[0],
+			destBytesPerRow, &pool);
+	}
+	if (status == B_OK) {
+		status = scaler.Scale(&source[0], sourceBytesPerRow, &alone[0],
+			destBytesPerRow);
+	}
+	Check(status == B_OK, "scale status", colorSpace, filter, size);
+	Check(pooled == alone, "the pool changes the result", colorSpace, filter,
+		size);
+}
+
+
+int
+main()
+{
+	ThreadPool pool("scaler test", 4);
+	if (pool.InitCheck() != B_OK) {
+		printf("Can't start the thread pool\n");
+		return 1;
+	}
+
+	const int32 sizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+	for (size_t i = 0; i < sizeof(kColorSpaces) / sizeof(kColorSpaces[0]);
+			i++) {
+		const color_space colorSpace = kColorSpaces[i];
+		for (size_t f = 0; f < sizeof(kFilters) / sizeof(kFilters[0]); f++) {
+			const scale_filter filter = kFilters[f];
+			if (!Scaler::IsSupported(colorSpace, filter))
+				continue;
+			for (int32 s = 0; s < sizeCount; s++) {
+				TestConstant(pool, colorSpace, filter, kSizes[s], false);
+				TestConstant(pool, colorSpace, filter, kSizes[s], true);
+			}
+			TestPool(pool, colorSpace, filter);
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(kKnownAnswerColorSpaces)
+			/ sizeof(kKnownAnswerColorSpaces[0]); i++) {
+		const color_space colorSpace = kKnownAnswerColorSpaces[i];
+		TestNearest(colorSpace);
+		TestBox(colorSpace);
+		for (int32 vertical = 0; vertical < 2; vertical++) {
+			TestRamp(colorSpace, B_SCALE_BILINEAR, vertical != 0);
+			TestRamp(colorSpace, B_SCALE_LANCZOS, vertical != 0);
+		}
+	}
+
+	printf("Scaler: %" B_PRId32 " checks, %" B_PRId32 " failed\n", sChecks,
+		sFailures);
+	return sFailures == 0 ? 0 : 1;
+}
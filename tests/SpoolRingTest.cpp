@@ -0,0 +1,161 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Records of random sizes, and duplicates, written to a ring until it
+// starts over from the beginning of the memory a few times. After every
+// record, all the ones the ring still holds must read back as they were
+// written, in order, and every duplicate must follow the frame it repeats.
+
+#include "SpoolRing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+const static off_t kMemorySize = 256 * 1024;
+const static off_t kAlignment = 64;
+const static int32 kRecords = 3000;
+
+static int32 sChecks = 0;
+static int32 sFailures = 0;
+
+
+static void
+Check(bool condition, const char* what, int32 record)
+{
+	sChecks++;
+	if (condition)
+		return;
+	sFailures++;
+	printf("FAILED: %s, after record %" B_PRId32 "\n", what, record);
+}
+
+
+static uint32
+Random(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+
+static uint8
+RecordByte(bigtime_t timeStamp, off_t position)
+{
+	return uint8(timeStamp * 31 + position);
+}
+
+
+// Every record holds bytes which depend on its time stamp
+static bool
+RecordIntact(const std::vector<uint8>& memory,
+	const SpoolRing::record& record)
+{
+	for (off_t i = 0; i < record.size; i++) {
+		if (memory[record.offset + i] != RecordByte(record.time_stamp, i))
+			return false;
+	}
+	return true;
+}
+
+
+static void
+CheckRing(const SpoolRing& ring, const std::vector<uint8>& memory,
+	const std::map<bigtime_t, bigtime_t>& repeats, bigtime_t newest,
+	int32 record)
+{
+	const int32 count = ring.CountRecords();
+	Check(count > 0 && ring.RecordAt(count - 1).time_stamp == newest,
+		"the newest frame is missing", record);
+
+	off_t used = 0;
+	bool intact = true;
+	bool ordered = true;
+	bool repeated = true;
+	bigtime_t lastRecord = -1;
+	for (int32 i = 0; i < count; i++) {
+		const SpoolRing::record& current = ring.RecordAt(i);
+		if (i > 0 && current.time_stamp <= ring.RecordAt(i - 1).time_stamp)
+			ordered = false;
+		if (current.offset < 0) {
+			std::map<bigtime_t, bigtime_t>::const_iterator found
+				= repeats.find(current.time_stamp);
+			if (found == repeats.end() || found->second != lastRecord)
+				repeated = false;
+			continue;
+		}
+		lastRecord = current.time_stamp;
+		used += current.size;
+		if (current.offset + current.size > kMemorySize
+			|| !RecordIntact(memory, current))
+			intact = false;
+	}
+	Check(intact, "a record was overwritten", record);
+	Check(ordered, "the records are out of order", record);
+	Check(repeated, "a duplicate repeats another frame", record);
+	Check(used == ring.MemoryUsed(), "the memory used is off", record);
+}
+
+
+// "length" small enough, the ring drops the records by time too
+static void
+TestRing(bigtime_t length, int32 capacity, uint32 seed)
+{
+	SpoolRing ring;
+	Check(ring.Init(kMemorySize, length, capacity) == B_OK, "init", 0);
+
+	std::vector<uint8> memory(kMemorySize, 0);
+	// The frame every duplicate repeats
+	std::map<bigtime_t, bigtime_t> repeats;
+	bigtime_t lastRecord = -1;
+	off_t lastOffset = -1;
+	int32 wraps = 0;
+	for (int32 i = 0; i < kRecords; i++) {
+		const bigtime_t timeStamp = 1000 + bigtime_t(i) * 33333;
+		if (lastRecord >= 0 && Random(seed) % 4 == 0) {
+			Check(ring.AddDuplicate(timeStamp) == B_OK, "duplicate", i);
+			repeats[timeStamp] = lastRecord;
+		} else {
+			// Sometimes as big as the ring allows
+			off_t size = (Random(seed) % (kMemorySize / 4 / kAlignment) + 1)
+				* kAlignment;
+			if (Random(seed) % 10 == 0)
+				size = kMemorySize / 4;
+			off_t offset;
+			status_t status = ring.Reserve(size, timeStamp, &offset);
+			Check(status == B_OK, "reserve", i);
+			if (status != B_OK)
+				continue;
+			if (offset < lastOffset)
+				wraps++;
+			lastOffset = offset;
+			for (off_t j = 0; j < size; j++)
+				memory[offset + j] = RecordByte(timeStamp, j);
+			lastRecord = timeStamp;
+		}
+		CheckRing(ring, memory, repeats, timeStamp, i);
+	}
+	Check(wraps >= 2, "the ring didn't start over twice", kRecords);
+
+	off_t offset;
+	Check(ring.Reserve(kMemorySize / 4 + kAlignment, 0, &offset)
+		== B_NO_MEMORY, "a record bigger than a quarter fits", kRecords);
+}
+
+
+int
+main()
+{
+	// Only the memory limits the ring
+	TestRing(1000000000, 10000, 1);
+	// The time, then the number of records
+	TestRing(2000000, 10000, 2);
+	TestRing(1000000000, 17, 3);
+
+	printf("SpoolRing: %" B_PRId32 " checks, %" B_PRId32 " failed\n",
+		sChecks, sFailures);
+	return sFailures == 0 ? 0 : 1;
+}
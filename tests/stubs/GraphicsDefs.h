@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __STUBS_GRAPHICSDEFS_H
+#define __STUBS_GRAPHICSDEFS_H
+
+// Stands in for the Haiku header when the tests are built on another
+// system. The color spaces have the values Haiku gives them.
+
+#include <SupportDefs.h>
+
+struct rgb_color {
+	uint8	red;
+	uint8	green;
+	uint8	blue;
+	uint8	alpha;
+};
+
+enum color_space {
+	B_NO_COLOR_SPACE = 0x0000,
+	B_RGB32 = 0x0008,
+	B_RGBA32 = 0x2008,
+	B_RGB24 = 0x0003,
+	B_RGB16 = 0x0005,
+	B_RGB15 = 0x0010,
+	B_RGBA15 = 0x2010,
+	B_CMAP8 = 0x0004,
+	B_GRAY8 = 0x0002,
+	B_YCbCr422 = 0x4000,
+	B_YCbCr420 = 0x4004,
+	B_YUV420 = 0x5004
+};
+
+// Only the packed RGB color spaces, B_CMAP8 and B_GRAY8
+status_t get_pixel_size_for(color_space space, size_t* pixelChunk,
+	size_t* rowAlignment, size_t* pixelsPerChunk);
+
+#endif // __STUBS_GRAPHICSDEFS_H
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __STUBS_INTERFACEDEFS_H
+#define __STUBS_INTERFACEDEFS_H
+
+// Stands in for the Haiku header when the tests are built on another
+// system. The system palette comes from Stubs.cpp.
+
+#include <GraphicsDefs.h>
+
+struct color_map {
+	int32		id;
+	rgb_color	color_list[256];
+	uint8		inversion_map[256];
+	uint8		index_map[32768];
+};
+
+const uint8 B_TRANSPARENT_MAGIC_CMAP8 = 0xff;
+
+const color_map* system_colors();
+
+#endif // __STUBS_INTERFACEDEFS_H
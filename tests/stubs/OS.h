@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __STUBS_OS_H
+#define __STUBS_OS_H
+
+// Stands in for the Haiku header when the tests are built on another
+// system: the threads, semaphores and atomics the thread pool uses. The
+// functions come from Stubs.cpp, on top of pthreads. The threads start
+// suspended, like on Haiku, and the priorities are ignored.
+
+#include <SupportDefs.h>
+
+#define B_OS_NAME_LENGTH 32
+
+typedef int32 sem_id;
+typedef int32 thread_id;
+typedef status_t (*thread_func)(void* data);
+#define thread_entry thread_func
+
+enum {
+	B_LOW_PRIORITY = 5,
+	B_NORMAL_PRIORITY = 10,
+	B_DISPLAY_PRIORITY = 15,
+	B_URGENT_DISPLAY_PRIORITY = 20,
+	B_REAL_TIME_DISPLAY_PRIORITY = 100
+};
+
+struct system_info {
+	uint32	cpu_count;
+};
+
+sem_id create_sem(int32 count, const char* name);
+status_t delete_sem(sem_id id);
+status_t acquire_sem(sem_id id);
+status_t acquire_sem_etc(sem_id id, int32 count, uint32 flags,
+	bigtime_t timeout);
+status_t release_sem(sem_id id);
+status_t release_sem_etc(sem_id id, int32 count, uint32 flags);
+
+thread_id spawn_thread(thread_func function, const char* name,
+	int32 priority, void* data);
+status_t resume_thread(thread_id thread);
+status_t wait_for_thread(thread_id thread, status_t* returnValue);
+status_t kill_thread(thread_id thread);
+
+int32 atomic_add(int32* value, int32 addValue);
+
+status_t get_system_info(system_info* info);
+bigtime_t system_time();
+
+#endif // __STUBS_OS_H
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// What the stub headers declare, for the tests built on another system
+
+#include <InterfaceDefs.h>
+#include <OS.h>
+
+#include <cstring>
+#include <map>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+struct stub_sem {
+	pthread_mutex_t	lock;
+	pthread_cond_t	released;
+	int32			count;
+};
+
+struct stub_thread {
+	pthread_t		thread;
+	thread_func		function;
+	void*			data;
+	status_t		returnValue;
+	bool			started;
+};
+
+// Guards the tables and the counters of the semaphores
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<sem_id, stub_sem*> sSems;
+static std::map<thread_id, stub_thread*> sThreads;
+static int32 sNextID = 1;
+
+
+// Like the Haiku one, mostly a cube of 6 levels for every channel, then
+// grays. The last entry is B_TRANSPARENT_MAGIC_CMAP8.
+static void
+InitPalette(color_map& colorMap)
+{
+	::memset(&colorMap, 0, sizeof(colorMap));
+	int32 index = 0;
+	for (int32 red = 0; red < 6; red++) {
+		for (int32 green = 0; green < 6; green++) {
+			for (int32 blue = 0; blue < 6; blue++) {
+				const rgb_color color = { uint8(red * 51), uint8(green * 51),
+					uint8(blue * 51), 255 };
+				colorMap.color_list[index++] = color;
+			}
+		}
+	}
+	for (int32 gray = 1; index < 255; gray++) {
+		// Between the levels of the cube
+		const uint8 level = uint8(gray * 255 / 40);
+		if (level % 51 == 0)
+			continue;
+		const rgb_color color = { level, level, level, 255 };
+		colorMap.color_list[index++] = color;
+	}
+	const rgb_color transparent = { 255, 255, 255, 0 };
+	colorMap.color_list[255] = transparent;
+
+	// The nearest color to every 15 bit one
+	for (int32 i = 0; i < 32768; i++) {
+		const int32 red = ((i >> 10) << 3) | (i >> 12);
+		const int32 green = (((i >> 5) & 31) << 3) | ((i >> 7) & 7);
+		const int32 blue = ((i & 31) << 3) | ((i >> 2) & 7);
+		int32 best = 0;
+		int32 bestDistance = 3 * 256 * 256;
+		for (int32 entry = 0; entry < 255; entry++) {
+			const rgb_color& color = colorMap.color_list[entry];
+			const int32 distance = (color.red - red) * (color.red - red)
+				+ (color.green - green) * (color.green - green)
+				+ (color.blue - blue) * (color.blue - blue);
+			if (distance < bestDistance) {
+				best = entry;
+				bestDistance = distance;
+			}
+		}
+		colorMap.index_map[i] = best;
+	}
+	for (int32 i = 0; i < 256; i++)
+		colorMap.inversion_map[i] = 255 - i;
+}
+
+
+status_t
+get_pixel_size_for(color_space space, size_t* pixelChunk,
+	size_t* rowAlignment, size_t* pixelsPerChunk)
+{
+	size_t chunk;
+	switch (space) {
+		case B_RGB32:
+		case B_RGBA32:
+			chunk = 4;
+			break;
+		case B_RGB24:
+			chunk = 3;
+			break;
+		case B_RGB16:
+		case B_RGB15:
+		case B_RGBA15:
+			chunk = 2;
+			break;
+		case B_CMAP8:
+		case B_GRAY8:
+			chunk = 1;
+			break;
+		default:
+			return B_BAD_VALUE;
+	}
+	if (pixelChunk != NULL)
+		*pixelChunk = chunk;
+	if (rowAlignment != NULL)
+		*rowAlignment = 4;
+	if (pixelsPerChunk != NULL)
+		*pixelsPerChunk = 1;
+	return B_OK;
+}
+
+
+const color_map*
+system_colors()
+{
+	static color_map sColorMap;
+	// Only once, even from different threads
+	static const bool sInitialized = (InitPalette(sColorMap), true);
+	(void)sInitialized;
+	return &sColorMap;
+}
+
+
+bigtime_t
+system_time()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return bigtime_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+
+static stub_sem*
+FindSem(sem_id id)
+{
+	pthread_mutex_lock(&sLock);
+	std::map<sem_id, stub_sem*>::iterator found = sSems.find(id);
+	stub_sem* sem = found != sSems.end() ? found->second : NULL;
+	pthread_mutex_unlock(&sLock);
+	return sem;
+}
+
+
+static stub_thread*
+FindThread(thread_id id)
+{
+	pthread_mutex_lock(&sLock);
+	std::map<thread_id, stub_thread*>::iterator found = sThreads.find(id);
+	stub_thread* thread = found != sThreads.end() ? found->second : NULL;
+	pthread_mutex_unlock(&sLock);
+	return thread;
+}
+
+
+sem_id
+create_sem(int32 count, const char* name)
+{
+	stub_sem* sem = new stub_sem;
+	pthread_mutex_init(&sem->lock, NULL);
+	pthread_cond_init(&sem->released, NULL);
+	sem->count = count;
+
+	pthread_mutex_lock(&sLock);
+	const sem_id id = sNextID++;
+	sSems[id] = sem;
+	pthread_mutex_unlock(&sLock);
+	return id;
+}
+
+
+status_t
+delete_sem(sem_id id)
+{
+	pthread_mutex_lock(&sLock);
+	std::map<sem_id, stub_sem*>::iterator found = sSems.find(id);
+	if (found == sSems.end()) {
+		pthread_mutex_unlock(&sLock);
+		return B_BAD_SEM_ID;
+	}
+	stub_sem* sem = found->second;
+	sSems.erase(found);
+	pthread_mutex_unlock(&sLock);
+
+	pthread_cond_destroy(&sem->released);
+	pthread_mutex_destroy(&sem->lock);
+	delete sem;
+	return B_OK;
+}
+
+
+status_t
+acquire_sem(sem_id id)
+{
+	return acquire_sem_etc(id, 1, 0, 0);
+}
+
+
+// Without timeouts: the tests don't use them
+status_t
+acquire_sem_etc(sem_id id, int32 count, uint32 flags, bigtime_t timeout)
+{
+	stub_sem* sem = FindSem(id);
+	if (sem == NULL)
+		return B_BAD_SEM_ID;
+
+	pthread_mutex_lock(&sem->lock);
+	while (sem->count < count)
+		pthread_cond_wait(&sem->released, &sem->lock);
+	sem->count -= count;
+	pthread_mutex_unlock(&sem->lock);
+	return B_OK;
+}
+
+
+status_t
+release_sem(sem_id id)
+{
+	return release_sem_etc(id, 1, 0);
+}
+
+
+status_t
+release_sem_etc(sem_id id, int32 count, uint32 flags)
+{
+	stub_sem* sem = FindSem(id);
+	if (sem == NULL)
+		return B_BAD_SEM_ID;
+
+	pthread_mutex_lock(&sem->lock);
+	sem->count += count;
+	pthread_cond_broadcast(&sem->released);
+	pthread_mutex_unlock(&sem->lock);
+	return B_OK;
+}
+
+
+static void*
+StartThread(void* data)
+{
+	stub_thread* thread = static_cast<stub_thread*>(data);
+	thread->returnValue = thread->function(thread->data);
+	return NULL;
+}
+
+
+thread_id
+spawn_thread(thread_func function, const char* name, int32 priority,
+	void* data)
+{
+	stub_thread* thread = new stub_thread;
+	thread->function = function;
+	thread->data = data;
+	thread->returnValue = B_OK;
+	thread->started = false;
+
+	pthread_mutex_lock(&sLock);
+	const thread_id id = sNextID++;
+	sThreads[id] = thread;
+	pthread_mutex_unlock(&sLock);
+	return id;
+}
+
+
+status_t
+resume_thread(thread_id id)
+{
+	stub_thread* thread = FindThread(id);
+	if (thread == NULL || thread->started)
+		return B_BAD_THREAD_ID;
+	if (pthread_create(&thread->thread, NULL, StartThread, thread) != 0)
+		return B_NO_MEMORY;
+	thread->started = true;
+	return B_OK;
+}
+
+
+static void
+RemoveThread(thread_id id)
+{
+	pthread_mutex_lock(&sLock);
+	std::map<thread_id, stub_thread*>::iterator found = sThreads.find(id);
+	if (found != sThreads.end()) {
+		delete found->second;
+		sThreads.erase(found);
+	}
+	pthread_mutex_unlock(&sLock);
+}
+
+
+status_t
+wait_for_thread(thread_id id, status_t* returnValue)
+{
+	stub_thread* thread = FindThread(id);
+	if (thread == NULL || !thread->started)
+		return B_BAD_THREAD_ID;
+	pthread_join(thread->thread, NULL);
+	if (returnValue != NULL)
+		*returnValue = thread->returnValue;
+	RemoveThread(id);
+	return B_OK;
+}
+
+
+// Only for threads which were never resumed
+status_t
+kill_thread(thread_id id)
+{
+	stub_thread* thread = FindThread(id);
+	if (thread == NULL || thread->started)
+		return B_BAD_THREAD_ID;
+	RemoveThread(id);
+	return B_OK;
+}
+
+
+int32
+atomic_add(int32* value, int32 addValue)
+{
+	return __atomic_fetch_add(value, addValue, __ATOMIC_SEQ_CST);
+}
+
+
+status_t
+get_system_info(system_info* info)
+{
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	info->cpu_count = count > 0 ? uint32(count) : 1;
+	return B_OK;
+}
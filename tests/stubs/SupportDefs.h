@@ -0,0 +1,47 @@
+/*
+ * Copyright 2026, Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __STUBS_SUPPORTDEFS_H
+#define __STUBS_SUPPORTDEFS_H
+
+// Stands in for the Haiku header when the tests are built on another
+// system: only what the code under test uses. The error codes are
+// distinct, but not the values Haiku gives them.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define B_PRId32 PRId32
+#define B_PRIu32 PRIu32
+
+typedef int8_t		int8;
+typedef uint8_t		uint8;
+typedef int16_t		int16;
+typedef uint16_t	uint16;
+typedef int32_t		int32;
+typedef uint32_t	uint32;
+typedef int64_t		int64;
+typedef uint64_t	uint64;
+
+typedef int32		status_t;
+typedef int64		bigtime_t;
+typedef uintptr_t	addr_t;
+
+enum {
+	B_OK = 0,
+	B_ERROR = -1,
+	B_NO_MEMORY = INT32_MIN,
+	B_BAD_VALUE,
+	B_NOT_SUPPORTED,
+	B_NO_INIT,
+	B_INTERRUPTED,
+	B_TIMED_OUT,
+	B_WOULD_BLOCK,
+	B_BAD_SEM_ID,
+	B_BAD_THREAD_ID
+};
+
+#endif // __STUBS_SUPPORTDEFS_H